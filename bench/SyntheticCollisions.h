@@ -0,0 +1,117 @@
+#pragma once
+#include <nycollision/parser/CSVSchema.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace nycollision {
+namespace bench {
+
+/**
+ * @brief Deterministic generator of CSV rows in the collisions export layout
+ *
+ * Value distributions roughly follow the real export: a handful of boroughs,
+ * mostly-zero casualty counts, a share of rows without coordinates and
+ * quoted LOCATION / street fields.
+ */
+class SyntheticCollisions {
+public:
+    explicit SyntheticCollisions(unsigned seed = 42) : rng_(seed) {}
+
+    static std::string header() {
+        std::string line;
+        for (std::size_t i = 0; i < kCSVColumnCount; ++i) {
+            if (i) line += ',';
+            line += columnName(static_cast<CSVColumn>(i));
+        }
+        return line;
+    }
+
+    /**
+     * @brief Generate one CSV row (without trailing newline)
+     * @param collisionId Value of the COLLISION_ID column
+     */
+    std::string row(int collisionId) {
+        static const char* boroughs[] = {"BROOKLYN", "QUEENS", "MANHATTAN", "BRONX", "STATEN ISLAND", ""};
+        static const char* streets[] = {"BROADWAY", "ATLANTIC AVENUE", "3 AVENUE", "QUEENS BOULEVARD",
+                                        "\"FLATBUSH AVENUE, EXTENSION\"", "\"\"\"B\"\" STREET\"", ""};
+        static const char* factors[] = {"Unspecified", "Driver Inattention/Distraction",
+                                        "Failure to Yield Right-of-Way", "Following Too Closely",
+                                        "Passing or Lane Usage Improper"};
+        static const char* vehicles[] = {"Sedan", "Station Wagon/Sport Utility Vehicle", "TAXI", "Bike",
+                                         "Box Truck", "Bus", "Pick-up Truck", "Motorcycle"};
+
+        char buffer[96];
+        std::string line;
+        line.reserve(320);
+
+        std::snprintf(buffer, sizeof(buffer), "%02d/%02d/%d,%d:%02d,", pick(1, 12), pick(1, 28),
+                      pick(2012, 2025), pick(0, 23), pick(0, 59));
+        line += buffer;
+
+        const char* borough = boroughs[pick(0, 5)];
+        line += borough;
+        line += ',';
+        if (*borough) line += std::to_string(pick(10001, 11697));
+        line += ',';
+
+        if (uniform() < 0.08) {
+            line += ",,,"; // missing coordinates
+        } else {
+            double lat = 40.50 + uniform() * 0.40;
+            double lon = -74.25 + uniform() * 0.55;
+            std::snprintf(buffer, sizeof(buffer), "%.7f,%.7f,\"(%.7f, %.7f)\",", lat, lon, lat, lon);
+            line += buffer;
+        }
+
+        line += streets[pick(0, 6)];
+        line += ',';
+        line += streets[pick(0, 6)];
+        line += ",,";
+
+        // Casualties: persons totals are the sum of the per-type counts
+        int injured[3], killed[3];
+        for (int i = 0; i < 3; ++i) {
+            injured[i] = uniform() < 0.15 ? pick(1, 3) : 0;
+            killed[i] = uniform() < 0.002 ? 1 : 0;
+        }
+        std::snprintf(buffer, sizeof(buffer), "%d,%d,%d,%d,%d,%d,%d,%d,",
+                      injured[0] + injured[1] + injured[2], killed[0] + killed[1] + killed[2],
+                      injured[0], killed[0], injured[1], killed[1], injured[2], killed[2]);
+        line += buffer;
+
+        int vehicleCount = pick(1, 5);
+        for (int i = 0; i < 5; ++i) {
+            if (i < vehicleCount) line += factors[pick(0, 4)];
+            line += ',';
+        }
+        line += std::to_string(collisionId);
+        for (int i = 0; i < 5; ++i) {
+            line += ',';
+            if (i < vehicleCount) line += vehicles[pick(0, 7)];
+        }
+        return line;
+    }
+
+    /**
+     * @brief Generate a full CSV document including the header
+     */
+    std::string document(std::size_t rows, int firstId = 1) {
+        std::string text = header() + "\n";
+        for (std::size_t i = 0; i < rows; ++i) {
+            text += row(firstId + static_cast<int>(i));
+            text += '\n';
+        }
+        return text;
+    }
+
+private:
+    int pick(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng_); }
+    double uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng_); }
+
+    std::mt19937 rng_;
+};
+
+} // namespace bench
+} // namespace nycollision
@@ -0,0 +1,525 @@
+// Concurrent query benchmark: N client threads issue a weighted mix of
+// IDataSet queries against one shared DataSet. Each thread count is run
+// after a warmup, repeated, and reported as throughput and latency
+// percentiles, followed by the scaling curve across thread counts.
+//
+// Usage: query_bench [options]
+//   --csv FILE           Load a collisions export instead of synthetic rows
+//   --rows N             Synthetic rows to generate (default 500000)
+//   --threads LIST       Client thread counts, e.g. 1,2,4,8 (default: powers of two up to the cores)
+//   --mix LIST           Query weights as kind=weight, e.g. geo=4,borough=1 (default: all kinds equally)
+//   --api rows|records|visit
+//                        Query form: rowsBy*() row sets, queryBy*() records, or visitBy*() scans
+//   --limit N            Records visited per visit query (default 100)
+//   --warmup N           Unmeasured queries per thread before each run (default 200)
+//   --ops N              Measured queries per thread in each run (default 2000)
+//   --repeat N           Runs per thread count; the median run's throughput is reported (default 3)
+//   --inner-threads N    Threads each query may use internally, also used for loading (default 1)
+//   --seed N             Seed for data generation and query parameters (default 42)
+//
+// Kinds: geo borough zip date vehicle injury fatality key pedestrian cyclist motorist
+
+#include "SyntheticCollisions.h"
+#include <nycollision/data/DataSet.h>
+#include <nycollision/parser/CSVParser.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Duration = std::chrono::duration<double>;
+using namespace nycollision;
+
+namespace {
+
+enum class Kind {
+    GeoBounds,
+    Borough,
+    ZipCode,
+    DateRange,
+    VehicleType,
+    InjuryRange,
+    FatalityRange,
+    UniqueKey,
+    PedestrianFatalities,
+    CyclistFatalities,
+    MotoristFatalities,
+    Count
+};
+
+constexpr std::size_t kKindCount = static_cast<std::size_t>(Kind::Count);
+const char* const kKindNames[kKindCount] = {"geo",      "borough", "zip",        "date",    "vehicle", "injury",
+                                            "fatality", "key",     "pedestrian", "cyclist", "motorist"};
+
+enum class Api { Rows, Records, Visit };
+
+struct Options {
+    std::string csv;
+    std::size_t rows = 500'000;
+    std::vector<std::size_t> threads;
+    std::vector<double> weights = std::vector<double>(kKindCount, 1.0);
+    Api api = Api::Rows;
+    std::size_t limit = 100;
+    std::size_t warmup = 200;
+    std::size_t ops = 2000;
+    std::size_t repeat = 3;
+    std::size_t innerThreads = 1;
+    unsigned seed = 42;
+};
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + flag);
+        }
+        const std::string value = argv[++i];
+        if (flag == "--csv") {
+            options.csv = value;
+        } else if (flag == "--rows") {
+            options.rows = std::stoul(value);
+        } else if (flag == "--threads") {
+            for (const auto& count : split(value, ',')) {
+                options.threads.push_back(std::max<std::size_t>(std::stoul(count), 1));
+            }
+        } else if (flag == "--mix") {
+            std::fill(options.weights.begin(), options.weights.end(), 0.0);
+            for (const auto& entry : split(value, ',')) {
+                const auto equals = entry.find('=');
+                const std::string name = entry.substr(0, equals);
+                auto kind = std::find(std::begin(kKindNames), std::end(kKindNames), name);
+                if (kind == std::end(kKindNames)) {
+                    throw std::invalid_argument("Unknown query kind: " + name);
+                }
+                options.weights[kind - std::begin(kKindNames)] =
+                    equals == std::string::npos ? 1.0 : std::stod(entry.substr(equals + 1));
+            }
+        } else if (flag == "--api") {
+            if (value == "rows") options.api = Api::Rows;
+            else if (value == "records") options.api = Api::Records;
+            else if (value == "visit") options.api = Api::Visit;
+            else throw std::invalid_argument("Unknown api: " + value);
+        } else if (flag == "--limit") {
+            options.limit = std::stoul(value);
+        } else if (flag == "--warmup") {
+            options.warmup = std::stoul(value);
+        } else if (flag == "--ops") {
+            options.ops = std::max<std::size_t>(std::stoul(value), 1);
+        } else if (flag == "--repeat") {
+            options.repeat = std::max<std::size_t>(std::stoul(value), 1);
+        } else if (flag == "--inner-threads") {
+            options.innerThreads = std::max<std::size_t>(std::stoul(value), 1);
+        } else if (flag == "--seed") {
+            options.seed = static_cast<unsigned>(std::stoul(value));
+        } else {
+            throw std::invalid_argument("Unknown option: " + flag);
+        }
+    }
+    if (options.threads.empty()) {
+        const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        for (std::size_t threads = 1; threads < cores; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(cores);
+    }
+    if (std::all_of(options.weights.begin(), options.weights.end(), [](double w) { return w <= 0.0; })) {
+        throw std::invalid_argument("Query mix has no positive weight");
+    }
+    return options;
+}
+
+// Values that queries draw their parameters from, sampled from the loaded rows
+struct ParameterPool {
+    std::vector<std::string> boroughs;
+    std::vector<std::string> zipCodes;
+    std::vector<std::string> vehicleTypes;
+    std::vector<int> keys;
+    Timestamp firstTimestamp = 0;
+    Timestamp lastTimestamp = 0;
+
+    ParameterPool(const DataSet& dataset, std::mt19937& rng) {
+        const ColumnStore& store = dataset.columns();
+        std::uniform_int_distribution<RowId> anyRow(0, static_cast<RowId>(store.size() - 1));
+        for (int i = 0; i < 4096; ++i) {
+            const RowId row = anyRow(rng);
+            boroughs.push_back(store.borough(row));
+            zipCodes.push_back(store.zipCode(row));
+            vehicleTypes.push_back(store.pool()->decode(StringDomain::VehicleType, store.vehicleTypeCodes(row)[0]));
+            keys.push_back(store.uniqueKey(row));
+        }
+        // Date ranges fall between the first and last known timestamp
+        firstTimestamp = std::numeric_limits<Timestamp>::max();
+        lastTimestamp = std::numeric_limits<Timestamp>::min();
+        for (std::size_t row = 0; row < store.size(); ++row) {
+            const Timestamp timestamp = store.timestamp(static_cast<RowId>(row));
+            if (timestamp != kInvalidTimestamp) {
+                firstTimestamp = std::min(firstTimestamp, timestamp);
+                lastTimestamp = std::max(lastTimestamp, timestamp);
+            }
+        }
+        if (firstTimestamp > lastTimestamp) {
+            firstTimestamp = lastTimestamp = 0;
+        }
+    }
+};
+
+// One client: draws query kinds from the mix and runs them in the chosen form
+class Client {
+public:
+    Client(const IDataSet& dataset, const ParameterPool& pool, const Options& options, unsigned seed)
+        : dataset_(dataset), pool_(pool), options_(options), rng_(seed),
+          mix_(options.weights.begin(), options.weights.end()) {}
+
+    // Run one query; returns its kind and adds its result size to checksum()
+    Kind next() {
+        const auto kind = static_cast<Kind>(mix_(rng_));
+        switch (kind) {
+        case Kind::GeoBounds: {
+            // Boxes from a block to a neighbourhood across the city
+            const float size = 0.002f * std::pow(2.0f, pick(0, 6));
+            const float lat = 40.50f + uniform() * 0.40f;
+            const float lon = -74.25f + uniform() * 0.55f;
+            run(
+                [&] { return dataset_.rowsByGeoBounds(lat, lat + size, lon, lon + size).size(); },
+                [&] { return dataset_.queryByGeoBounds(lat, lat + size, lon, lon + size).size(); },
+                [&](auto& visitor, auto scan) {
+                    return dataset_.visitByGeoBounds(lat, lat + size, lon, lon + size, visitor, scan);
+                });
+            break;
+        }
+        case Kind::Borough: {
+            const std::string& borough = any(pool_.boroughs);
+            run([&] { return dataset_.rowsByBorough(borough).size(); },
+                [&] { return dataset_.queryByBorough(borough).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByBorough(borough, visitor, scan); });
+            break;
+        }
+        case Kind::ZipCode: {
+            const std::string& zipCode = any(pool_.zipCodes);
+            run([&] { return dataset_.rowsByZipCode(zipCode).size(); },
+                [&] { return dataset_.queryByZipCode(zipCode).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByZipCode(zipCode, visitor, scan); });
+            break;
+        }
+        case Kind::DateRange: {
+            // One day to about a month
+            const Timestamp span = kMinutesPerDay * pick(1, 31);
+            const Timestamp start = pool_.firstTimestamp + static_cast<Timestamp>(
+                uniform() * std::max<double>(pool_.lastTimestamp - pool_.firstTimestamp - span, 0.0));
+            const Timestamp end = start + span;
+            run([&] { return dataset_.rowsByDateRange(start, end).size(); },
+                [&] { return dataset_.queryByDateRange(start, end).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByDateRange(start, end, visitor, scan); });
+            break;
+        }
+        case Kind::VehicleType: {
+            const std::string& vehicleType = any(pool_.vehicleTypes);
+            run([&] { return dataset_.rowsByVehicleType(vehicleType).size(); },
+                [&] { return dataset_.queryByVehicleType(vehicleType).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByVehicleType(vehicleType, visitor, scan); });
+            break;
+        }
+        case Kind::InjuryRange: {
+            const int low = pick(1, 6);
+            const int high = low + pick(0, 10);
+            run([&] { return dataset_.rowsByInjuryRange(low, high).size(); },
+                [&] { return dataset_.queryByInjuryRange(low, high).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByInjuryRange(low, high, visitor, scan); });
+            break;
+        }
+        case Kind::FatalityRange: {
+            const int low = pick(1, 2);
+            run([&] { return dataset_.rowsByFatalityRange(low, 99).size(); },
+                [&] { return dataset_.queryByFatalityRange(low, 99).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByFatalityRange(low, 99, visitor, scan); });
+            break;
+        }
+        case Kind::UniqueKey: {
+            // A single record in every form
+            const int key = any(pool_.keys);
+            checksum_ += dataset_.queryByUniqueKey(key) ? 1 : 0;
+            break;
+        }
+        case Kind::PedestrianFatalities:
+            run([&] { return dataset_.rowsByPedestrianFatalities(1, 99).size(); },
+                [&] { return dataset_.queryByPedestrianFatalities(1, 99).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByPedestrianFatalities(1, 99, visitor, scan); });
+            break;
+        case Kind::CyclistFatalities:
+            run([&] { return dataset_.rowsByCyclistFatalities(1, 99).size(); },
+                [&] { return dataset_.queryByCyclistFatalities(1, 99).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByCyclistFatalities(1, 99, visitor, scan); });
+            break;
+        case Kind::MotoristFatalities:
+            run([&] { return dataset_.rowsByMotoristFatalities(1, 99).size(); },
+                [&] { return dataset_.queryByMotoristFatalities(1, 99).size(); },
+                [&](auto& visitor, auto scan) { return dataset_.visitByMotoristFatalities(1, 99, visitor, scan); });
+            break;
+        case Kind::Count:
+            break;
+        }
+        return kind;
+    }
+
+    std::size_t checksum() const { return checksum_; }
+
+private:
+    template <typename Rows, typename Records, typename Visit>
+    void run(Rows&& rows, Records&& records, Visit&& visit) {
+        switch (options_.api) {
+        case Api::Rows:
+            checksum_ += rows();
+            break;
+        case Api::Records:
+            checksum_ += records();
+            break;
+        case Api::Visit: {
+            // Touch a field so the visit materializes each record
+            RecordVisitor visitor = [this](const IRecord& record) {
+                checksum_ += record.getCasualtyStats().getTotalInjuries();
+                return true;
+            };
+            ScanOptions scan;
+            scan.limit = options_.limit;
+            checksum_ += visit(visitor, scan);
+            break;
+        }
+        }
+    }
+
+    int pick(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng_); }
+    float uniform() { return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng_); }
+    template <typename T>
+    const T& any(const std::vector<T>& values) {
+        return values[std::uniform_int_distribution<std::size_t>(0, values.size() - 1)(rng_)];
+    }
+
+    const IDataSet& dataset_;
+    const ParameterPool& pool_;
+    const Options& options_;
+    std::mt19937 rng_;
+    std::discrete_distribution<std::size_t> mix_;
+    std::size_t checksum_ = 0;
+};
+
+struct Sample {
+    Kind kind;
+    double seconds;
+};
+
+struct RunResult {
+    double throughput = 0.0;  // Queries per second over all clients
+    std::vector<Sample> samples;
+    std::size_t checksum = 0;  // Sum of result sizes, so no query can be optimized away
+};
+
+// Start all clients together, warm up, then time ops queries each
+RunResult runClients(const IDataSet& dataset, const ParameterPool& pool, const Options& options,
+                     std::size_t threads, unsigned seed) {
+    std::vector<std::vector<Sample>> samples(threads);
+    std::vector<std::size_t> checksums(threads);
+    std::atomic<std::size_t> warmedUp{0};
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> clients;
+    for (std::size_t t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t] {
+            Client client(dataset, pool, options, seed + static_cast<unsigned>(t));
+            for (std::size_t i = 0; i < options.warmup; ++i) {
+                client.next();
+            }
+            warmedUp.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            samples[t].reserve(options.ops);
+            for (std::size_t i = 0; i < options.ops; ++i) {
+                auto begin = Clock::now();
+                Kind kind = client.next();
+                samples[t].push_back({kind, Duration(Clock::now() - begin).count()});
+            }
+            checksums[t] = client.checksum();
+        });
+    }
+    while (warmedUp.load() < threads) {
+        std::this_thread::yield();
+    }
+    const auto start = Clock::now();
+    go.store(true);
+    for (auto& client : clients) {
+        client.join();
+    }
+    const double elapsed = Duration(Clock::now() - start).count();
+
+    RunResult result;
+    result.throughput = threads * options.ops / elapsed;
+    for (auto& clientSamples : samples) {
+        result.samples.insert(result.samples.end(), clientSamples.begin(), clientSamples.end());
+    }
+    for (std::size_t value : checksums) {
+        result.checksum += value;
+    }
+    return result;
+}
+
+struct Percentiles {
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+Percentiles percentilesOf(std::vector<double> seconds) {
+    Percentiles p;
+    if (seconds.empty()) return p;
+    std::sort(seconds.begin(), seconds.end());
+    auto at = [&](double q) { return seconds[std::min(seconds.size() - 1, static_cast<std::size_t>(q * seconds.size()))]; };
+    p.p50 = at(0.50);
+    p.p99 = at(0.99);
+    p.p999 = at(0.999);
+    p.max = seconds.back();
+    return p;
+}
+
+void printLatencyRow(const std::string& name, std::size_t count, const Percentiles& p) {
+    std::cout << "  " << std::setw(12) << std::left << name << std::right << std::setw(9) << count
+              << std::fixed << std::setprecision(1) << std::setw(11) << p.p50 * 1e6 << std::setw(11)
+              << p.p99 * 1e6 << std::setw(11) << p.p999 * 1e6 << std::setw(11) << p.max * 1e6 << "\n";
+}
+
+std::string loadInput(const Options& options) {
+    if (!options.csv.empty()) {
+        return options.csv;
+    }
+    // DataSet loads from files, so synthetic rows go through a temporary one
+    auto path = std::filesystem::temp_directory_path() /
+                ("query_bench_" + std::to_string(options.rows) + "_" + std::to_string(options.seed) + ".csv");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << bench::SyntheticCollisions(options.seed).document(options.rows);
+    if (!out) {
+        throw std::runtime_error("Failed to write synthetic data to " + path.string());
+    }
+    return path.string();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = parseOptions(argc, argv);
+
+        // Parallelism comes from the clients; queries get only innerThreads each
+        ExecutionContext::Options contextOptions;
+        contextOptions.threads = options.innerThreads;
+        CSVParser parser;
+        DataSet dataset(parser.stringPool(), std::make_shared<ExecutionContext>(contextOptions));
+        const std::string input = loadInput(options);
+        auto loadStart = Clock::now();
+        dataset.loadFromFile(input, parser);
+        const double loadTime = Duration(Clock::now() - loadStart).count();
+        if (options.csv.empty()) {
+            std::filesystem::remove(input);
+        }
+        if (dataset.size() == 0) {
+            throw std::runtime_error("No rows loaded");
+        }
+
+        std::mt19937 rng(options.seed);
+        const ParameterPool pool(dataset, rng);
+
+        static const char* apiNames[] = {"rowsBy*()", "queryBy*()", "visitBy*()"};
+        std::cout << "Rows: " << dataset.size() << (options.csv.empty() ? " (synthetic)" : "")
+                  << ", loaded in " << std::fixed << std::setprecision(2) << loadTime << " s\n"
+                  << "API: " << apiNames[static_cast<int>(options.api)] << ", mix:" << std::defaultfloat;
+        for (std::size_t k = 0; k < kKindCount; ++k) {
+            if (options.weights[k] > 0.0) std::cout << " " << kKindNames[k] << "=" << options.weights[k];
+        }
+        std::cout << "\nPer thread count: " << options.repeat << " runs of " << options.ops
+                  << " queries per client after " << options.warmup << " warmup queries\n";
+
+        struct CurvePoint {
+            std::size_t threads;
+            double throughput;
+            Percentiles latency;
+        };
+        std::vector<CurvePoint> curve;
+
+        for (std::size_t threads : options.threads) {
+            std::vector<RunResult> runs;
+            for (std::size_t r = 0; r < options.repeat; ++r) {
+                runs.push_back(runClients(dataset, pool, options, threads, options.seed + 1000 * (r + 1)));
+            }
+            std::sort(runs.begin(), runs.end(),
+                      [](const RunResult& a, const RunResult& b) { return a.throughput < b.throughput; });
+            const double throughput = runs[runs.size() / 2].throughput;
+
+            // Latencies pool every run of this thread count
+            std::vector<double> all;
+            std::vector<std::vector<double>> byKind(kKindCount);
+            for (const auto& run : runs) {
+                for (const auto& sample : run.samples) {
+                    all.push_back(sample.seconds);
+                    byKind[static_cast<std::size_t>(sample.kind)].push_back(sample.seconds);
+                }
+            }
+
+            std::cout << "\n=== " << threads << " client thread" << (threads == 1 ? "" : "s") << " ===\n"
+                      << "Throughput: " << std::fixed << std::setprecision(0) << throughput << " queries/s"
+                      << " (runs " << std::setprecision(0) << runs.front().throughput << " - "
+                      << runs.back().throughput << "), checksum " << runs.front().checksum << "\n"
+                      << "  " << std::setw(12) << std::left << "latency us" << std::right << std::setw(9) << "count"
+                      << std::setw(11) << "p50" << std::setw(11) << "p99" << std::setw(11) << "p99.9"
+                      << std::setw(11) << "max" << "\n";
+            for (std::size_t k = 0; k < kKindCount; ++k) {
+                if (!byKind[k].empty()) {
+                    printLatencyRow(kKindNames[k], byKind[k].size(), percentilesOf(byKind[k]));
+                }
+            }
+            const Percentiles overall = percentilesOf(all);
+            printLatencyRow("all", all.size(), overall);
+            curve.push_back({threads, throughput, overall});
+        }
+
+        std::cout << "\n=== Scaling ===\n"
+                  << std::setw(8) << "threads" << std::setw(14) << "queries/s" << std::setw(10) << "speedup"
+                  << std::setw(12) << "efficiency" << std::setw(11) << "p50 us" << std::setw(11) << "p99 us"
+                  << std::setw(11) << "p99.9 us" << "\n";
+        const double base = curve.front().throughput / curve.front().threads;
+        for (const auto& point : curve) {
+            const double speedup = point.throughput / base;
+            std::cout << std::setw(8) << point.threads << std::fixed << std::setprecision(0) << std::setw(14)
+                      << point.throughput << std::setprecision(2) << std::setw(10) << speedup
+                      << std::setprecision(0) << std::setw(11) << 100.0 * speedup / point.threads << "%"
+                      << std::setprecision(1) << std::setw(11) << point.latency.p50 * 1e6 << std::setw(11)
+                      << point.latency.p99 * 1e6 << std::setw(11) << point.latency.p999 * 1e6 << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Distance query benchmark: k-nearest-neighbour and radius queries through
+// the R-tree against a scan of every row's great-circle distance. Results
+// of both methods are compared row for row. The kNN table also counts the
+// queries whose k nearest by planar lat/lon distance differ from the true
+// k nearest, the error of ranking NYC points in raw degrees. DBSCAN over a
+// grid of eps-sized cells is compared with the pairwise baseline.
+//
+// Usage: spatial_bench [collisions.csv] [rows] [queries]
+// Without a file, synthetic rows are generated (default 500000 rows, 100 queries).
+
+#include "SyntheticCollisions.h"
+#include <nycollision/data/DataSet.h>
+#include <nycollision/parser/CSVParser.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Duration = std::chrono::duration<double>;
+using namespace nycollision;
+
+namespace {
+
+struct Probe {
+    float latitude;
+    float longitude;
+};
+
+// Points near stored collisions, so queries land where the data is
+std::vector<Probe> makeProbes(const DataSet& dataset, std::size_t count, std::mt19937& rng) {
+    const auto& lats = dataset.columns().latitudes();
+    const auto& lons = dataset.columns().longitudes();
+    std::vector<RowId> located;
+    for (std::size_t row = 0; row < lats.size(); ++row) {
+        if (lats[row] != 0.0f && lons[row] != 0.0f) {
+            located.push_back(static_cast<RowId>(row));
+        }
+    }
+    if (located.empty()) {
+        throw std::runtime_error("No rows with coordinates");
+    }
+    std::uniform_int_distribution<std::size_t> pick(0, located.size() - 1);
+    std::uniform_real_distribution<float> jitter(-0.002f, 0.002f);
+    std::vector<Probe> probes;
+    for (std::size_t i = 0; i < count; ++i) {
+        const RowId row = located[pick(rng)];
+        probes.push_back({lats[row] + jitter(rng), lons[row] + jitter(rng)});
+    }
+    return probes;
+}
+
+bool sameRows(const std::vector<DataSet::Neighbor>& a, const std::vector<DataSet::Neighbor>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](const auto& x, const auto& y) { return x.row == y.row; });
+}
+
+// Whether the k nearest rows in planar degrees are the true k nearest
+bool planarAgrees(const DataSet& dataset, const Probe& probe, const std::vector<DataSet::Neighbor>& truth) {
+    const auto& lats = dataset.columns().latitudes();
+    const auto& lons = dataset.columns().longitudes();
+    std::vector<std::pair<double, RowId>> planar(lats.size());
+    for (std::size_t row = 0; row < lats.size(); ++row) {
+        const double dLat = lats[row] - probe.latitude;
+        const double dLon = lons[row] - probe.longitude;
+        planar[row] = {dLat * dLat + dLon * dLon, static_cast<RowId>(row)};
+    }
+    const std::size_t k = truth.size();
+    std::partial_sort(planar.begin(), planar.begin() + k, planar.end());
+    std::vector<RowId> planarRows, trueRows;
+    for (std::size_t i = 0; i < k; ++i) {
+        planarRows.push_back(planar[i].second);
+        trueRows.push_back(truth[i].row);
+    }
+    std::sort(planarRows.begin(), planarRows.end());
+    std::sort(trueRows.begin(), trueRows.end());
+    return planarRows == trueRows;
+}
+
+template <typename Func>
+double timePerQuery(const std::vector<Probe>& probes, Func&& func) {
+    auto start = Clock::now();
+    for (const auto& probe : probes) {
+        func(probe);
+    }
+    return Duration(Clock::now() - start).count() / probes.size();
+}
+
+void printHeader(const char* parameter) {
+    std::cout << std::setw(10) << std::left << parameter << std::right << std::setw(12) << "rows/query"
+              << std::setw(14) << "R-tree (us)" << std::setw(14) << "scan (us)" << std::setw(10) << "speedup"
+              << std::setw(12) << "mismatches";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const std::size_t rows = argc > 2 ? std::stoul(argv[2]) : 500'000;
+        const std::size_t queries = argc > 3 ? std::stoul(argv[3]) : 100;
+
+        std::string input;
+        if (argc > 1) {
+            input = argv[1];
+        } else {
+            // DataSet loads from files, so synthetic rows go through a temporary one
+            input = (std::filesystem::temp_directory_path() / ("spatial_bench_" + std::to_string(rows) + ".csv"))
+                        .string();
+            std::ofstream out(input, std::ios::binary | std::ios::trunc);
+            out << bench::SyntheticCollisions().document(rows);
+            if (!out) {
+                throw std::runtime_error("Failed to write synthetic data to " + input);
+            }
+        }
+
+        CSVParser parser;
+        DataSet dataset(parser.stringPool());
+        dataset.loadFromFile(input, parser);
+        if (argc <= 1) {
+            std::filesystem::remove(input);
+        }
+
+        std::mt19937 rng(42);
+        const auto probes = makeProbes(dataset, queries, rng);
+        std::cout << "Rows: " << dataset.size() << (argc > 1 ? "" : " (synthetic)") << ", queries: " << queries
+                  << "\n\n=== k nearest ===\n";
+        printHeader("k");
+        std::cout << std::setw(16) << "planar wrong" << "\n";
+
+        for (std::size_t k : {1, 10, 100, 1000}) {
+            std::size_t mismatches = 0, planarWrong = 0;
+            for (const auto& probe : probes) {
+                auto indexed = dataset.neighbors(probe.latitude, probe.longitude, k);
+                auto scanned = dataset.neighborsBruteForce(probe.latitude, probe.longitude, k);
+                mismatches += !sameRows(indexed, scanned);
+                planarWrong += !planarAgrees(dataset, probe, scanned);
+            }
+            const double indexed = timePerQuery(probes, [&](const Probe& p) {
+                return dataset.neighbors(p.latitude, p.longitude, k);
+            });
+            const double scanned = timePerQuery(probes, [&](const Probe& p) {
+                return dataset.neighborsBruteForce(p.latitude, p.longitude, k);
+            });
+            std::cout << std::setw(10) << std::left << k << std::right << std::setw(12) << k << std::fixed
+                      << std::setprecision(1) << std::setw(14) << indexed * 1e6 << std::setw(14) << scanned * 1e6
+                      << std::setw(9) << scanned / indexed << "x" << std::setw(12) << mismatches << std::setw(16)
+                      << planarWrong << std::defaultfloat << std::setprecision(6) << "\n";
+        }
+
+        std::cout << "\n=== Within radius ===\n";
+        printHeader("meters");
+        std::cout << "\n";
+        for (double meters : {50.0, 250.0, 1000.0, 5000.0}) {
+            std::size_t mismatches = 0, found = 0;
+            for (const auto& probe : probes) {
+                auto indexed = dataset.neighborsWithin(probe.latitude, probe.longitude, meters);
+                auto scanned = dataset.neighborsWithinBruteForce(probe.latitude, probe.longitude, meters);
+                mismatches += !sameRows(indexed, scanned);
+                found += indexed.size();
+            }
+            const double indexed = timePerQuery(probes, [&](const Probe& p) {
+                return dataset.neighborsWithin(p.latitude, p.longitude, meters);
+            });
+            const double scanned = timePerQuery(probes, [&](const Probe& p) {
+                return dataset.neighborsWithinBruteForce(p.latitude, p.longitude, meters);
+            });
+            std::cout << std::setw(10) << std::left << static_cast<int>(meters) << std::right << std::setw(12)
+                      << found / probes.size() << std::fixed << std::setprecision(1) << std::setw(14)
+                      << indexed * 1e6 << std::setw(14) << scanned * 1e6 << std::setw(9) << scanned / indexed
+                      << "x" << std::setw(12) << mismatches << std::defaultfloat << std::setprecision(6) << "\n";
+        }
+
+        // The pairwise baseline is quadratic, so both run on a prefix of the rows
+        std::cout << "\n=== DBSCAN (minPoints 10) ===\n" << std::setw(10) << std::left << "meters" << std::right
+                  << std::setw(12) << "rows" << std::setw(12) << "clusters" << std::setw(14) << "grid (ms)"
+                  << std::setw(14) << "pairwise (ms)" << std::setw(10) << "speedup" << std::setw(12) << "mismatches"
+                  << "\n";
+        std::vector<RowId> sample(std::min<std::size_t>(dataset.size(), 5'000));
+        std::iota(sample.begin(), sample.end(), 0);
+        for (double meters : {50.0, 250.0, 1000.0}) {
+            auto start = Clock::now();
+            auto grid = SpatialClustering::dbscan(dataset.columns(), sample, meters, 10, dataset.executionContext());
+            const double gridTime = Duration(Clock::now() - start).count();
+            start = Clock::now();
+            auto pairwise = SpatialClustering::dbscanBruteForce(dataset.columns(), sample, meters, 10);
+            const double pairwiseTime = Duration(Clock::now() - start).count();
+            std::size_t mismatches = 0;
+            for (std::size_t i = 0; i < grid.labels().size(); ++i) {
+                mismatches += grid.labels()[i] != pairwise.labels()[i];
+            }
+            std::cout << std::setw(10) << std::left << static_cast<int>(meters) << std::right << std::setw(12)
+                      << grid.rows().size() << std::setw(12) << grid.clusters().size() << std::fixed
+                      << std::setprecision(1) << std::setw(14) << gridTime * 1e3 << std::setw(14)
+                      << pairwiseTime * 1e3 << std::setw(9) << pairwiseTime / gridTime << "x" << std::setw(12)
+                      << mismatches << std::defaultfloat << std::setprecision(6) << "\n";
+        }
+
+        // Every row, grid only
+        std::vector<RowId> all(dataset.size());
+        std::iota(all.begin(), all.end(), 0);
+        auto start = Clock::now();
+        auto clustered = SpatialClustering::dbscan(dataset.columns(), all, 100.0, 10, dataset.executionContext());
+        std::cout << "All " << clustered.rows().size() << " located rows at 100 m: " << clustered.clusters().size()
+                  << " clusters, " << clustered.noise() << " noise in " << std::fixed << std::setprecision(1)
+                  << Duration(Clock::now() - start).count() * 1e3 << " ms" << std::defaultfloat
+                  << std::setprecision(6) << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Micro-benchmark of CSV tokenizing on the 29-column collisions layout.
+//
+// Usage: tokenizer_bench [collisions.csv] [rows]
+// Without a file, synthetic rows are generated.
+
+#include "SyntheticCollisions.h"
+#include <nycollision/parser/CSVParser.h>
+#include <nycollision/util/MappedFile.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using Duration = std::chrono::duration<double>;
+using nycollision::CSVParser;
+using nycollision::CSVScanner;
+using nycollision::FieldBuffer;
+
+namespace {
+
+// The original character-at-a-time tokenizer, kept as the baseline
+std::vector<std::string> legacyTokenize(const std::string& line, char delimiter = ',', char quote = '"') {
+    std::vector<std::string> tokens;
+    bool inQuotes = false;
+    std::ostringstream currentToken;
+
+    for (size_t i = 0; i < line.length(); ++i) {
+        char c = line[i];
+        if (c == quote) {
+            if (inQuotes && i + 1 < line.length() && line[i + 1] == quote) {
+                currentToken << c;
+                ++i;
+            } else {
+                inQuotes = !inQuotes;
+            }
+        } else if (c == delimiter && !inQuotes) {
+            tokens.push_back(currentToken.str());
+            currentToken.str("");
+            currentToken.clear();
+        } else {
+            currentToken << c;
+        }
+    }
+    tokens.push_back(currentToken.str());
+    return tokens;
+}
+
+// Run func over every line a few times and report the best pass
+template <typename Func>
+void report(const std::string& name, const std::vector<std::string>& lines, std::size_t bytes, Func&& func) {
+    constexpr int kPasses = 3;
+    double best = 0.0;
+    std::size_t checksum = 0;
+    for (int pass = 0; pass < kPasses; ++pass) {
+        checksum = 0;
+        auto start = Clock::now();
+        for (const auto& line : lines) {
+            checksum += func(line);
+        }
+        Duration elapsed = Clock::now() - start;
+        if (pass == 0 || elapsed.count() < best) best = elapsed.count();
+    }
+    std::cout << std::setw(28) << std::left << name
+              << std::setw(10) << std::right << std::fixed << std::setprecision(1)
+              << (bytes / best / 1e6) << " MB/s"
+              << std::setw(12) << std::setprecision(1) << (lines.size() / best / 1e6) << " Mrows/s"
+              << "   fields=" << checksum << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t rowLimit = argc > 2 ? std::stoul(argv[2]) : 500'000;
+
+    std::string text;
+    if (argc > 1) {
+        nycollision::MappedFile file(argv[1]);
+        text.assign(file.data(), file.size());
+    } else {
+        text = nycollision::bench::SyntheticCollisions().document(rowLimit);
+    }
+
+    // Split into records once, skipping the header
+    CSVParser parser;
+    std::vector<std::string> lines;
+    std::string_view rest(text);
+    rest.remove_prefix(parser.recordLength(rest));
+    std::size_t bytes = 0;
+    while (!rest.empty() && lines.size() < rowLimit) {
+        std::size_t length = parser.recordLength(rest);
+        std::string_view record = rest.substr(0, length);
+        rest.remove_prefix(length);
+        while (!record.empty() && (record.back() == '\n' || record.back() == '\r')) record.remove_suffix(1);
+        lines.emplace_back(record);
+        bytes += record.size();
+    }
+
+    std::cout << "Rows: " << lines.size() << ", bytes: " << bytes
+              << ", best kernel: " << CSVScanner(',', '"').kernelName() << "\n\n";
+
+    std::cout << "=== Tokenize ===\n";
+    report("legacy ostringstream", lines, bytes, [](const std::string& line) {
+        return legacyTokenize(line).size();
+    });
+    report("tokenize -> vector<string>", lines, bytes, [&](const std::string& line) {
+        return parser.tokenize(line).size();
+    });
+
+    for (auto kernel : {CSVScanner::Kernel::Scalar, CSVScanner::Kernel::SSE42, CSVScanner::Kernel::AVX2}) {
+        if (!CSVScanner::isSupported(kernel)) continue;
+        CSVScanner scanner(',', '"', kernel);
+        std::vector<std::uint32_t> positions;
+        report(std::string("delimiter scan ") + scanner.kernelName(), lines, bytes, [&](const std::string& line) {
+            scanner.findDelimiters(line, positions);
+            return positions.size() + 1;
+        });
+    }
+
+    FieldBuffer fields;
+    report("tokenize -> FieldBuffer", lines, bytes, [&](const std::string& line) {
+        return parser.tokenize(std::string_view(line), fields);
+    });
+
+    std::cout << "\n=== Record boundaries ===\n";
+    std::vector<std::string> document{text};
+    report("byte loop", document, text.size(), [](const std::string& data) {
+        std::size_t records = 0;
+        bool inQuotes = false;
+        for (char c : data) {
+            if (c == '"') inQuotes = !inQuotes;
+            else if (c == '\n' && !inQuotes) ++records;
+        }
+        return records;
+    });
+    for (auto kernel : {CSVScanner::Kernel::Scalar, CSVScanner::Kernel::SSE42, CSVScanner::Kernel::AVX2}) {
+        if (!CSVScanner::isSupported(kernel)) continue;
+        CSVScanner scanner(',', '"', kernel);
+        report(std::string("findRecordEnd ") + scanner.kernelName(), document, text.size(), [&](const std::string& data) {
+            std::size_t records = 0;
+            std::string_view view(data);
+            while (!view.empty()) {
+                view.remove_prefix(scanner.findRecordEnd(view));
+                ++records;
+            }
+            return records;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+namespace nycollision {
+
+/**
+ * @brief Mean Earth radius (IUGG) used for every distance in meters
+ */
+constexpr double kEarthRadiusMeters = 6371008.8;
+
+constexpr double kRadiansPerDegree = 3.14159265358979323846 / 180.0;
+
+/**
+ * @brief Great-circle distance between two points on a spherical Earth
+ *
+ * Haversine formula; within 0.5% of the ellipsoidal distance, and exact
+ * enough at street scale that rounding of the float coordinates dominates.
+ *
+ * @return Meters
+ */
+inline double distanceMeters(double lat1, double lon1, double lat2, double lon2) {
+    const double sinLat = std::sin((lat2 - lat1) * kRadiansPerDegree / 2);
+    const double sinLon = std::sin((lon2 - lon1) * kRadiansPerDegree / 2);
+    const double h = sinLat * sinLat +
+                     std::cos(lat1 * kRadiansPerDegree) * std::cos(lat2 * kRadiansPerDegree) * sinLon * sinLon;
+    return 2 * kEarthRadiusMeters * std::asin(std::min(1.0, std::sqrt(h)));
+}
+
+/**
+ * @brief Latitude/longitude half-extents of the smallest box holding a circle
+ *
+ * Every point within the radius of the center lies within
+ * [lat +- latDegrees] x [lon +- lonDegrees]. A circle reaching a pole spans
+ * every longitude (lonDegrees = 180).
+ */
+struct DegreeExtent {
+    double latDegrees = 0.0;
+    double lonDegrees = 0.0;
+};
+
+inline DegreeExtent degreeExtent(double latitude, double meters) {
+    const double angle = meters / kEarthRadiusMeters;
+    const double cosLat = std::cos(latitude * kRadiansPerDegree);
+    DegreeExtent extent;
+    extent.latDegrees = angle / kRadiansPerDegree;
+    const bool reachesPole = angle >= 3.14159265358979323846 / 2 || std::sin(angle) >= cosLat;
+    extent.lonDegrees = reachesPole ? 180.0 : std::asin(std::sin(angle) / cosLat) / kRadiansPerDegree;
+    return extent;
+}
+
+} // namespace nycollision
@@ -21,6 +21,7 @@ public:
 
     // Time information
     virtual Date getDateTime() const = 0;
+    virtual Timestamp getTimestamp() const { return getDateTime().toTimestamp(); }
 
     // Casualty information
     virtual const CasualtyStats& getCasualtyStats() const = 0;
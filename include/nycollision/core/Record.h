@@ -1,56 +1,133 @@
 #pragma once
 #include "IRecord.h"
+#include "StringPool.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 namespace nycollision {
 
 /**
  * @brief Concrete implementation of a collision record
+ *
+ * Categorical strings are interned in a StringPool and stored as codes;
+ * getters decode them on access. VehicleInfo is materialized on first use,
+ * so a record should be fully built before it is read.
  */
 class Record : public IRecord {
 public:
+    using Code = StringPool::Code;
+    static constexpr std::size_t kVehicleSlots = 5;
+    using VehicleCodes = std::array<Code, kVehicleSlots>; // empty slots at the end
+
+    explicit Record(std::shared_ptr<StringPool> pool = StringPool::global())
+        : pool_(std::move(pool)) {}
+
     // Location information
-    const std::string& getBorough() const override { return borough_; }
-    const std::string& getZipCode() const override { return zip_code_; }
+    const std::string& getBorough() const override { return decode(StringDomain::Borough, borough_); }
+    const std::string& getZipCode() const override { return decode(StringDomain::ZipCode, zip_code_); }
     GeoCoordinate getLocation() const override { return location_; }
-    const std::string& getOnStreet() const override { return on_street_; }
-    const std::string& getCrossStreet() const override { return cross_street_; }
-    const std::string& getOffStreet() const override { return off_street_; }
+    const std::string& getOnStreet() const override { return decode(StringDomain::Street, on_street_); }
+    const std::string& getCrossStreet() const override { return decode(StringDomain::Street, cross_street_); }
+    const std::string& getOffStreet() const override { return decode(StringDomain::Street, off_street_); }
 
     // Time information
-    Date getDateTime() const override { return date_time_; }
+    Date getDateTime() const override { return Date::fromTimestamp(timestamp_); }
+    Timestamp getTimestamp() const override { return timestamp_; }
 
     // Casualty information
     const CasualtyStats& getCasualtyStats() const override { return casualty_stats_; }
 
     // Vehicle information
-    const VehicleInfo& getVehicleInfo() const override { return vehicle_info_; }
+    const VehicleInfo& getVehicleInfo() const override {
+        std::call_once(vehicle_info_once_, [this] {
+            VehicleInfo info;
+            for (Code code : contributing_factors_) {
+                if (code == StringPool::kEmpty) break;
+                info.contributing_factors.push_back(decode(StringDomain::ContributingFactor, code));
+            }
+            for (Code code : vehicle_types_) {
+                if (code == StringPool::kEmpty) break;
+                info.vehicle_types.push_back(decode(StringDomain::VehicleType, code));
+            }
+            vehicle_info_ = std::move(info);
+        });
+        return *vehicle_info_;
+    }
 
     // Unique identifier
     int getUniqueKey() const override { return unique_key_; }
 
+    // Dictionary codes, valid in getStringPool()
+    const std::shared_ptr<StringPool>& getStringPool() const { return pool_; }
+    Code getBoroughCode() const { return borough_; }
+    Code getZipCodeCode() const { return zip_code_; }
+    Code getOnStreetCode() const { return on_street_; }
+    Code getCrossStreetCode() const { return cross_street_; }
+    Code getOffStreetCode() const { return off_street_; }
+    const VehicleCodes& getVehicleTypeCodes() const { return vehicle_types_; }
+    const VehicleCodes& getContributingFactorCodes() const { return contributing_factors_; }
+
     // Setters for building the record
-    void setBorough(const std::string& borough) { borough_ = borough; }
-    void setZipCode(const std::string& zip) { zip_code_ = zip; }
+    void setBorough(std::string_view borough) { borough_ = pool_->encode(StringDomain::Borough, borough); }
+    void setZipCode(std::string_view zip) { zip_code_ = pool_->encode(StringDomain::ZipCode, zip); }
     void setLocation(const GeoCoordinate& loc) { location_ = loc; }
-    void setOnStreet(const std::string& street) { on_street_ = street; }
-    void setCrossStreet(const std::string& street) { cross_street_ = street; }
-    void setOffStreet(const std::string& street) { off_street_ = street; }
-    void setDateTime(const Date& dt) { date_time_ = dt; }
+    void setOnStreet(std::string_view street) { on_street_ = pool_->encode(StringDomain::Street, street); }
+    void setCrossStreet(std::string_view street) { cross_street_ = pool_->encode(StringDomain::Street, street); }
+    void setOffStreet(std::string_view street) { off_street_ = pool_->encode(StringDomain::Street, street); }
+    void setDateTime(const Date& dt) { timestamp_ = dt.toTimestamp(); }
+    void setTimestamp(Timestamp timestamp) { timestamp_ = timestamp; }
     void setCasualtyStats(const CasualtyStats& stats) { casualty_stats_ = stats; }
-    void setVehicleInfo(const VehicleInfo& info) { vehicle_info_ = info; }
+    void setVehicleInfo(const VehicleInfo& info) {
+        vehicle_types_ = encodeSlots(StringDomain::VehicleType, info.vehicle_types);
+        contributing_factors_ = encodeSlots(StringDomain::ContributingFactor, info.contributing_factors);
+    }
     void setUniqueKey(int key) { unique_key_ = key; }
 
+    // Code setters, for parsers that encode into getStringPool() themselves
+    void setBoroughCode(Code code) { borough_ = code; }
+    void setZipCodeCode(Code code) { zip_code_ = code; }
+    void setStreetCodes(Code on, Code cross, Code off) {
+        on_street_ = on;
+        cross_street_ = cross;
+        off_street_ = off;
+    }
+    void setVehicleCodes(const VehicleCodes& types, const VehicleCodes& factors) {
+        vehicle_types_ = types;
+        contributing_factors_ = factors;
+    }
+
 private:
-    std::string borough_;
-    std::string zip_code_;
+    const std::string& decode(StringDomain domain, Code code) const { return pool_->decode(domain, code); }
+
+    VehicleCodes encodeSlots(StringDomain domain, const std::vector<std::string>& values) const {
+        VehicleCodes codes{};
+        std::size_t filled = 0;
+        for (const auto& value : values) {
+            if (filled == kVehicleSlots) break;
+            if (!value.empty()) codes[filled++] = pool_->encode(domain, value);
+        }
+        return codes;
+    }
+
+    std::shared_ptr<StringPool> pool_;
+    Code borough_ = StringPool::kEmpty;
+    Code zip_code_ = StringPool::kEmpty;
     GeoCoordinate location_;
-    std::string on_street_;
-    std::string cross_street_;
-    std::string off_street_;
-    Date date_time_;
+    Code on_street_ = StringPool::kEmpty;
+    Code cross_street_ = StringPool::kEmpty;
+    Code off_street_ = StringPool::kEmpty;
+    Timestamp timestamp_ = kInvalidTimestamp;
     CasualtyStats casualty_stats_;
-    VehicleInfo vehicle_info_;
+    VehicleCodes vehicle_types_{};
+    VehicleCodes contributing_factors_{};
     int unique_key_ = 0;
+
+    mutable std::once_flag vehicle_info_once_;
+    mutable std::optional<VehicleInfo> vehicle_info_;
 };
 
 } // namespace nycollision
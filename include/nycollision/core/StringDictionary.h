@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace nycollision {
+
+/**
+ * @brief Append-only mapping between strings and dense integer codes
+ *
+ * Code 0 is always the empty string. Strings are kept in fixed-size blocks
+ * that never move, so decoded references stay valid for the lifetime of
+ * the dictionary and decode() is lock-free. encode() and find() may be
+ * called concurrently from any number of threads.
+ */
+class StringDictionary {
+public:
+    using Code = std::uint32_t;
+    static constexpr Code kEmpty = 0;
+    static constexpr Code kNotFound = UINT32_MAX;
+
+    StringDictionary() { encode(std::string_view()); }
+    ~StringDictionary() {
+        for (auto& block : blocks_) {
+            delete[] block.load(std::memory_order_relaxed);
+        }
+    }
+
+    StringDictionary(const StringDictionary&) = delete;
+    StringDictionary& operator=(const StringDictionary&) = delete;
+
+    /**
+     * @brief Return the code for a string, adding it if unseen
+     * @throws std::length_error if the dictionary is full
+     */
+    Code encode(std::string_view value) {
+        {
+            std::shared_lock lock(mutex_);
+            auto it = index_.find(value);
+            if (it != index_.end()) {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(mutex_);
+        auto it = index_.find(value);
+        if (it != index_.end()) {
+            return it->second;
+        }
+
+        Code code = size_.load(std::memory_order_relaxed);
+        std::size_t block = code >> kBlockBits;
+        if (block >= kMaxBlocks) {
+            throw std::length_error("StringDictionary capacity exceeded");
+        }
+        std::string* strings = blocks_[block].load(std::memory_order_relaxed);
+        if (!strings) {
+            strings = new std::string[kBlockSize];
+            blocks_[block].store(strings, std::memory_order_release);
+        }
+        std::string& stored = strings[code & (kBlockSize - 1)];
+        stored.assign(value);
+        index_.emplace(std::string_view(stored), code);
+        size_.store(code + 1, std::memory_order_release);
+        return code;
+    }
+
+    /**
+     * @brief Look up a string without adding it
+     * @return Its code, or kNotFound
+     */
+    Code find(std::string_view value) const {
+        std::shared_lock lock(mutex_);
+        auto it = index_.find(value);
+        return it != index_.end() ? it->second : kNotFound;
+    }
+
+    /**
+     * @brief String for a code previously returned by encode() or find()
+     */
+    const std::string& decode(Code code) const {
+        return blocks_[code >> kBlockBits].load(std::memory_order_acquire)[code & (kBlockSize - 1)];
+    }
+
+    /**
+     * @brief Number of distinct strings, including the empty string
+     */
+    std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Approximate heap usage in bytes
+     */
+    std::size_t memoryUsage() const {
+        std::size_t count = size();
+        std::size_t blocks = (count + kBlockSize - 1) >> kBlockBits;
+        std::size_t bytes = blocks * kBlockSize * sizeof(std::string) +
+                            count * (sizeof(std::string_view) + sizeof(Code) + 16);
+        for (std::size_t code = 0; code < count; ++code) {
+            const auto& s = decode(static_cast<Code>(code));
+            if (s.capacity() > 15) bytes += s.capacity();
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr std::size_t kBlockBits = 12;
+    static constexpr std::size_t kBlockSize = std::size_t{1} << kBlockBits;
+    static constexpr std::size_t kMaxBlocks = 4096; // 16M strings
+
+    std::array<std::atomic<std::string*>, kMaxBlocks> blocks_{};
+    std::atomic<Code> size_{0};
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string_view, Code> index_;
+};
+
+} // namespace nycollision
@@ -0,0 +1,88 @@
+#pragma once
+#include "StringDictionary.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+namespace nycollision {
+
+/**
+ * @brief Categorical string fields that share a dictionary
+ */
+enum class StringDomain {
+    Borough = 0,
+    ZipCode,
+    Street,             ///< On, cross and off street names
+    VehicleType,
+    ContributingFactor,
+    Count
+};
+
+constexpr std::size_t kStringDomainCount = static_cast<std::size_t>(StringDomain::Count);
+
+/**
+ * @brief Interned strings for every categorical field, one dictionary per domain
+ *
+ * Parsers encode into a pool while parsing and records carry the resulting
+ * codes. A process-wide pool is available through global(); codes are only
+ * comparable between users of the same pool.
+ */
+class StringPool {
+public:
+    using Code = StringDictionary::Code;
+    static constexpr Code kEmpty = StringDictionary::kEmpty;
+    static constexpr Code kNotFound = StringDictionary::kNotFound;
+
+    StringPool();
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    /**
+     * @brief The process-wide pool used by default
+     */
+    static const std::shared_ptr<StringPool>& global();
+
+    Code encode(StringDomain domain, std::string_view value) { return dictionary(domain).encode(value); }
+    Code find(StringDomain domain, std::string_view value) const { return dictionary(domain).find(value); }
+    const std::string& decode(StringDomain domain, Code code) const { return dictionary(domain).decode(code); }
+
+    StringDictionary& dictionary(StringDomain domain) { return dictionaries_[static_cast<std::size_t>(domain)]; }
+    const StringDictionary& dictionary(StringDomain domain) const {
+        return dictionaries_[static_cast<std::size_t>(domain)];
+    }
+
+    /**
+     * @brief Unique id of this pool instance, never reused within a process
+     */
+    std::uint64_t id() const { return id_; }
+
+    /**
+     * @brief Approximate heap usage of all dictionaries in bytes
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief Per-thread memo of encodings that avoids the dictionary lock on hits
+     *
+     * Keep one instance per thread (e.g. thread_local). Switching to another
+     * pool clears the memo.
+     */
+    class LocalCache {
+    public:
+        Code encode(StringPool& pool, StringDomain domain, std::string_view value);
+
+    private:
+        static constexpr std::size_t kMaxEntries = 1 << 16;
+
+        std::uint64_t poolId_ = 0;
+        std::array<std::unordered_map<std::string_view, Code>, kStringDomainCount> codes_;
+    };
+
+private:
+    std::array<StringDictionary, kStringDomainCount> dictionaries_;
+    std::uint64_t id_;
+};
+
+} // namespace nycollision
@@ -0,0 +1,188 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace nycollision {
+
+/**
+ * @brief Minutes since 1970-01-01 00:00 (local NYC time, no zone conversion)
+ *
+ * The packed form of a collision's date and time. Ordering timestamps is a
+ * plain integer comparison.
+ */
+using Timestamp = std::int32_t;
+
+constexpr Timestamp kInvalidTimestamp = INT32_MIN;
+constexpr std::int32_t kMinutesPerDay = 24 * 60;
+
+/**
+ * @brief Years whose every minute fits in a Timestamp
+ */
+constexpr int kMinYear = 0;
+constexpr int kMaxYear = 6052;
+
+/**
+ * @brief Days since 1970-01-01 for a proleptic Gregorian date
+ */
+constexpr std::int32_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = year - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static_assert(std::int64_t{daysFromCivil(kMinYear, 1, 1)} * kMinutesPerDay > kInvalidTimestamp);
+static_assert(std::int64_t{daysFromCivil(kMaxYear + 1, 1, 1)} * kMinutesPerDay - 1 <= INT32_MAX);
+
+/**
+ * @brief A calendar day, used as an inclusive bound for date range queries
+ */
+struct CalendarDate {
+    int year = 1970;
+    int month = 1;
+    int day = 1;
+
+    /**
+     * @brief Whether the date exists and lies in [kMinYear, kMaxYear]
+     */
+    bool isValid() const {
+        static constexpr int kDaysInMonth[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        if (year < kMinYear || year > kMaxYear) return false;
+        if (month < 1 || month > 12 || day < 1 || day > kDaysInMonth[month - 1]) return false;
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return month != 2 || day <= 28 || leap;
+    }
+
+    /**
+     * @brief First minute of the day
+     *
+     * Dates outside the valid years clamp to the first or last day a
+     * Timestamp can hold.
+     */
+    Timestamp startOfDay() const {
+        constexpr std::int64_t kFirst = std::int64_t{daysFromCivil(kMinYear, 1, 1)} * kMinutesPerDay;
+        constexpr std::int64_t kLast = std::int64_t{daysFromCivil(kMaxYear, 12, 31)} * kMinutesPerDay;
+        const std::int64_t start = std::int64_t{daysFromCivil(year, month, day)} * kMinutesPerDay;
+        return static_cast<Timestamp>(start < kFirst ? kFirst : start > kLast ? kLast : start);
+    }
+
+    /**
+     * @brief Last minute of the day
+     */
+    Timestamp endOfDay() const { return startOfDay() + kMinutesPerDay - 1; }
+
+    static CalendarDate fromTimestamp(Timestamp timestamp) {
+        std::int32_t days = timestamp / kMinutesPerDay - (timestamp % kMinutesPerDay < 0);
+        days += 719468;
+        const int era = (days >= 0 ? days : days - 146096) / 146097;
+        const int doe = days - era * 146097;
+        const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const int mp = (5 * doy + 2) / 153;
+        CalendarDate date;
+        date.day = doy - (153 * mp + 2) / 5 + 1;
+        date.month = mp < 10 ? mp + 3 : mp - 9;
+        date.year = yoe + era * 400 + (date.month <= 2);
+        return date;
+    }
+};
+
+namespace detail {
+
+inline bool parseDigits(std::string_view text, int& value) {
+    if (text.empty()) return false;
+    const char* last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), last, value);
+    return ec == std::errc() && ptr == last && text.front() != '-';
+}
+
+} // namespace detail
+
+/**
+ * @brief Parse MM/DD/YYYY (the export format) or YYYY-MM-DD[Thh:mm...]
+ * @return Whether text held a valid calendar date in [kMinYear, kMaxYear]
+ */
+inline bool parseCalendarDate(std::string_view text, CalendarDate& date) {
+    CalendarDate parsed;
+    if (text.size() == 10 && text[2] == '/' && text[5] == '/') {
+        if (!detail::parseDigits(text.substr(0, 2), parsed.month) ||
+            !detail::parseDigits(text.substr(3, 2), parsed.day) ||
+            !detail::parseDigits(text.substr(6, 4), parsed.year)) {
+            return false;
+        }
+    } else if (text.size() >= 10 && text[4] == '-' && text[7] == '-') {
+        if (!detail::parseDigits(text.substr(0, 4), parsed.year) ||
+            !detail::parseDigits(text.substr(5, 2), parsed.month) ||
+            !detail::parseDigits(text.substr(8, 2), parsed.day) ||
+            (text.size() > 10 && text[10] != 'T' && text[10] != ' ')) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    if (!parsed.isValid()) return false;
+    date = parsed;
+    return true;
+}
+
+/**
+ * @brief Parse H:MM, HH:MM or HH:MM:SS into minutes after midnight
+ * @return Whether text held a valid time of day
+ */
+inline bool parseTimeOfDay(std::string_view text, int& minutes) {
+    auto colon = text.find(':');
+    if (colon == std::string_view::npos) return false;
+    std::string_view minutePart = text.substr(colon + 1, 2);
+    if (text.size() > colon + 3 && text[colon + 3] != ':') return false;
+
+    int hour = 0, minute = 0;
+    if (!detail::parseDigits(text.substr(0, colon), hour) || minutePart.size() != 2 ||
+        !detail::parseDigits(minutePart, minute) || hour > 23 || minute > 59) {
+        return false;
+    }
+    minutes = hour * 60 + minute;
+    return true;
+}
+
+/**
+ * @brief Combine a date and an optional time into a timestamp
+ * @return The timestamp, or kInvalidTimestamp if either part is malformed
+ */
+inline Timestamp makeTimestamp(std::string_view date, std::string_view time) {
+    CalendarDate day;
+    int minutes = 0;
+    if (!parseCalendarDate(date, day) || (!time.empty() && !parseTimeOfDay(time, minutes))) {
+        return kInvalidTimestamp;
+    }
+    return day.startOfDay() + minutes;
+}
+
+/**
+ * @brief Format the date part as MM/DD/YYYY
+ */
+inline std::string formatDate(Timestamp timestamp) {
+    if (timestamp == kInvalidTimestamp) return {};
+    CalendarDate date = CalendarDate::fromTimestamp(timestamp);
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%02d/%02d/%04d", date.month, date.day, date.year);
+    return buffer;
+}
+
+/**
+ * @brief Format the time part as H:MM
+ */
+inline std::string formatTime(Timestamp timestamp) {
+    if (timestamp == kInvalidTimestamp) return {};
+    int minutes = timestamp % kMinutesPerDay;
+    if (minutes < 0) minutes += kMinutesPerDay;
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "%d:%02d", minutes / 60, minutes % 60);
+    return buffer;
+}
+
+} // namespace nycollision
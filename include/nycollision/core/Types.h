@@ -1,9 +1,17 @@
 #pragma once
+#include "Timestamp.h"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace nycollision {
 
+/**
+ * @brief Position of a record in columnar storage
+ */
+using RowId = std::uint32_t;
+
 /**
  * @brief Represents a geographic coordinate
  */
@@ -14,37 +22,67 @@ struct GeoCoordinate {
 
 /**
  * @brief Represents a date in the collision record
+ *
+ * Kept for display and for callers that build bounds from strings; storage
+ * and indexes use the packed Timestamp. Comparisons go through toTimestamp()
+ * and never allocate.
  */
 struct Date {
     std::string date;
     std::string time;
 
-    // Comparison operators for container operations
-    bool operator<(const Date& other) const {
-        return (date + time) < (other.date + other.time);
-    }
-    
-    bool operator<=(const Date& other) const {
-        return (date + time) <= (other.date + other.time);
-    }
-    
-    bool operator>(const Date& other) const {
-        return (date + time) > (other.date + other.time);
-    }
-    
-    bool operator>=(const Date& other) const {
-        return (date + time) >= (other.date + other.time);
-    }
-    
-    bool operator==(const Date& other) const {
-        return (date + time) == (other.date + other.time);
+    /**
+     * @brief Packed form of this date, or kInvalidTimestamp if unparseable
+     */
+    Timestamp toTimestamp() const { return makeTimestamp(date, time); }
+
+    /**
+     * @brief Render a timestamp as MM/DD/YYYY and H:MM
+     */
+    static Date fromTimestamp(Timestamp timestamp) {
+        return Date{formatDate(timestamp), formatTime(timestamp)};
     }
-    
-    bool operator!=(const Date& other) const {
-        return !(*this == other);
+
+    /**
+     * @brief Three-way comparison on the packed value
+     *
+     * Unparseable dates order before every valid one and among themselves
+     * by their raw strings.
+     */
+    int compare(const Date& other) const {
+        Timestamp lhs = toTimestamp();
+        Timestamp rhs = other.toTimestamp();
+        if (lhs != rhs) return lhs < rhs ? -1 : 1;
+        if (lhs != kInvalidTimestamp) return 0;
+        if (int cmp = date.compare(other.date)) return cmp;
+        return time.compare(other.time);
     }
+
+    bool operator<(const Date& other) const { return compare(other) < 0; }
+    bool operator<=(const Date& other) const { return compare(other) <= 0; }
+    bool operator>(const Date& other) const { return compare(other) > 0; }
+    bool operator>=(const Date& other) const { return compare(other) >= 0; }
+    bool operator==(const Date& other) const { return compare(other) == 0; }
+    bool operator!=(const Date& other) const { return compare(other) != 0; }
 };
 
+/**
+ * @brief Individual counters of CasualtyStats, in declaration order
+ */
+enum class CasualtyField {
+    PersonsInjured = 0,
+    PersonsKilled,
+    PedestriansInjured,
+    PedestriansKilled,
+    CyclistsInjured,
+    CyclistsKilled,
+    MotoristsInjured,
+    MotoristsKilled,
+    Count
+};
+
+constexpr std::size_t kCasualtyFieldCount = static_cast<std::size_t>(CasualtyField::Count);
+
 /**
  * @brief Statistics about injuries and fatalities
  */
@@ -65,6 +103,34 @@ struct CasualtyStats {
     int getTotalFatalities() const {
         return persons_killed + pedestrians_killed + cyclists_killed + motorists_killed;
     }
+
+    int get(CasualtyField field) const {
+        switch (field) {
+        case CasualtyField::PersonsInjured: return persons_injured;
+        case CasualtyField::PersonsKilled: return persons_killed;
+        case CasualtyField::PedestriansInjured: return pedestrians_injured;
+        case CasualtyField::PedestriansKilled: return pedestrians_killed;
+        case CasualtyField::CyclistsInjured: return cyclists_injured;
+        case CasualtyField::CyclistsKilled: return cyclists_killed;
+        case CasualtyField::MotoristsInjured: return motorists_injured;
+        case CasualtyField::MotoristsKilled: return motorists_killed;
+        default: return 0;
+        }
+    }
+
+    void set(CasualtyField field, int value) {
+        switch (field) {
+        case CasualtyField::PersonsInjured: persons_injured = value; break;
+        case CasualtyField::PersonsKilled: persons_killed = value; break;
+        case CasualtyField::PedestriansInjured: pedestrians_injured = value; break;
+        case CasualtyField::PedestriansKilled: pedestrians_killed = value; break;
+        case CasualtyField::CyclistsInjured: cyclists_injured = value; break;
+        case CasualtyField::CyclistsKilled: cyclists_killed = value; break;
+        case CasualtyField::MotoristsInjured: motorists_injured = value; break;
+        case CasualtyField::MotoristsKilled: motorists_killed = value; break;
+        default: break;
+        }
+    }
 };
 
 /**
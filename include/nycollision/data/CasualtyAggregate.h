@@ -0,0 +1,126 @@
+#pragma once
+#include "ColumnStore.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace nycollision {
+
+/**
+ * @brief Casualty counters summed over a group of rows
+ */
+struct CasualtyTotals {
+    std::uint64_t collisions = 0;
+    std::array<std::uint64_t, kCasualtyFieldCount> casualties{};
+
+    std::uint64_t get(CasualtyField field) const { return casualties[static_cast<std::size_t>(field)]; }
+
+    /**
+     * @brief Count one row of a store and add its casualty counters
+     */
+    void add(const ColumnStore& store, RowId row) {
+        ++collisions;
+        for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+            casualties[i] += static_cast<std::uint64_t>(store.casualty(static_cast<CasualtyField>(i), row));
+        }
+    }
+
+    std::uint64_t injuries() const {
+        return get(CasualtyField::PersonsInjured) + get(CasualtyField::PedestriansInjured) +
+               get(CasualtyField::CyclistsInjured) + get(CasualtyField::MotoristsInjured);
+    }
+
+    std::uint64_t fatalities() const {
+        return get(CasualtyField::PersonsKilled) + get(CasualtyField::PedestriansKilled) +
+               get(CasualtyField::CyclistsKilled) + get(CasualtyField::MotoristsKilled);
+    }
+
+    CasualtyTotals& operator+=(const CasualtyTotals& other) {
+        collisions += other.collisions;
+        for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+            casualties[i] += other.casualties[i];
+        }
+        return *this;
+    }
+
+    CasualtyTotals& operator-=(const CasualtyTotals& other) {
+        collisions -= other.collisions;
+        for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+            casualties[i] -= other.casualties[i];
+        }
+        return *this;
+    }
+};
+
+/**
+ * @brief Sums, extremes and value histograms of the casualty counters of a row selection
+ *
+ * Computed straight from the ColumnStore casualty columns by DataSet::aggregate().
+ * Histogram bin v counts rows whose counter equals v; the last bin also holds
+ * every larger value.
+ */
+struct CasualtyAggregate {
+    static constexpr std::size_t kHistogramBins = 16;
+
+    using Histogram = std::array<std::uint64_t, kHistogramBins>;
+
+    CasualtyTotals totals;  ///< Row count and per-counter sums
+    std::array<int, kCasualtyFieldCount> min;
+    std::array<int, kCasualtyFieldCount> max;
+    std::array<Histogram, kCasualtyFieldCount> histograms{};
+
+    CasualtyAggregate() {
+        min.fill(std::numeric_limits<int>::max());
+        max.fill(std::numeric_limits<int>::min());
+    }
+
+    std::uint64_t count() const { return totals.collisions; }
+    std::uint64_t sum(CasualtyField field) const { return totals.get(field); }
+
+    /**
+     * @brief Smallest value of a counter, or 0 over an empty selection
+     */
+    int minimum(CasualtyField field) const { return count() ? min[index(field)] : 0; }
+
+    /**
+     * @brief Largest value of a counter, or 0 over an empty selection
+     */
+    int maximum(CasualtyField field) const { return count() ? max[index(field)] : 0; }
+
+    double mean(CasualtyField field) const {
+        return count() ? static_cast<double>(sum(field)) / static_cast<double>(count()) : 0.0;
+    }
+
+    const Histogram& histogram(CasualtyField field) const { return histograms[index(field)]; }
+
+    /**
+     * @brief Fold in the aggregate of a disjoint selection
+     */
+    CasualtyAggregate& operator+=(const CasualtyAggregate& other) {
+        totals += other.totals;
+        for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+            min[i] = std::min(min[i], other.min[i]);
+            max[i] = std::max(max[i], other.max[i]);
+            for (std::size_t bin = 0; bin < kHistogramBins; ++bin) {
+                histograms[i][bin] += other.histograms[i][bin];
+            }
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Add the consecutive rows [first, last) of a store
+     */
+    void addRange(const ColumnStore& store, RowId first, RowId last);
+
+    /**
+     * @brief Add the listed rows of a store; they need not be sorted
+     */
+    void addRows(const ColumnStore& store, const RowId* rows, std::size_t count);
+
+private:
+    static constexpr std::size_t index(CasualtyField field) { return static_cast<std::size_t>(field); }
+};
+
+} // namespace nycollision
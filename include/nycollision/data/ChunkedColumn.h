@@ -0,0 +1,157 @@
+#pragma once
+#include "../util/Snapshot.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief Column of fixed-size chunks that copies share until one of them writes
+ *
+ * Rows are stored kChunkRows to a chunk, PerRow values per row. Copying a
+ * column copies its list of chunks, not the values; a chunk is duplicated
+ * the first time a copy writes to it while another copy still refers to
+ * it. A fork of a large dataset that appends or revises a few rows thus
+ * copies only the chunks those rows fall in.
+ *
+ * Writes are prepared on one thread: resize() readies the chunks of new
+ * rows and prepare() the chunk of an existing row. mutableRow() may then be
+ * called from several threads for distinct rows.
+ */
+template <typename T, std::size_t PerRow = 1>
+class ChunkedColumn {
+    static_assert(std::is_trivially_copyable_v<T>, "column values must be trivially copyable");
+
+public:
+    static constexpr std::size_t kChunkBits = 16;
+    static constexpr std::size_t kChunkRows = std::size_t{1} << kChunkBits;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * @brief First value of a row; the only one when PerRow is 1
+     */
+    const T& operator[](std::size_t row) const { return *this->row(row); }
+
+    /**
+     * @brief The PerRow values of a row
+     */
+    const T* row(std::size_t row) const { return data_[row >> kChunkBits] + (row & kRowMask) * PerRow; }
+
+    /**
+     * @brief Call func(values, firstRow, rows) for each chunk's part of rows [first, last)
+     */
+    template <typename Func>
+    void forEachRun(std::size_t first, std::size_t last, Func&& func) const {
+        while (first < last) {
+            const std::size_t end = std::min(last, ((first >> kChunkBits) + 1) << kChunkBits);
+            func(row(first), first, end - first);
+            first = end;
+        }
+    }
+
+    /**
+     * @brief Grow or shrink to a number of rows; new values are set to value
+     *
+     * The chunks that receive new rows are made writable.
+     */
+    void resize(std::size_t rows, const T& value = T{}) {
+        const std::size_t old = size_;
+        if (rows > old && (old & kRowMask) != 0) {
+            prepare(old);
+        }
+        const std::size_t chunks = (rows + kChunkRows - 1) >> kChunkBits;
+        chunks_.resize(chunks);
+        data_.resize(chunks);
+        for (std::size_t c = (old + kChunkRows - 1) >> kChunkBits; c < chunks; ++c) {
+            chunks_[c] = allocate();
+            data_[c] = chunks_[c].get();
+        }
+        size_ = rows;
+        for (std::size_t row = old; row < rows; ++row) {
+            std::fill_n(mutableRow(row), PerRow, value);
+        }
+    }
+
+    /**
+     * @brief Make the chunk holding a row writable, copying it if another column shares it
+     */
+    void prepare(std::size_t row) {
+        const std::size_t c = row >> kChunkBits;
+        if (chunks_[c].use_count() > 1) {
+            auto copy = allocate();
+            std::copy_n(data_[c], std::min(kChunkRows, size_ - (c << kChunkBits)) * PerRow, copy.get());
+            chunks_[c] = std::move(copy);
+            data_[c] = chunks_[c].get();
+        }
+    }
+
+    /**
+     * @brief Values of a row prepared for writing by resize() or prepare()
+     */
+    T* mutableRow(std::size_t row) { return data_[row >> kChunkBits] + (row & kRowMask) * PerRow; }
+
+    /**
+     * @brief Set the first value of a row prepared for writing
+     */
+    void set(std::size_t row, const T& value) { *mutableRow(row) = value; }
+
+    void clear() {
+        chunks_.clear();
+        data_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief Append the values as one array, in the layout of SnapshotBuffer::putArray()
+     */
+    void save(SnapshotBuffer& out) const {
+        out.put<std::uint64_t>(size_ * PerRow);
+        forEachRun(0, size_, [&out](const T* values, std::size_t, std::size_t rows) {
+            out.putValues(values, rows * PerRow);
+        });
+    }
+
+    /**
+     * @brief Replace the contents with an array written by save()
+     * @throws std::runtime_error if the section is truncated or the array is not whole rows
+     */
+    void load(SnapshotCursor& in) {
+        const std::string_view bytes = in.template getArray<T>();
+        if (bytes.size() % (sizeof(T) * PerRow) != 0) {
+            throw std::runtime_error("Snapshot column is not whole rows: " + in.name());
+        }
+        clear();
+        resize(bytes.size() / (sizeof(T) * PerRow));
+        forEachRun(0, size_, [&](const T*, std::size_t first, std::size_t rows) {
+            std::memcpy(mutableRow(first), bytes.data() + first * PerRow * sizeof(T), rows * PerRow * sizeof(T));
+        });
+    }
+
+    /**
+     * @brief Heap bytes of the chunks, counting shared chunks in full
+     */
+    std::size_t memoryUsage() const {
+        return chunks_.size() * (kChunkRows * PerRow * sizeof(T) + sizeof(Chunk) + sizeof(T*));
+    }
+
+private:
+    using Chunk = std::shared_ptr<T[]>;
+    static constexpr std::size_t kRowMask = kChunkRows - 1;
+
+    static Chunk allocate() { return Chunk(new T[kChunkRows * PerRow]()); }
+
+    std::vector<Chunk> chunks_;
+    std::vector<T*> data_;  // chunks_[c].get(), one indirection less on reads
+    std::size_t size_ = 0;
+};
+
+} // namespace nycollision
@@ -0,0 +1,171 @@
+#pragma once
+#include "../core/Record.h"
+#include "../core/StringPool.h"
+#include "../util/ExecutionContext.h"
+#include "ChunkedColumn.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotReader;
+class SnapshotWriter;
+
+/**
+ * @brief Structure-of-arrays storage for collision records
+ *
+ * Every field lives in its own ChunkedColumn indexed by RowId. Categorical
+ * fields hold codes of a shared StringPool; vehicle types and contributing
+ * factors use a fixed number of code slots per row with empty slots at the
+ * end. Clones share chunks until they write to them.
+ */
+class ColumnStore {
+public:
+    using Code = StringPool::Code;
+    using Count = std::uint16_t;
+
+    static constexpr std::size_t kVehicleSlots = Record::kVehicleSlots;
+
+    template <typename T>
+    using Column = ChunkedColumn<T>;
+    using SlotColumn = ChunkedColumn<Code, kVehicleSlots>;
+
+    explicit ColumnStore(std::shared_ptr<StringPool> pool = StringPool::global())
+        : pool_(std::move(pool)) {}
+    ColumnStore& operator=(const ColumnStore&) = delete;
+
+    /**
+     * @brief Encode a record into a new row
+     *
+     * Codes are copied as-is when the record uses this store's pool and
+     * re-encoded from strings otherwise.
+     *
+     * @return Row id of the appended record
+     */
+    RowId append(const Record& record);
+
+    /**
+     * @brief Encode a batch of records into consecutive new rows
+     *
+     * Columns are grown once and the rows are written in parallel.
+     *
+     * @param records Records in row order
+     * @param context Threads to write rows with
+     * @return Row id of the first appended record
+     */
+    RowId append(const std::vector<const Record*>& records, const ExecutionContext& context);
+
+    /**
+     * @brief Overwrite an existing row with a revised record
+     *
+     * Codes are copied or re-encoded as in append().
+     */
+    void update(RowId row, const Record& record);
+
+    /**
+     * @brief Overwrite a batch of existing rows with revised records
+     *
+     * The chunks holding the rows are made writable first, then the rows
+     * are written in parallel.
+     *
+     * @param rows Distinct rows to overwrite
+     * @param records Revised record of each row
+     * @param context Threads to write rows with
+     */
+    void update(const std::vector<RowId>& rows, const std::vector<const Record*>& records,
+                const ExecutionContext& context);
+
+    /**
+     * @brief Copy of every column that shares chunks with this store until either writes, and the string pool
+     */
+    std::shared_ptr<ColumnStore> clone() const { return std::shared_ptr<ColumnStore>(new ColumnStore(*this)); }
+
+    std::size_t size() const { return uniqueKeys_.size(); }
+
+    /**
+     * @brief String pool the categorical codes refer to
+     */
+    const std::shared_ptr<StringPool>& pool() const { return pool_; }
+
+    // Row accessors
+    int uniqueKey(RowId row) const { return uniqueKeys_[row]; }
+    GeoCoordinate location(RowId row) const { return {latitudes_[row], longitudes_[row]}; }
+    const std::string& borough(RowId row) const { return decode(StringDomain::Borough, boroughCodes_[row]); }
+    const std::string& zipCode(RowId row) const { return decode(StringDomain::ZipCode, zipCodeCodes_[row]); }
+    const std::string& onStreet(RowId row) const { return decode(StringDomain::Street, onStreetCodes_[row]); }
+    const std::string& crossStreet(RowId row) const { return decode(StringDomain::Street, crossStreetCodes_[row]); }
+    const std::string& offStreet(RowId row) const { return decode(StringDomain::Street, offStreetCodes_[row]); }
+    Date dateTime(RowId row) const { return Date::fromTimestamp(timestamps_[row]); }
+    Timestamp timestamp(RowId row) const { return timestamps_[row]; }
+    int casualty(CasualtyField field, RowId row) const { return casualties_[index(field)][row]; }
+    CasualtyStats casualtyStats(RowId row) const;
+    VehicleInfo vehicleInfo(RowId row) const;
+
+    // Dictionary codes
+    Code boroughCode(RowId row) const { return boroughCodes_[row]; }
+    Code zipCodeCode(RowId row) const { return zipCodeCodes_[row]; }
+    const Code* vehicleTypeCodes(RowId row) const { return vehicleTypeCodes_.row(row); }
+    const Code* contributingFactorCodes(RowId row) const { return contributingFactorCodes_.row(row); }
+
+    // Whole columns for scans
+    const Column<float>& latitudes() const { return latitudes_; }
+    const Column<float>& longitudes() const { return longitudes_; }
+    const Column<Timestamp>& timestamps() const { return timestamps_; }
+    const Column<Count>& casualties(CasualtyField field) const { return casualties_[index(field)]; }
+
+    /**
+     * @brief Approximate heap usage of all columns in bytes, excluding the shared pool
+     *
+     * Chunks shared with clones are counted in full.
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief Add one snapshot section per column
+     */
+    void save(SnapshotWriter& out) const;
+
+    /**
+     * @brief Replace the columns of an empty store with those of a snapshot
+     *
+     * Codes are copied as stored, so the store's pool must hold the snapshot's
+     * strings under the same codes. Columns are verified and copied in parallel.
+     *
+     * @throws std::runtime_error if the store is not empty or a column is missing, corrupt or of the wrong length
+     */
+    void load(const SnapshotReader& in, const ExecutionContext& context);
+
+private:
+    static constexpr std::size_t index(CasualtyField field) { return static_cast<std::size_t>(field); }
+    ColumnStore(const ColumnStore&) = default;  // For clone() only
+
+    const std::string& decode(StringDomain domain, Code code) const { return pool_->decode(domain, code); }
+    void resize(std::size_t rows);
+    void writeRow(RowId row, const Record& record);
+
+    // Calls visit(section name, column) for every column
+    template <typename Store, typename Visit>
+    static void forEachColumn(Store& store, Visit&& visit);
+
+    std::shared_ptr<StringPool> pool_;
+
+    // Scalar columns
+    Column<std::int32_t> uniqueKeys_;
+    Column<float> latitudes_;
+    Column<float> longitudes_;
+    Column<Timestamp> timestamps_;
+    std::array<Column<Count>, kCasualtyFieldCount> casualties_;
+
+    // Dictionary-encoded columns
+    Column<Code> boroughCodes_;
+    Column<Code> zipCodeCodes_;
+    Column<Code> onStreetCodes_;
+    Column<Code> crossStreetCodes_;
+    Column<Code> offStreetCodes_;
+    SlotColumn vehicleTypeCodes_;
+    SlotColumn contributingFactorCodes_;
+};
+
+} // namespace nycollision
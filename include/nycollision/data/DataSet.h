@@ -2,37 +2,60 @@
 #include "IDataSet.h"
 #include "../parser/IParser.h"
 #include "../core/Record.h"
+#include "CasualtyAggregate.h"
+#include "ChunkedColumn.h"
+#include "ColumnStore.h"
+#include "DateIndex.h"
+#include "HeatmapTiles.h"
+#include "KeyIndex.h"
+#include "PackedRTree.h"
+#include "RecordView.h"
+#include "Query.h"
+#include "RegionLayer.h"
+#include "RollupCube.h"
+#include "RowSet.h"
+#include "SpatialClustering.h"
+#include "../util/ExecutionContext.h"
+#include "../util/Snapshot.h"
+#include <algorithm>
+#include <functional>
 #include <unordered_map>
 #include <map>
 #include <memory>
 #include <string>
-#include <fstream>
 #include <stdexcept>
 #include <chrono>
 #include <iostream>
 #include <iomanip>
-#include <omp.h>
+#include <mutex>
 #include <shared_mutex>
 #include <boost/geometry.hpp>
-#include <boost/geometry/geometries/point.hpp>
-#include <boost/geometry/geometries/box.hpp>
-#include <boost/geometry/index/rtree.hpp>
 
 namespace nycollision {
 
 namespace bg = boost::geometry;
-namespace bgi = boost::geometry::index;
 
 /**
  * @brief Concrete implementation of collision records dataset with optimized querying
+ *
+ * Records are stored column-wise in a ColumnStore and every index refers to
+ * rows by RowId. IRecord results are views that read from the columns.
+ *
+ * Const methods may run concurrently with each other but not with loads.
+ * To keep serving queries during ingest, modify a fork() and publish it
+ * through a LiveDataSet. A dataset owned by a std::shared_ptr is kept alive
+ * by the row sets borrowed from its indexes.
  */
-class DataSet : public IDataSet {
+class DataSet : public IDataSet, public std::enable_shared_from_this<DataSet> {
 public:
-    // Type definitions for R-tree
-    using Point = bg::model::point<float, 2, bg::cs::cartesian>;
-    using Box = bg::model::box<Point>;
-    using Value = std::pair<Point, std::shared_ptr<Record>>;
-    using RTree = bgi::rtree<Value, bgi::rstar<16>>;
+    /**
+     * @brief Construct an empty dataset
+     * @param pool String pool for categorical fields; use the parser's pool to avoid re-encoding
+     * @param context Threads used for loading, index builds and result materialization
+     */
+    explicit DataSet(std::shared_ptr<StringPool> pool = StringPool::global(),
+                     std::shared_ptr<const ExecutionContext> context = ExecutionContext::defaultContext())
+        : store_(std::make_shared<ColumnStore>(pool)), context_(std::move(context)), rollup_(std::move(pool)) {}
 
     // Benchmarking structure
     struct QueryStats {
@@ -41,54 +64,115 @@ public:
         size_t result_count;
     };
 
+    /**
+     * @brief Shape and build cost of the spatial index
+     */
+    struct SpatialIndexStats {
+        double build_time = 0.0;      ///< Seconds spent packing the tree(s)
+        size_t partitions = 0;        ///< Number of independently packed trees
+        size_t values = 0;            ///< Indexed points
+        size_t levels = 0;            ///< Height of the deepest tree, counting the leaf level
+        size_t internal_nodes = 0;
+        size_t leaves = 0;
+        size_t min_leaf_values = 0;   ///< Fewest values in any leaf
+        size_t max_leaf_values = 0;   ///< Most values in any leaf
+    };
+
     /**
      * @brief Load records from a file using the specified parser
+     *
+     * The file is memory-mapped and split into chunks on record boundaries;
+     * each chunk is parsed by its own worker straight from the mapped bytes.
+     * Rows are then written to the columns in parallel and every index is
+     * built by its own task; the spatial index is bulk-loaded in one pass,
+     * or takes a small addition to loaded data by insertion (see kRepackRatio).
+     * Records are appended as they are; appendFromFile() upserts instead.
+     *
      * @param filename Path to the data file
      * @param parser Parser implementation to use
      * @throws std::runtime_error if file cannot be opened or parsing fails
      */
-    void loadFromFile(const std::string& filename, const IParser& parser) {
-        auto startTime = std::chrono::high_resolution_clock::now();
-
-        std::ifstream file(filename);
-        if (!file) {
-            throw std::runtime_error("Failed to open file: " + filename);
-        }
-
-        std::string line;
-        // Skip header line
-        if (!std::getline(file, line)) {
-            return;
-        }
-
-        omp_set_num_threads(11);
-        // Read all lines into memory
-        std::vector<std::string> lines;
-        lines.reserve(2'700'000); // Reserve space for ~2.7M lines
-        while (std::getline(file, line)) {
-            lines.push_back(std::move(line));
-        }
-
-        // Create a temporary vector to hold parsed records
-        std::vector<std::shared_ptr<Record>> parsedRecords(lines.size());
-
-        // Parallel parse each line
-        #pragma omp parallel for
-        for (std::size_t i = 0; i < lines.size(); ++i) {
-            parsedRecords[i] = parser.parseRecord(lines[i]);
-        }
-
-        // Sequentially add parsed records to data structures
-        for (auto& rec : parsedRecords) {
-            if (rec) {
-                addRecord(rec);
-            }
-        }
-
-        auto endTime = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsedSeconds = endTime - startTime;
-        std::cout << "loadFromFile took " << elapsedSeconds.count() << " seconds.\n";
-    }
+    void loadFromFile(const std::string& filename, const IParser& parser);
+
+    /**
+     * @brief Outcome of appendFromFile()
+     */
+    struct AppendStats {
+        size_t inserted = 0;    ///< Records with a new collision id, appended as rows
+        size_t updated = 0;     ///< Revisions of stored records, overwritten in place
+        size_t superseded = 0;  ///< Records replaced by a later record of the same id in the file
+        size_t rejected = 0;    ///< Records without a usable collision id, left out
+    };
+
+    /**
+     * @brief Ingest a delta file, upserting records on their collision id
+     *
+     * Records with a new id are appended as rows. Records whose id is already
+     * stored are revisions: they overwrite their row in place, so row ids stay
+     * stable. When the file lists an id more than once its last record wins.
+     * Records whose COLLISION_ID is blank or malformed cannot be matched to a
+     * row and are rejected.
+     *
+     * Indexes are maintained incrementally rather than rebuilt: revised rows
+     * leave their old postings, date entries, rollup cells, heatmap tiles and
+     * R-tree points before joining under the new values, and new rows are
+     * merged in as by loadFromFile(). New points are packed into small delta
+     * trees beside the strips, and removed points are masked out of theirs,
+     * until the two exceed 1/kRepackRatio of the strips' points, which
+     * re-packs instead.
+     *
+     * Row sets obtained earlier may observe revised values.
+     *
+     * @param filename Path to the delta file, with the same header as the full export
+     * @param parser Parser implementation to use
+     * @throws std::runtime_error if file cannot be opened or parsing fails
+     */
+    AppendStats appendFromFile(const std::string& filename, const IParser& parser);
+
+    /**
+     * @brief Copy that shares the rows and every index with this dataset
+     *
+     * The copy can be loaded into while this dataset keeps answering queries.
+     * Nothing is copied up front: columns, bitmaps, date blocks, key runs,
+     * rollup shards, tiles and packed trees are shared, and a piece is copied
+     * only when one of the two datasets writes to it. A fork costs time in
+     * the number of pieces, not rows, and a small load into it copies little
+     * beyond the pieces its rows fall in.
+     *
+     * @param context Threads the copy runs its work on; nullptr keeps this dataset's
+     */
+    std::unique_ptr<DataSet> fork(std::shared_ptr<const ExecutionContext> context = nullptr) const;
+
+    /**
+     * @brief Write the columns, string dictionaries and every index to a snapshot file
+     *
+     * Sections are streamed to a uniquely named temporary file as they are
+     * serialized, which is synced and renamed into place.
+     *
+     * @param filename Snapshot to write
+     * @param source Stamp of the file the data was loaded from, checked by SnapshotReader::isFresh()
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void saveSnapshot(const std::string& filename, SnapshotSource source = {}) const;
+
+    /**
+     * @brief Fill an empty dataset from a snapshot written by saveSnapshot()
+     *
+     * The file is memory-mapped and each section is checksummed and copied
+     * into place concurrently; nothing is parsed or rebuilt. Posting bitmaps,
+     * date blocks, key runs, rollup cube, heatmap tiles and the packed trees
+     * of the spatial index, with their masked rows, are read as stored.
+     * Region layers added before the call read their region columns and
+     * postings from the snapshot; a layer is computed over the loaded rows
+     * only when the snapshot lacks it or holds other polygons under its name.
+     *
+     * The dataset's pool must be empty or already hold the snapshot's strings
+     * under the same codes. On failure the dataset is left empty.
+     *
+     * @throws std::runtime_error if the dataset is not empty, or the snapshot
+     *         is unreadable, of another format version, or corrupt
+     */
+    void loadSnapshot(const std::string& filename);
 
     // IDataSet interface implementation
     Records queryByGeoBounds(
@@ -98,73 +182,442 @@ public:
         return queryByGeoBoundsRTree(minLat, maxLat, minLon, maxLon);
     }
 
-    Records queryByBorough(const std::string& borough) const override;
-    Records queryByZipCode(const std::string& zipCode) const override;
-    Records queryByDateRange(const Date& start, const Date& end) const override;
-    Records queryByVehicleType(const std::string& vehicleType) const override;
-    Records queryByInjuryRange(int minInjuries, int maxInjuries) const override;
-    Records queryByFatalityRange(int minFatalities, int maxFatalities) const override;
+    Records queryByBorough(const std::string& borough) const override {
+        return toRecords(rowsByBorough(borough));
+    }
+    Records queryByZipCode(const std::string& zipCode) const override {
+        return toRecords(rowsByZipCode(zipCode));
+    }
+    using IDataSet::queryByDateRange;
+    Records queryByDateRange(Timestamp start, Timestamp end) const override {
+        return toRecords(rowsByDateRange(start, end));
+    }
+    Records queryByVehicleType(const std::string& vehicleType) const override {
+        return toRecords(rowsByVehicleType(vehicleType));
+    }
+    Records queryByInjuryRange(int minInjuries, int maxInjuries) const override {
+        return toRecords(rowsByInjuryRange(minInjuries, maxInjuries));
+    }
+    Records queryByFatalityRange(int minFatalities, int maxFatalities) const override {
+        return toRecords(rowsByFatalityRange(minFatalities, maxFatalities));
+    }
     RecordPtr queryByUniqueKey(int key) const override;
-    Records queryByPedestrianFatalities(int minFatalities, int maxFatalities) const override;
-    Records queryByCyclistFatalities(int minFatalities, int maxFatalities) const override;
-    Records queryByMotoristFatalities(int minFatalities, int maxFatalities) const override;
+    Records queryByPedestrianFatalities(int minFatalities, int maxFatalities) const override {
+        return toRecords(rowsByPedestrianFatalities(minFatalities, maxFatalities));
+    }
+    Records queryByCyclistFatalities(int minFatalities, int maxFatalities) const override {
+        return toRecords(rowsByCyclistFatalities(minFatalities, maxFatalities));
+    }
+    Records queryByMotoristFatalities(int minFatalities, int maxFatalities) const override {
+        return toRecords(rowsByMotoristFatalities(minFatalities, maxFatalities));
+    }
+    Records queryNearest(float latitude, float longitude, std::size_t k) const override {
+        return toRecords(rowsNearest(latitude, longitude, k));
+    }
+    Records queryByRadius(float latitude, float longitude, double meters) const override {
+        return toRecords(rowsByRadius(latitude, longitude, meters));
+    }
+
+    // Index lookups borrow posting bitmaps or the date order; spatial results own their rows.
+    // Borrowed spans stay valid until the next load into this dataset.
+    RowSet rowsByGeoBounds(float minLat, float maxLat, float minLon, float maxLon) const override;
+    RowSet rowsByBorough(const std::string& borough) const override;
+    RowSet rowsByZipCode(const std::string& zipCode) const override;
+    using IDataSet::rowsByDateRange;
+    RowSet rowsByDateRange(Timestamp start, Timestamp end) const override;
+    RowSet rowsByVehicleType(const std::string& vehicleType) const override;
+    RowSet rowsByInjuryRange(int minInjuries, int maxInjuries) const override;
+    RowSet rowsByFatalityRange(int minFatalities, int maxFatalities) const override;
+    RowSet rowsByPedestrianFatalities(int minFatalities, int maxFatalities) const override;
+    RowSet rowsByCyclistFatalities(int minFatalities, int maxFatalities) const override;
+    RowSet rowsByMotoristFatalities(int minFatalities, int maxFatalities) const override;
+    RowSet rowsNearest(float latitude, float longitude, std::size_t k) const override;
+    RowSet rowsByRadius(float latitude, float longitude, double meters) const override;
+
+    /**
+     * @brief A row and its great-circle distance from a query point
+     */
+    struct Neighbor {
+        RowId row;
+        double meters;
+    };
+
+    /**
+     * @brief The k rows nearest to a point, with their distances, nearest first
+     *
+     * The R-tree is in planar degrees, where a degree of longitude is about
+     * 0.76 of a degree of latitude at NYC, so its nearest() order is not the
+     * true order. The k planar-nearest points of each tree give an upper
+     * bound on the k-th true distance; every point within that bound is then
+     * collected by a radius search, which ranks them by great-circle distance.
+     */
+    std::vector<Neighbor> neighbors(float latitude, float longitude, std::size_t k) const;
+
+    /**
+     * @brief Rows within a great-circle distance of a point, nearest first
+     *
+     * The R-tree is searched with the smallest latitude/longitude box
+     * holding the circle, and candidates are kept by their exact distance.
+     */
+    std::vector<Neighbor> neighborsWithin(float latitude, float longitude, double meters) const;
+
+    Records toRecords(const RowSet& rows) const override;
+
+    // Walks the R-tree incrementally so an early stop skips the rest of the search.
+    // The visitor runs under the spatial index's read lock.
+    std::size_t visitByGeoBounds(float minLat, float maxLat, float minLon, float maxLon,
+                                 const RecordVisitor& visitor, ScanOptions options = {}) const override;
     
-    size_t size() const override { return records_.size(); }
+    /**
+     * @brief Assign every row to a region of a polygon layer and index the assignment
+     *
+     * Computes the layer's region-id column over the stored rows in parallel
+     * and keeps it current through later loads and upserts, so queries by
+     * region (rowsByRegion(), Query::region()) read a posting bitmap instead
+     * of testing geometry. Region columns and postings are saved in snapshots
+     * by layer name; see loadSnapshot() for layers added before loading one.
+     *
+     * @throws std::runtime_error if a layer of the same name was added
+     */
+    void addRegionLayer(std::shared_ptr<const RegionLayer> layer);
+
+    /**
+     * @brief Layer added under a name, or nullptr
+     */
+    std::shared_ptr<const RegionLayer> regionLayer(const std::string& name) const;
+
+    /**
+     * @brief Region of every row in a layer, or RegionLayer::kNoRegion outside all of them
+     * @throws std::runtime_error if no layer of that name was added
+     */
+    const ChunkedColumn<RegionLayer::RegionId>& regionColumn(const std::string& layer) const;
+
+    /**
+     * @brief Rows whose point lies in a region of a layer, in row order
+     * @throws std::runtime_error if no layer of that name was added
+     */
+    RowSet rowsByRegion(const std::string& layer, const std::string& region) const;
+    Records queryByRegion(const std::string& layer, const std::string& region) const {
+        return toRecords(rowsByRegion(layer, region));
+    }
+
+    /**
+     * @brief Rows whose point lies in an area, in row order
+     *
+     * Tests geometry on every call: the R-tree supplies the points in the
+     * area's bounding box and each is checked against the polygons. Areas
+     * queried repeatedly are cheaper as a region layer.
+     *
+     * @param area Longitude/latitude polygons; rings are closed and oriented as needed
+     */
+    RowSet rowsInArea(RegionLayer::MultiPolygon area) const;
+
+    /**
+     * @brief Collisions binned into a uniform grid over a box, with casualty sums per cell
+     *
+     * The grid starts at the box's south-west corner; cells are cellMeters
+     * tall, and as wide in degrees of longitude at the box's mid-latitude.
+     * Cells on the north and east edges are cut off by the box. Rows come
+     * from rowsMatching() with the box added to the filter, and are binned
+     * in parallel straight from the columns.
+     *
+     * @param cellMeters North-south extent of a cell
+     * @param filter Further predicates, e.g. a date range or casualty type
+     * @return Cells holding collisions, ordered by y, then x
+     * @throws std::runtime_error if cellMeters is not positive
+     */
+    std::vector<HeatmapCell> heatmap(float minLat, float maxLat, float minLon, float maxLon, double cellMeters,
+                                     const Query& filter = Query()) const;
+
+    /**
+     * @brief Pre-aggregated tiles of one level overlapping a box
+     *
+     * Reads tiles(), so the cost grows with the tiles returned rather than
+     * the rows under them; zoomed-out views of every collision stay cheap.
+     *
+     * @param level Tile level, see HeatmapTiles::levelFor()
+     * @see HeatmapTiles::cells()
+     */
+    std::vector<HeatmapCell> heatmapTiles(float minLat, float maxLat, float minLon, float maxLon, int level) const;
+
+    /**
+     * @brief DBSCAN clusters of the collisions matching a query, with casualty sums per cluster
+     *
+     * Clusters the locations of rowsMatching(filter), so hotspots can be
+     * found for a date range, a casualty type or an area. Rows without
+     * coordinates are left out.
+     *
+     * @param epsMeters Neighbourhood radius, great-circle
+     * @param minPoints Collisions within eps, counting the point itself, that make a core point
+     * @see SpatialClustering::dbscan()
+     * @throws std::runtime_error if epsMeters is not positive or minPoints is 0
+     */
+    SpatialClustering clusters(double epsMeters, std::size_t minPoints, const Query& filter = Query()) const;
+
+    /**
+     * @brief Rows matching every predicate of a query, in row order
+     *
+     * Follows plan(): the rows of the most selective predicate are read from
+     * its index; when that is a bitmap, the bitmaps of other predicates of
+     * comparable size are ANDed into it. The remaining predicates are checked
+     * against the columns. A query without predicates matches every row. A
+     * single predicate with one posting bitmap returns it without copying.
+     */
+    RowSet rowsMatching(const Query& query) const;
+
+    /**
+     * @brief Records matching every predicate of a query, in row order
+     */
+    Records query(const Query& query) const { return toRecords(rowsMatching(query)); }
+
+    /**
+     * @brief Plan a query without running it
+     *
+     * Row estimates are exact for every predicate except areas, which assume
+     * points are spread evenly over the bounds of the spatial index.
+     */
+    QueryPlan plan(const Query& query) const;
+
+    /**
+     * @brief Plan of a query as text, one line per step
+     */
+    std::string explain(const Query& query) const;
+
+    /**
+     * @brief Sums, extremes and histograms of the casualty counters of a row selection
+     *
+     * Reads the casualty columns directly, never materializing records.
+     * Consecutive runs of rows are summed straight off the column arrays and
+     * scattered rows are gathered in batches; blocks are split over the
+     * execution context and the partial aggregates combined.
+     */
+    CasualtyAggregate aggregate(const RowSet& rows) const;
+
+    /**
+     * @brief Casualty aggregate of the rows matching a query
+     */
+    CasualtyAggregate aggregate(const Query& query) const { return aggregate(rowsMatching(query)); }
+
+    size_t size() const override { return store_->size(); }
+
+    /**
+     * @brief Casualty totals pre-aggregated by borough, month, hour and vehicle type
+     *
+     * Updated with every load; answers grouped sums without reading rows.
+     */
+    const RollupCube& rollup() const { return rollup_; }
+
+    /**
+     * @brief Collision counts and casualty sums per map tile at several zoom levels
+     *
+     * Updated with every load and saved in snapshots as stored.
+     */
+    const HeatmapTiles& tiles() const { return tiles_; }
+
+    /**
+     * @brief Approximate heap usage of the posting bitmaps, the date index and region columns in bytes
+     */
+    std::size_t indexMemoryUsage() const;
+
+    /**
+     * @brief Columnar storage backing this dataset
+     */
+    const ColumnStore& columns() const { return *store_; }
+
+    /**
+     * @brief Threads this dataset runs its parallel work on
+     */
+    const ExecutionContext& executionContext() const { return *context_; }
+
+    /**
+     * @brief Data-quality counters accumulated over all loads
+     */
+    const ParseStats& parseStats() const { return parseStats_; }
+
+    /**
+     * @brief Statistics of the most recent spatial index build
+     */
+    SpatialIndexStats spatialIndexStats() const {
+        std::shared_lock lock(spatial_mutex_);
+        return spatialStats_;
+    }
+
+    /**
+     * @brief Split the spatial index into latitude strips packed in parallel
+     *
+     * Takes effect when the index is next packed in full. Strips hold at
+     * least kMinPartitionValues points each, so small datasets still get a
+     * single tree. Queries visit every strip.
+     *
+     * @param partitions Requested number of trees; 1 (the default) packs a single tree
+     */
+    void setSpatialPartitions(size_t partitions) { spatialPartitions_ = std::max<size_t>(partitions, 1); }
+
+    static constexpr size_t kMinPartitionValues = size_t{1} << 16;
 
     // Benchmark spatial queries with different methods
     QueryStats benchmarkQuery(float minLat, float maxLat, float minLon, float maxLon) const;
 
 public:
     // Spatial query implementations for benchmarking
-    Records queryByGeoBoundsBruteForce(float minLat, float maxLat, float minLon, float maxLon) const;
-    Records queryByGeoBoundsRTree(float minLat, float maxLat, float minLon, float maxLon) const;
+    Records queryByGeoBoundsBruteForce(float minLat, float maxLat, float minLon, float maxLon) const {
+        return toRecords(rowsByGeoBoundsBruteForce(minLat, maxLat, minLon, maxLon));
+    }
+    Records queryByGeoBoundsRTree(float minLat, float maxLat, float minLon, float maxLon) const {
+        return toRecords(rowsByGeoBoundsRTree(minLat, maxLat, minLon, maxLon));
+    }
+    RowSet rowsByGeoBoundsBruteForce(float minLat, float maxLat, float minLon, float maxLon) const;
+    RowSet rowsByGeoBoundsRTree(float minLat, float maxLat, float minLon, float maxLon) const;
+    // Scan every row's distance: the baselines of neighbors() and neighborsWithin()
+    std::vector<Neighbor> neighborsBruteForce(float latitude, float longitude, std::size_t k) const;
+    std::vector<Neighbor> neighborsWithinBruteForce(float latitude, float longitude, double meters) const;
+
+    // Re-pack once points in delta trees and points removed from any tree exceed
+    // 1/kRepackRatio of the points packed into the strips
+    static constexpr size_t kRepackRatio = 4;
 
 private:
-    void addRecord(std::shared_ptr<Record> record);
-    
-    // Helper to convert internal records to interface records
-    Records convertToInterfaceRecords(const std::vector<std::shared_ptr<Record>>& records) const {
-        #ifdef _OPENMP
-        omp_set_num_threads(13);
-        #endif
+    // Parse a file into records in file order, merging into parseStats_. When
+    // keyless is given, records whose collision id the parser counted as
+    // missing or malformed are dropped and counted there.
+    std::vector<std::shared_ptr<Record>> parseFile(const std::string& filename, const IParser& parser,
+                                                   std::size_t* keyless = nullptr);
+    // Write records into the columns; returns the row of the first
+    RowId appendRows(const std::vector<const Record*>& records);
 
-        Records result(records.size());
-        auto startTime = std::chrono::high_resolution_clock::now();
+    // Index rows [firstRow, size()): one concurrent task per index, large
+    // indexes built over row partitions that are merged in row order
+    void buildIndexes(RowId firstRow);
+    void indexKeys(RowId firstRow);
 
-        #pragma omp parallel for
-        for (std::size_t i = 0; i < records.size(); ++i) {
-            result[i] = std::static_pointer_cast<const IRecord>(records[i]);
-        }
+    // Call visit(index, keysOf) for every posting index, where keysOf(row, emit)
+    // emits the keys a row is posted under
+    template <typename Visit>
+    void forEachPostingIndex(Visit&& visit);
 
-        auto endTime = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsedSeconds = endTime - startTime;
-        std::cout << "convertToInterfaceRecords took " << elapsedSeconds.count() << " seconds.\n";
-        std::cout << "convertToInterfaceRecords result size is " << result.size() << " records.\n";
-        return result;
-    }
+    // Drop stored rows from, or add them back to, every index but the key map;
+    // revisions are written between the two calls
+    void unindexRows(const std::vector<RowId>& rows);
+    void indexRows(const std::vector<RowId>& rows);
 
-    // Primary storage
-    std::vector<std::shared_ptr<Record>> records_;
+    // Row partitions per index build; each holds at least kMinPartitionRows rows
+    static constexpr std::size_t kMinPartitionRows = std::size_t{1} << 16;
+    std::size_t indexPartitions(std::size_t rows) const;
 
-    // R-tree spatial index
-    mutable RTree rtree_;
+    // A packed tree and the rows masked out of it since it was packed
+    struct SpatialSegment {
+        std::shared_ptr<const PackedRTree> tree;
+        RowBitmap removed;
+    };
+
+    // Pack the strips over every stored row, replacing the current index
+    void buildSpatialIndex();
+
+    // Points of every row in packing order: row order cut into latitude strips
+    std::vector<PackedRTree::Entry> spatialValues(std::size_t partitions) const;
+    // One packed tree per strip of spatialValues()
+    std::vector<SpatialSegment> packStrips(const std::vector<PackedRTree::Entry>& values,
+                                           std::size_t partitions) const;
+    // Replace the index with strips followed by delta trees
+    void installSpatialIndex(std::vector<SpatialSegment> segments, std::size_t strips,
+                             std::chrono::steady_clock::time_point startTime);
+    // Shape of segments_; the caller holds spatial_mutex_
+    SpatialIndexStats statistics() const;
+
+    // Add the points of rows [firstRow, size()), inserting or re-packing per kRepackRatio
+    void updateSpatialIndex(RowId firstRow);
+    // Pack the stored points of rows into a delta tree, or mask them out of the tree holding them
+    void insertPoints(const std::vector<RowId>& rows);
+    void removePoints(const std::vector<RowId>& rows);
+    // Call visit(entry) for every live point in a box, stopping when visit
+    // returns false; the caller holds spatial_mutex_
+    template <typename Visit>
+    bool visitPoints(const PackedRTree::Bounds& box, Visit&& visit) const;
+    // Append the points within a distance to out; the caller holds spatial_mutex_
+    void collectWithin(float latitude, float longitude, double meters, std::vector<Neighbor>& out) const;
+
+    // Drop every row and index, as before the first load
+    void clear();
+
+    // Region-id column and postings of one polygon layer
+    struct RegionIndex {
+        std::shared_ptr<const RegionLayer> layer;
+        ChunkedColumn<RegionLayer::RegionId> regions;
+        std::vector<RowBitmap> postings;
+    };
+    const RegionIndex& regionIndex(const std::string& layer) const;
+    // Compute the region columns of rows [firstRow, size()), or of the given rows
+    void locateRegions(RowId firstRow);
+    void locateRegions(const std::vector<RowId>& rows);
+    // Compute one layer's column and postings over every row
+    void indexRegionLayer(RegionIndex& index);
+
+    // Merge rows [firstRow, size()) into the timestamp-ordered date index
+    void indexDates(RowId firstRow);
+
+    // Postings are row bitmaps; categorical indices are addressed by StringPool code
+    using CodeIndex = std::vector<RowBitmap>;
+    using CountIndex = std::map<int, RowBitmap>;
+    const RowBitmap* findPostings(const CodeIndex& index, StringDomain domain,
+                                  const std::string& value) const;
+
+    // Create a shared IRecord view that keeps the column store alive
+    RecordPtr makeRecordPtr(RowId row) const;
+
+    // Row sets over index-owned postings, or over a computed list of rows
+    RowSet borrowRows(std::vector<RowSpan> spans) const;
+    RowSet borrowRows(const std::vector<const RowBitmap*>& bitmaps) const;
+    RowSet ownRows(std::vector<RowId> rows) const;
+    RowSet rowsInCountRange(const CountIndex& index, int minCount, int maxCount) const;
+
+    // Query planning: exact or estimated matches of one predicate, whether
+    // its index is a bitmap, its rows from the index, and a row test against
+    // the columns
+    std::size_t estimateRows(const Query::Predicate& predicate) const;
+    static bool hasBitmapIndex(Query::Field field);
+    RowSet rowsFor(const Query::Predicate& predicate) const;
+    std::function<bool(RowId)> matcherFor(const Query::Predicate& predicate) const;
+
+    // Intersect when a predicate's bitmap is at most this many times the candidates
+    static constexpr std::size_t kIntersectRatio = 4;
+
+    // Primary columnar storage
+    std::shared_ptr<ColumnStore> store_;
+    std::shared_ptr<const ExecutionContext> context_;
+    ParseStats parseStats_;
+
+    // Spatial index: one packed tree per latitude strip, then delta trees of
+    // the points inserted since, oldest first
+    std::vector<SpatialSegment> segments_;
+    std::size_t strips_ = 0;
+    SpatialIndexStats spatialStats_;
+    size_t spatialPartitions_ = 1;
     mutable std::shared_mutex spatial_mutex_;
 
+    // Polygon layers in the order they were added
+    std::vector<RegionIndex> regionIndexes_;
+
     // Other indices for efficient querying
-    std::unordered_map<int, std::shared_ptr<Record>> keyIndex_;
-    std::unordered_map<std::string, std::vector<std::shared_ptr<Record>>> boroughIndex_;
-    std::unordered_map<std::string, std::vector<std::shared_ptr<Record>>> zipIndex_;
-    std::map<Date, std::vector<std::shared_ptr<Record>>> dateIndex_;
+    KeyIndex keyIndex_;
+    CodeIndex boroughIndex_;
+    CodeIndex zipIndex_;
+
+    // Date index: rows sorted by timestamp
+    DateIndex dates_;
     
     // Indices for range queries
-    std::map<int, std::vector<std::shared_ptr<Record>>> injuryIndex_;
-    std::map<int, std::vector<std::shared_ptr<Record>>> fatalityIndex_;
-    std::map<int, std::vector<std::shared_ptr<Record>>> pedestrianFatalityIndex_;
-    std::map<int, std::vector<std::shared_ptr<Record>>> cyclistFatalityIndex_;
-    std::map<int, std::vector<std::shared_ptr<Record>>> motoristFatalityIndex_;
+    CountIndex injuryIndex_;
+    CountIndex fatalityIndex_;
+    CountIndex pedestrianFatalityIndex_;
+    CountIndex cyclistFatalityIndex_;
+    CountIndex motoristFatalityIndex_;
     
     // Vehicle type index
-    std::unordered_map<std::string, std::vector<std::shared_ptr<Record>>> vehicleTypeIndex_;
+    CodeIndex vehicleTypeIndex_;
+
+    // Casualty rollups
+    RollupCube rollup_;
+    HeatmapTiles tiles_;
 };
 
 } // namespace nycollision
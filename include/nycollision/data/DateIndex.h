@@ -0,0 +1,91 @@
+#pragma once
+#include "../core/Timestamp.h"
+#include "../core/Types.h"
+#include "RowSet.h"
+#include "../util/ExecutionContext.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief Rows ordered by timestamp, in blocks that copies share
+ *
+ * The order is cut into blocks of about kBlockEntries rows, each holding
+ * its timestamps and rows in parallel arrays so a range lookup
+ * binary-searches dense integers and returns one span per block. On equal
+ * timestamps lower rows come first.
+ *
+ * Copies share blocks. Inserting or removing rows rewrites only the blocks
+ * their timestamps fall in, so a fork that takes recent collisions copies
+ * the last few blocks rather than the whole order.
+ */
+class DateIndex {
+public:
+    using Entry = std::pair<Timestamp, RowId>;
+
+    static constexpr std::size_t kBlockEntries = std::size_t{1} << 12;
+
+    /**
+     * @brief Add rows under their timestamps; the batch is sorted over the context's threads
+     */
+    void insert(std::vector<Entry> added, const ExecutionContext& context);
+
+    /**
+     * @brief Drop rows stored under the given timestamps; entries not stored are ignored
+     */
+    void remove(std::vector<Entry> removed);
+
+    /**
+     * @brief Rows with a timestamp in [start, end], in timestamp order, one span per block
+     *
+     * Spans point into the blocks and stay valid while this index is not modified.
+     */
+    std::vector<RowSpan> range(Timestamp start, Timestamp end) const;
+
+    std::size_t size() const { return size_; }
+
+    void clear() {
+        blocks_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief Approximate heap usage in bytes, counting shared blocks in full
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief Append the timestamps and rows in order as two arrays
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Replace the contents with arrays written by save()
+     * @throws std::runtime_error if the section is truncated or the arrays differ in length
+     */
+    void load(SnapshotCursor& in);
+
+private:
+    struct Block {
+        std::vector<Timestamp> keys;
+        std::vector<RowId> rows;
+
+        Entry entry(std::size_t i) const { return {keys[i], rows[i]}; }
+        Entry front() const { return entry(0); }
+        Entry back() const { return entry(keys.size() - 1); }
+    };
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    // Append sorted entries as blocks of at most 2 * kBlockEntries
+    static void appendBlocks(const std::vector<Entry>& entries, std::vector<BlockPtr>& out);
+
+    std::vector<BlockPtr> blocks_;
+    std::size_t size_ = 0;
+};
+
+} // namespace nycollision
@@ -0,0 +1,135 @@
+#pragma once
+#include "CasualtyAggregate.h"
+#include "ColumnStore.h"
+#include "../util/ExecutionContext.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief One cell of a heatmap: its grid position, bounds and casualty sums
+ *
+ * Cells are numbered from the grid's south-west corner: x grows eastward
+ * and y northward.
+ */
+struct HeatmapCell {
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+    double minLat = 0.0, maxLat = 0.0, minLon = 0.0, maxLon = 0.0;
+    CasualtyTotals totals;  ///< Collisions in the cell and their casualty sums
+};
+
+/**
+ * @brief Collision counts and casualty sums pre-aggregated into a quadtree of tiles
+ *
+ * Level z cuts longitude [-180, 180] and latitude [-90, 90] into 2^z x 2^z
+ * equal tiles, so each tile splits into four of the next level, as geohash
+ * cells do. Levels kMinLevel to kMaxLevel are kept; at NYC a level-18 tile
+ * is about 115 m east-west by 76 m north-south, and each coarser level
+ * doubles both. Only tiles holding collisions are stored.
+ *
+ * Rows are binned once at the finest level and the changes rolled up level
+ * by level, so an update costs one hash insert per row plus one per touched
+ * tile above it. Reading a view costs its number of tiles, not rows.
+ *
+ * Each level is an immutable base of tiles shared by copies, plus the
+ * changes made since it was built. Changes are folded into a new base once
+ * they reach 1/kFoldRatio of its tiles, so copying the tiles of a large
+ * dataset that takes small deltas copies only the recent changes.
+ */
+class HeatmapTiles {
+public:
+    static constexpr int kMinLevel = 6;
+    static constexpr int kMaxLevel = 18;
+    static constexpr std::size_t kFoldRatio = 16;
+
+    /**
+     * @brief Add rows [first, last) of a store, splitting the binning over the context's threads
+     */
+    void add(const ColumnStore& store, RowId first, RowId last, const ExecutionContext& context);
+
+    /**
+     * @brief Add individual rows, e.g. the new values of revised records
+     */
+    void add(const ColumnStore& store, const std::vector<RowId>& rows);
+
+    /**
+     * @brief Subtract rows added earlier, reading their current column values
+     *
+     * Call before the rows are overwritten; tiles left without collisions are dropped.
+     */
+    void remove(const ColumnStore& store, const std::vector<RowId>& rows);
+
+    /**
+     * @brief Tiles of a level that hold collisions and overlap a box
+     *
+     * Tiles are whole: those on the edge of the box also count collisions
+     * just outside it. Visits the tiles in the box, or every stored tile of
+     * the level when there are fewer.
+     *
+     * @param level Clamped to [kMinLevel, kMaxLevel]
+     * @return Tiles ordered by y, then x
+     */
+    std::vector<HeatmapCell> cells(double minLat, double maxLat, double minLon, double maxLon, int level) const;
+
+    /**
+     * @brief Finest level whose tiles are at least a given height
+     * @param cellMeters North-south extent of a tile
+     */
+    static int levelFor(double cellMeters);
+
+    /**
+     * @brief Number of stored tiles over every level
+     */
+    std::size_t cellCount() const;
+
+    /**
+     * @brief Append every level's base and changes as stored
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Replace the tiles with those written by save()
+     * @throws std::runtime_error if the section is truncated
+     */
+    void load(SnapshotCursor& in);
+
+private:
+    // Tile x in the high 32 bits, y in the low
+    using Key = std::uint64_t;
+    using Cells = std::unordered_map<Key, CasualtyTotals>;
+
+    static constexpr std::size_t kLevels = kMaxLevel - kMinLevel + 1;
+
+    // Tiles of one level: a shared base and the changes since, both keyed by tile.
+    // Changes are added-minus-subtracted totals, modulo 2^64 like the totals.
+    struct Level {
+        std::shared_ptr<const Cells> base = std::make_shared<const Cells>();
+        Cells changes;
+
+        // Totals of a tile; collisions is 0 for tiles without collisions
+        CasualtyTotals find(Key key) const;
+        // Call func(key, totals) for every tile holding collisions
+        template <typename Func>
+        void forEach(Func&& func) const;
+        std::size_t size() const;
+        void fold();
+    };
+
+    static Key finestKeyOf(float latitude, float longitude);
+    static void addRows(const ColumnStore& store, RowId first, RowId last, Cells& cells);
+
+    // Fold changes of the finest level into every level, adding or subtracting
+    void apply(Cells changes, bool subtract);
+
+    std::array<Level, kLevels> levels_;  // Coarsest first
+};
+
+} // namespace nycollision
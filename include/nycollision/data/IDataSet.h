@@ -1,12 +1,41 @@
 #pragma once
 #include "../core/IRecord.h"
+#include "RowSet.h"
+#include <cstddef>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <vector>
 
 namespace nycollision {
 
+/**
+ * @brief Window of a streamed query result
+ */
+struct ScanOptions {
+    static constexpr std::size_t kNoLimit = std::numeric_limits<std::size_t>::max();
+
+    std::size_t offset = 0;        ///< Matching rows to skip before the first visit
+    std::size_t limit = kNoLimit;  ///< Most rows to visit
+};
+
+/**
+ * @brief Consumer of a streamed query; return false to stop the scan
+ *
+ * The record is only valid during the call.
+ */
+using RecordVisitor = std::function<bool(const IRecord&)>;
+
 /**
  * @brief Interface for querying collision records
+ *
+ * Every query comes in two forms. queryBy*() returns shared IRecord handles,
+ * one allocation per row. rowsBy*() returns a RowSet that borrows the
+ * matching row ids from the indexes where possible, so returning even a
+ * large result costs O(1); records are materialized only when iterated or
+ * passed to toRecords(). visitBy*() streams matching records to a callback
+ * without building a result at all, honouring ScanOptions and stopping as
+ * soon as the callback returns false.
  */
 class IDataSet {
 public:
@@ -40,7 +69,15 @@ public:
      * @brief Date range query
      * @return Records within the specified date range (inclusive)
      */
-    virtual Records queryByDateRange(const Date& start, const Date& end) const = 0;
+    virtual Records queryByDateRange(const Date& start, const Date& end) const {
+        return queryByDateRange(start.toTimestamp(), end.toTimestamp());
+    }
+
+    /**
+     * @brief Timestamp range query
+     * @return Records with start <= timestamp <= end, in chronological order
+     */
+    virtual Records queryByDateRange(Timestamp start, Timestamp end) const = 0;
 
     /**
      * @brief Vehicle type query
@@ -73,6 +110,116 @@ public:
     virtual Records queryByCyclistFatalities(int minFatalities, int maxFatalities) const = 0;
     virtual Records queryByMotoristFatalities(int minFatalities, int maxFatalities) const = 0;
 
+    /**
+     * @brief The collisions nearest to a point by great-circle distance
+     * @param k Most records to return
+     * @return Up to k records, nearest first; equally distant records in row order
+     */
+    virtual Records queryNearest(float latitude, float longitude, std::size_t k) const = 0;
+
+    /**
+     * @brief Collisions within a great-circle distance of a point
+     * @param meters Radius; records at exactly this distance match
+     * @return Records nearest first; equally distant records in row order
+     */
+    virtual Records queryByRadius(float latitude, float longitude, double meters) const = 0;
+
+    /**
+     * @brief Row-set forms of the queries above
+     *
+     * Results are in the same order as the matching queryBy*() call.
+     */
+    virtual RowSet rowsByGeoBounds(float minLat, float maxLat, float minLon, float maxLon) const = 0;
+    virtual RowSet rowsByBorough(const std::string& borough) const = 0;
+    virtual RowSet rowsByZipCode(const std::string& zipCode) const = 0;
+    virtual RowSet rowsByDateRange(const Date& start, const Date& end) const {
+        return rowsByDateRange(start.toTimestamp(), end.toTimestamp());
+    }
+    virtual RowSet rowsByDateRange(Timestamp start, Timestamp end) const = 0;
+    virtual RowSet rowsByVehicleType(const std::string& vehicleType) const = 0;
+    virtual RowSet rowsByInjuryRange(int minInjuries, int maxInjuries) const = 0;
+    virtual RowSet rowsByFatalityRange(int minFatalities, int maxFatalities) const = 0;
+    virtual RowSet rowsByPedestrianFatalities(int minFatalities, int maxFatalities) const = 0;
+    virtual RowSet rowsByCyclistFatalities(int minFatalities, int maxFatalities) const = 0;
+    virtual RowSet rowsByMotoristFatalities(int minFatalities, int maxFatalities) const = 0;
+    virtual RowSet rowsNearest(float latitude, float longitude, std::size_t k) const = 0;
+    virtual RowSet rowsByRadius(float latitude, float longitude, double meters) const = 0;
+
+    /**
+     * @brief Materialize a row set as shared IRecord handles
+     * @return One record per row, in row-set order
+     */
+    virtual Records toRecords(const RowSet& rows) const = 0;
+
+    /**
+     * @brief Stream the rows of a row set to a visitor
+     * @param rows Rows to visit, in row-set order
+     * @param visitor Called once per row until it returns false
+     * @param options Rows to skip and most rows to visit
+     * @return Number of rows passed to the visitor
+     */
+    std::size_t visit(const RowSet& rows, const RecordVisitor& visitor, ScanOptions options = {}) const {
+        std::size_t visited = 0;
+        if (options.limit == 0) {
+            return visited;
+        }
+        rows.forEachUntil([&](RowId row) {
+            ++visited;
+            return visitor(RecordView(rows.store(), row)) && visited != options.limit;
+        }, options.offset);
+        return visited;
+    }
+
+    /**
+     * @brief Streaming forms of the queries above
+     *
+     * Records arrive in the order of the matching queryBy*() call. The
+     * defaults visit the row set of the query; implementations may override
+     * them to avoid computing rows past the point where the visitor stops.
+     *
+     * @return Number of records passed to the visitor
+     */
+    virtual std::size_t visitByGeoBounds(float minLat, float maxLat, float minLon, float maxLon,
+                                         const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByGeoBounds(minLat, maxLat, minLon, maxLon), visitor, options);
+    }
+    virtual std::size_t visitByBorough(const std::string& borough,
+                                       const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByBorough(borough), visitor, options);
+    }
+    virtual std::size_t visitByZipCode(const std::string& zipCode,
+                                       const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByZipCode(zipCode), visitor, options);
+    }
+    virtual std::size_t visitByDateRange(Timestamp start, Timestamp end,
+                                         const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByDateRange(start, end), visitor, options);
+    }
+    virtual std::size_t visitByVehicleType(const std::string& vehicleType,
+                                           const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByVehicleType(vehicleType), visitor, options);
+    }
+    virtual std::size_t visitByInjuryRange(int minInjuries, int maxInjuries,
+                                           const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByInjuryRange(minInjuries, maxInjuries), visitor, options);
+    }
+    virtual std::size_t visitByFatalityRange(int minFatalities, int maxFatalities,
+                                             const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByFatalityRange(minFatalities, maxFatalities), visitor, options);
+    }
+    virtual std::size_t visitByPedestrianFatalities(int minFatalities, int maxFatalities,
+                                                    const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByPedestrianFatalities(minFatalities, maxFatalities), visitor, options);
+    }
+    virtual std::size_t visitByCyclistFatalities(int minFatalities, int maxFatalities,
+                                                 const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByCyclistFatalities(minFatalities, maxFatalities), visitor, options);
+    }
+    virtual std::size_t visitByMotoristFatalities(int minFatalities, int maxFatalities,
+                                                  const RecordVisitor& visitor, ScanOptions options = {}) const {
+        return visit(rowsByMotoristFatalities(minFatalities, maxFatalities), visitor, options);
+    }
+
     /**
      * @brief Returns total number of records in the dataset
      */
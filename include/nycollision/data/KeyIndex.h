@@ -0,0 +1,82 @@
+#pragma once
+#include "../core/Types.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief Map from collision id to row, kept as immutable sorted runs
+ *
+ * Each insert() adds its batch as a new run, sorted by key, then merges
+ * the newest runs while one is at most twice the size of the run after it,
+ * so a dataset of n keys has O(log n) runs and a key is merged O(log n)
+ * times. Lookups binary-search the runs newest first.
+ *
+ * Copies share the runs, so a forked dataset that takes a small delta
+ * pays for its new keys and the small runs they merge with, not for a
+ * copy of the whole map.
+ */
+class KeyIndex {
+public:
+    struct Entry {
+        std::int32_t key;
+        RowId row;
+    };
+
+    /**
+     * @brief Map keys to rows; later entries win over earlier ones and over earlier batches
+     */
+    void insert(std::vector<Entry> entries);
+
+    /**
+     * @brief Row of a key
+     * @return Whether the key is mapped
+     */
+    bool find(int key, RowId& row) const;
+
+    void clear() { runs_.clear(); }
+
+    std::size_t runCount() const { return runs_.size(); }
+
+    /**
+     * @brief Approximate heap usage in bytes, counting shared runs in full
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief Append the runs as stored, oldest first
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Replace the runs with those written by save()
+     * @throws std::runtime_error if the section is truncated
+     */
+    void load(SnapshotCursor& in);
+
+    /**
+     * @brief Call func(entry) for every entry, oldest run first; a later entry of a key overrides earlier ones
+     */
+    template <typename Func>
+    void forEach(Func&& func) const {
+        for (const auto& run : runs_) {
+            for (const Entry& entry : *run) {
+                func(entry);
+            }
+        }
+    }
+
+private:
+    using Run = std::vector<Entry>;
+
+    static Run merge(const Run& older, const Run& newer);
+
+    std::vector<std::shared_ptr<const Run>> runs_;  // Oldest and largest first
+};
+
+} // namespace nycollision
@@ -0,0 +1,93 @@
+#pragma once
+#include "DataSet.h"
+#include "../util/Epoch.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace nycollision {
+
+/**
+ * @brief DataSet that keeps answering queries while data is loaded into it
+ *
+ * Readers work on an immutable version: read() runs a query on the current
+ * version without taking a lock, and current() pins it for longer. Loads
+ * fork the current version, apply the change to the copy while readers
+ * continue on the original, and then publish the copy in one atomic swap.
+ * A version is freed once no reader or pinned handle refers to it.
+ *
+ * Versions share the column chunks and index pieces a load leaves alone
+ * (see DataSet::fork()), so a small delta costs time and memory in the
+ * pieces it touches rather than in the whole dataset. Loads may run on
+ * their own execution context so they do not compete with queries for
+ * the readers' threads.
+ */
+class LiveDataSet {
+public:
+    /**
+     * @brief Start with an empty version
+     * @param pool String pool for categorical fields; use the parser's pool to avoid re-encoding
+     * @param context Threads used for queries and result materialization
+     * @param ingestContext Threads used for loading and index builds; nullptr uses context
+     */
+    explicit LiveDataSet(std::shared_ptr<StringPool> pool = StringPool::global(),
+                         std::shared_ptr<const ExecutionContext> context = ExecutionContext::defaultContext(),
+                         std::shared_ptr<const ExecutionContext> ingestContext = nullptr);
+
+    /**
+     * @brief Call fn(const DataSet&) on the current version
+     *
+     * The version cannot be freed during the call. Row sets returned from fn
+     * keep their version alive; references into it must not escape. fn must
+     * not load into this object.
+     */
+    template <typename Fn>
+    decltype(auto) read(Fn&& fn) const {
+        return versions_.read(std::forward<Fn>(fn));
+    }
+
+    /**
+     * @brief Pin the current version for as long as the handle is held
+     */
+    std::shared_ptr<const DataSet> current() const { return versions_.acquire(); }
+
+    /**
+     * @brief Number of the current version; 1 before the first load
+     */
+    std::uint64_t version() const { return versions_.version(); }
+
+    /**
+     * @brief Apply a change to a fork of the current version and publish it
+     *
+     * Updates are serialized. If build throws, nothing is published.
+     */
+    void update(const std::function<void(DataSet&)>& build);
+
+    /**
+     * @brief Publish a version with the records of a file appended
+     * @see DataSet::loadFromFile()
+     */
+    void loadFromFile(const std::string& filename, const IParser& parser);
+
+    /**
+     * @brief Publish a version with a delta file upserted
+     * @see DataSet::appendFromFile()
+     */
+    DataSet::AppendStats appendFromFile(const std::string& filename, const IParser& parser);
+
+    /**
+     * @brief Publish a version read from a snapshot; the current version must be empty
+     * @see DataSet::loadSnapshot()
+     */
+    void loadSnapshot(const std::string& filename);
+
+private:
+    std::shared_ptr<const ExecutionContext> context_;
+    std::shared_ptr<const ExecutionContext> ingestContext_;
+    std::mutex update_mutex_;
+    Versioned<DataSet> versions_;
+};
+
+} // namespace nycollision
@@ -0,0 +1,232 @@
+#pragma once
+#include "../core/Types.h"
+#include "../util/ExecutionContext.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief Immutable R-tree over points, packed Sort-Tile-Recursive in one pass
+ *
+ * Points are sorted into latitude slices and each slice by longitude, then
+ * cut into full leaves of kNodeCapacity points; every level above groups
+ * kNodeCapacity consecutive nodes. The tree is two flat arrays, the points
+ * in leaf order and the node boxes level by level, so it is never changed
+ * after packing and can be shared by any number of datasets.
+ *
+ * Coordinates are planar degrees, latitude first, as in the rest of the
+ * spatial index.
+ */
+class PackedRTree {
+public:
+    static constexpr std::size_t kNodeCapacity = 16;
+
+    struct Entry {
+        float latitude;
+        float longitude;
+        RowId row;
+    };
+
+    /**
+     * @brief Inclusive latitude/longitude box
+     */
+    struct Bounds {
+        float minLat = std::numeric_limits<float>::max();
+        float minLon = std::numeric_limits<float>::max();
+        float maxLat = std::numeric_limits<float>::lowest();
+        float maxLon = std::numeric_limits<float>::lowest();
+
+        bool contains(float latitude, float longitude) const {
+            return latitude >= minLat && latitude <= maxLat && longitude >= minLon && longitude <= maxLon;
+        }
+        bool intersects(const Bounds& other) const {
+            return minLat <= other.maxLat && other.minLat <= maxLat && minLon <= other.maxLon &&
+                   other.minLon <= maxLon;
+        }
+        void expand(const Bounds& other) {
+            minLat = std::min(minLat, other.minLat);
+            minLon = std::min(minLon, other.minLon);
+            maxLat = std::max(maxLat, other.maxLat);
+            maxLon = std::max(maxLon, other.maxLon);
+        }
+        // Squared planar distance from a point; 0 inside
+        double distance2(float latitude, float longitude) const {
+            const double dLat = std::max({static_cast<double>(minLat) - latitude, 0.0,
+                                          static_cast<double>(latitude) - maxLat});
+            const double dLon = std::max({static_cast<double>(minLon) - longitude, 0.0,
+                                          static_cast<double>(longitude) - maxLon});
+            return dLat * dLat + dLon * dLon;
+        }
+    };
+
+    /**
+     * @brief Node counts of a packed tree
+     */
+    struct Shape {
+        std::size_t levels = 0;          ///< Node levels, counting the leaf level
+        std::size_t internalNodes = 0;
+        std::size_t leaves = 0;
+        std::size_t minLeafEntries = 0;
+        std::size_t maxLeafEntries = 0;
+    };
+
+    PackedRTree() = default;
+
+    /**
+     * @brief Pack points; the slices are sorted in parallel
+     */
+    static PackedRTree pack(std::vector<Entry> entries, const ExecutionContext& context);
+
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    /**
+     * @brief Box of every point; empty bounds for an empty tree
+     */
+    Bounds bounds() const { return nodes_.empty() ? Bounds{} : nodes_.back(); }
+
+    /**
+     * @brief Points in leaf order
+     */
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    Shape shape() const;
+
+    /**
+     * @brief Call visit(entry) for every point in a box, in leaf order
+     *
+     * Stops as soon as visit returns false.
+     *
+     * @return Whether every point in the box was visited
+     */
+    template <typename Visit>
+    bool query(const Bounds& box, Visit&& visit) const;
+
+    /**
+     * @brief Up to k points nearest to a location in planar degrees, nearest first
+     * @param accept Called as accept(entry); rejected points are skipped
+     */
+    template <typename Accept>
+    std::vector<Entry> nearest(float latitude, float longitude, std::size_t k, Accept&& accept) const;
+
+    /**
+     * @brief Whether the tree holds a row at a point
+     */
+    bool contains(const Entry& entry) const;
+
+    /**
+     * @brief Append the points, node boxes and level offsets as stored
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Read a tree written by save() without packing it again
+     * @throws std::runtime_error if the section is truncated or the levels do not fit the points
+     */
+    static PackedRTree load(SnapshotCursor& in);
+
+private:
+    // Nodes of level l are nodes_[levelStarts_[l], levelStarts_[l + 1]); level 0 are the leaves
+    std::size_t levelSize(std::size_t level) const { return levelStarts_[level + 1] - levelStarts_[level]; }
+    // Children of node i of a level: entries for leaves, nodes of the level below otherwise
+    std::size_t childCount(std::size_t level, std::size_t node) const {
+        const std::size_t children = level == 0 ? entries_.size() : levelSize(level - 1);
+        return std::min(kNodeCapacity, children - node * kNodeCapacity);
+    }
+
+    std::vector<Entry> entries_;
+    std::vector<Bounds> nodes_;
+    std::vector<std::size_t> levelStarts_;
+};
+
+template <typename Visit>
+bool PackedRTree::query(const Bounds& box, Visit&& visit) const {
+    if (nodes_.empty()) {
+        return true;
+    }
+    struct Pending {
+        std::size_t level;
+        std::size_t node;
+    };
+    std::vector<Pending> stack{{levelStarts_.size() - 2, 0}};
+    while (!stack.empty()) {
+        const Pending pending = stack.back();
+        stack.pop_back();
+        const std::size_t first = pending.node * kNodeCapacity;
+        const std::size_t count = childCount(pending.level, pending.node);
+        if (pending.level == 0) {
+            for (std::size_t i = first; i < first + count; ++i) {
+                const Entry& entry = entries_[i];
+                if (box.contains(entry.latitude, entry.longitude) && !visit(entry)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        // Pushed in reverse so children are visited in order
+        const std::size_t below = levelStarts_[pending.level - 1];
+        for (std::size_t i = first + count; i-- > first;) {
+            if (nodes_[below + i].intersects(box)) {
+                stack.push_back({pending.level - 1, i});
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Accept>
+std::vector<PackedRTree::Entry> PackedRTree::nearest(float latitude, float longitude, std::size_t k,
+                                                     Accept&& accept) const {
+    std::vector<Entry> result;
+    if (nodes_.empty() || k == 0) {
+        return result;
+    }
+    // Best first: nodes by the distance to their box, points by their own;
+    // a point popped before every node left is nearer than anything below them
+    struct Candidate {
+        double distance2;
+        std::size_t level;  // Node level, or kPoint for an entry
+        std::size_t index;
+        bool operator>(const Candidate& other) const { return distance2 > other.distance2; }
+    };
+    constexpr std::size_t kPoint = std::numeric_limits<std::size_t>::max();
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+    queue.push({0.0, levelStarts_.size() - 2, 0});
+    while (!queue.empty() && result.size() < k) {
+        const Candidate candidate = queue.top();
+        queue.pop();
+        if (candidate.level == kPoint) {
+            result.push_back(entries_[candidate.index]);
+            continue;
+        }
+        const std::size_t first = candidate.index * kNodeCapacity;
+        const std::size_t count = childCount(candidate.level, candidate.index);
+        for (std::size_t i = first; i < first + count; ++i) {
+            if (candidate.level == 0) {
+                const Entry& entry = entries_[i];
+                const double dLat = static_cast<double>(entry.latitude) - latitude;
+                const double dLon = static_cast<double>(entry.longitude) - longitude;
+                const double distance2 = dLat * dLat + dLon * dLon;
+                // Points without coordinates have no distance and are never near
+                if (!std::isnan(distance2) && accept(entry)) {
+                    queue.push({distance2, kPoint, i});
+                }
+            } else {
+                const Bounds& box = nodes_[levelStarts_[candidate.level - 1] + i];
+                queue.push({box.distance2(latitude, longitude), candidate.level - 1, i});
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace nycollision
@@ -0,0 +1,155 @@
+#pragma once
+#include "../core/Timestamp.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief Conjunction of predicates over collision records
+ *
+ * Built with chained calls and answered by DataSet::rowsMatching(), which
+ * plans the query: the most selective predicate is read from its index and
+ * the others are ANDed with its bitmap or checked against the columns.
+ *
+ * @code
+ * auto rows = dataset.rowsMatching(Query()
+ *     .borough("BROOKLYN")
+ *     .dateRange(CalendarDate{2024, 1, 1}, CalendarDate{2024, 1, 31})
+ *     .injuries(1, 999));
+ * @endcode
+ */
+class Query {
+public:
+    enum class Field {
+        GeoBounds,
+        Borough,
+        ZipCode,
+        DateRange,
+        VehicleType,
+        Injuries,
+        Fatalities,
+        PedestrianFatalities,
+        CyclistFatalities,
+        MotoristFatalities,
+        Region
+    };
+
+    struct Predicate {
+        Field field;
+        std::string value;       ///< Borough, ZIP code, vehicle type or region
+        std::string layer{};     ///< Region layer, see DataSet::addRegionLayer()
+        std::int64_t min = 0;    ///< Inclusive range: timestamps or casualty counts
+        std::int64_t max = 0;
+        float minLat = 0.0f, maxLat = 0.0f, minLon = 0.0f, maxLon = 0.0f;
+    };
+
+    // Location
+    Query& inArea(float minLat, float maxLat, float minLon, float maxLon) {
+        Predicate predicate{Field::GeoBounds, {}};
+        predicate.minLat = minLat;
+        predicate.maxLat = maxLat;
+        predicate.minLon = minLon;
+        predicate.maxLon = maxLon;
+        predicates_.push_back(std::move(predicate));
+        return *this;
+    }
+    Query& borough(std::string borough) { return equals(Field::Borough, std::move(borough)); }
+    Query& zipCode(std::string zipCode) { return equals(Field::ZipCode, std::move(zipCode)); }
+    Query& region(std::string layer, std::string region) {
+        equals(Field::Region, std::move(region));
+        predicates_.back().layer = std::move(layer);
+        return *this;
+    }
+
+    // Time
+    Query& dateRange(Timestamp start, Timestamp end) { return range(Field::DateRange, start, end); }
+    Query& dateRange(const CalendarDate& first, const CalendarDate& last) {
+        return dateRange(first.startOfDay(), last.endOfDay());
+    }
+
+    // Vehicles
+    Query& vehicleType(std::string vehicleType) { return equals(Field::VehicleType, std::move(vehicleType)); }
+
+    // Casualty counts, inclusive
+    Query& injuries(int min, int max) { return range(Field::Injuries, min, max); }
+    Query& fatalities(int min, int max) { return range(Field::Fatalities, min, max); }
+    Query& pedestrianFatalities(int min, int max) { return range(Field::PedestrianFatalities, min, max); }
+    Query& cyclistFatalities(int min, int max) { return range(Field::CyclistFatalities, min, max); }
+    Query& motoristFatalities(int min, int max) { return range(Field::MotoristFatalities, min, max); }
+
+    const std::vector<Predicate>& predicates() const { return predicates_; }
+    bool empty() const { return predicates_.empty(); }
+
+    /**
+     * @brief Human-readable form of a predicate, e.g. "borough = BROOKLYN"
+     */
+    static std::string describe(const Predicate& predicate) {
+        auto interval = [&predicate] {
+            return "[" + std::to_string(predicate.min) + ", " + std::to_string(predicate.max) + "]";
+        };
+        switch (predicate.field) {
+        case Field::GeoBounds:
+            return "area lat [" + std::to_string(predicate.minLat) + ", " + std::to_string(predicate.maxLat) +
+                   "] lon [" + std::to_string(predicate.minLon) + ", " + std::to_string(predicate.maxLon) + "]";
+        case Field::Borough: return "borough = " + predicate.value;
+        case Field::ZipCode: return "zip code = " + predicate.value;
+        case Field::DateRange: {
+            auto start = static_cast<Timestamp>(predicate.min);
+            auto end = static_cast<Timestamp>(predicate.max);
+            return "date in [" + formatDate(start) + " " + formatTime(start) + ", " +
+                   formatDate(end) + " " + formatTime(end) + "]";
+        }
+        case Field::VehicleType: return "vehicle type = " + predicate.value;
+        case Field::Injuries: return "injuries in " + interval();
+        case Field::Fatalities: return "fatalities in " + interval();
+        case Field::PedestrianFatalities: return "pedestrian fatalities in " + interval();
+        case Field::CyclistFatalities: return "cyclist fatalities in " + interval();
+        case Field::MotoristFatalities: return "motorist fatalities in " + interval();
+        case Field::Region: return predicate.layer + " = " + predicate.value;
+        }
+        return {};
+    }
+
+private:
+    Query& equals(Field field, std::string value) {
+        predicates_.push_back(Predicate{field, std::move(value)});
+        return *this;
+    }
+
+    Query& range(Field field, std::int64_t min, std::int64_t max) {
+        Predicate predicate{field, {}};
+        predicate.min = min;
+        predicate.max = max;
+        predicates_.push_back(std::move(predicate));
+        return *this;
+    }
+
+    std::vector<Predicate> predicates_;
+};
+
+/**
+ * @brief How DataSet answers a Query, in execution order
+ */
+struct QueryPlan {
+    enum class Access {
+        Index,     ///< Rows of this predicate read from its index; produces the candidates
+        Intersect, ///< Candidate bitmap ANDed with the predicate's index bitmap
+        Filter,    ///< Candidates checked against the columns
+        Empty      ///< Predicate matches nothing; the query stops here
+    };
+
+    struct Step {
+        std::size_t predicate = 0;     ///< Position in Query::predicates()
+        Access access = Access::Filter;
+        std::size_t estimated_rows = 0; ///< Rows matching this predicate alone
+    };
+
+    std::vector<Step> steps;            ///< Empty for a query without predicates, which returns every row
+    std::size_t estimated_rows = 0;     ///< Expected result size, assuming independent predicates
+};
+
+} // namespace nycollision
@@ -0,0 +1,63 @@
+#pragma once
+#include "../core/IRecord.h"
+#include "ColumnStore.h"
+#include <mutex>
+#include <optional>
+
+namespace nycollision {
+
+/**
+ * @brief IRecord over one row of a ColumnStore
+ *
+ * Construction only stores the row position. Casualty statistics and vehicle
+ * information are materialized on first access; string fields are returned
+ * straight from the store's dictionaries. The view must not outlive the
+ * store it refers to.
+ */
+class RecordView : public IRecord {
+public:
+    RecordView(const ColumnStore& store, RowId row) : store_(&store), row_(row) {}
+
+    // Location information
+    const std::string& getBorough() const override { return store_->borough(row_); }
+    const std::string& getZipCode() const override { return store_->zipCode(row_); }
+    GeoCoordinate getLocation() const override { return store_->location(row_); }
+    const std::string& getOnStreet() const override { return store_->onStreet(row_); }
+    const std::string& getCrossStreet() const override { return store_->crossStreet(row_); }
+    const std::string& getOffStreet() const override { return store_->offStreet(row_); }
+
+    // Time information
+    Date getDateTime() const override { return store_->dateTime(row_); }
+    Timestamp getTimestamp() const override { return store_->timestamp(row_); }
+
+    // Casualty information
+    const CasualtyStats& getCasualtyStats() const override {
+        std::call_once(statsOnce_, [this] { stats_ = store_->casualtyStats(row_); });
+        return *stats_;
+    }
+
+    // Vehicle information
+    const VehicleInfo& getVehicleInfo() const override {
+        std::call_once(vehicleOnce_, [this] { vehicleInfo_ = store_->vehicleInfo(row_); });
+        return *vehicleInfo_;
+    }
+
+    // Unique identifier
+    int getUniqueKey() const override { return store_->uniqueKey(row_); }
+
+    /**
+     * @brief Row of the underlying store
+     */
+    RowId row() const { return row_; }
+
+private:
+    const ColumnStore* store_;
+    RowId row_;
+
+    mutable std::once_flag statsOnce_;
+    mutable std::optional<CasualtyStats> stats_;
+    mutable std::once_flag vehicleOnce_;
+    mutable std::optional<VehicleInfo> vehicleInfo_;
+};
+
+} // namespace nycollision
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+namespace nycollision {
+
+/**
+ * @brief Named polygons, such as police precincts or community districts
+ *
+ * Regions are numbered in the order they are first added. Coordinates are
+ * longitude/latitude degrees as in WKT and GeoJSON, and edges are straight
+ * lines in those degrees. A point on a region's boundary is inside it.
+ *
+ * Regions may overlap; each point is assigned to the lowest-numbered region
+ * that covers it, so layers of overlapping areas should be split into
+ * separate layers when every membership matters.
+ */
+class RegionLayer {
+public:
+    using RegionId = std::uint32_t;
+    static constexpr RegionId kNoRegion = std::numeric_limits<RegionId>::max();
+
+    using Point = boost::geometry::model::d2::point_xy<double>;  ///< x = longitude, y = latitude
+    using Polygon = boost::geometry::model::polygon<Point>;
+    using MultiPolygon = boost::geometry::model::multi_polygon<Polygon>;
+    using Box = boost::geometry::model::box<Point>;
+
+    /**
+     * @param name Name queries refer to the layer by, e.g. "precinct"
+     */
+    explicit RegionLayer(std::string name) : name_(std::move(name)) {}
+
+    /**
+     * @brief Read a layer from a file: GeoJSON for .json/.geojson files, otherwise WKT lines
+     * @param nameProperty GeoJSON feature property holding the region name
+     * @see fromGeoJson(), fromWkt()
+     */
+    static std::shared_ptr<RegionLayer> load(const std::string& name, const std::string& filename,
+                                             const std::string& nameProperty = "name");
+
+    /**
+     * @brief Read a GeoJSON FeatureCollection of Polygon and MultiPolygon features
+     *
+     * Features with the same name are parts of one region. Features of other
+     * geometry types are skipped.
+     *
+     * @param nameProperty Feature property holding the region name; numbers are used as written
+     * @throws std::runtime_error if the file cannot be read or is not a FeatureCollection,
+     *         or a polygon feature lacks the name property
+     */
+    static std::shared_ptr<RegionLayer> fromGeoJson(const std::string& name, const std::string& filename,
+                                                    const std::string& nameProperty = "name");
+
+    /**
+     * @brief Read one region per line as "<region name><TAB><WKT>"
+     *
+     * The WKT is a POLYGON or MULTIPOLYGON. Blank lines and lines starting
+     * with '#' are skipped; a name on several lines adds parts to one region.
+     *
+     * @throws std::runtime_error if the file cannot be read or a line does not parse
+     */
+    static std::shared_ptr<RegionLayer> fromWkt(const std::string& name, const std::string& filename);
+
+    /**
+     * @brief Add an area to a region, creating the region on first use
+     *
+     * Rings are closed and oriented as needed.
+     *
+     * @return Id of the region
+     */
+    RegionId add(const std::string& region, MultiPolygon area);
+
+    /**
+     * @brief Add a POLYGON or MULTIPOLYGON given as WKT
+     * @throws std::runtime_error if the text does not parse
+     */
+    RegionId addWkt(const std::string& region, const std::string& wkt);
+
+    const std::string& name() const { return name_; }
+    std::size_t size() const { return regions_.size(); }
+
+    const std::string& regionName(RegionId region) const { return regions_[region].name; }
+    const MultiPolygon& area(RegionId region) const { return regions_[region].area; }
+
+    /**
+     * @brief Id of a region by name, or kNoRegion
+     */
+    RegionId find(const std::string& region) const;
+
+    /**
+     * @brief The lowest-numbered region covering a point, or kNoRegion
+     *
+     * Candidates come from an R-tree over the bounding boxes of the polygons,
+     * so only polygons whose box holds the point are tested.
+     */
+    RegionId regionOf(float latitude, float longitude) const;
+
+private:
+    struct Region {
+        std::string name;
+        MultiPolygon area;
+    };
+
+    using Entry = std::pair<Box, RegionId>;
+
+    std::string name_;
+    std::vector<Region> regions_;
+    std::unordered_map<std::string, RegionId> ids_;
+    boost::geometry::index::rtree<Entry, boost::geometry::index::rstar<16>> boxes_;  ///< One box per polygon
+};
+
+} // namespace nycollision
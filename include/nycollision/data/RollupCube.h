@@ -0,0 +1,185 @@
+#pragma once
+#include "CasualtyAggregate.h"
+#include "ColumnStore.h"
+#include "../util/ExecutionContext.h"
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief Cells of a RollupCube to aggregate; every default matches all rows
+ *
+ * Months are numbered year * 12 + month - 1 (see RollupCube::monthOf()).
+ * Rows without a valid date fall into RollupCube::kUnknown for month and
+ * hour, which only the default ranges include.
+ */
+struct CubeSlice {
+    std::vector<std::string> boroughs;     ///< Boroughs to include; empty includes all
+    int firstMonth = INT_MIN;              ///< Inclusive month range
+    int lastMonth = INT_MAX;
+    int firstHour = INT_MIN;               ///< Inclusive hour-of-day range, 0-23
+    int lastHour = INT_MAX;
+    std::vector<std::string> vehicleTypes; ///< Vehicle types to include; empty includes all rows once
+};
+
+/**
+ * @brief Pre-aggregated casualty counters over borough x month x hour x vehicle type
+ *
+ * Each cell holds the number of collisions and the sums of all eight
+ * CasualtyStats counters. Queries combine cells and never read rows.
+ *
+ * A collision involves several vehicle types, so it is added once to a
+ * cube without the vehicle dimension and once per distinct vehicle type
+ * to a second cube (collisions without any vehicle type go to the empty
+ * type). Slices and groupings that involve vehicle types read the second
+ * cube, so their totals count a collision once per matching type.
+ *
+ * Cells are kept in one shard per month. Copies share shards, and a shard
+ * is duplicated the first time a copy changes it, so a copy that takes a
+ * delta of recent collisions only pays for the months they fall in.
+ */
+class RollupCube {
+public:
+    using Code = StringPool::Code;
+
+    static constexpr int kUnknown = INT_MIN;
+
+    enum Dimension : unsigned {
+        Borough = 1u << 0,
+        Month = 1u << 1,
+        Hour = 1u << 2,
+        VehicleType = 1u << 3
+    };
+
+    /**
+     * @brief One row of a grouped result; dimensions not grouped by are empty or kUnknown
+     */
+    struct Group {
+        std::string borough;
+        int month = kUnknown;
+        int hour = kUnknown;
+        std::string vehicleType;
+        CasualtyTotals totals;
+    };
+
+    explicit RollupCube(std::shared_ptr<StringPool> pool = StringPool::global()) : pool_(std::move(pool)) {}
+
+    /**
+     * @brief Add rows [first, last) of a store, splitting the work over the context's threads
+     *
+     * Cells are summed, so calling this again for appended rows updates the
+     * cube incrementally.
+     */
+    void add(const ColumnStore& store, RowId first, RowId last, const ExecutionContext& context);
+
+    /**
+     * @brief Add individual rows, e.g. the new values of revised records
+     */
+    void add(const ColumnStore& store, const std::vector<RowId>& rows);
+
+    /**
+     * @brief Subtract rows added earlier, reading their current column values
+     *
+     * Call before the rows are overwritten; cells left without collisions are dropped.
+     */
+    void remove(const ColumnStore& store, const std::vector<RowId>& rows);
+
+    /**
+     * @brief Sum of every cell in a slice
+     */
+    CasualtyTotals total(const CubeSlice& slice = {}) const;
+
+    /**
+     * @brief Sums of a slice grouped by a combination of dimensions
+     * @param dimensions Bitwise OR of Dimension values; 0 yields a single group
+     * @return Groups sorted by borough, month, hour and vehicle type
+     */
+    std::vector<Group> groupBy(unsigned dimensions, const CubeSlice& slice = {}) const;
+
+    /**
+     * @brief Number of non-empty cells in both cubes
+     */
+    std::size_t cellCount() const;
+
+    /**
+     * @brief Month number of a timestamp: year * 12 + month - 1, or kUnknown
+     */
+    static int monthOf(Timestamp timestamp);
+
+    /**
+     * @brief Month number of a calendar date
+     */
+    static int monthOf(const CalendarDate& date) { return date.year * 12 + date.month - 1; }
+
+    /**
+     * @brief Append every cell to a snapshot section
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Replace the cells with those written by save()
+     * @throws std::runtime_error if the section is truncated
+     */
+    void load(SnapshotCursor& in);
+
+private:
+    struct Key {
+        Code borough = 0;
+        Code vehicleType = 0;
+        int month = kUnknown;
+        int hour = kUnknown;
+
+        bool operator==(const Key& other) const {
+            return borough == other.borough && vehicleType == other.vehicleType && month == other.month &&
+                   hour == other.hour;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            std::uint64_t h = key.borough;
+            h = h * 0x9E3779B97F4A7C15ull + key.vehicleType;
+            h = h * 0x9E3779B97F4A7C15ull + static_cast<std::uint32_t>(key.month);
+            h = h * 0x9E3779B97F4A7C15ull + static_cast<std::uint32_t>(key.hour);
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    using Cells = std::unordered_map<Key, CasualtyTotals, KeyHash>;
+
+    // Cells of one month
+    struct Shard {
+        Cells cells;        // Vehicle type always kEmpty
+        Cells vehicleCells; // One entry per distinct vehicle type of a row
+    };
+
+    // The shard of a month, created or copied so that it can be changed
+    Shard& shardFor(int month);
+    void addCell(bool byVehicle, const Key& key, const CasualtyTotals& totals) {
+        Shard& shard = shardFor(key.month);
+        (byVehicle ? shard.vehicleCells : shard.cells)[key] += totals;
+    }
+
+    void saveCells(bool byVehicle, SnapshotBuffer& out) const;
+    void loadCells(bool byVehicle, SnapshotCursor& in);
+
+    // Calls apply(vehicle cube, key, totals) for every cell a row adds to
+    template <typename Apply>
+    static void forEachCell(const ColumnStore& store, RowId row, Apply&& apply);
+
+    static void addRows(const ColumnStore& store, RowId first, RowId last, Cells& cells, Cells& vehicleCells);
+
+    std::shared_ptr<StringPool> pool_;
+    std::map<int, std::shared_ptr<Shard>> shards_;  // By month
+};
+
+} // namespace nycollision
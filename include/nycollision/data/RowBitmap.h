@@ -0,0 +1,212 @@
+#pragma once
+#include "../core/Types.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace nycollision {
+
+class SnapshotBuffer;
+class SnapshotCursor;
+
+/**
+ * @brief Compressed set of row ids, Roaring-style
+ *
+ * Row ids are grouped by their upper 16 bits into containers. A container
+ * holding at most kArrayLimit rows is a sorted array of 16-bit offsets
+ * (2 bytes per row); a denser one is a 65536-bit bitmap (8 KiB). Set
+ * operations work container by container, so they never touch rows of
+ * key ranges the other operand does not have.
+ *
+ * Adding rows in increasing order, as index builds do, appends without
+ * searching.
+ *
+ * Copies share containers: copying a bitmap copies one pointer per
+ * container, and a container is duplicated the first time a copy modifies
+ * it while another bitmap still holds it. A forked index thus only pays for
+ * the containers its changes touch.
+ */
+class RowBitmap {
+public:
+    static constexpr std::size_t kContainerRows = std::size_t{1} << 16;
+    static constexpr std::size_t kArrayLimit = 4096;
+
+    /**
+     * @brief Forward iterator over the rows in increasing order
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = RowId;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const RowId*;
+        using reference = RowId;
+
+        const_iterator() = default;
+
+        RowId operator*() const { return row_; }
+
+        const_iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            advance();
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return container_ == other.container_ && position_ == other.position_ && word_ == other.word_;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class RowBitmap;
+        const_iterator(const RowBitmap* bitmap, std::size_t container);
+
+        void advance();
+        void settle();
+
+        const RowBitmap* bitmap_ = nullptr;
+        std::size_t container_ = 0;
+        std::size_t position_ = 0;  // Array index, or word index of a bitmap container
+        std::uint64_t word_ = 0;    // Unvisited bits of the current bitmap word
+        RowId row_ = 0;
+    };
+
+    RowBitmap() = default;
+
+    /**
+     * @brief Build from row ids sorted in increasing order; duplicates are ignored
+     */
+    static RowBitmap fromSorted(const RowId* rows, std::size_t count);
+
+    /**
+     * @brief Insert a row; appending rows in increasing order is O(1)
+     */
+    void add(RowId row);
+
+    /**
+     * @brief Erase a row if present; containers shrink back to arrays and empty ones are dropped
+     */
+    void remove(RowId row);
+
+    bool contains(RowId row) const;
+
+    std::size_t cardinality() const { return cardinality_; }
+    bool empty() const { return cardinality_ == 0; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, containers_.size()); }
+
+    RowBitmap& operator&=(const RowBitmap& other);
+    RowBitmap& operator|=(const RowBitmap& other);
+
+    friend RowBitmap operator&(const RowBitmap& a, const RowBitmap& b) {
+        RowBitmap result(a);
+        result &= b;
+        return result;
+    }
+
+    friend RowBitmap operator|(const RowBitmap& a, const RowBitmap& b) {
+        RowBitmap result(a);
+        result |= b;
+        return result;
+    }
+
+    bool operator==(const RowBitmap& other) const;
+    bool operator!=(const RowBitmap& other) const { return !(*this == other); }
+
+    /**
+     * @brief Containers in key order; rows of container i share the upper 16 bits
+     */
+    std::size_t containerCount() const { return containers_.size(); }
+    std::size_t containerCardinality(std::size_t container) const { return containers_[container]->cardinality; }
+
+    /**
+     * @brief Write the rows of one container to out in increasing order
+     * @param out Room for at least containerCardinality(container) rows
+     * @return Number of rows written
+     */
+    std::size_t decodeContainer(std::size_t container, RowId* out) const;
+
+    /**
+     * @brief Iterator at the first row of a container; containerCount() gives end()
+     */
+    const_iterator containerBegin(std::size_t container) const { return const_iterator(this, container); }
+
+    /**
+     * @brief Call func(row) for every row in increasing order
+     */
+    template <typename Func>
+    void forEach(Func&& func) const {
+        for (const auto& shared : containers_) {
+            const Container& container = *shared;
+            const RowId base = static_cast<RowId>(container.key) << 16;
+            if (container.bits.empty()) {
+                for (std::uint16_t low : container.array) {
+                    func(base | low);
+                }
+                continue;
+            }
+            for (std::size_t w = 0; w < container.bits.size(); ++w) {
+                for (std::uint64_t word = container.bits[w]; word != 0; word &= word - 1) {
+                    func(base | static_cast<RowId>(w * 64 + __builtin_ctzll(word)));
+                }
+            }
+        }
+    }
+
+    std::vector<RowId> toVector() const;
+
+    /**
+     * @brief Approximate heap usage in bytes, counting shared containers in full
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief Release spare capacity left over from building
+     */
+    void shrinkToFit();
+
+    /**
+     * @brief Append the containers to a snapshot section
+     */
+    void save(SnapshotBuffer& out) const;
+
+    /**
+     * @brief Read a bitmap written by save()
+     * @throws std::runtime_error if the section is truncated or the containers are invalid
+     */
+    static RowBitmap load(SnapshotCursor& in);
+
+private:
+    struct Container {
+        std::uint16_t key = 0;
+        std::uint32_t cardinality = 0;
+        std::vector<std::uint16_t> array;  // Sorted offsets while cardinality <= kArrayLimit
+        std::vector<std::uint64_t> bits;   // kContainerRows bits otherwise
+    };
+
+    using ContainerPtr = std::shared_ptr<Container>;
+
+    static constexpr std::size_t kWords = kContainerRows / 64;
+
+    // Make a container writable, copying it if another bitmap shares it
+    static Container& own(ContainerPtr& container);
+    Container& containerFor(std::uint16_t key);
+    const Container* findContainer(std::uint16_t key) const;
+    static void toBitmap(Container& container);
+    static void toArray(Container& container);
+    static void intersect(Container& into, const Container& other);
+    static void unite(Container& into, const Container& other);
+
+    std::vector<ContainerPtr> containers_;
+    std::size_t cardinality_ = 0;
+};
+
+} // namespace nycollision
@@ -0,0 +1,363 @@
+#pragma once
+#include "ColumnStore.h"
+#include "RecordView.h"
+#include "RowBitmap.h"
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief Contiguous run of row ids owned by someone else
+ */
+struct RowSpan {
+    const RowId* data = nullptr;
+    std::size_t size = 0;
+
+    const RowId* begin() const { return data; }
+    const RowId* end() const { return data + size; }
+};
+
+/**
+ * @brief Query result as a sequence of row-id spans and bitmaps, without per-row copies
+ *
+ * Index lookups return parts that point straight into the index: posting
+ * bitmaps or slices of the date order. Computed results (e.g. spatial
+ * queries) own their rows. Copying a RowSet copies only the part list. The
+ * set keeps its ColumnStore and the owner of the parts alive through shared
+ * pointers.
+ *
+ * Parts borrowed from a DataSet's indexes stay valid until the next load
+ * into that DataSet; a DataSet owned by a std::shared_ptr, such as a
+ * LiveDataSet version, is kept alive by the set instead.
+ */
+class RowSet {
+    struct Part {
+        RowSpan span;                       // Used when bitmap is null
+        const RowBitmap* bitmap = nullptr;
+        std::size_t size = 0;
+    };
+
+public:
+    /**
+     * @brief Forward iterator over the row ids of all parts, in order
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = RowId;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const RowId*;
+        using reference = RowId;
+
+        const_iterator() = default;
+
+        RowId operator*() const {
+            const Part& part = (*parts_)[part_];
+            return part.bitmap ? *bit_ : part.span.data[offset_];
+        }
+
+        const_iterator& operator++() {
+            const Part& part = (*parts_)[part_];
+            bool done = part.bitmap ? ++bit_ == part.bitmap->end() : ++offset_ == part.size;
+            if (done) {
+                ++part_;
+                offset_ = 0;
+                enterPart();
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return part_ == other.part_ && offset_ == other.offset_ && bit_ == other.bit_;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class RowSet;
+        const_iterator(const std::vector<Part>* parts, std::size_t part) : parts_(parts), part_(part) {
+            enterPart();
+        }
+
+        void enterPart() {
+            bool bitmap = part_ < parts_->size() && (*parts_)[part_].bitmap;
+            bit_ = bitmap ? (*parts_)[part_].bitmap->begin() : RowBitmap::const_iterator();
+        }
+
+        const std::vector<Part>* parts_ = nullptr;
+        std::size_t part_ = 0;
+        std::size_t offset_ = 0;
+        RowBitmap::const_iterator bit_;
+    };
+
+    /**
+     * @brief Iterator that materializes a RecordView for each row on dereference
+     */
+    class record_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+
+        record_iterator(const ColumnStore* store, const_iterator row) : store_(store), row_(row) {}
+
+        RecordView operator*() const { return RecordView(*store_, *row_); }
+        RowId row() const { return *row_; }
+
+        record_iterator& operator++() {
+            ++row_;
+            return *this;
+        }
+
+        bool operator==(const record_iterator& other) const { return row_ == other.row_; }
+        bool operator!=(const record_iterator& other) const { return row_ != other.row_; }
+
+    private:
+        const ColumnStore* store_;
+        const_iterator row_;
+    };
+
+    /**
+     * @brief Range adaptor yielding RecordView values
+     */
+    class RecordRange {
+    public:
+        explicit RecordRange(const RowSet& rows) : rows_(&rows) {}
+        record_iterator begin() const { return {&rows_->store(), rows_->begin()}; }
+        record_iterator end() const { return {&rows_->store(), rows_->end()}; }
+
+    private:
+        const RowSet* rows_;
+    };
+
+    RowSet() = default;
+
+    /**
+     * @brief Empty result over a store
+     */
+    explicit RowSet(std::shared_ptr<const ColumnStore> store) : store_(std::move(store)) {}
+
+    /**
+     * @brief Borrow spans owned by another object
+     * @param store Store the row ids refer to
+     * @param owner Kept alive for as long as the set exists
+     * @param spans Row-id spans, in result order; empty spans are dropped
+     */
+    RowSet(std::shared_ptr<const ColumnStore> store, std::shared_ptr<const void> owner, std::vector<RowSpan> spans)
+        : store_(std::move(store)), owner_(std::move(owner)) {
+        parts_.reserve(spans.size());
+        for (const auto& span : spans) {
+            addPart(Part{span, nullptr, span.size});
+        }
+    }
+
+    /**
+     * @brief Borrow bitmaps owned by another object
+     * @param store Store the row ids refer to
+     * @param owner Kept alive for as long as the set exists
+     * @param bitmaps Bitmaps whose rows follow each other in result order; empty ones are dropped
+     */
+    RowSet(std::shared_ptr<const ColumnStore> store, std::shared_ptr<const void> owner,
+           const std::vector<const RowBitmap*>& bitmaps)
+        : store_(std::move(store)), owner_(std::move(owner)) {
+        parts_.reserve(bitmaps.size());
+        for (const RowBitmap* bitmap : bitmaps) {
+            addPart(Part{{}, bitmap, bitmap->cardinality()});
+        }
+    }
+
+    /**
+     * @brief Take ownership of a computed list of rows
+     */
+    RowSet(std::shared_ptr<const ColumnStore> store, std::vector<RowId> rows) : store_(std::move(store)) {
+        auto owned = std::make_shared<const std::vector<RowId>>(std::move(rows));
+        addPart(Part{RowSpan{owned->data(), owned->size()}, nullptr, owned->size()});
+        owner_ = std::move(owned);
+    }
+
+    /**
+     * @brief Take ownership of a computed bitmap
+     */
+    RowSet(std::shared_ptr<const ColumnStore> store, RowBitmap rows) : store_(std::move(store)) {
+        auto owned = std::make_shared<const RowBitmap>(std::move(rows));
+        addPart(Part{{}, owned.get(), owned->cardinality()});
+        owner_ = std::move(owned);
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return const_iterator(&parts_, 0); }
+    const_iterator end() const { return const_iterator(&parts_, parts_.size()); }
+
+    /**
+     * @brief Call block(rows, count) for consecutive runs of row ids, in order
+     *
+     * Spans are passed as they are; bitmaps are decoded one container at a
+     * time into a buffer that is only valid during the call.
+     *
+     * @param block Returns false to stop
+     * @param skip Leading rows to leave out; whole spans and containers are
+     *        skipped without being read
+     */
+    template <typename Block>
+    void forEachBlock(Block&& block, std::size_t skip = 0) const {
+        std::unique_ptr<RowId[]> buffer;  // Left uninitialized, grown to the largest container decoded
+        std::size_t capacity = 0;
+        for (const auto& part : parts_) {
+            if (skip >= part.size) {
+                skip -= part.size;
+                continue;
+            }
+            if (!part.bitmap) {
+                if (!block(part.span.data + skip, part.size - skip)) {
+                    return;
+                }
+                skip = 0;
+                continue;
+            }
+            for (std::size_t c = 0; c < part.bitmap->containerCount(); ++c) {
+                std::size_t count = part.bitmap->containerCardinality(c);
+                if (skip >= count) {
+                    skip -= count;
+                    continue;
+                }
+                if (count > capacity) {
+                    buffer.reset(new RowId[count]);
+                    capacity = count;
+                }
+                part.bitmap->decodeContainer(c, buffer.get());
+                if (!block(buffer.get() + skip, count - skip)) {
+                    return;
+                }
+                skip = 0;
+            }
+        }
+    }
+
+    /**
+     * @brief Call row(id) for every row id, in order, until it returns false
+     *
+     * Bitmap rows are read one at a time rather than a container at a time,
+     * so a caller that stops after a few rows pays only for those.
+     *
+     * @param skip Leading rows to leave out; whole spans and containers are
+     *        skipped without being read
+     */
+    template <typename Row>
+    void forEachUntil(Row&& row, std::size_t skip = 0) const {
+        for (const auto& part : parts_) {
+            if (skip >= part.size) {
+                skip -= part.size;
+                continue;
+            }
+            if (!part.bitmap) {
+                for (std::size_t i = skip; i < part.size; ++i) {
+                    if (!row(part.span.data[i])) {
+                        return;
+                    }
+                }
+                skip = 0;
+                continue;
+            }
+            const RowBitmap& bitmap = *part.bitmap;
+            std::size_t c = 0;
+            while (skip >= bitmap.containerCardinality(c)) {
+                skip -= bitmap.containerCardinality(c++);
+            }
+            auto it = bitmap.containerBegin(c);
+            for (; skip != 0; --skip) {
+                ++it;
+            }
+            for (; it != bitmap.end(); ++it) {
+                if (!row(*it)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Call func(row) for every row id, in order
+     */
+    template <typename Func>
+    void forEach(Func&& func) const {
+        for (const auto& part : parts_) {
+            if (part.bitmap) {
+                part.bitmap->forEach(func);
+            } else {
+                for (RowId row : part.span) {
+                    func(row);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Copy the row ids into one vector
+     */
+    std::vector<RowId> toVector() const {
+        std::vector<RowId> rows;
+        rows.reserve(size_);
+        forEachBlock([&rows](const RowId* block, std::size_t count) {
+            rows.insert(rows.end(), block, block + count);
+            return true;
+        });
+        return rows;
+    }
+
+    /**
+     * @brief The rows as one bitmap, borrowed when the set is a single bitmap
+     *
+     * @param scratch Receives the union when the set has to be converted
+     * @return The bitmap of the single part, or scratch
+     */
+    const RowBitmap& asBitmap(RowBitmap& scratch) const {
+        if (parts_.size() == 1 && parts_.front().bitmap) {
+            return *parts_.front().bitmap;
+        }
+        scratch = RowBitmap();
+        for (const auto& part : parts_) {
+            if (part.bitmap) {
+                scratch |= *part.bitmap;
+            } else {
+                for (RowId row : part.span) {
+                    scratch.add(row);
+                }
+            }
+        }
+        return scratch;
+    }
+
+    /**
+     * @brief Records of the set, materialized one at a time while iterating
+     */
+    RecordRange records() const { return RecordRange(*this); }
+
+    const ColumnStore& store() const { return *store_; }
+    const std::shared_ptr<const ColumnStore>& storePtr() const { return store_; }
+
+private:
+    void addPart(const Part& part) {
+        if (part.size != 0) {
+            parts_.push_back(part);
+            size_ += part.size;
+        }
+    }
+
+    std::shared_ptr<const ColumnStore> store_;
+    std::shared_ptr<const void> owner_;
+    std::vector<Part> parts_;
+    std::size_t size_ = 0;
+};
+
+} // namespace nycollision
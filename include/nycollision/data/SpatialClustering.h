@@ -0,0 +1,102 @@
+#pragma once
+#include "CasualtyAggregate.h"
+#include "ColumnStore.h"
+#include "../util/ExecutionContext.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief One density cluster: its size, casualty sums and extent
+ */
+struct Cluster {
+    CasualtyTotals totals;       ///< Collisions in the cluster and their casualty sums
+    std::size_t corePoints = 0;  ///< Members with at least minPoints collisions within eps
+    double latitude = 0.0;       ///< Mean position of the members
+    double longitude = 0.0;
+    float minLat = 0.0f, maxLat = 0.0f, minLon = 0.0f, maxLon = 0.0f;
+};
+
+/**
+ * @brief DBSCAN clusters of collision locations
+ *
+ * A row is a core point when at least minPoints rows, itself included, lie
+ * within eps meters great-circle distance. Core points within eps of each
+ * other share a cluster; a non-core row within eps of a core point joins
+ * the cluster of its nearest one, and the other rows are noise.
+ *
+ * Clusters are numbered in the order of their first row, so results do not
+ * depend on the number of threads.
+ */
+class SpatialClustering {
+public:
+    using ClusterId = std::uint32_t;
+    static constexpr ClusterId kNoise = std::numeric_limits<ClusterId>::max();
+
+    /**
+     * @brief Cluster rows of a store by location
+     *
+     * Points are hashed into a grid of cells at least eps wide, so the
+     * neighbours of a point are searched in the 3 x 3 cells around it.
+     * Core points are found and linked through a lock-free union-find in
+     * parallel over the cells. Distances are compared as chords between
+     * points on the unit sphere, which order exactly as great-circle
+     * distances without any trigonometry per pair.
+     *
+     * @param rows Rows to cluster, in row order; rows without coordinates (0, 0) are left out
+     * @param epsMeters Neighbourhood radius
+     * @param minPoints Rows within eps, the row included, that make a core point
+     * @throws std::runtime_error if epsMeters is not positive or minPoints is 0
+     */
+    static SpatialClustering dbscan(const ColumnStore& store, const std::vector<RowId>& rows, double epsMeters,
+                                    std::size_t minPoints, const ExecutionContext& context);
+
+    /**
+     * @brief The same clustering by comparing every pair of rows: the baseline of dbscan()
+     */
+    static SpatialClustering dbscanBruteForce(const ColumnStore& store, const std::vector<RowId>& rows,
+                                              double epsMeters, std::size_t minPoints);
+
+    /**
+     * @brief Clustered rows in row order: the input rows that have coordinates
+     */
+    const std::vector<RowId>& rows() const { return rows_; }
+
+    /**
+     * @brief Cluster of each entry of rows(), or kNoise
+     */
+    const std::vector<ClusterId>& labels() const { return labels_; }
+
+    /**
+     * @brief Clusters by id
+     */
+    const std::vector<Cluster>& clusters() const { return clusters_; }
+
+    /**
+     * @brief Rows of one cluster, in row order
+     */
+    std::vector<RowId> rowsOf(ClusterId cluster) const;
+
+    /**
+     * @brief Number of rows in no cluster
+     */
+    std::size_t noise() const { return noise_; }
+
+private:
+    // Number clusters by first row and sum their members; roots[i] is the
+    // representative of rows_[i], or kNoise
+    void label(const ColumnStore& store, const std::vector<std::uint32_t>& roots,
+               const std::vector<char>& core);
+
+    static void checkParameters(double epsMeters, std::size_t minPoints);
+    static std::vector<RowId> locatedRows(const ColumnStore& store, const std::vector<RowId>& rows);
+
+    std::vector<RowId> rows_;
+    std::vector<ClusterId> labels_;
+    std::vector<Cluster> clusters_;
+    std::size_t noise_ = 0;
+};
+
+} // namespace nycollision
@@ -1,6 +1,10 @@
 #pragma once
 #include "IParser.h"
+#include "CSVSchema.h"
+#include "CSVScanner.h"
+#include "FieldParse.h"
 #include <string>
+#include <string_view>
 
 namespace nycollision {
 
@@ -13,16 +17,36 @@ public:
      * @brief Construct a new CSV Parser
      * @param delimiter The character used to separate fields (default: ',')
      * @param quote The character used for quoting fields (default: '"')
+     * @param pool String pool that categorical fields are encoded into
      */
-    explicit CSVParser(char delimiter = ',', char quote = '"')
-        : delimiter_(delimiter), quote_(quote) {}
+    explicit CSVParser(char delimiter = ',', char quote = '"',
+                       std::shared_ptr<StringPool> pool = StringPool::global())
+        : delimiter_(delimiter), quote_(quote), scanner_(delimiter, quote), pool_(std::move(pool)) {}
+
+    /**
+     * @brief String pool the parsed records' codes refer to
+     */
+    const std::shared_ptr<StringPool>& stringPool() const { return pool_; }
 
     /**
      * @brief Parse a CSV line into a Record object
+     *
+     * Fields are tokenized into a per-thread FieldBuffer and categorical
+     * fields are encoded straight into the string pool, so no intermediate
+     * strings are built.
+     *
+     * @param line The CSV line to parse
+     * @return Parsed record or nullptr if parsing failed
+     */
+    std::shared_ptr<Record> parseRecord(std::string_view line) const override;
+
+    /**
+     * @brief Parse a CSV line and count missing/malformed numeric fields
      * @param line The CSV line to parse
+     * @param stats Per-column data-quality counters to update
      * @return Parsed record or nullptr if parsing failed
      */
-    std::shared_ptr<Record> parseRecord(const std::string& line) const override;
+    std::shared_ptr<Record> parseRecord(std::string_view line, ParseStats& stats) const override;
 
     /**
      * @brief Split a CSV line into tokens, respecting quotes
@@ -31,25 +55,88 @@ public:
      */
     std::vector<std::string> tokenize(const std::string& line) const override;
 
+    /**
+     * @brief Split a CSV line into views, respecting quotes
+     *
+     * Field boundaries come from the vectorized CSVScanner. Plain and
+     * simply-quoted fields are returned as slices of line; only fields with
+     * escaped quotes are materialized in the buffer.
+     *
+     * @param line The CSV line to split
+     * @param fields Reusable buffer receiving the fields
+     * @return Number of fields
+     */
+    std::size_t tokenize(std::string_view line, FieldBuffer& fields) const override;
+
+    /**
+     * @brief Length of the CSV record at the front of a buffer
+     *
+     * Newlines inside quoted fields do not terminate the record.
+     */
+    std::size_t recordLength(std::string_view data) const override;
+
+    /**
+     * @brief Split a CSV buffer into chunks on quote-aware record boundaries
+     *
+     * Quote parity at each candidate cut is derived from per-chunk quote
+     * counts, so the buffer is only scanned once, in parallel.
+     */
+    std::vector<std::string_view> splitChunks(std::string_view data, std::size_t chunkCount,
+                                              const ExecutionContext& context) const override;
+
 private:
     char delimiter_;
     char quote_;
+    CSVScanner scanner_;
+    std::shared_ptr<StringPool> pool_;
 
     /**
-     * @brief Convert a string to a float, with error handling
-     * @param str The string to convert
-     * @param defaultValue Value to return if conversion fails
-     * @return Converted float value or defaultValue
+     * @brief Unescape a field starting at pos into the buffer's arena
+     * @return Position of the delimiter ending the field, or line.size()
      */
-    static float toFloat(const std::string& str, float defaultValue = 0.0f);
+    std::size_t tokenizeEscaped(std::string_view line, std::size_t pos, FieldBuffer& fields) const;
 
     /**
-     * @brief Convert a string to an integer, with error handling
-     * @param str The string to convert
+     * @brief Convert a numeric field, recording failures per column
+     * @param tokens Tokenized line
+     * @param column Column to convert
+     * @param stats Counters updated on empty or malformed values
      * @param defaultValue Value to return if conversion fails
-     * @return Converted integer value or defaultValue
+     * @return Converted value or defaultValue
      */
-    static int toInt(const std::string& str, int defaultValue = 0);
+    template <typename T>
+    static T numberField(const FieldBuffer& tokens, CSVColumn column, ParseStats& stats, T defaultValue = T{}) {
+        T value = defaultValue;
+        switch (parseNumber(tokens[columnIndex(column)], value)) {
+        case FieldStatus::Ok:
+            break;
+        case FieldStatus::Empty:
+            ++stats.missing[columnIndex(column)];
+            break;
+        case FieldStatus::Malformed:
+            ++stats.malformed[columnIndex(column)];
+            break;
+        }
+        return value;
+    }
+
+    /**
+     * @brief Combine the crash date and time columns, recording their status
+     * @return The timestamp, or kInvalidTimestamp when the date is unusable
+     */
+    static Timestamp timestampField(const FieldBuffer& tokens, ParseStats& stats) {
+        auto count = [&](CSVColumn column, FieldStatus status) {
+            if (status == FieldStatus::Empty) ++stats.missing[columnIndex(column)];
+            if (status == FieldStatus::Malformed) ++stats.malformed[columnIndex(column)];
+        };
+
+        Timestamp day = kInvalidTimestamp;
+        int minutes = 0;
+        FieldStatus dateStatus = parseDateField(tokens[columnIndex(CSVColumn::CrashDate)], day);
+        count(CSVColumn::CrashDate, dateStatus);
+        count(CSVColumn::CrashTime, parseTimeField(tokens[columnIndex(CSVColumn::CrashTime)], minutes));
+        return dateStatus == FieldStatus::Ok ? day + minutes : kInvalidTimestamp;
+    }
 };
 
 } // namespace nycollision
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace nycollision {
+
+namespace detail {
+struct ScanKernel;
+}
+
+/**
+ * @brief Vectorized structural scanner for CSV data
+ *
+ * Classifies 64-byte blocks into quote, delimiter and newline bitmasks and
+ * tracks quote parity with a prefix-XOR over the quote mask, so characters
+ * inside quoted fields are masked out without a per-byte state machine.
+ * The widest kernel supported by the CPU is selected at runtime.
+ */
+class CSVScanner {
+public:
+    enum class Kernel {
+        Auto,   ///< Best kernel supported by the running CPU
+        Scalar, ///< Portable byte-at-a-time classification
+        SSE42,  ///< 4 x 16-byte compares per block
+        AVX2    ///< 2 x 32-byte compares per block, CLMUL quote parity
+    };
+
+    /**
+     * @brief Construct a scanner
+     * @param delimiter The field separator
+     * @param quote The quoting character
+     * @param kernel Kernel to use; Auto picks the best supported one
+     * @throws std::invalid_argument if the requested kernel is not supported
+     */
+    explicit CSVScanner(char delimiter = ',', char quote = '"', Kernel kernel = Kernel::Auto);
+
+    /**
+     * @brief Whether a kernel is compiled in and supported by this CPU
+     */
+    static bool isSupported(Kernel kernel);
+
+    /**
+     * @brief Best kernel supported by this CPU
+     */
+    static Kernel bestKernel();
+
+    Kernel kernel() const { return kernel_; }
+    const char* kernelName() const;
+
+    /**
+     * @brief Find the end of the record at the front of a buffer
+     * @param data Buffer to scan
+     * @param inQuotes Whether data starts inside a quoted field
+     * @return Offset one past the first newline outside quotes, or data.size()
+     */
+    std::size_t findRecordEnd(std::string_view data, bool inQuotes = false) const;
+
+    /**
+     * @brief Collect offsets of delimiters that lie outside quoted fields
+     * @param line A single record
+     * @param positions Receives the delimiter offsets in increasing order
+     * @return Whether the line contains any quote character
+     */
+    bool findDelimiters(std::string_view line, std::vector<std::uint32_t>& positions) const;
+
+    /**
+     * @brief Count quote characters in a buffer
+     */
+    std::size_t countQuotes(std::string_view data) const;
+
+private:
+    const detail::ScanKernel* impl_;
+    Kernel kernel_;
+    char delimiter_;
+    char quote_;
+};
+
+} // namespace nycollision
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+
+namespace nycollision {
+
+/**
+ * @brief Column layout of the NYPD Motor Vehicle Collisions - Crashes export
+ */
+enum class CSVColumn : std::size_t {
+    CrashDate = 0,
+    CrashTime,
+    Borough,
+    ZipCode,
+    Latitude,
+    Longitude,
+    Location,
+    OnStreet,
+    CrossStreet,
+    OffStreet,
+    PersonsInjured,
+    PersonsKilled,
+    PedestriansInjured,
+    PedestriansKilled,
+    CyclistsInjured,
+    CyclistsKilled,
+    MotoristsInjured,
+    MotoristsKilled,
+    ContributingFactor1,
+    ContributingFactor2,
+    ContributingFactor3,
+    ContributingFactor4,
+    ContributingFactor5,
+    CollisionId,
+    VehicleType1,
+    VehicleType2,
+    VehicleType3,
+    VehicleType4,
+    VehicleType5,
+    Count
+};
+
+constexpr std::size_t kCSVColumnCount = static_cast<std::size_t>(CSVColumn::Count);
+
+constexpr std::size_t columnIndex(CSVColumn column) {
+    return static_cast<std::size_t>(column);
+}
+
+/**
+ * @brief Header name of a column as it appears in the export
+ */
+constexpr const char* columnName(CSVColumn column) {
+    constexpr const char* names[kCSVColumnCount] = {
+        "CRASH DATE", "CRASH TIME", "BOROUGH", "ZIP CODE", "LATITUDE", "LONGITUDE",
+        "LOCATION", "ON STREET NAME", "CROSS STREET NAME", "OFF STREET NAME",
+        "NUMBER OF PERSONS INJURED", "NUMBER OF PERSONS KILLED",
+        "NUMBER OF PEDESTRIANS INJURED", "NUMBER OF PEDESTRIANS KILLED",
+        "NUMBER OF CYCLIST INJURED", "NUMBER OF CYCLIST KILLED",
+        "NUMBER OF MOTORIST INJURED", "NUMBER OF MOTORIST KILLED",
+        "CONTRIBUTING FACTOR VEHICLE 1", "CONTRIBUTING FACTOR VEHICLE 2",
+        "CONTRIBUTING FACTOR VEHICLE 3", "CONTRIBUTING FACTOR VEHICLE 4",
+        "CONTRIBUTING FACTOR VEHICLE 5", "COLLISION_ID",
+        "VEHICLE TYPE CODE 1", "VEHICLE TYPE CODE 2", "VEHICLE TYPE CODE 3",
+        "VEHICLE TYPE CODE 4", "VEHICLE TYPE CODE 5"
+    };
+    return column < CSVColumn::Count ? names[columnIndex(column)] : "";
+}
+
+} // namespace nycollision
@@ -0,0 +1,94 @@
+#pragma once
+#include "../core/Timestamp.h"
+#include <charconv>
+#include <string_view>
+#include <system_error>
+
+namespace nycollision {
+
+/**
+ * @brief Outcome of converting a text field
+ */
+enum class FieldStatus {
+    Ok,       ///< Field parsed completely
+    Empty,    ///< Field was empty or whitespace only
+    Malformed ///< Field had unparseable or trailing characters, or was out of range
+};
+
+/**
+ * @brief Strip surrounding spaces and tabs from a field
+ */
+inline std::string_view trimField(std::string_view text) {
+    constexpr std::string_view kBlank = " \t\r";
+    auto first = text.find_first_not_of(kBlank);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    auto last = text.find_last_not_of(kBlank);
+    return text.substr(first, last - first + 1);
+}
+
+/**
+ * @brief Convert a field to a number without throwing
+ *
+ * Uses std::from_chars, so no locale lookups or allocations are involved.
+ * A leading '+' is accepted for compatibility with std::stoi/std::stof.
+ *
+ * @param text The field text
+ * @param value Receives the parsed number; left untouched unless Ok
+ * @return Parse status
+ */
+template <typename T>
+FieldStatus parseNumber(std::string_view text, T& value) {
+    text = trimField(text);
+    if (text.empty()) {
+        return FieldStatus::Empty;
+    }
+    if (text.front() == '+' && text.size() > 1 && text[1] != '-') {
+        text.remove_prefix(1);
+    }
+
+    T parsed{};
+    const char* last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), last, parsed);
+    if (ec != std::errc() || ptr != last) {
+        return FieldStatus::Malformed;
+    }
+    value = parsed;
+    return FieldStatus::Ok;
+}
+
+/**
+ * @brief Convert a date field (MM/DD/YYYY or YYYY-MM-DD) to its first minute
+ * @param text The field text
+ * @param value Receives the timestamp of midnight; left untouched unless Ok
+ * @return Parse status
+ */
+inline FieldStatus parseDateField(std::string_view text, Timestamp& value) {
+    text = trimField(text);
+    if (text.empty()) {
+        return FieldStatus::Empty;
+    }
+    CalendarDate date;
+    if (!parseCalendarDate(text, date)) {
+        return FieldStatus::Malformed;
+    }
+    value = date.startOfDay();
+    return FieldStatus::Ok;
+}
+
+/**
+ * @brief Convert a time field (H:MM or HH:MM[:SS]) to minutes after midnight
+ * @param text The field text
+ * @param minutes Receives the minute of day; left untouched unless Ok
+ * @return Parse status
+ */
+inline FieldStatus parseTimeField(std::string_view text, int& minutes) {
+    text = trimField(text);
+    if (text.empty()) {
+        return FieldStatus::Empty;
+    }
+    return parseTimeOfDay(text, minutes) ? FieldStatus::Ok : FieldStatus::Malformed;
+}
+
+} // namespace nycollision
@@ -1,10 +1,112 @@
 #pragma once
 #include "../core/Record.h"
+#include "CSVSchema.h"
+#include "../util/ExecutionContext.h"
+#include <algorithm>
+#include <array>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace nycollision {
 
+/**
+ * @brief Data-quality counters gathered while parsing
+ *
+ * Counters are plain integers; each worker fills its own instance and the
+ * results are combined with merge().
+ */
+struct ParseStats {
+    std::size_t records = 0;  ///< Lines parsed into records
+    std::size_t rejected = 0; ///< Lines that could not be parsed (e.g. too few fields)
+    std::array<std::size_t, kCSVColumnCount> missing{};   ///< Empty numeric or date/time fields per column
+    std::array<std::size_t, kCSVColumnCount> malformed{}; ///< Unparseable numeric or date/time fields per column
+
+    std::size_t totalMalformed() const {
+        std::size_t total = 0;
+        for (auto count : malformed) total += count;
+        return total;
+    }
+
+    void merge(const ParseStats& other) {
+        records += other.records;
+        rejected += other.rejected;
+        for (std::size_t i = 0; i < kCSVColumnCount; ++i) {
+            missing[i] += other.missing[i];
+            malformed[i] += other.malformed[i];
+        }
+    }
+};
+
+/**
+ * @brief Reusable field array filled by zero-copy tokenizers
+ *
+ * Fields are views into the tokenized line. Fields that needed unescaping
+ * are materialized into a scratch arena owned by the buffer. All views are
+ * valid until the next clear() or until the source line goes away.
+ */
+class FieldBuffer {
+public:
+    using const_iterator = std::vector<std::string_view>::const_iterator;
+
+    std::size_t size() const { return fields_.size(); }
+    bool empty() const { return fields_.empty(); }
+    std::string_view operator[](std::size_t index) const { return fields_[index]; }
+    const_iterator begin() const { return fields_.begin(); }
+    const_iterator end() const { return fields_.end(); }
+
+    /**
+     * @brief Drop all fields while keeping allocated capacity
+     */
+    void clear() {
+        fields_.clear();
+        owned_.clear();
+        arena_.clear();
+    }
+
+    /**
+     * @brief Append a field that is a slice of the source line
+     */
+    void addView(std::string_view field) { fields_.push_back(field); }
+
+    /**
+     * @brief Start a field that must be materialized
+     * @return Arena to which the unescaped field bytes are appended
+     */
+    std::string& beginOwned() {
+        owned_.push_back({fields_.size(), arena_.size()});
+        fields_.emplace_back();
+        return arena_;
+    }
+
+    /**
+     * @brief Finish the field started by the last beginOwned() call
+     */
+    void endOwned() {
+        const auto& owned = owned_.back();
+        fields_[owned.first] = std::string_view(nullptr, arena_.size() - owned.second);
+    }
+
+    /**
+     * @brief Point owned fields at their final arena location
+     *
+     * Must be called once all fields are added, since the arena may
+     * reallocate while it grows.
+     */
+    void seal() {
+        for (const auto& [index, offset] : owned_) {
+            fields_[index] = std::string_view(arena_.data() + offset, fields_[index].size());
+        }
+    }
+
+private:
+    std::vector<std::string_view> fields_;
+    std::vector<std::pair<std::size_t, std::size_t>> owned_; // field index, arena offset
+    std::string arena_;
+};
+
 /**
  * @brief Interface for parsing collision records from various formats
  */
@@ -17,7 +119,49 @@ public:
      * @param line The text line to parse
      * @return Parsed record or nullptr if parsing failed
      */
-    virtual std::shared_ptr<Record> parseRecord(const std::string& line) const = 0;
+    virtual std::shared_ptr<Record> parseRecord(std::string_view line) const = 0;
+
+    /**
+     * @brief Parse a single record and account for it in stats
+     * @param line The text line to parse
+     * @param stats Counters updated with the outcome of this line
+     * @return Parsed record or nullptr if parsing failed
+     */
+    virtual std::shared_ptr<Record> parseRecord(std::string_view line, ParseStats& stats) const {
+        auto record = parseRecord(line);
+        ++(record ? stats.records : stats.rejected);
+        return record;
+    }
+
+    /**
+     * @brief Length of the record at the front of a buffer
+     * @param data Buffer starting at a record boundary
+     * @return Number of bytes up to and including the record terminator
+     */
+    virtual std::size_t recordLength(std::string_view data) const {
+        auto pos = data.find('\n');
+        return pos == std::string_view::npos ? data.size() : pos + 1;
+    }
+
+    /**
+     * @brief Split a buffer into chunks that each start on a record boundary
+     * @param data Buffer starting at a record boundary
+     * @param chunkCount Desired number of chunks
+     * @param context Threads available for scanning the buffer
+     * @return Non-empty chunks covering the whole buffer, in order
+     */
+    virtual std::vector<std::string_view> splitChunks(std::string_view data, std::size_t chunkCount,
+                                                      const ExecutionContext& /*context*/) const {
+        std::vector<std::string_view> chunks;
+        const std::size_t target = data.size() / std::max<std::size_t>(chunkCount, 1) + 1;
+        while (!data.empty()) {
+            std::size_t cut = std::min(target, data.size());
+            cut += recordLength(data.substr(cut));
+            chunks.push_back(data.substr(0, cut));
+            data.remove_prefix(std::min(cut, data.size()));
+        }
+        return chunks;
+    }
 
 protected:
     // Protected constructor to prevent direct instantiation
@@ -36,6 +180,14 @@ public:
      */
     virtual std::vector<std::string> tokenize(const std::string& line) const = 0;
 
+    /**
+     * @brief Split a CSV line into fields without copying them
+     * @param line The CSV line to split
+     * @param fields Reusable buffer receiving views into line
+     * @return Number of fields
+     */
+    virtual std::size_t tokenize(std::string_view line, FieldBuffer& fields) const = 0;
+
 protected:
     ICSVParser() = default;
 };
@@ -1,32 +1,113 @@
 #pragma once
-#include "../data/DataSet.h"
+#include "../data/LiveDataSet.h"
 #include "../parser/CSVParser.h"
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace nycollision {
 
 /**
  * @brief Facade class providing a simplified interface for collision data analysis
+ *
+ * Queries may be issued from any number of threads, including while
+ * appendData() runs; each query sees the data before or after the delta.
  */
 class CollisionAnalyzer {
 public:
     /**
-     * @brief Load collision data from a CSV file
+     * @brief Create an analyzer
+     * @param context Threads used for loading and queries; share one context
+     *        between analyzers to cap their combined parallelism
+     * @param ingestContext Threads used for loading instead, so loads do not
+     *        compete with queries; nullptr uses context
+     */
+    explicit CollisionAnalyzer(
+        std::shared_ptr<const ExecutionContext> context = ExecutionContext::defaultContext(),
+        std::shared_ptr<const ExecutionContext> ingestContext = nullptr
+    ) : context_(std::move(context)), ingestContext_(std::move(ingestContext)) {}
+
+    /**
+     * @brief Load collision data from a CSV file, or from its snapshot when that is fresh
+     *
+     * A snapshot at snapshotPath(filename) written from the file as it is now
+     * is loaded instead of parsing. Otherwise the CSV is parsed and a new
+     * snapshot is written for the next start; failing to write it does not
+     * fail the load.
+     *
      * @param filename Path to the CSV file
+     * @param useSnapshot Read and write snapshots; false always parses the CSV
      * @throws std::runtime_error if file cannot be opened or parsing fails
      */
-    void loadData(const std::string& filename) {
-        dataset_ = std::make_unique<DataSet>();
-        parser_ = std::make_unique<CSVParser>();
-        dataset_->loadFromFile(filename, *parser_);
+    void loadData(const std::string& filename, bool useSnapshot = true) {
+        const std::string snapshot = snapshotPath(filename);
+        loadedFromSnapshot_ = false;
+        if (useSnapshot && SnapshotReader::isFresh(snapshot, filename)) {
+            reset();
+            try {
+                live_->loadSnapshot(snapshot);
+                loadedFromSnapshot_ = true;
+                return;
+            } catch (const std::runtime_error&) {
+                // Unreadable or corrupt: parse the CSV and replace it
+            }
+        }
+
+        reset();
+        // Stamp before parsing so a file changed meanwhile leaves the snapshot stale
+        const SnapshotSource source = useSnapshot ? SnapshotSource::of(filename) : SnapshotSource{};
+        live_->loadFromFile(filename, *parser_);
+        if (useSnapshot) {
+            try {
+                live_->current()->saveSnapshot(snapshot, source);
+            } catch (const std::runtime_error&) {
+                // The snapshot is only a cache; the data is loaded either way
+            }
+        }
+    }
+
+    /**
+     * @brief Apply a delta CSV, such as a daily Open Data export, to the loaded data
+     *
+     * New collision ids are added and known ones are replaced by their
+     * revision; see DataSet::appendFromFile(). Queries keep running on the
+     * data as it was until the delta is applied. The snapshot is not updated,
+     * so the next loadData() starts from the full file again.
+     *
+     * @param filename Path to the delta CSV, with the same header as the full export
+     * @return Counts of inserted, updated, superseded and rejected records
+     * @throws std::runtime_error if no data is loaded, or the file cannot be opened or parsed
+     */
+    DataSet::AppendStats appendData(const std::string& filename) {
+        if (!live_) {
+            throw std::runtime_error("Dataset not loaded");
+        }
+        return live_->appendFromFile(filename, *parser_);
     }
 
+    /**
+     * @brief Whether the last loadData() read a snapshot instead of the CSV
+     */
+    bool loadedFromSnapshot() const { return loadedFromSnapshot_; }
+
+    /**
+     * @brief Snapshot file used for a CSV file
+     */
+    static std::string snapshotPath(const std::string& filename) { return filename + ".snapshot"; }
+
     /**
      * @brief Get total number of records
      */
     size_t getTotalRecords() const {
-        return dataset_ ? dataset_->size() : 0;
+        return withDataset([&](const DataSet& dataset) { return dataset.size(); });
+    }
+
+    /**
+     * @brief Get per-column counts of missing and malformed values seen while loading
+     */
+    ParseStats getParseStats() const {
+        return withDataset([&](const DataSet& dataset) { return dataset.parseStats(); });
     }
 
     /**
@@ -35,7 +116,7 @@ public:
     std::vector<std::shared_ptr<const IRecord>> findCollisionsInBorough(
         const std::string& borough
     ) const {
-        return dataset_ ? dataset_->queryByBorough(borough) : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByBorough(borough); });
     }
 
     /**
@@ -44,20 +125,47 @@ public:
     std::vector<std::shared_ptr<const IRecord>> findCollisionsInZipCode(
         const std::string& zipCode
     ) const {
-        return dataset_ ? dataset_->queryByZipCode(zipCode) : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByZipCode(zipCode); });
     }
 
     /**
      * @brief Find collisions within a date range
+     * @param startDate First day, as MM/DD/YYYY or YYYY-MM-DD
+     * @param endDate Last day (inclusive), in the same formats
+     * @throws std::runtime_error if either date cannot be parsed or falls outside [kMinYear, kMaxYear]
      */
     std::vector<std::shared_ptr<const IRecord>> findCollisionsInDateRange(
         const std::string& startDate,
         const std::string& endDate
     ) const {
-        if (!dataset_) return std::vector<std::shared_ptr<const IRecord>>{};
-        Date start{startDate, "00:00"};
-        Date end{endDate, "23:59"};
-        return dataset_->queryByDateRange(start, end);
+        CalendarDate first, last;
+        if (!parseCalendarDate(startDate, first)) {
+            throw std::runtime_error("Invalid date: " + startDate);
+        }
+        if (!parseCalendarDate(endDate, last)) {
+            throw std::runtime_error("Invalid date: " + endDate);
+        }
+        return findCollisionsInDateRange(first, last);
+    }
+
+    /**
+     * @brief Find collisions from the start of one day to the end of another
+     */
+    std::vector<std::shared_ptr<const IRecord>> findCollisionsInDateRange(
+        const CalendarDate& first,
+        const CalendarDate& last
+    ) const {
+        return findCollisionsInDateRange(first.startOfDay(), last.endOfDay());
+    }
+
+    /**
+     * @brief Find collisions between two timestamps (inclusive)
+     */
+    std::vector<std::shared_ptr<const IRecord>> findCollisionsInDateRange(
+        Timestamp start,
+        Timestamp end
+    ) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByDateRange(start, end); });
     }
 
     /**
@@ -66,7 +174,7 @@ public:
     std::vector<std::shared_ptr<const IRecord>> findCollisionsByVehicleType(
         const std::string& vehicleType
     ) const {
-        return dataset_ ? dataset_->queryByVehicleType(vehicleType) : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByVehicleType(vehicleType); });
     }
 
     /**
@@ -76,8 +184,104 @@ public:
         float minLat, float maxLat,
         float minLon, float maxLon
     ) const {
-        return dataset_ ? dataset_->queryByGeoBounds(minLat, maxLat, minLon, maxLon) 
-                       : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) {
+            return dataset.queryByGeoBounds(minLat, maxLat, minLon, maxLon);
+        });
+    }
+
+    /**
+     * @brief Assign every collision, now and in later loads, to a region of a polygon layer
+     *
+     * The analyzer keeps the layer: each loadData() adds it to the new data
+     * before reading it, so snapshots written from then on carry its regions.
+     *
+     * @see DataSet::addRegionLayer()
+     * @throws std::runtime_error if no data is loaded or a layer of the same name was added
+     */
+    void addRegionLayer(std::shared_ptr<const RegionLayer> layer) {
+        if (!live_) {
+            throw std::runtime_error("Dataset not loaded");
+        }
+        live_->update([&](DataSet& next) { next.addRegionLayer(layer); });
+        regionLayers_.push_back(std::move(layer));
+    }
+
+    /**
+     * @brief Find collisions in a region of a layer added with addRegionLayer()
+     * @throws std::runtime_error if no layer of that name was added
+     */
+    std::vector<std::shared_ptr<const IRecord>> findCollisionsInRegion(
+        const std::string& layer,
+        const std::string& region
+    ) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByRegion(layer, region); });
+    }
+
+    /**
+     * @brief Find the collisions nearest to a point, nearest first
+     * @param count Most collisions to return
+     */
+    std::vector<std::shared_ptr<const IRecord>> findNearestCollisions(
+        float latitude, float longitude,
+        std::size_t count
+    ) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.queryNearest(latitude, longitude, count); });
+    }
+
+    /**
+     * @brief Find collisions within a distance of a point, nearest first
+     * @param meters Great-circle radius in meters
+     */
+    std::vector<std::shared_ptr<const IRecord>> findCollisionsWithinRadius(
+        float latitude, float longitude,
+        double meters
+    ) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByRadius(latitude, longitude, meters); });
+    }
+
+    /**
+     * @brief Collision counts and casualty sums per cell of a uniform grid over an area
+     * @param cellMeters North-south extent of a cell
+     * @param filter Further predicates the collisions must match
+     * @see DataSet::heatmap()
+     */
+    std::vector<HeatmapCell> collisionHeatmap(
+        float minLat, float maxLat,
+        float minLon, float maxLon,
+        double cellMeters,
+        const Query& filter = Query()
+    ) const {
+        return withDataset([&](const DataSet& dataset) {
+            return dataset.heatmap(minLat, maxLat, minLon, maxLon, cellMeters, filter);
+        });
+    }
+
+    /**
+     * @brief DBSCAN hotspots among the collisions matching a query
+     * @param epsMeters Neighbourhood radius
+     * @param minPoints Collisions within eps that make a core point
+     * @see DataSet::clusters()
+     */
+    SpatialClustering findCollisionHotspots(
+        double epsMeters,
+        std::size_t minPoints,
+        const Query& filter = Query()
+    ) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.clusters(epsMeters, minPoints, filter); });
+    }
+
+    /**
+     * @brief Pre-aggregated map tiles of an area at a zoom level
+     * @see DataSet::heatmapTiles(), HeatmapTiles::levelFor()
+     */
+    std::vector<HeatmapCell> collisionHeatmapTiles(
+        float minLat, float maxLat,
+        float minLon, float maxLon,
+        int level
+    ) const {
+        return withDataset([&](const DataSet& dataset) {
+            return dataset.heatmapTiles(minLat, maxLat, minLon, maxLon, level);
+        });
     }
 
     /**
@@ -87,8 +291,9 @@ public:
         int minInjuries,
         int maxInjuries
     ) const {
-        return dataset_ ? dataset_->queryByInjuryRange(minInjuries, maxInjuries)
-                       : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) {
+            return dataset.queryByInjuryRange(minInjuries, maxInjuries);
+        });
     }
 
     /**
@@ -98,30 +303,78 @@ public:
         int minFatalities,
         int maxFatalities
     ) const {
-        return dataset_ ? dataset_->queryByFatalityRange(minFatalities, maxFatalities)
-                       : std::vector<std::shared_ptr<const IRecord>>{};
+        return withDataset([&](const DataSet& dataset) {
+            return dataset.queryByFatalityRange(minFatalities, maxFatalities);
+        });
     }
 
     /**
      * @brief Find a specific collision by its unique key
      */
     std::shared_ptr<const IRecord> findCollisionByKey(int key) const {
-        return dataset_ ? dataset_->queryByUniqueKey(key) : nullptr;
+        return withDataset([&](const DataSet& dataset) { return dataset.queryByUniqueKey(key); });
+    }
+
+    /**
+     * @brief Find collisions matching every predicate of a query
+     *
+     * @code
+     * analyzer.findCollisions(Query().borough("QUEENS").vehicleType("Taxi").injuries(1, 999));
+     * @endcode
+     */
+    std::vector<std::shared_ptr<const IRecord>> findCollisions(const Query& query) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.query(query); });
+    }
+
+    /**
+     * @brief Describe how a query would be executed
+     */
+    std::string explainQuery(const Query& query) const {
+        return withDataset([&](const DataSet& dataset) { return dataset.explain(query); });
     }
 
     /**
      * @brief Get access to the underlying dataset for benchmarking
+     *
+     * The handle pins the current version; later appendData() calls publish
+     * new versions without changing it.
      */
-    const DataSet& getDataset() const {
-        if (!dataset_) {
+    std::shared_ptr<const DataSet> getDataset() const {
+        if (!live_) {
             throw std::runtime_error("Dataset not loaded");
         }
-        return *dataset_;
+        return live_->current();
     }
 
 private:
-    std::unique_ptr<DataSet> dataset_;
+    // Run fn(const DataSet&) on the current version; an empty result before the first load
+    template <typename Fn>
+    auto withDataset(Fn&& fn) const -> decltype(fn(std::declval<const DataSet&>())) {
+        using Result = decltype(fn(std::declval<const DataSet&>()));
+        return live_ ? live_->read(std::forward<Fn>(fn)) : Result{};
+    }
+
+    // A private pool per load, so other files parsed in the process cannot
+    // shift its codes away from those of a snapshot
+    void reset() {
+        auto pool = std::make_shared<StringPool>();
+        parser_ = std::make_unique<CSVParser>(',', '"', pool);
+        live_ = std::make_unique<LiveDataSet>(std::move(pool), context_, ingestContext_);
+        if (!regionLayers_.empty()) {
+            live_->update([&](DataSet& next) {
+                for (const auto& layer : regionLayers_) {
+                    next.addRegionLayer(layer);
+                }
+            });
+        }
+    }
+
+    std::shared_ptr<const ExecutionContext> context_;
+    std::shared_ptr<const ExecutionContext> ingestContext_;
+    std::unique_ptr<LiveDataSet> live_;
     std::unique_ptr<CSVParser> parser_;
+    std::vector<std::shared_ptr<const RegionLayer>> regionLayers_;
+    bool loadedFromSnapshot_ = false;
 };
 
 } // namespace nycollision
@@ -0,0 +1,148 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace nycollision {
+
+/**
+ * @brief Epoch-based reclamation: lets readers use shared objects without locks
+ *
+ * A reader holds a Guard while it dereferences anything a writer may retire.
+ * Entering and leaving are single stores to a per-thread slot, so readers
+ * never wait for writers or for each other. A writer unlinks an object, then
+ * calls synchronize(), which returns once every guard entered before the
+ * call has been left; the object can then be freed.
+ */
+class EpochDomain {
+public:
+    /**
+     * @brief Marks the calling thread as reading until destroyed
+     */
+    class Guard {
+    public:
+        Guard(Guard&& other) noexcept : slot_(std::exchange(other.slot_, nullptr)) {}
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+        ~Guard() {
+            if (slot_) {
+                slot_->store(0, std::memory_order_release);
+            }
+        }
+
+    private:
+        friend class EpochDomain;
+        explicit Guard(std::atomic<std::uint64_t>* slot) : slot_(slot) {}
+        std::atomic<std::uint64_t>* slot_;
+    };
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    /**
+     * @brief Enter a read-side critical section
+     *
+     * Guards may nest; each takes its own slot. More than kSlots concurrent
+     * guards spin until a slot frees up.
+     */
+    Guard enter() const;
+
+    /**
+     * @brief Wait until every guard entered before this call has been left
+     *
+     * Must not be called while the calling thread holds a guard of this domain.
+     */
+    void synchronize();
+
+    static constexpr std::size_t kSlots = 128;
+
+private:
+    // Epoch the holder entered at, or 0 when free; one cache line each
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+    mutable std::array<Slot, kSlots> slots_;
+    std::atomic<std::uint64_t> epoch_{1};
+};
+
+/**
+ * @brief Atomically replaceable pointer to an immutable object
+ *
+ * Readers see one complete version at a time without taking locks: read()
+ * runs a function on the current version inside an epoch guard, and
+ * acquire() returns a reference-counted handle that keeps the version alive
+ * past the call. publish() swaps in the next version and frees the previous
+ * one once no reader can still reach it through this object; handles from
+ * acquire() keep it alive for as long as they exist.
+ */
+template <typename T>
+class Versioned {
+public:
+    explicit Versioned(std::shared_ptr<const T> initial)
+        : current_(new Holder{std::move(initial), 1}) {}
+    ~Versioned() { delete current_.load(); }
+
+    Versioned(const Versioned&) = delete;
+    Versioned& operator=(const Versioned&) = delete;
+
+    /**
+     * @brief Call fn(const T&) on the current version
+     *
+     * The version stays valid for the duration of the call; references into
+     * it must not escape. publish() waits for calls in progress, so fn must
+     * not publish to the same object.
+     */
+    template <typename Fn>
+    decltype(auto) read(Fn&& fn) const {
+        auto guard = epochs_.enter();
+        return std::forward<Fn>(fn)(*current_.load(std::memory_order_seq_cst)->value);
+    }
+
+    /**
+     * @brief Shared handle to the current version
+     */
+    std::shared_ptr<const T> acquire() const {
+        auto guard = epochs_.enter();
+        return current_.load(std::memory_order_seq_cst)->value;
+    }
+
+    /**
+     * @brief Number of the current version, starting at 1
+     */
+    std::uint64_t version() const {
+        auto guard = epochs_.enter();
+        return current_.load(std::memory_order_seq_cst)->version;
+    }
+
+    /**
+     * @brief Make next the current version
+     *
+     * Returns once readers that may still see the previous version through
+     * read() have finished. Concurrent calls are serialized.
+     */
+    void publish(std::shared_ptr<const T> next) {
+        std::lock_guard lock(writer_);
+        Holder* previous = current_.load(std::memory_order_relaxed);
+        current_.store(new Holder{std::move(next), previous->version + 1}, std::memory_order_seq_cst);
+        epochs_.synchronize();
+        delete previous;
+    }
+
+private:
+    struct Holder {
+        std::shared_ptr<const T> value;
+        std::uint64_t version;
+    };
+
+    std::atomic<Holder*> current_;
+    mutable EpochDomain epochs_;
+    std::mutex writer_;
+};
+
+} // namespace nycollision
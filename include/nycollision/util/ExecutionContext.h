@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace nycollision {
+
+class WorkStealingPool;
+
+/**
+ * @brief Thread budget and scheduler shared by ingest and queries
+ *
+ * Parallel code in the library runs through parallelFor() and
+ * parallelInvoke() of the context it was given instead of touching global
+ * OpenMP state, so several analyzers in one process can each be held to
+ * their own number of threads. Calls may nest: a task started by
+ * parallelInvoke() can itself call parallelFor().
+ */
+class ExecutionContext {
+public:
+    enum class Backend {
+        OpenMP,      ///< OpenMP teams of threads() threads; nested calls become tasks
+        WorkStealing ///< A private pool of threads() - 1 workers plus the calling thread
+    };
+
+    struct Options {
+        std::size_t threads = 0;     ///< 0 uses the affinity list size, or the hardware concurrency
+        std::vector<int> cpuAffinity; ///< CPUs to pin worker threads to, round-robin; the calling thread and an empty list leave threads unpinned
+        Backend backend = Backend::OpenMP;
+    };
+
+    /**
+     * @brief Create an OpenMP context using all hardware threads
+     */
+    ExecutionContext();
+
+    /**
+     * @brief Create a context
+     * @param options Thread count, affinity and backend
+     */
+    explicit ExecutionContext(Options options);
+    ~ExecutionContext();
+
+    ExecutionContext(const ExecutionContext&) = delete;
+    ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+    /**
+     * @brief Process-wide context using all hardware threads with OpenMP
+     */
+    static const std::shared_ptr<ExecutionContext>& defaultContext();
+
+    std::size_t threads() const { return threads_; }
+    Backend backend() const { return backend_; }
+    const std::vector<int>& cpuAffinity() const { return cpuAffinity_; }
+
+    /**
+     * @brief Run body over [0, count) split into chunks of about grain items
+     *
+     * Chunks are handed out dynamically. Runs inline when there is a single
+     * chunk or a single thread.
+     *
+     * @param body Called as body(begin, end) for each chunk
+     * @throws The first exception thrown by body, after all chunks finished
+     */
+    void parallelFor(std::size_t count, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& body) const;
+
+    /**
+     * @brief Run independent tasks concurrently and wait for all of them
+     * @throws The first exception thrown by a task, after all tasks finished
+     */
+    void parallelInvoke(std::initializer_list<std::function<void()>> tasks) const;
+    void parallelInvoke(const std::vector<std::function<void()>>& tasks) const;
+
+private:
+    void invoke(const std::function<void()>* first, const std::function<void()>* last) const;
+
+    std::size_t threads_;
+    std::vector<int> cpuAffinity_;
+    Backend backend_;
+    std::unique_ptr<WorkStealingPool> pool_;
+};
+
+} // namespace nycollision
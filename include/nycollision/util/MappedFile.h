@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace nycollision {
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * The mapping is released when the object is destroyed. Views returned by
+ * view() are only valid for the lifetime of the MappedFile.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Map a file into memory
+     * @param filename Path to the file
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    void release() noexcept;
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace nycollision
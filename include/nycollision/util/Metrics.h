@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief Latency histogram with logarithmic buckets of bounded relative error
+ *
+ * Values below 2^kSubBucketBits are counted exactly; larger values fall in
+ * one of 2^kSubBucketBits linear sub-buckets per power of two, so a reported
+ * percentile overstates the true value by at most 1/2^kSubBucketBits.
+ * Values of 2^kMaxExponent nanoseconds and more share the last bucket.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr unsigned kSubBuckets = 1u << kSubBucketBits;
+    static constexpr unsigned kMaxExponent = 40;
+    static constexpr std::size_t kBuckets = kSubBuckets * (kMaxExponent - kSubBucketBits + 2);
+
+    static std::size_t bucketOf(std::uint64_t nanoseconds);
+    // Largest value counted in a bucket
+    static std::uint64_t upperBound(std::size_t bucket);
+
+    void record(std::uint64_t nanoseconds, std::uint64_t count = 1);
+    void merge(const LatencyHistogram& other);
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t sum() const { return sum_; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    /**
+     * @brief Smallest bucket bound at or above a fraction of the recorded values
+     * @param quantile Fraction in [0, 1], e.g. 0.99
+     * @return Nanoseconds; 0 when nothing was recorded
+     */
+    std::uint64_t percentile(double quantile) const;
+
+    std::uint64_t bucketCount(std::size_t bucket) const { return buckets_[bucket]; }
+
+private:
+    friend class Metrics;
+
+    std::array<std::uint64_t, kBuckets> buckets_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t max_ = 0;
+};
+
+/**
+ * @brief Counters and latency histograms merged from every thread at one point in time
+ */
+struct MetricsSnapshot {
+    struct Latency {
+        std::string operation;
+        LatencyHistogram histogram;
+    };
+    struct Count {
+        std::string counter;
+        std::uint64_t value = 0;
+    };
+
+    std::vector<Latency> latencies;  ///< Operations recorded at least once
+    std::vector<Count> counters;     ///< Every counter, including zeros
+
+    /**
+     * @brief Prometheus text exposition: a summary per operation and a counter per count
+     */
+    std::string toPrometheus() const;
+
+    /**
+     * @brief JSON object with count, sum, max and percentiles per operation
+     */
+    std::string toJson() const;
+
+    /**
+     * @brief Write toJson() if filename ends in ".json", else toPrometheus()
+     *
+     * The file is written next to its destination and renamed into place,
+     * so a scraper never reads a partial export.
+     *
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void write(const std::string& filename) const;
+};
+
+/**
+ * @brief Process-wide instrumentation of queries and ingest stages
+ *
+ * Each thread records into its own shard, so recording never contends:
+ * a histogram update is a few relaxed loads and stores to thread-owned
+ * cache lines. snapshot() merges the shards of all threads that have
+ * recorded, including threads that have exited.
+ *
+ * The library records through NYCOLLISION_TIME_SCOPE and NYCOLLISION_COUNT,
+ * which compile to nothing unless it is built with NYCOLLISION_METRICS
+ * (the CMake option of the same name, on by default).
+ */
+class Metrics {
+public:
+    enum class Operation : std::uint8_t {
+        // Row lookups of the IDataSet queries, shared by their rowsBy*(), queryBy*()
+        // and visitBy*() forms; queryBy*() adds MaterializeRecords. visitByGeoBounds()
+        // walks the R-tree inside the caller's visitor and is not timed
+        QueryGeoBounds,
+        QueryNearest,
+        QueryRadius,
+        QueryRegion,
+        QueryPolygon,
+        QueryHeatmap,
+        QueryClusters,
+        QueryBorough,
+        QueryZipCode,
+        QueryDateRange,
+        QueryVehicleType,
+        QueryInjuryRange,
+        QueryFatalityRange,
+        QueryPedestrianFatalities,
+        QueryCyclistFatalities,
+        QueryMotoristFatalities,
+        QueryUniqueKey,
+        QueryMultiPredicate,
+        QueryAggregate,
+        MaterializeRecords,
+        // Ingest stages
+        IngestRead,      ///< Mapping the file
+        IngestSplit,     ///< Finding chunk boundaries
+        IngestTokenize,  ///< Per record: splitting into fields
+        IngestParse,     ///< Per record: converting fields
+        IngestStore,     ///< Writing rows into the columns
+        IngestIndex,     ///< Building or updating every index
+        IngestSpatialIndex,
+        IngestRegions,   ///< Assigning rows to the regions of polygon layers
+        IngestUpsert,    ///< Replacing revised rows of a delta
+        SnapshotSave,
+        SnapshotLoad,
+        Count
+    };
+
+    enum class Counter : std::uint8_t {
+        IngestBytes,
+        IngestRecords,
+        IngestRejected,
+        MaterializedRecords,  ///< Records built by toRecords() and the queryBy*() forms
+        Count
+    };
+
+    static constexpr std::size_t kOperations = static_cast<std::size_t>(Operation::Count);
+    static constexpr std::size_t kCounters = static_cast<std::size_t>(Counter::Count);
+
+    static void record(Operation operation, std::uint64_t nanoseconds);
+    static void add(Counter counter, std::uint64_t value = 1);
+
+    static MetricsSnapshot snapshot();
+
+    /**
+     * @brief Zero every shard; values recorded concurrently may survive or be lost
+     */
+    static void reset();
+
+    /**
+     * @brief Whether the library was built with instrumentation
+     */
+    static bool enabled();
+
+    static const char* name(Operation operation);
+    static const char* name(Counter counter);
+};
+
+/**
+ * @brief Records the lifetime of the object as one latency sample
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metrics::Operation operation)
+        : operation_(operation), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        Metrics::record(operation_, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - start_).count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Metrics::Operation operation_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace nycollision
+
+#define NYCOLLISION_METRICS_CONCAT_(a, b) a##b
+#define NYCOLLISION_METRICS_CONCAT(a, b) NYCOLLISION_METRICS_CONCAT_(a, b)
+
+#ifdef NYCOLLISION_METRICS
+#define NYCOLLISION_TIME_SCOPE(operation)                                                   \
+    ::nycollision::ScopedTimer NYCOLLISION_METRICS_CONCAT(scopedTimer_, __LINE__)(          \
+        ::nycollision::Metrics::Operation::operation)
+#define NYCOLLISION_COUNT(counter, value) \
+    ::nycollision::Metrics::add(::nycollision::Metrics::Counter::counter, (value))
+#else
+#define NYCOLLISION_TIME_SCOPE(operation) static_cast<void>(0)
+#define NYCOLLISION_COUNT(counter, value) static_cast<void>(0)
+#endif
@@ -0,0 +1,292 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief CRC-32 (IEEE 802.3) of a byte range
+ * @param crc Result of a previous call to continue a running checksum
+ */
+std::uint32_t crc32(const void* data, std::size_t size, std::uint32_t crc = 0);
+
+/**
+ * @brief Size and modification time of the file a snapshot was built from
+ *
+ * A snapshot is fresh while its recorded source still matches the file on disk.
+ */
+struct SnapshotSource {
+    std::uint64_t size = 0;
+    std::int64_t modified_ns = 0;  ///< Modification time in nanoseconds since the epoch
+
+    /**
+     * @brief Stamp of a file on disk
+     * @throws std::runtime_error if the file cannot be examined
+     */
+    static SnapshotSource of(const std::string& filename);
+
+    bool operator==(const SnapshotSource& other) const {
+        return size == other.size && modified_ns == other.modified_ns;
+    }
+    bool operator!=(const SnapshotSource& other) const { return !(*this == other); }
+};
+
+class SnapshotWriter;
+
+/**
+ * @brief Append-only byte sink for one snapshot section
+ *
+ * Values are staged in a small buffer that is streamed to the snapshot file
+ * whenever it fills, so a section never has to fit in memory. Values are
+ * stored in native byte order; the file header rejects snapshots written on a
+ * machine of different endianness.
+ */
+class SnapshotBuffer {
+public:
+    SnapshotBuffer(const SnapshotBuffer&) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot values must be trivially copyable");
+        append(&value, sizeof(T));
+    }
+
+    /**
+     * @brief Append an element count followed by the elements
+     */
+    template <typename T>
+    void putArray(const T* values, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot values must be trivially copyable");
+        put<std::uint64_t>(count);
+        append(values, count * sizeof(T));
+    }
+
+    template <typename T>
+    void putVector(const std::vector<T>& values) { putArray(values.data(), values.size()); }
+
+    /**
+     * @brief Append elements without a count, e.g. an array written in pieces after its total count
+     */
+    template <typename T>
+    void putValues(const T* values, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot values must be trivially copyable");
+        append(values, count * sizeof(T));
+    }
+
+    void putString(std::string_view value) { putArray(value.data(), value.size()); }
+
+    /**
+     * @brief Bytes appended to the section so far
+     */
+    std::uint64_t size() const { return size_; }
+
+private:
+    friend class SnapshotWriter;
+
+    static constexpr std::size_t kStagingBytes = std::size_t{1} << 20;
+
+    SnapshotBuffer(SnapshotWriter& writer, std::string name, std::uint64_t offset)
+        : writer_(&writer), name_(std::move(name)), offset_(offset) {}
+
+    void append(const void* data, std::size_t size) {
+        if (!finished_ && pending_.size() + size <= kStagingBytes) {
+            pending_.append(static_cast<const char*>(data), size);
+            size_ += size;
+        } else {
+            spill(data, size);
+        }
+    }
+
+    // Slow path of append(): writes the staged bytes, then stages or writes the new ones
+    void spill(const void* data, std::size_t size);
+
+    void flush();
+
+    SnapshotWriter* writer_;
+    std::string name_;
+    std::string pending_;
+    std::uint64_t offset_;  // File offset of the first byte
+    std::uint64_t size_ = 0;
+    std::uint32_t crc_ = 0;  // Over the bytes already written to the file
+    bool finished_ = false;
+};
+
+/**
+ * @brief Reads the values of a SnapshotBuffer back in the same order
+ *
+ * Reading past the end of the section throws std::runtime_error, so a
+ * damaged section cannot cause out-of-bounds reads.
+ */
+class SnapshotCursor {
+public:
+    SnapshotCursor(std::string_view bytes, std::string name) : bytes_(bytes), name_(std::move(name)) {}
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot values must be trivially copyable");
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Read an element count and return a view of the elements' bytes
+     */
+    template <typename T>
+    std::string_view getArray() {
+        const auto count = get<std::uint64_t>();
+        if (count > bytes_.size() / sizeof(T)) {
+            truncated();
+        }
+        const char* data = take(count * sizeof(T));
+        return std::string_view(data, count * sizeof(T));
+    }
+
+    template <typename T>
+    void getVector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot values must be trivially copyable");
+        std::string_view data = getArray<T>();
+        values.resize(data.size() / sizeof(T));
+        if (!data.empty()) {
+            std::memcpy(values.data(), data.data(), data.size());
+        }
+    }
+
+    std::string_view getString() { return getArray<char>(); }
+
+    bool atEnd() const { return bytes_.empty(); }
+
+    const std::string& name() const { return name_; }
+
+private:
+    const char* take(std::size_t size) {
+        if (size > bytes_.size()) {
+            truncated();
+        }
+        const char* data = bytes_.data();
+        bytes_.remove_prefix(size);
+        return data;
+    }
+
+    [[noreturn]] void truncated() const {
+        throw std::runtime_error("Snapshot section truncated: " + name_);
+    }
+
+    std::string_view bytes_;
+    std::string name_;
+};
+
+/**
+ * @brief Streams named sections into one snapshot file
+ *
+ * The file starts with a header holding a magic number, the format version,
+ * the byte-order mark, the source stamp and the position of the section
+ * table. Section payloads follow, 64-byte aligned, and the table of their
+ * offsets, sizes and CRC-32 checksums comes last, once every size is known.
+ *
+ * Sections are written to a uniquely named temporary file next to the
+ * destination, which commit() syncs and renames into place; a writer
+ * destroyed without committing removes it again.
+ */
+class SnapshotWriter {
+public:
+    /**
+     * @brief Create the temporary file the sections are written to
+     * @throws std::runtime_error if the file cannot be created
+     */
+    explicit SnapshotWriter(const std::string& filename, SnapshotSource source = {});
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    /**
+     * @brief Finish the current section and start a new one
+     *
+     * The buffer stays valid until the writer is destroyed, but appending to
+     * it once a later section has started throws std::logic_error.
+     *
+     * @throws std::invalid_argument if the name is taken or longer than kMaxNameLength
+     * @throws std::runtime_error if the file cannot be written
+     */
+    SnapshotBuffer& section(const std::string& name);
+
+    /**
+     * @brief Write the section table and header and replace the destination
+     *
+     * The file is synced before it is renamed and its directory after, so
+     * after a crash the destination holds either the old snapshot or the
+     * complete new one.
+     *
+     * @throws std::runtime_error if the file cannot be written, synced or renamed
+     */
+    void commit();
+
+    static constexpr std::size_t kMaxNameLength = 23;
+
+private:
+    friend class SnapshotBuffer;
+
+    void writeAt(std::uint64_t offset, const void* data, std::size_t size);
+    void writeBytes(const void* data, std::size_t size);
+    void pad();
+    void finishSection();
+
+    std::string filename_;
+    std::string temporary_;
+    int fd_ = -1;
+    SnapshotSource source_;
+    std::uint64_t offset_ = 0;  // End of the bytes written so far
+    std::vector<std::unique_ptr<SnapshotBuffer>> sections_;
+};
+
+/**
+ * @brief Memory-mapped snapshot file
+ *
+ * Opening checks the header and the format version; each section's checksum
+ * is verified when the section is first read, so independent sections can
+ * be verified and decoded concurrently.
+ */
+class SnapshotReader {
+public:
+    static constexpr std::uint32_t kFormatVersion = 3;
+
+    /**
+     * @brief Map a snapshot and read its section table
+     * @throws std::runtime_error if the file is missing, not a snapshot, or of another format version
+     */
+    explicit SnapshotReader(const std::string& filename);
+
+    const SnapshotSource& source() const { return source_; }
+
+    bool hasSection(const std::string& name) const { return sections_.count(name) != 0; }
+
+    /**
+     * @brief Cursor over a section after verifying its checksum
+     * @throws std::runtime_error if the section is missing or its checksum does not match
+     */
+    SnapshotCursor section(const std::string& name) const;
+
+    /**
+     * @brief Whether a snapshot exists, has the current format version and was built from the source as it is now
+     *
+     * Only reads the header; checksums are verified when sections are read.
+     */
+    static bool isFresh(const std::string& snapshot, const std::string& source);
+
+private:
+    MappedFile file_;
+    SnapshotSource source_;
+    std::map<std::string, std::pair<std::string_view, std::uint32_t>> sections_;  // Bytes and CRC
+};
+
+} // namespace nycollision
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace nycollision {
+
+/**
+ * @brief Pin the calling thread to a single CPU
+ * @param cpu Zero-based CPU number
+ * @return false if pinning is unsupported on this platform or was rejected
+ */
+bool pinCurrentThread(int cpu);
+
+} // namespace nycollision
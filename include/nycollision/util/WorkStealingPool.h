@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nycollision {
+
+/**
+ * @brief Fixed set of worker threads with one task deque each
+ *
+ * A worker pops its own newest task first and steals the oldest task of
+ * another worker when it runs dry. Tasks submitted from outside the pool
+ * go to a shared injection queue. A thread waiting on a TaskGroup runs the
+ * group's own queued tasks, and blocks only once every remaining task of
+ * the group has been taken by another thread, so tasks may submit and wait
+ * on nested groups without deadlocking or picking up unrelated work.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * @brief Set of tasks that can be waited on together
+     *
+     * The first exception thrown by a task is kept and rethrown by wait().
+     */
+    class TaskGroup {
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+    private:
+        friend class WorkStealingPool;
+        std::atomic<std::size_t> pending_{0};  // Submitted and not yet finished
+        std::atomic<std::size_t> queued_{0};   // Submitted and not yet taken
+        std::atomic<bool> waiting_{false};     // A thread is blocked in wait()
+        std::mutex mutex_;                     // Guards error_ and finishing tasks
+        std::condition_variable changed_;
+        std::exception_ptr error_;
+    };
+
+    /**
+     * @brief Start the workers
+     * @param workers Number of threads to start; may be 0, then callers run every task in wait()
+     * @param cpuAffinity CPUs to pin workers to, assigned round-robin; empty leaves them unpinned
+     */
+    explicit WorkStealingPool(std::size_t workers, std::vector<int> cpuAffinity = {});
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief Queue a task as part of a group
+     */
+    void submit(TaskGroup& group, std::function<void()> task);
+
+    /**
+     * @brief Run queued tasks of the group, then block until every task of it has finished
+     * @throws The first exception thrown by a task of the group
+     */
+    void wait(TaskGroup& group);
+
+    std::size_t workerCount() const { return threads_.size(); }
+
+private:
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group = nullptr;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    // Take a task, searching queue self first; only a task of group when given
+    bool tryTake(std::size_t self, Task& task, const TaskGroup* group = nullptr);
+    void execute(Task& task);
+
+    // queues_[i] belongs to worker i; the last queue takes external submissions
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+};
+
+} // namespace nycollision
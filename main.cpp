@@ -1,4 +1,7 @@
 #include <nycollision/util/CollisionAnalyzer.h>
+#include <nycollision/util/Metrics.h>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
 #include <map>
@@ -7,71 +10,78 @@
 using Clock = std::chrono::high_resolution_clock;
 using Duration = std::chrono::duration<double>;
 
+// Helper function to print one collision record
+void printCollision(const nycollision::IRecord& record) {
+    const auto& stats = record.getCasualtyStats();
+    const auto& vehicleInfo = record.getVehicleInfo();
+    
+    std::cout << "\nDate: " << record.getDateTime().date
+              << " " << record.getDateTime().time << "\n"
+              << "Location: " << record.getBorough()
+              << " (ZIP: " << record.getZipCode() << ")\n"
+              << "Coordinates: " << std::fixed << std::setprecision(6)
+              << record.getLocation().latitude << ", "
+              << record.getLocation().longitude << "\n"
+              << "Casualties:\n"
+              << "  Total: " << stats.getTotalInjuries() << " injured, "
+              << stats.getTotalFatalities() << " killed\n"
+              << "  Pedestrians: " << stats.pedestrians_injured << " injured, "
+              << stats.pedestrians_killed << " killed\n"
+              << "  Cyclists: " << stats.cyclists_injured << " injured, "
+              << stats.cyclists_killed << " killed\n"
+              << "  Motorists: " << stats.motorists_injured << " injured, "
+              << stats.motorists_killed << " killed\n"
+              << "Street: " << record.getOnStreet()
+              << " at " << record.getCrossStreet() << "\n";
+    
+    if (!vehicleInfo.vehicle_types.empty()) {
+        std::cout << "Vehicles involved:";
+        for (const auto& type : vehicleInfo.vehicle_types) {
+            if (!type.empty()) std::cout << " " << type;
+        }
+        std::cout << "\n";
+    }
+    
+    if (!vehicleInfo.contributing_factors.empty()) {
+        std::cout << "Contributing factors:";
+        for (const auto& factor : vehicleInfo.contributing_factors) {
+            if (!factor.empty()) std::cout << " " << factor;
+        }
+        std::cout << "\n";
+    }
+}
+
 // Helper function to print collision records
 void printCollisions(const std::vector<std::shared_ptr<const nycollision::IRecord>>& records, size_t limit = 3) {
     std::cout << "Found " << records.size() << " collisions:\n";
     for (size_t i = 0; i < std::min(limit, records.size()); ++i) {
-        const auto& record = records[i];
-        const auto& stats = record->getCasualtyStats();
-        const auto& vehicleInfo = record->getVehicleInfo();
-        
-        std::cout << "\nDate: " << record->getDateTime().date
-                  << " " << record->getDateTime().time << "\n"
-                  << "Location: " << record->getBorough()
-                  << " (ZIP: " << record->getZipCode() << ")\n"
-                  << "Coordinates: " << std::fixed << std::setprecision(6)
-                  << record->getLocation().latitude << ", "
-                  << record->getLocation().longitude << "\n"
-                  << "Casualties:\n"
-                  << "  Total: " << stats.getTotalInjuries() << " injured, "
-                  << stats.getTotalFatalities() << " killed\n"
-                  << "  Pedestrians: " << stats.pedestrians_injured << " injured, "
-                  << stats.pedestrians_killed << " killed\n"
-                  << "  Cyclists: " << stats.cyclists_injured << " injured, "
-                  << stats.cyclists_killed << " killed\n"
-                  << "  Motorists: " << stats.motorists_injured << " injured, "
-                  << stats.motorists_killed << " killed\n"
-                  << "Street: " << record->getOnStreet()
-                  << " at " << record->getCrossStreet() << "\n";
-        
-        if (!vehicleInfo.vehicle_types.empty()) {
-            std::cout << "Vehicles involved:";
-            for (const auto& type : vehicleInfo.vehicle_types) {
-                if (!type.empty()) std::cout << " " << type;
-            }
-            std::cout << "\n";
-        }
-        
-        if (!vehicleInfo.contributing_factors.empty()) {
-            std::cout << "Contributing factors:";
-            for (const auto& factor : vehicleInfo.contributing_factors) {
-                if (!factor.empty()) std::cout << " " << factor;
-            }
-            std::cout << "\n";
-        }
+        printCollision(*records[i]);
     }
     std::cout << std::endl;
 }
 
-// Helper function to analyze casualty statistics
-void analyzeCasualties(const std::vector<std::shared_ptr<const nycollision::IRecord>>& records) {
-    int totalInjuries = 0, totalFatalities = 0;
-    int pedInjuries = 0, pedFatalities = 0;
-    int cycInjuries = 0, cycFatalities = 0;
-    int motInjuries = 0, motFatalities = 0;
-    
-    for (const auto& record : records) {
-        const auto& stats = record->getCasualtyStats();
-        totalInjuries += stats.getTotalInjuries();
-        totalFatalities += stats.getTotalFatalities();
-        pedInjuries += stats.pedestrians_injured;
-        pedFatalities += stats.pedestrians_killed;
-        cycInjuries += stats.cyclists_injured;
-        cycFatalities += stats.cyclists_killed;
-        motInjuries += stats.motorists_injured;
-        motFatalities += stats.motorists_killed;
-    }
-    
+// Helper function to print the first rows of a row set; only those rows are read
+void printCollisions(const nycollision::IDataSet& dataset, const nycollision::RowSet& rows, size_t limit = 3) {
+    std::cout << "Found " << rows.size() << " collisions:\n";
+    dataset.visit(rows, [](const nycollision::IRecord& record) {
+        printCollision(record);
+        return true;
+    }, {0, limit});
+    std::cout << std::endl;
+}
+
+// Helper function to analyze casualty statistics, summed from the casualty columns
+void analyzeCasualties(const nycollision::DataSet& dataset, const nycollision::RowSet& rows) {
+    using nycollision::CasualtyField;
+    const auto totals = dataset.aggregate(rows).totals;
+    const auto totalInjuries = totals.injuries(), totalFatalities = totals.fatalities();
+    const auto pedInjuries = totals.get(CasualtyField::PedestriansInjured);
+    const auto pedFatalities = totals.get(CasualtyField::PedestriansKilled);
+    const auto cycInjuries = totals.get(CasualtyField::CyclistsInjured);
+    const auto cycFatalities = totals.get(CasualtyField::CyclistsKilled);
+    const auto motInjuries = totals.get(CasualtyField::MotoristsInjured);
+    const auto motFatalities = totals.get(CasualtyField::MotoristsKilled);
+
     std::cout << "Casualty Analysis:\n"
               << "Total: " << totalInjuries << " injured, " << totalFatalities << " killed\n"
               << "Pedestrians: " << pedInjuries << " injured, " << pedFatalities << " killed\n"
@@ -95,6 +105,28 @@ void analyzeVehicleTypes(const std::vector<std::shared_ptr<const nycollision::IR
     std::cout << std::endl;
 }
 
+// Helper function to print per-column data-quality counters
+void printDataQuality(const nycollision::ParseStats& stats) {
+    std::cout << "Data Quality:\n"
+              << "Parsed: " << stats.records << " rows, rejected: " << stats.rejected << " rows\n";
+    for (std::size_t i = 0; i < nycollision::kCSVColumnCount; ++i) {
+        if (stats.missing[i] == 0 && stats.malformed[i] == 0) continue;
+        std::cout << std::setw(32) << std::left << nycollision::columnName(static_cast<nycollision::CSVColumn>(i))
+                  << ": " << stats.missing[i] << " missing, " << stats.malformed[i] << " malformed\n";
+    }
+    std::cout << std::endl;
+}
+
+// Helper function to print the shape of the spatial index
+void printSpatialIndexStats(const nycollision::DataSet::SpatialIndexStats& stats) {
+    std::cout << "Spatial Index:\n"
+              << "Points: " << stats.values << " in " << stats.partitions << " packed tree(s)\n"
+              << "Levels: " << stats.levels << ", internal nodes: " << stats.internal_nodes
+              << ", leaves: " << stats.leaves << " (" << stats.min_leaf_values << "-"
+              << stats.max_leaf_values << " points each)\n"
+              << "Build took " << stats.build_time << " seconds\n" << std::endl;
+}
+
 // Helper function to measure and print execution time
 template<typename Func>
 auto measureTime(const std::string& description, Func&& func) {
@@ -107,8 +139,8 @@ auto measureTime(const std::string& description, Func&& func) {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <collision_data.csv>\n";
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <collision_data.csv> [delta.csv ...]\n";
         return 1;
     }
 
@@ -119,16 +151,35 @@ int main(int argc, char* argv[]) {
         analyzer.loadData(argv[1]);
         auto endTime = Clock::now();
         Duration loadTime = endTime - startTime;
-        std::cout << "Data loaded in " << loadTime.count() << " seconds.\n";
+        std::cout << "Data loaded in " << loadTime.count() << " seconds"
+                  << (analyzer.loadedFromSnapshot() ? " from snapshot" : "") << ".\n";
+
+        // Apply delta exports in order; later files revise earlier ones
+        for (int i = 2; i < argc; ++i) {
+            auto appendStart = Clock::now();
+            auto appended = analyzer.appendData(argv[i]);
+            Duration appendTime = Clock::now() - appendStart;
+            std::cout << "Applied " << argv[i] << " in " << appendTime.count() << " seconds: "
+                      << appended.inserted << " inserted, " << appended.updated << " updated, "
+                      << appended.superseded << " superseded, " << appended.rejected << " rejected.\n";
+        }
         std::cout << "Total records: " << analyzer.getTotalRecords() << "\n\n";
+        printDataQuality(analyzer.getParseStats());
+        printSpatialIndexStats(analyzer.getDataset()->spatialIndexStats());
+        std::cout << "Secondary indexes: " << analyzer.getDataset()->indexMemoryUsage() / 1024 << " KiB\n\n";
+
+        // Examples that only print a few rows and aggregate the rest read
+        // row sets, which borrow the index postings instead of copying them
+        const auto pinned = analyzer.getDataset();
+        const auto& dataset = *pinned;
 
         // Example 1: Find collisions in Brooklyn
         std::cout << "\n=== Collisions in Brooklyn ===\n";
         auto brooklynCollisions = measureTime("Normal query", [&]() {
-            return analyzer.findCollisionsInBorough("BROOKLYN");
+            return dataset.rowsByBorough("BROOKLYN");
         });
-        printCollisions(brooklynCollisions);
-        analyzeCasualties(brooklynCollisions);
+        printCollisions(dataset, brooklynCollisions);
+        analyzeCasualties(dataset, brooklynCollisions);
 
         // Example 2: Find severe collisions
         std::cout << "\n=== Severe Collisions (5+ injuries) ===\n";
@@ -149,7 +200,7 @@ int main(int argc, char* argv[]) {
         });
         std::cout << "R-tree Query:\n";
         auto areaCollisionsRTree = measureTime("R-tree query", [&]() {
-            return analyzer.getDataset().queryByGeoBoundsRTree(
+            return analyzer.getDataset()->queryByGeoBoundsRTree(
                 40.7000, 40.7200,  // latitude range
                 -74.0100, -73.9900 // longitude range
             );
@@ -162,15 +213,16 @@ int main(int argc, char* argv[]) {
         // Example 4: Find taxi-involved collisions
         std::cout << "\n=== Taxi-involved Collisions ===\n";
         auto taxiCollisions = measureTime("Normal query", [&]() {
-            return analyzer.findCollisionsByVehicleType("TAXI");
+            return dataset.rowsByVehicleType("TAXI");
         });
-        printCollisions(taxiCollisions);
-        analyzeCasualties(taxiCollisions);
+        printCollisions(dataset, taxiCollisions);
+        analyzeCasualties(dataset, taxiCollisions);
 
         // Example 5: Find collisions by date range
         std::cout << "\n=== Collisions in January 2024 ===\n";
         auto januaryCollisions = measureTime("Normal query", [&]() {
-            return analyzer.findCollisionsInDateRange("2024-01-01", "2024-01-31");
+            return analyzer.findCollisionsInDateRange(nycollision::CalendarDate{2024, 1, 1},
+                                                      nycollision::CalendarDate{2024, 1, 31});
         });
         printCollisions(januaryCollisions);
         analyzeVehicleTypes(januaryCollisions);
@@ -178,10 +230,142 @@ int main(int argc, char* argv[]) {
         // Example 6: Find collisions with cyclist fatalities
         std::cout << "\n=== Collisions with Cyclist Fatalities ===\n";
         auto cyclistFatalities = measureTime("Normal query", [&]() {
-            return analyzer.findCollisionsByFatalityCount(1, 999);
+            return dataset.rowsByFatalityRange(1, 999);
+        });
+        printCollisions(dataset, cyclistFatalities);
+        analyzeCasualties(dataset, cyclistFatalities);
+
+        // Example 7: Combine predicates in one query
+        std::cout << "\n=== Injury Collisions Involving Taxis in Brooklyn, 2024 ===\n";
+        auto combinedQuery = nycollision::Query()
+            .borough("BROOKLYN")
+            .vehicleType("TAXI")
+            .dateRange(nycollision::CalendarDate{2024, 1, 1}, nycollision::CalendarDate{2024, 12, 31})
+            .injuries(1, 999);
+        std::cout << analyzer.explainQuery(combinedQuery);
+        auto combinedCollisions = measureTime("Combined query", [&]() {
+            return dataset.rowsMatching(combinedQuery);
+        });
+        printCollisions(dataset, combinedCollisions);
+        analyzeCasualties(dataset, combinedCollisions);
+
+        // Example 8: Rollups answered from the pre-aggregated cube
+        std::cout << "\n=== Casualties by Borough (rollup) ===\n";
+        auto boroughTotals = measureTime("Rollup query", [&]() {
+            return dataset.rollup().groupBy(nycollision::RollupCube::Borough);
+        });
+        for (const auto& group : boroughTotals) {
+            std::cout << std::setw(20) << std::left << (group.borough.empty() ? "(unknown)" : group.borough)
+                      << ": " << group.totals.collisions << " collisions, "
+                      << group.totals.injuries() << " injured, "
+                      << group.totals.fatalities() << " killed\n";
+        }
+        std::cout << std::endl;
+
+        // Example 9: Aggregate casualty columns over a selection
+        std::cout << "\n=== Casualty Distribution in Brooklyn, 2023 ===\n";
+        auto brooklyn2023 = nycollision::Query()
+            .borough("BROOKLYN")
+            .dateRange(nycollision::CalendarDate{2023, 1, 1}, nycollision::CalendarDate{2023, 12, 31});
+        auto aggregate = measureTime("Aggregate", [&]() {
+            return dataset.aggregate(brooklyn2023);
+        });
+        std::cout << "Collisions: " << aggregate.count() << "\n";
+        for (auto field : {nycollision::CasualtyField::PersonsInjured, nycollision::CasualtyField::PersonsKilled}) {
+            const auto& histogram = aggregate.histogram(field);
+            std::cout << (field == nycollision::CasualtyField::PersonsInjured ? "Persons injured" : "Persons killed")
+                      << ": total " << aggregate.sum(field) << ", max " << aggregate.maximum(field)
+                      << ", mean " << std::fixed << std::setprecision(3) << aggregate.mean(field)
+                      << std::defaultfloat << "\n  per collision:";
+            for (std::size_t bin = 0; bin < histogram.size(); ++bin) {
+                if (histogram[bin] != 0) {
+                    std::cout << " " << bin << (bin + 1 == histogram.size() ? "+" : "") << "=" << histogram[bin];
+                }
+            }
+            std::cout << "\n";
+        }
+        std::cout << std::endl;
+
+        // Example 10: Distance queries around an intersection
+        std::cout << "\n=== Collisions near Times Square (7th Ave & W 45th St) ===\n";
+        const float squareLat = 40.7580f, squareLon = -73.9855f;
+        auto nearest = measureTime("Nearest query", [&]() {
+            return dataset.neighbors(squareLat, squareLon, 5);
+        });
+        for (const auto& neighbor : nearest) {
+            printCollision(nycollision::RecordView(dataset.columns(), neighbor.row));
+            std::cout << "Distance: " << std::fixed << std::setprecision(1) << neighbor.meters << " m\n"
+                      << std::defaultfloat << std::setprecision(6);
+        }
+        auto withinRadius = measureTime("Radius query", [&]() {
+            return dataset.rowsByRadius(squareLat, squareLon, 250.0);
+        });
+        std::cout << "Within 250 m: " << withinRadius.size() << " collisions\n";
+        analyzeCasualties(dataset, withinRadius);
+
+        // Example 11: Regions of a polygon layer; real layers come from
+        // RegionLayer::load() on precinct or district GeoJSON
+        std::cout << "\n=== Collisions by Manhattan Area ===\n";
+        auto areas = std::make_shared<nycollision::RegionLayer>("area");
+        areas->addWkt("Midtown", "POLYGON((-74.0040 40.7530,-73.9800 40.7420,-73.9580 40.7620,"
+                                 "-73.9820 40.7730,-74.0040 40.7530))");
+        areas->addWkt("Financial District", "POLYGON((-74.0190 40.7000,-74.0090 40.7010,-74.0000 40.7080,"
+                                            "-74.0090 40.7150,-74.0160 40.7120,-74.0190 40.7000))");
+        measureTime("Region index", [&]() {
+            analyzer.addRegionLayer(areas);
+            return 0;
+        });
+        for (const char* area : {"Midtown", "Financial District"}) {
+            auto inArea = measureTime("Region query", [&]() {
+                return analyzer.findCollisionsInRegion("area", area);
+            });
+            std::cout << area << ": " << inArea.size() << " collisions\n";
+        }
+        const auto withRegions = analyzer.getDataset();
+        auto midtownInjuries = nycollision::Query().region("area", "Midtown").injuries(1, 999);
+        std::cout << withRegions->explain(midtownInjuries)
+                  << "Midtown collisions with injuries: " << withRegions->rowsMatching(midtownInjuries).size()
+                  << "\n";
+
+        // Example 12: Hotspot grid of Manhattan, and a zoomed-out view of the city from the tiles
+        std::cout << "\n=== Manhattan Injury Heatmap (500 m cells) ===\n";
+        auto grid = measureTime("Heatmap", [&]() {
+            return analyzer.collisionHeatmap(40.70f, 40.88f, -74.02f, -73.91f, 500.0,
+                                             nycollision::Query().injuries(1, 999));
+        });
+        std::sort(grid.begin(), grid.end(), [](const auto& a, const auto& b) {
+            return a.totals.injuries() > b.totals.injuries();
+        });
+        for (std::size_t i = 0; i < std::min<std::size_t>(grid.size(), 3); ++i) {
+            std::cout << "Cell at (" << grid[i].minLat << ", " << grid[i].minLon << "): "
+                      << grid[i].totals.collisions << " collisions, " << grid[i].totals.injuries() << " injuries\n";
+        }
+        const int cityLevel = nycollision::HeatmapTiles::levelFor(5000.0);
+        auto tiles = measureTime("Heatmap tiles", [&]() {
+            return analyzer.collisionHeatmapTiles(40.49f, 40.92f, -74.26f, -73.70f, cityLevel);
+        });
+        std::uint64_t tiled = 0;
+        for (const auto& tile : tiles) {
+            tiled += tile.totals.collisions;
+        }
+        std::cout << "Level " << cityLevel << ": " << tiles.size() << " tiles holding " << tiled << " collisions\n";
+
+        // Example 13: DBSCAN hotspots of injury collisions
+        std::cout << "\n=== Injury Hotspots (DBSCAN, eps 100 m, 25 points) ===\n";
+        auto hotspots = measureTime("Clustering", [&]() {
+            return analyzer.findCollisionHotspots(100.0, 25, nycollision::Query().injuries(1, 999));
         });
-        printCollisions(cyclistFatalities);
-        analyzeCasualties(cyclistFatalities);
+        std::vector<nycollision::Cluster> ranked = hotspots.clusters();
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            return a.totals.injuries() > b.totals.injuries();
+        });
+        std::cout << hotspots.rows().size() << " collisions, " << ranked.size() << " clusters, "
+                  << hotspots.noise() << " noise\n";
+        for (std::size_t i = 0; i < std::min<std::size_t>(ranked.size(), 3); ++i) {
+            std::cout << "Hotspot at (" << ranked[i].latitude << ", " << ranked[i].longitude << "): "
+                      << ranked[i].totals.collisions << " collisions, " << ranked[i].totals.injuries()
+                      << " injuries, " << ranked[i].totals.fatalities() << " fatalities\n";
+        }
 
         // Performance comparison for different area sizes
         std::cout << "\n=== Spatial Query Performance Comparison ===\n";
@@ -210,7 +394,7 @@ int main(int argc, char* argv[]) {
 
         for (const auto& test : testCases) {
             std::cout << "\nTesting " << test.name << ":\n";
-            auto stats = analyzer.getDataset().benchmarkQuery(
+            auto stats = analyzer.getDataset()->benchmarkQuery(
                 test.minLat, test.maxLat,
                 test.minLon, test.maxLon
             );
@@ -220,6 +404,12 @@ int main(int argc, char* argv[]) {
                       << "Speedup: " << (stats.bruteforce_time / stats.rtree_time) << "x\n";
         }
 
+        // Export stage and query latencies: Prometheus text, or JSON for a .json file
+        if (const char* metricsFile = std::getenv("NYCOLLISION_METRICS_FILE")) {
+            nycollision::Metrics::snapshot().write(metricsFile);
+            std::cout << "\nMetrics written to " << metricsFile << "\n";
+        }
+
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -1,118 +1,189 @@
 #include "../include/nycollision/parser/CSVParser.h"
 #include "../include/nycollision/core/Record.h"
-#include <sstream>
+#include "../include/nycollision/util/Metrics.h"
+#include <algorithm>
 #include <stdexcept>
 
 namespace nycollision {
 
 std::vector<std::string> CSVParser::tokenize(const std::string& line) const {
-    std::vector<std::string> tokens;
-    std::string token;
+    FieldBuffer fields;
+    tokenize(std::string_view(line), fields);
+    return std::vector<std::string>(fields.begin(), fields.end());
+}
+
+std::size_t CSVParser::tokenize(std::string_view line, FieldBuffer& fields) const {
+    thread_local std::vector<std::uint32_t> delimiters;
+    fields.clear();
+    const bool hasQuotes = scanner_.findDelimiters(line, delimiters);
+
+    std::size_t start = 0;
+    for (std::size_t i = 0; i <= delimiters.size(); ++i) {
+        std::size_t end = i < delimiters.size() ? delimiters[i] : line.size();
+        std::string_view field = line.substr(start, end - start);
+
+        if (!hasQuotes || field.find(quote_) == std::string_view::npos) {
+            fields.addView(field);
+        } else if (field.size() >= 2 && field.front() == quote_ && field.back() == quote_ &&
+                   field.substr(1, field.size() - 2).find(quote_) == std::string_view::npos) {
+            // Simply quoted field: "text"
+            fields.addView(field.substr(1, field.size() - 2));
+        } else {
+            tokenizeEscaped(line, start, fields);
+        }
+        start = end + 1; // skip delimiter
+    }
+
+    fields.seal();
+    return fields.size();
+}
+
+std::size_t CSVParser::tokenizeEscaped(std::string_view line, std::size_t pos, FieldBuffer& fields) const {
+    std::string& out = fields.beginOwned();
     bool inQuotes = false;
-    std::ostringstream currentToken;
 
-    for (size_t i = 0; i < line.length(); ++i) {
-        char c = line[i];
-        
+    for (; pos < line.size(); ++pos) {
+        char c = line[pos];
+
         if (c == quote_) {
-            if (inQuotes && i + 1 < line.length() && line[i + 1] == quote_) {
+            if (inQuotes && pos + 1 < line.size() && line[pos + 1] == quote_) {
                 // Handle escaped quotes
-                currentToken << c;
-                ++i;
+                out.push_back(c);
+                ++pos;
             } else {
                 inQuotes = !inQuotes;
             }
         } else if (c == delimiter_ && !inQuotes) {
-            // End of current token
-            tokens.push_back(currentToken.str());
-            currentToken.str("");
-            currentToken.clear();
+            break;
         } else {
-            currentToken << c;
+            out.push_back(c);
         }
     }
-    
-    // Add the last token
-    tokens.push_back(currentToken.str());
-    return tokens;
+
+    fields.endOwned();
+    return pos;
 }
 
-float CSVParser::toFloat(const std::string& str, float defaultValue) {
-    try {
-        return str.empty() ? defaultValue : std::stof(str);
-    } catch (const std::exception&) {
-        return defaultValue;
-    }
+std::size_t CSVParser::recordLength(std::string_view data) const {
+    return scanner_.findRecordEnd(data);
 }
 
-int CSVParser::toInt(const std::string& str, int defaultValue) {
-    try {
-        return str.empty() ? defaultValue : std::stoi(str);
-    } catch (const std::exception&) {
-        return defaultValue;
+std::vector<std::string_view> CSVParser::splitChunks(std::string_view data, std::size_t chunkCount,
+                                                     const ExecutionContext& context) const {
+    // Keep chunks large enough that the boundary scan stays negligible
+    constexpr std::size_t kMinChunkBytes = 1 << 16;
+    chunkCount = std::clamp<std::size_t>(data.size() / kMinChunkBytes, 1, std::max<std::size_t>(chunkCount, 1));
+    const std::size_t stride = data.size() / chunkCount;
+
+    // Count quotes per stride; an odd running total means the stride starts inside a quoted field
+    std::vector<std::size_t> quoteCounts(chunkCount);
+    context.parallelFor(chunkCount, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            std::size_t length = (i + 1 == chunkCount) ? data.size() - i * stride : stride;
+            quoteCounts[i] = scanner_.countQuotes(data.substr(i * stride, length));
+        }
+    });
+
+    std::vector<std::size_t> cuts{0};
+    std::size_t quotesBefore = 0;
+    for (std::size_t i = 1; i < chunkCount; ++i) {
+        quotesBefore += quoteCounts[i - 1];
+        std::size_t pos = i * stride;
+        if (pos <= cuts.back()) {
+            continue; // previous record ran past this stride
+        }
+
+        // Advance to the first record terminator outside quotes
+        bool inQuotes = (quotesBefore % 2) != 0;
+        pos += scanner_.findRecordEnd(data.substr(pos), inQuotes);
+        if (pos < data.size() && pos > cuts.back()) {
+            cuts.push_back(pos);
+        }
+    }
+    cuts.push_back(data.size());
+
+    std::vector<std::string_view> chunks;
+    chunks.reserve(cuts.size() - 1);
+    for (std::size_t i = 0; i + 1 < cuts.size(); ++i) {
+        if (cuts[i + 1] > cuts[i]) {
+            chunks.push_back(data.substr(cuts[i], cuts[i + 1] - cuts[i]));
+        }
     }
+    return chunks;
 }
 
-std::shared_ptr<Record> CSVParser::parseRecord(const std::string& line) const {
-    auto tokens = tokenize(line);
-    if (tokens.size() < 29) { // Minimum expected number of fields
+std::shared_ptr<Record> CSVParser::parseRecord(std::string_view line) const {
+    ParseStats ignored;
+    return parseRecord(line, ignored);
+}
+
+std::shared_ptr<Record> CSVParser::parseRecord(std::string_view line, ParseStats& stats) const {
+    thread_local FieldBuffer tokens;
+    std::size_t fieldCount;
+    {
+        NYCOLLISION_TIME_SCOPE(IngestTokenize);
+        fieldCount = tokenize(line, tokens);
+    }
+    if (fieldCount < kCSVColumnCount) { // Minimum expected number of fields
+        ++stats.rejected;
         return nullptr;
     }
+    ++stats.records;
+    NYCOLLISION_TIME_SCOPE(IngestParse);
+    auto field = [&](CSVColumn column) { return tokens[columnIndex(column)]; };
 
-    auto record = std::make_shared<Record>();
+    thread_local StringPool::LocalCache codes;
+    auto encode = [&](StringDomain domain, CSVColumn column) {
+        return codes.encode(*pool_, domain, field(column));
+    };
 
-    // Parse date and time
-    Date date;
-    date.date = tokens[0];
-    date.time = tokens[1];
-    record->setDateTime(date);
+    auto record = std::make_shared<Record>(pool_);
+
+    // Parse date and time once into the packed form
+    record->setTimestamp(timestampField(tokens, stats));
 
     // Parse location information
-    record->setBorough(tokens[2]);
-    record->setZipCode(tokens[3]);
+    record->setBoroughCode(encode(StringDomain::Borough, CSVColumn::Borough));
+    record->setZipCodeCode(encode(StringDomain::ZipCode, CSVColumn::ZipCode));
 
     GeoCoordinate location;
-    location.latitude = toFloat(tokens[4]);
-    location.longitude = toFloat(tokens[5]);
+    location.latitude = numberField<float>(tokens, CSVColumn::Latitude, stats);
+    location.longitude = numberField<float>(tokens, CSVColumn::Longitude, stats);
     record->setLocation(location);
 
-    record->setOnStreet(tokens[6]);
-    record->setCrossStreet(tokens[7]);
-    record->setOffStreet(tokens[8]);
+    record->setStreetCodes(encode(StringDomain::Street, CSVColumn::OnStreet),
+                           encode(StringDomain::Street, CSVColumn::CrossStreet),
+                           encode(StringDomain::Street, CSVColumn::OffStreet));
 
     // Parse casualty statistics
-    CasualtyStats stats;
-    stats.persons_injured = toInt(tokens[9]);
-    stats.persons_killed = toInt(tokens[10]);
-    stats.pedestrians_injured = toInt(tokens[11]);
-    stats.pedestrians_killed = toInt(tokens[12]);
-    stats.cyclists_injured = toInt(tokens[13]);
-    stats.cyclists_killed = toInt(tokens[14]);
-    stats.motorists_injured = toInt(tokens[15]);
-    stats.motorists_killed = toInt(tokens[16]);
-    record->setCasualtyStats(stats);
-
-    // Parse vehicle information
-    VehicleInfo vehicleInfo;
-    // Contributing factors
-    for (int i = 0; i < 5; ++i) {
-        const auto& factor = tokens[17 + i];
-        if (!factor.empty()) {
-            vehicleInfo.contributing_factors.push_back(factor);
+    CasualtyStats casualties;
+    casualties.persons_injured = numberField<int>(tokens, CSVColumn::PersonsInjured, stats);
+    casualties.persons_killed = numberField<int>(tokens, CSVColumn::PersonsKilled, stats);
+    casualties.pedestrians_injured = numberField<int>(tokens, CSVColumn::PedestriansInjured, stats);
+    casualties.pedestrians_killed = numberField<int>(tokens, CSVColumn::PedestriansKilled, stats);
+    casualties.cyclists_injured = numberField<int>(tokens, CSVColumn::CyclistsInjured, stats);
+    casualties.cyclists_killed = numberField<int>(tokens, CSVColumn::CyclistsKilled, stats);
+    casualties.motorists_injured = numberField<int>(tokens, CSVColumn::MotoristsInjured, stats);
+    casualties.motorists_killed = numberField<int>(tokens, CSVColumn::MotoristsKilled, stats);
+    record->setCasualtyStats(casualties);
+
+    // Parse vehicle information: non-empty values first, empty slots at the end
+    auto encodeSlots = [&](StringDomain domain, CSVColumn first) {
+        Record::VehicleCodes slots{};
+        std::size_t filled = 0;
+        for (std::size_t i = 0; i < Record::kVehicleSlots; ++i) {
+            auto value = tokens[columnIndex(first) + i];
+            if (!value.empty()) {
+                slots[filled++] = codes.encode(*pool_, domain, value);
+            }
         }
-    }
+        return slots;
+    };
+    record->setVehicleCodes(encodeSlots(StringDomain::VehicleType, CSVColumn::VehicleType1),
+                            encodeSlots(StringDomain::ContributingFactor, CSVColumn::ContributingFactor1));
 
     // Unique key
-    record->setUniqueKey(toInt(tokens[23]));
-
-    // Vehicle types
-    for (int i = 0; i < 5; ++i) {
-        const auto& type = tokens[24 + i];
-        if (!type.empty()) {
-            vehicleInfo.vehicle_types.push_back(type);
-        }
-    }
-    record->setVehicleInfo(vehicleInfo);
+    record->setUniqueKey(numberField<int>(tokens, CSVColumn::CollisionId, stats));
 
     return record;
 }
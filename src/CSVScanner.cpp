@@ -0,0 +1,106 @@
+#include "../include/nycollision/parser/CSVScanner.h"
+#include "CSVScannerKernels.h"
+#include <stdexcept>
+
+namespace nycollision {
+
+namespace detail {
+namespace {
+
+struct ScalarClassify {
+    static ScanMasks classify(const char* block, char delimiter, char quote) {
+        ScanMasks masks{0, 0, 0};
+        for (std::size_t i = 0; i < kScanBlock; ++i) {
+            std::uint64_t bit = std::uint64_t{1} << i;
+            char c = block[i];
+            masks.quote |= (c == quote) ? bit : 0;
+            masks.delimiter |= (c == delimiter) ? bit : 0;
+            masks.newline |= (c == '\n') ? bit : 0;
+        }
+        return masks;
+    }
+
+    static std::uint64_t prefixXor(std::uint64_t mask) { return prefixXorShift(mask); }
+};
+
+} // namespace
+
+const ScanKernel& scalarKernel() {
+    return ScanLoops<ScalarClassify>::kernel("scalar");
+}
+
+} // namespace detail
+
+namespace {
+
+const detail::ScanKernel* kernelImpl(CSVScanner::Kernel kernel) {
+    switch (kernel) {
+#ifdef NYCOLLISION_X86_KERNELS
+    case CSVScanner::Kernel::AVX2:
+        return &detail::avx2Kernel();
+    case CSVScanner::Kernel::SSE42:
+        return &detail::sse42Kernel();
+#endif
+    default:
+        return &detail::scalarKernel();
+    }
+}
+
+} // namespace
+
+CSVScanner::CSVScanner(char delimiter, char quote, Kernel kernel)
+    : kernel_(kernel == Kernel::Auto ? bestKernel() : kernel),
+      delimiter_(delimiter),
+      quote_(quote) {
+    if (!isSupported(kernel_)) {
+        throw std::invalid_argument("CSV scan kernel not supported on this CPU");
+    }
+    impl_ = kernelImpl(kernel_);
+}
+
+bool CSVScanner::isSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Auto:
+    case Kernel::Scalar:
+        return true;
+#ifdef NYCOLLISION_X86_KERNELS
+    case Kernel::SSE42:
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    case Kernel::AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul") &&
+               __builtin_cpu_supports("popcnt");
+#endif
+    default:
+        return false;
+    }
+}
+
+CSVScanner::Kernel CSVScanner::bestKernel() {
+    static const Kernel best = [] {
+        for (Kernel kernel : {Kernel::AVX2, Kernel::SSE42}) {
+            if (isSupported(kernel)) {
+                return kernel;
+            }
+        }
+        return Kernel::Scalar;
+    }();
+    return best;
+}
+
+const char* CSVScanner::kernelName() const {
+    return impl_->name;
+}
+
+std::size_t CSVScanner::findRecordEnd(std::string_view data, bool inQuotes) const {
+    return impl_->findRecordEnd(data, quote_, inQuotes);
+}
+
+bool CSVScanner::findDelimiters(std::string_view line, std::vector<std::uint32_t>& positions) const {
+    return impl_->findDelimiters(line, delimiter_, quote_, positions);
+}
+
+std::size_t CSVScanner::countQuotes(std::string_view data) const {
+    return impl_->countQuotes(data, quote_);
+}
+
+} // namespace nycollision
@@ -0,0 +1,63 @@
+// Compiled with -mavx2 -mpclmul -mpopcnt; only reached after a runtime CPU check.
+#include "CSVScannerKernels.h"
+#include <immintrin.h>
+
+namespace nycollision {
+namespace detail {
+namespace {
+
+struct AVX2Classify {
+    static std::uint64_t match(__m256i lo, __m256i hi, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        auto loBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+        auto hiBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+        return std::uint64_t{loBits} | (std::uint64_t{hiBits} << 32);
+    }
+
+    static ScanMasks classify(const char* block, char delimiter, char quote) {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+        return {match(lo, hi, quote), match(lo, hi, delimiter), match(lo, hi, '\n')};
+    }
+
+    // Carry-less multiply by all ones computes the prefix XOR in one instruction
+    static std::uint64_t prefixXor(std::uint64_t mask) {
+        __m128i product = _mm_clmulepi64_si128(
+            _mm_set_epi64x(0, static_cast<long long>(mask)), _mm_set1_epi8(-1), 0);
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(product));
+    }
+};
+
+using Loops = ScanLoops<AVX2Classify>;
+
+// Entry points clear the upper ymm halves on return. GCC only adds
+// vzeroupper itself when optimizing; without it, SSE code run afterwards,
+// such as libm's sin and cos, pays an AVX transition penalty on every
+// instruction until the next vzeroupper.
+std::size_t findRecordEnd(std::string_view data, char quote, bool inQuotes) {
+    const std::size_t end = Loops::findRecordEnd(data, quote, inQuotes);
+    _mm256_zeroupper();
+    return end;
+}
+
+bool findDelimiters(std::string_view line, char delimiter, char quote, std::vector<std::uint32_t>& positions) {
+    const bool quoted = Loops::findDelimiters(line, delimiter, quote, positions);
+    _mm256_zeroupper();
+    return quoted;
+}
+
+std::size_t countQuotes(std::string_view data, char quote) {
+    const std::size_t count = Loops::countQuotes(data, quote);
+    _mm256_zeroupper();
+    return count;
+}
+
+} // namespace
+
+const ScanKernel& avx2Kernel() {
+    static const ScanKernel instance{"avx2", &findRecordEnd, &findDelimiters, &countQuotes};
+    return instance;
+}
+
+} // namespace detail
+} // namespace nycollision
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace nycollision {
+namespace detail {
+
+constexpr std::size_t kScanBlock = 64;
+
+/**
+ * @brief Per-byte classification of one 64-byte block
+ */
+struct ScanMasks {
+    std::uint64_t quote;
+    std::uint64_t delimiter;
+    std::uint64_t newline;
+};
+
+/**
+ * @brief Entry points of one scanning kernel
+ */
+struct ScanKernel {
+    const char* name;
+    std::size_t (*findRecordEnd)(std::string_view data, char quote, bool inQuotes);
+    bool (*findDelimiters)(std::string_view line, char delimiter, char quote,
+                           std::vector<std::uint32_t>& positions);
+    std::size_t (*countQuotes)(std::string_view data, char quote);
+};
+
+const ScanKernel& scalarKernel();
+#ifdef NYCOLLISION_X86_KERNELS
+const ScanKernel& sse42Kernel();
+const ScanKernel& avx2Kernel();
+#endif
+
+// Internal linkage: every kernel translation unit gets its own copy, compiled
+// with that unit's instruction set flags.
+namespace {
+
+/**
+ * @brief Block loops shared by all kernels
+ * @tparam Classify Provides classify(const char*, char, char) over 64 bytes
+ *                  and prefixXor(uint64_t)
+ */
+template <typename Classify>
+struct ScanLoops {
+    static ScanMasks block(std::string_view data, std::size_t offset, char delimiter, char quote) {
+        std::size_t remaining = data.size() - offset;
+        if (remaining >= kScanBlock) {
+            return Classify::classify(data.data() + offset, delimiter, quote);
+        }
+
+        // Zero-pad the tail and drop bits past the end
+        alignas(kScanBlock) char tail[kScanBlock] = {};
+        std::memcpy(tail, data.data() + offset, remaining);
+        ScanMasks masks = Classify::classify(tail, delimiter, quote);
+        std::uint64_t valid = (std::uint64_t{1} << remaining) - 1;
+        masks.quote &= valid;
+        masks.delimiter &= valid;
+        masks.newline &= valid;
+        return masks;
+    }
+
+    // All ones when the last byte of the block lies inside quotes
+    static std::uint64_t carryOut(std::uint64_t inside) {
+        return std::uint64_t{0} - (inside >> 63);
+    }
+
+    static std::size_t findRecordEnd(std::string_view data, char quote, bool inQuotes) {
+        std::uint64_t carry = inQuotes ? ~std::uint64_t{0} : 0;
+        for (std::size_t offset = 0; offset < data.size(); offset += kScanBlock) {
+            ScanMasks masks = block(data, offset, '\n', quote);
+            std::uint64_t inside = Classify::prefixXor(masks.quote) ^ carry;
+            std::uint64_t newlines = masks.newline & ~inside;
+            if (newlines) {
+                return offset + static_cast<std::size_t>(__builtin_ctzll(newlines)) + 1;
+            }
+            carry = carryOut(inside);
+        }
+        return data.size();
+    }
+
+    static bool findDelimiters(std::string_view line, char delimiter, char quote,
+                               std::vector<std::uint32_t>& positions) {
+        positions.clear();
+        std::uint64_t carry = 0;
+        std::uint64_t anyQuote = 0;
+        for (std::size_t offset = 0; offset < line.size(); offset += kScanBlock) {
+            ScanMasks masks = block(line, offset, delimiter, quote);
+            anyQuote |= masks.quote;
+            std::uint64_t inside = Classify::prefixXor(masks.quote) ^ carry;
+            std::uint64_t delimiters = masks.delimiter & ~inside;
+            while (delimiters) {
+                positions.push_back(static_cast<std::uint32_t>(offset + __builtin_ctzll(delimiters)));
+                delimiters &= delimiters - 1;
+            }
+            carry = carryOut(inside);
+        }
+        return anyQuote != 0;
+    }
+
+    static std::size_t countQuotes(std::string_view data, char quote) {
+        std::size_t count = 0;
+        for (std::size_t offset = 0; offset < data.size(); offset += kScanBlock) {
+            count += static_cast<std::size_t>(__builtin_popcountll(block(data, offset, quote, quote).quote));
+        }
+        return count;
+    }
+
+    static const ScanKernel& kernel(const char* name) {
+        static const ScanKernel instance{name, &findRecordEnd, &findDelimiters, &countQuotes};
+        return instance;
+    }
+};
+
+/**
+ * @brief Inclusive prefix XOR: bit i is the parity of set bits 0..i
+ */
+inline std::uint64_t prefixXorShift(std::uint64_t mask) {
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+
+} // namespace
+} // namespace detail
+} // namespace nycollision
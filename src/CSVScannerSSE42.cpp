@@ -0,0 +1,40 @@
+// Compiled with -msse4.2 -mpopcnt; only reached after a runtime CPU check.
+#include "CSVScannerKernels.h"
+#include <nmmintrin.h>
+
+namespace nycollision {
+namespace detail {
+namespace {
+
+struct SSE42Classify {
+    static std::uint64_t match(const __m128i (&chunks)[4], char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        std::uint64_t mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], needle)));
+            mask |= std::uint64_t{bits} << (16 * i);
+        }
+        return mask;
+    }
+
+    static ScanMasks classify(const char* block, char delimiter, char quote) {
+        const __m128i chunks[4] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48)),
+        };
+        return {match(chunks, quote), match(chunks, delimiter), match(chunks, '\n')};
+    }
+
+    static std::uint64_t prefixXor(std::uint64_t mask) { return prefixXorShift(mask); }
+};
+
+} // namespace
+
+const ScanKernel& sse42Kernel() {
+    return ScanLoops<SSE42Classify>::kernel("sse4.2");
+}
+
+} // namespace detail
+} // namespace nycollision
@@ -0,0 +1,82 @@
+#include "../include/nycollision/data/CasualtyAggregate.h"
+
+namespace nycollision {
+
+namespace {
+
+using Count = ColumnStore::Count;
+
+// Rows gathered per batch by addRows(); small enough to stay in L1
+constexpr std::size_t kGatherBatch = 1024;
+
+struct ColumnSummary {
+    std::uint64_t sum = 0;
+    Count min = std::numeric_limits<Count>::max();
+    Count max = 0;
+};
+
+// Branch-free over a contiguous array so the compiler can vectorize it
+ColumnSummary summarize(const Count* values, std::size_t count) {
+    ColumnSummary summary;
+    std::uint64_t sum = 0;
+    Count lo = summary.min;
+    Count hi = summary.max;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Count value = values[i];
+        sum += value;
+        lo = value < lo ? value : lo;
+        hi = value > hi ? value : hi;
+    }
+    summary.sum = sum;
+    summary.min = lo;
+    summary.max = hi;
+    return summary;
+}
+
+void countValues(const Count* values, std::size_t count, CasualtyAggregate::Histogram& histogram) {
+    constexpr Count kLastBin = CasualtyAggregate::kHistogramBins - 1;
+    for (std::size_t i = 0; i < count; ++i) {
+        ++histogram[values[i] < kLastBin ? values[i] : kLastBin];
+    }
+}
+
+void addColumn(CasualtyAggregate& into, std::size_t field, const Count* values, std::size_t count) {
+    const ColumnSummary summary = summarize(values, count);
+    into.totals.casualties[field] += summary.sum;
+    into.min[field] = std::min<int>(into.min[field], summary.min);
+    into.max[field] = std::max<int>(into.max[field], summary.max);
+    countValues(values, count, into.histograms[field]);
+}
+
+} // namespace
+
+void CasualtyAggregate::addRange(const ColumnStore& store, RowId first, RowId last) {
+    if (last <= first) {
+        return;
+    }
+    const std::size_t count = last - first;
+    totals.collisions += count;
+    for (std::size_t field = 0; field < kCasualtyFieldCount; ++field) {
+        store.casualties(static_cast<CasualtyField>(field))
+            .forEachRun(first, last, [&](const Count* values, std::size_t, std::size_t rows) {
+                addColumn(*this, field, values, rows);
+            });
+    }
+}
+
+void CasualtyAggregate::addRows(const ColumnStore& store, const RowId* rows, std::size_t count) {
+    totals.collisions += count;
+    Count gathered[kGatherBatch];
+    for (std::size_t field = 0; field < kCasualtyFieldCount; ++field) {
+        const auto& column = store.casualties(static_cast<CasualtyField>(field));
+        for (std::size_t offset = 0; offset < count; offset += kGatherBatch) {
+            const std::size_t batch = std::min(kGatherBatch, count - offset);
+            for (std::size_t i = 0; i < batch; ++i) {
+                gathered[i] = column[rows[offset + i]];
+            }
+            addColumn(*this, field, gathered, batch);
+        }
+    }
+}
+
+} // namespace nycollision
@@ -0,0 +1,178 @@
+#include "../include/nycollision/data/ColumnStore.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace nycollision {
+
+namespace {
+
+std::vector<std::string> decodeSlots(const ColumnStore::SlotColumn& column, RowId row,
+                                     const StringPool& pool, StringDomain domain) {
+    std::vector<std::string> values;
+    const auto* slots = column.row(row);
+    for (std::size_t i = 0; i < ColumnStore::kVehicleSlots && slots[i] != StringPool::kEmpty; ++i) {
+        values.push_back(pool.decode(domain, slots[i]));
+    }
+    return values;
+}
+
+} // namespace
+
+template <typename Store, typename Visit>
+void ColumnStore::forEachColumn(Store& store, Visit&& visit) {
+    visit("col.unique_keys", store.uniqueKeys_);
+    visit("col.latitudes", store.latitudes_);
+    visit("col.longitudes", store.longitudes_);
+    visit("col.timestamps", store.timestamps_);
+    for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+        visit("col.casualties." + std::to_string(i), store.casualties_[i]);
+    }
+    visit("col.boroughs", store.boroughCodes_);
+    visit("col.zip_codes", store.zipCodeCodes_);
+    visit("col.on_streets", store.onStreetCodes_);
+    visit("col.cross_streets", store.crossStreetCodes_);
+    visit("col.off_streets", store.offStreetCodes_);
+    visit("col.vehicle_types", store.vehicleTypeCodes_);
+    visit("col.factors", store.contributingFactorCodes_);
+}
+
+RowId ColumnStore::append(const Record& record) {
+    RowId row = static_cast<RowId>(size());
+    resize(size() + 1);
+    writeRow(row, record);
+    return row;
+}
+
+RowId ColumnStore::append(const std::vector<const Record*>& records, const ExecutionContext& context) {
+    RowId first = static_cast<RowId>(size());
+    resize(size() + records.size());
+
+    // Rows are disjoint slices of every column; pool encoding is thread-safe
+    constexpr std::size_t kRowsPerTask = 1 << 14;
+    context.parallelFor(records.size(), kRowsPerTask, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            writeRow(static_cast<RowId>(first + i), *records[i]);
+        }
+    });
+    return first;
+}
+
+void ColumnStore::update(RowId row, const Record& record) {
+    forEachColumn(*this, [row](const std::string&, auto& column) { column.prepare(row); });
+    writeRow(row, record);
+}
+
+void ColumnStore::update(const std::vector<RowId>& rows, const std::vector<const Record*>& records,
+                         const ExecutionContext& context) {
+    // Copying shared chunks is not thread-safe; writing distinct rows is
+    forEachColumn(*this, [&rows](const std::string&, auto& column) {
+        for (RowId row : rows) {
+            column.prepare(row);
+        }
+    });
+    constexpr std::size_t kRowsPerTask = 1 << 12;
+    context.parallelFor(rows.size(), kRowsPerTask, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            writeRow(rows[i], *records[i]);
+        }
+    });
+}
+
+void ColumnStore::resize(std::size_t rows) {
+    forEachColumn(*this, [rows](const std::string&, auto& column) { column.resize(rows); });
+}
+
+void ColumnStore::writeRow(RowId row, const Record& record) {
+    uniqueKeys_.set(row, record.getUniqueKey());
+    auto location = record.getLocation();
+    latitudes_.set(row, location.latitude);
+    longitudes_.set(row, location.longitude);
+    timestamps_.set(row, record.getTimestamp());
+
+    const auto& stats = record.getCasualtyStats();
+    for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+        int value = stats.get(static_cast<CasualtyField>(i));
+        casualties_[i].set(row, static_cast<Count>(std::clamp<int>(value, 0, std::numeric_limits<Count>::max())));
+    }
+
+    Record::VehicleCodes vehicleTypes = record.getVehicleTypeCodes();
+    Record::VehicleCodes factors = record.getContributingFactorCodes();
+    if (record.getStringPool() == pool_) {
+        boroughCodes_.set(row, record.getBoroughCode());
+        zipCodeCodes_.set(row, record.getZipCodeCode());
+        onStreetCodes_.set(row, record.getOnStreetCode());
+        crossStreetCodes_.set(row, record.getCrossStreetCode());
+        offStreetCodes_.set(row, record.getOffStreetCode());
+    } else {
+        // Record was built against another pool: translate through the strings
+        boroughCodes_.set(row, pool_->encode(StringDomain::Borough, record.getBorough()));
+        zipCodeCodes_.set(row, pool_->encode(StringDomain::ZipCode, record.getZipCode()));
+        onStreetCodes_.set(row, pool_->encode(StringDomain::Street, record.getOnStreet()));
+        crossStreetCodes_.set(row, pool_->encode(StringDomain::Street, record.getCrossStreet()));
+        offStreetCodes_.set(row, pool_->encode(StringDomain::Street, record.getOffStreet()));
+        const auto& source = *record.getStringPool();
+        for (auto& code : vehicleTypes) {
+            code = pool_->encode(StringDomain::VehicleType, source.decode(StringDomain::VehicleType, code));
+        }
+        for (auto& code : factors) {
+            code = pool_->encode(StringDomain::ContributingFactor,
+                                 source.decode(StringDomain::ContributingFactor, code));
+        }
+    }
+    std::copy(vehicleTypes.begin(), vehicleTypes.end(), vehicleTypeCodes_.mutableRow(row));
+    std::copy(factors.begin(), factors.end(), contributingFactorCodes_.mutableRow(row));
+}
+
+CasualtyStats ColumnStore::casualtyStats(RowId row) const {
+    CasualtyStats stats;
+    for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+        stats.set(static_cast<CasualtyField>(i), casualties_[i][row]);
+    }
+    return stats;
+}
+
+VehicleInfo ColumnStore::vehicleInfo(RowId row) const {
+    VehicleInfo info;
+    info.contributing_factors = decodeSlots(contributingFactorCodes_, row, *pool_, StringDomain::ContributingFactor);
+    info.vehicle_types = decodeSlots(vehicleTypeCodes_, row, *pool_, StringDomain::VehicleType);
+    return info;
+}
+
+std::size_t ColumnStore::memoryUsage() const {
+    std::size_t bytes = 0;
+    forEachColumn(*this, [&bytes](const std::string&, const auto& column) { bytes += column.memoryUsage(); });
+    return bytes;
+}
+
+void ColumnStore::save(SnapshotWriter& out) const {
+    forEachColumn(*this, [&out](const std::string& name, const auto& column) { column.save(out.section(name)); });
+}
+
+void ColumnStore::load(const SnapshotReader& in, const ExecutionContext& context) {
+    if (size() != 0) {
+        throw std::runtime_error("Snapshots can only be loaded into an empty column store");
+    }
+    std::vector<std::function<void()>> loads;
+    forEachColumn(*this, [&](const std::string& name, auto& column) {
+        loads.push_back([&in, &column, name] {
+            SnapshotCursor cursor = in.section(name);
+            column.load(cursor);
+        });
+    });
+    context.parallelFor(loads.size(), 1, [&loads](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            loads[i]();
+        }
+    });
+
+    const std::size_t rows = uniqueKeys_.size();
+    forEachColumn(*this, [rows](const std::string& name, const auto& column) {
+        if (column.size() != rows) {
+            throw std::runtime_error("Snapshot column has the wrong length: " + name);
+        }
+    });
+}
+
+} // namespace nycollision
@@ -1,85 +1,947 @@
 #include "../include/nycollision/data/DataSet.h"
+#include "../include/nycollision/core/GeoDistance.h"
+#include "../include/nycollision/util/MappedFile.h"
+#include "../include/nycollision/util/Metrics.h"
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <tuple>
+#include <unordered_set>
 
 namespace nycollision {
 
-void DataSet::addRecord(std::shared_ptr<Record> record) {
-    // Add to primary storage
-    records_.push_back(record);
-    
-    // Update R-tree index with thread safety
+std::vector<std::shared_ptr<Record>> DataSet::parseFile(const std::string& filename, const IParser& parser,
+                                                        std::size_t* keyless) {
+    auto mapFile = [&] {
+        NYCOLLISION_TIME_SCOPE(IngestRead);
+        return MappedFile(filename);
+    };
+    MappedFile file = mapFile();
+    std::string_view data = file.view();
+    NYCOLLISION_COUNT(IngestBytes, data.size());
+
+    // Skip header line
+    data.remove_prefix(parser.recordLength(data));
+    if (data.empty()) {
+        return {};
+    }
+
+    // Over-split so dynamic scheduling can balance uneven chunks
+    const ExecutionContext& context = *context_;
+    std::vector<std::string_view> chunks;
     {
-        std::unique_lock lock(spatial_mutex_);
-        auto loc = record->getLocation();
-        Point p(loc.latitude, loc.longitude);
-        rtree_.insert(std::make_pair(p, record));
+        NYCOLLISION_TIME_SCOPE(IngestSplit);
+        chunks = parser.splitChunks(data, context.threads() * 4, context);
     }
-    
-    // Update other indices
-    keyIndex_[record->getUniqueKey()] = record;
-    boroughIndex_[record->getBorough()].push_back(record);
-    zipIndex_[record->getZipCode()].push_back(record);
-    dateIndex_[record->getDateTime()].push_back(record);
-    
-    // Update range indices
-    const auto& stats = record->getCasualtyStats();
-    injuryIndex_[stats.getTotalInjuries()].push_back(record);
-    fatalityIndex_[stats.getTotalFatalities()].push_back(record);
-    pedestrianFatalityIndex_[stats.pedestrians_killed].push_back(record);
-    cyclistFatalityIndex_[stats.cyclists_killed].push_back(record);
-    motoristFatalityIndex_[stats.motorists_killed].push_back(record);
-    
-    // Update vehicle type index
-    const auto& vehicleInfo = record->getVehicleInfo();
-    for (const auto& type : vehicleInfo.vehicle_types) {
-        vehicleTypeIndex_[type].push_back(record);
+    std::vector<std::vector<std::shared_ptr<Record>>> parsedChunks(chunks.size());
+    std::vector<ParseStats> chunkStats(chunks.size());
+    std::vector<std::size_t> chunkKeyless(chunks.size());
+    const std::size_t keyColumn = columnIndex(CSVColumn::CollisionId);
+
+    // Parallel parse each chunk straight from the mapped bytes
+    context.parallelFor(chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c) {
+            std::string_view chunk = chunks[c];
+            auto& parsed = parsedChunks[c];
+            ParseStats& stats = chunkStats[c];
+            parsed.reserve(chunk.size() / 200);
+
+            while (!chunk.empty()) {
+                std::size_t length = parser.recordLength(chunk);
+                std::string_view text = chunk.substr(0, length);
+                chunk.remove_prefix(length);
+
+                if (!text.empty() && text.back() == '\n') text.remove_suffix(1);
+                if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+
+                const std::size_t badKeys = stats.missing[keyColumn] + stats.malformed[keyColumn];
+                auto rec = parser.parseRecord(text, stats);
+                if (!rec) {
+                    continue;
+                }
+                if (keyless && stats.missing[keyColumn] + stats.malformed[keyColumn] != badKeys) {
+                    ++chunkKeyless[c];
+                    continue;
+                }
+                parsed.push_back(std::move(rec));
+            }
+        }
+    });
+
+    std::size_t total = 0;
+    ParseStats fileStats;
+    for (std::size_t c = 0; c < chunks.size(); ++c) {
+        total += parsedChunks[c].size();
+        fileStats.merge(chunkStats[c]);
+        if (keyless) {
+            *keyless += chunkKeyless[c];
+        }
+    }
+    parseStats_.merge(fileStats);
+    NYCOLLISION_COUNT(IngestRecords, fileStats.records);
+    NYCOLLISION_COUNT(IngestRejected, fileStats.rejected);
+
+    // Flatten in file order
+    std::vector<std::shared_ptr<Record>> records;
+    records.reserve(total);
+    for (auto& parsed : parsedChunks) {
+        std::move(parsed.begin(), parsed.end(), std::back_inserter(records));
+    }
+    return records;
+}
+
+std::unique_ptr<DataSet> DataSet::fork(std::shared_ptr<const ExecutionContext> context) const {
+    // Every member shares its pieces, so copying takes no work worth spreading over threads
+    auto copy = std::make_unique<DataSet>(store_->pool(), context ? std::move(context) : context_);
+    copy->store_ = store_->clone();
+    copy->parseStats_ = parseStats_;
+    copy->spatialPartitions_ = spatialPartitions_;
+    {
+        std::shared_lock lock(spatial_mutex_);
+        copy->segments_ = segments_;
+        copy->strips_ = strips_;
+        copy->spatialStats_ = spatialStats_;
+    }
+    copy->keyIndex_ = keyIndex_;
+    copy->dates_ = dates_;
+    copy->rollup_ = rollup_;
+    copy->tiles_ = tiles_;
+    copy->boroughIndex_ = boroughIndex_;
+    copy->zipIndex_ = zipIndex_;
+    copy->vehicleTypeIndex_ = vehicleTypeIndex_;
+    copy->injuryIndex_ = injuryIndex_;
+    copy->fatalityIndex_ = fatalityIndex_;
+    copy->pedestrianFatalityIndex_ = pedestrianFatalityIndex_;
+    copy->cyclistFatalityIndex_ = cyclistFatalityIndex_;
+    copy->motoristFatalityIndex_ = motoristFatalityIndex_;
+    copy->regionIndexes_ = regionIndexes_;
+    return copy;
+}
+
+void DataSet::loadFromFile(const std::string& filename, const IParser& parser) {
+    auto parsed = parseFile(filename, parser);
+    if (parsed.empty()) {
+        return;
+    }
+
+    // Write all rows into the columns at once
+    std::vector<const Record*> records;
+    records.reserve(parsed.size());
+    for (const auto& rec : parsed) {
+        records.push_back(rec.get());
+    }
+    RowId firstRow = appendRows(records);
+    records.clear();
+    parsed.clear();
+
+    buildIndexes(firstRow);
+}
+
+DataSet::AppendStats DataSet::appendFromFile(const std::string& filename, const IParser& parser) {
+    AppendStats stats;
+    auto parsed = parseFile(filename, parser, &stats.rejected);
+
+    // The last record of each collision id in the file wins
+    std::unordered_map<int, std::size_t> latest;
+    latest.reserve(parsed.size());
+    for (std::size_t i = 0; i < parsed.size(); ++i) {
+        latest[parsed[i]->getUniqueKey()] = i;
+    }
+
+    std::vector<RowId> revisedRows;
+    std::vector<const Record*> revisions;
+    std::vector<const Record*> inserts;
+    for (std::size_t i = 0; i < parsed.size(); ++i) {
+        const int key = parsed[i]->getUniqueKey();
+        if (latest[key] != i) {
+            ++stats.superseded;
+            continue;
+        }
+        RowId row;
+        if (keyIndex_.find(key, row)) {
+            revisedRows.push_back(row);
+            revisions.push_back(parsed[i].get());
+        } else {
+            inserts.push_back(parsed[i].get());
+        }
+    }
+    stats.updated = revisedRows.size();
+    stats.inserted = inserts.size();
+
+    // Revised rows leave every index under their old values and rejoin under the new ones
+    if (!revisedRows.empty()) {
+        NYCOLLISION_TIME_SCOPE(IngestUpsert);
+        unindexRows(revisedRows);
+        store_->update(revisedRows, revisions, *context_);
+        locateRegions(revisedRows);
+        indexRows(revisedRows);
+    }
+
+    if (!inserts.empty()) {
+        buildIndexes(appendRows(inserts));
+    }
+    return stats;
+}
+
+RowId DataSet::appendRows(const std::vector<const Record*>& records) {
+    NYCOLLISION_TIME_SCOPE(IngestStore);
+    return store_->append(records, *context_);
+}
+
+namespace {
+
+RowBitmap& postingsFor(std::vector<RowBitmap>& index, StringPool::Code code) {
+    if (code >= index.size()) {
+        index.resize(static_cast<std::size_t>(code) + 1);
+    }
+    return index[code];
+}
+
+RowBitmap& postingsFor(std::map<int, RowBitmap>& index, int key) {
+    return index[key];
+}
+
+void appendPostings(std::vector<RowBitmap>& into, const std::vector<RowBitmap>& from) {
+    for (std::size_t code = 0; code < from.size(); ++code) {
+        if (!from[code].empty()) {
+            postingsFor(into, static_cast<StringPool::Code>(code)) |= from[code];
+        }
+    }
+}
+
+void appendPostings(std::map<int, RowBitmap>& into, const std::map<int, RowBitmap>& from) {
+    for (const auto& [key, rows] : from) {
+        into[key] |= rows;
     }
 }
 
-DataSet::Records DataSet::queryByGeoBoundsBruteForce(
+void removePosting(std::vector<RowBitmap>& index, StringPool::Code code, RowId row) {
+    if (code < index.size()) {
+        index[code].remove(row);
+    }
+}
+
+void removePosting(std::map<int, RowBitmap>& index, int key, RowId row) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second.remove(row);
+        if (it->second.empty()) {
+            index.erase(it);
+        }
+    }
+}
+
+/**
+ * @brief Build postings over [first, last) as one task per row partition
+ *
+ * Partition bitmaps cover disjoint, increasing row ranges, so merging them
+ * mostly appends containers.
+ *
+ * @param keysOf Called as keysOf(row, emit); calls emit(key) once per key of the row
+ */
+template <typename Index, typename KeysOf>
+void buildPostings(Index& index, RowId first, RowId last, std::size_t partitions,
+                   const ExecutionContext& context, KeysOf keysOf) {
+    std::vector<Index> parts(partitions);
+    const std::size_t rows = last - first;
+
+    context.parallelFor(partitions, 1, [&](std::size_t firstPart, std::size_t lastPart) {
+        for (std::size_t p = firstPart; p < lastPart; ++p) {
+            auto& part = parts[p];
+            RowId begin = static_cast<RowId>(first + rows * p / partitions);
+            RowId end = static_cast<RowId>(first + rows * (p + 1) / partitions);
+            for (RowId row = begin; row < end; ++row) {
+                keysOf(row, [&](auto key) { postingsFor(part, key).add(row); });
+            }
+        }
+    });
+
+    for (const auto& part : parts) {
+        appendPostings(index, part);
+    }
+}
+
+} // namespace
+
+std::size_t DataSet::indexPartitions(std::size_t rows) const {
+    return std::clamp<std::size_t>(rows / kMinPartitionRows, 1, context_->threads());
+}
+
+template <typename Visit>
+void DataSet::forEachPostingIndex(Visit&& visit) {
+    const ColumnStore& store = *store_;
+    auto code = [](auto column) {
+        return [column](RowId row, auto emit) { emit(column(row)); };
+    };
+    auto casualty = [&store](auto value) {
+        return [&store, value](RowId row, auto emit) { emit(value(store.casualtyStats(row))); };
+    };
+
+    visit(boroughIndex_, code([&store](RowId row) { return store.boroughCode(row); }));
+    visit(zipIndex_, code([&store](RowId row) { return store.zipCodeCode(row); }));
+    visit(vehicleTypeIndex_, [&store](RowId row, auto emit) {
+        const auto* vehicleTypes = store.vehicleTypeCodes(row);
+        for (std::size_t i = 0; i < ColumnStore::kVehicleSlots && vehicleTypes[i] != StringPool::kEmpty; ++i) {
+            emit(vehicleTypes[i]);
+        }
+    });
+    visit(injuryIndex_, casualty([](const CasualtyStats& stats) { return stats.getTotalInjuries(); }));
+    visit(fatalityIndex_, casualty([](const CasualtyStats& stats) { return stats.getTotalFatalities(); }));
+    visit(pedestrianFatalityIndex_, casualty([](const CasualtyStats& stats) { return stats.pedestrians_killed; }));
+    visit(cyclistFatalityIndex_, casualty([](const CasualtyStats& stats) { return stats.cyclists_killed; }));
+    visit(motoristFatalityIndex_, casualty([](const CasualtyStats& stats) { return stats.motorists_killed; }));
+    for (auto& index : regionIndexes_) {
+        visit(index.postings, [&regions = index.regions](RowId row, auto emit) {
+            if (regions[row] != RegionLayer::kNoRegion) {
+                emit(regions[row]);
+            }
+        });
+    }
+}
+
+void DataSet::buildIndexes(RowId firstRow) {
+    NYCOLLISION_TIME_SCOPE(IngestIndex);
+    // Region postings are built from the region columns
+    locateRegions(firstRow);
+    const RowId lastRow = static_cast<RowId>(store_->size());
+    const std::size_t partitions = indexPartitions(lastRow - firstRow);
+    const ExecutionContext& context = *context_;
+
+    std::vector<std::function<void()>> tasks = {
+        [&] { indexKeys(firstRow); },
+        [&] { indexDates(firstRow); },
+        [&] { updateSpatialIndex(firstRow); },
+        [&] { rollup_.add(*store_, firstRow, lastRow, context); },
+        [&] { tiles_.add(*store_, firstRow, lastRow, context); },
+    };
+    forEachPostingIndex([&](auto& index, auto keysOf) {
+        tasks.push_back([&, keysOf] { buildPostings(index, firstRow, lastRow, partitions, context, keysOf); });
+    });
+    context.parallelInvoke(tasks);
+}
+
+void DataSet::unindexRows(const std::vector<RowId>& rows) {
+    std::vector<std::function<void()>> tasks = {
+        [&] {
+            std::vector<DateIndex::Entry> removed;
+            removed.reserve(rows.size());
+            for (RowId row : rows) {
+                removed.emplace_back(store_->timestamp(row), row);
+            }
+            dates_.remove(std::move(removed));
+        },
+        [&] { removePoints(rows); },
+        [&] { rollup_.remove(*store_, rows); },
+        [&] { tiles_.remove(*store_, rows); },
+    };
+    forEachPostingIndex([&](auto& index, auto keysOf) {
+        tasks.push_back([&, keysOf] {
+            for (RowId row : rows) {
+                keysOf(row, [&](auto key) { removePosting(index, key, row); });
+            }
+        });
+    });
+    context_->parallelInvoke(tasks);
+}
+
+void DataSet::indexRows(const std::vector<RowId>& rows) {
+    std::vector<std::function<void()>> tasks = {
+        [&] {
+            std::vector<DateIndex::Entry> added;
+            added.reserve(rows.size());
+            for (RowId row : rows) {
+                added.emplace_back(store_->timestamp(row), row);
+            }
+            dates_.insert(std::move(added), *context_);
+        },
+        [&] { insertPoints(rows); },
+        [&] { rollup_.add(*store_, rows); },
+        [&] { tiles_.add(*store_, rows); },
+    };
+    forEachPostingIndex([&](auto& index, auto keysOf) {
+        tasks.push_back([&, keysOf] {
+            for (RowId row : rows) {
+                keysOf(row, [&](auto key) { postingsFor(index, key).add(row); });
+            }
+        });
+    });
+    context_->parallelInvoke(tasks);
+}
+
+void DataSet::addRegionLayer(std::shared_ptr<const RegionLayer> layer) {
+    if (regionLayer(layer->name())) {
+        throw std::runtime_error("Region layer already added: " + layer->name());
+    }
+    regionIndexes_.push_back(RegionIndex{std::move(layer), {}, {}});
+    indexRegionLayer(regionIndexes_.back());
+}
+
+std::shared_ptr<const RegionLayer> DataSet::regionLayer(const std::string& name) const {
+    for (const auto& index : regionIndexes_) {
+        if (index.layer->name() == name) {
+            return index.layer;
+        }
+    }
+    return nullptr;
+}
+
+const DataSet::RegionIndex& DataSet::regionIndex(const std::string& layer) const {
+    for (const auto& index : regionIndexes_) {
+        if (index.layer->name() == layer) {
+            return index;
+        }
+    }
+    throw std::runtime_error("Unknown region layer: " + layer);
+}
+
+const ChunkedColumn<RegionLayer::RegionId>& DataSet::regionColumn(const std::string& layer) const {
+    return regionIndex(layer).regions;
+}
+
+void DataSet::locateRegions(RowId firstRow) {
+    if (regionIndexes_.empty()) {
+        return;
+    }
+    std::vector<RowId> rows(store_->size() - firstRow);
+    std::iota(rows.begin(), rows.end(), firstRow);
+    locateRegions(rows);
+}
+
+void DataSet::locateRegions(const std::vector<RowId>& rows) {
+    NYCOLLISION_TIME_SCOPE(IngestRegions);
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    constexpr std::size_t kRowsPerTask = 1 << 12;
+    for (auto& index : regionIndexes_) {
+        // Chunks shared with other versions are copied before the parallel writes
+        auto& regions = index.regions;
+        regions.resize(store_->size(), RegionLayer::kNoRegion);
+        for (RowId row : rows) {
+            regions.prepare(row);
+        }
+        const RegionLayer& layer = *index.layer;
+        context_->parallelFor(rows.size(), kRowsPerTask, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                regions.set(rows[i], layer.regionOf(lats[rows[i]], lons[rows[i]]));
+            }
+        });
+    }
+}
+
+void DataSet::indexRegionLayer(RegionIndex& index) {
+    NYCOLLISION_TIME_SCOPE(IngestRegions);
+    const RowId rows = static_cast<RowId>(store_->size());
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    const RegionLayer& layer = *index.layer;
+    index.regions.clear();
+    index.regions.resize(rows, RegionLayer::kNoRegion);
+    index.postings.clear();
+    context_->parallelFor(rows, kMinPartitionRows / 16, [&](std::size_t first, std::size_t last) {
+        for (std::size_t row = first; row < last; ++row) {
+            index.regions.set(row, layer.regionOf(lats[row], lons[row]));
+        }
+    });
+    buildPostings(index.postings, 0, rows, indexPartitions(rows), *context_,
+                  [&regions = index.regions](RowId row, auto emit) {
+                      if (regions[row] != RegionLayer::kNoRegion) {
+                          emit(regions[row]);
+                      }
+                  });
+}
+
+void DataSet::indexKeys(RowId firstRow) {
+    // Later rows win on duplicate keys
+    std::vector<KeyIndex::Entry> entries;
+    entries.reserve(store_->size() - firstRow);
+    for (std::size_t row = firstRow; row < store_->size(); ++row) {
+        entries.push_back({store_->uniqueKey(static_cast<RowId>(row)), static_cast<RowId>(row)});
+    }
+    keyIndex_.insert(std::move(entries));
+}
+
+void DataSet::buildSpatialIndex() {
+    auto startTime = std::chrono::steady_clock::now();
+    const std::size_t partitions = std::clamp<std::size_t>(
+        store_->size() / kMinPartitionValues, 1, spatialPartitions_);
+    installSpatialIndex(packStrips(spatialValues(partitions), partitions), partitions, startTime);
+}
+
+void DataSet::updateSpatialIndex(RowId firstRow) {
+    NYCOLLISION_TIME_SCOPE(IngestSpatialIndex);
+    const std::size_t added = store_->size() - firstRow;
+    std::size_t indexed;
+    {
+        std::shared_lock lock(spatial_mutex_);
+        indexed = spatialStats_.values;
+    }
+    if (added * kRepackRatio > indexed) {
+        buildSpatialIndex();
+        return;
+    }
+    std::vector<RowId> rows(added);
+    std::iota(rows.begin(), rows.end(), firstRow);
+    insertPoints(rows);
+}
+
+namespace {
+
+// Points of a tree that are not masked out
+std::vector<PackedRTree::Entry> livePoints(const PackedRTree& tree, const RowBitmap& removed) {
+    std::vector<PackedRTree::Entry> points;
+    points.reserve(tree.size() - removed.cardinality());
+    for (const auto& entry : tree.entries()) {
+        if (!removed.contains(entry.row)) {
+            points.push_back(entry);
+        }
+    }
+    return points;
+}
+
+} // namespace
+
+void DataSet::insertPoints(const std::vector<RowId>& rows) {
+    auto startTime = std::chrono::steady_clock::now();
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    std::vector<PackedRTree::Entry> points;
+    points.reserve(rows.size());
+    for (RowId row : rows) {
+        points.push_back({lats[row], lons[row], row});
+    }
+    auto tree = std::make_shared<const PackedRTree>(PackedRTree::pack(std::move(points), *context_));
+
+    std::unique_lock lock(spatial_mutex_);
+    segments_.push_back(SpatialSegment{std::move(tree), {}});
+    // Merge delta trees while the older is at most twice the newer, so there are O(log n) of them
+    while (segments_.size() > strips_ + 1) {
+        SpatialSegment& newer = segments_.back();
+        SpatialSegment& older = segments_[segments_.size() - 2];
+        if (older.tree->size() > 2 * newer.tree->size()) {
+            break;
+        }
+        points = livePoints(*older.tree, older.removed);
+        const auto newerPoints = livePoints(*newer.tree, newer.removed);
+        points.insert(points.end(), newerPoints.begin(), newerPoints.end());
+        older = SpatialSegment{std::make_shared<const PackedRTree>(PackedRTree::pack(std::move(points), *context_)),
+                               {}};
+        segments_.pop_back();
+    }
+
+    std::size_t packed = 0;
+    std::size_t masked = 0;
+    for (std::size_t s = 0; s < segments_.size(); ++s) {
+        (s < strips_ ? packed : masked) += segments_[s].tree->size();
+        masked += segments_[s].removed.cardinality();
+    }
+    if (masked * kRepackRatio > packed) {
+        lock.unlock();
+        buildSpatialIndex();
+        return;
+    }
+    spatialStats_ = statistics();
+    spatialStats_.build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void DataSet::removePoints(const std::vector<RowId>& rows) {
+    auto startTime = std::chrono::steady_clock::now();
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    std::unique_lock lock(spatial_mutex_);
+    for (RowId row : rows) {
+        // A row revised before lives in a newer tree than the one it was first packed into
+        const PackedRTree::Entry point{lats[row], lons[row], row};
+        for (auto segment = segments_.rbegin(); segment != segments_.rend(); ++segment) {
+            if (!segment->removed.contains(row) && segment->tree->contains(point)) {
+                segment->removed.add(row);
+                break;
+            }
+        }
+    }
+    spatialStats_ = statistics();
+    spatialStats_.build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+std::vector<PackedRTree::Entry> DataSet::spatialValues(std::size_t partitions) const {
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    std::vector<PackedRTree::Entry> values(lats.size());
+    context_->parallelFor(values.size(), kMinPartitionRows, [&](std::size_t first, std::size_t last) {
+        for (std::size_t row = first; row < last; ++row) {
+            values[row] = {lats[row], lons[row], static_cast<RowId>(row)};
+        }
+    });
+
+    if (partitions > 1) {
+        // Cut into latitude strips so each tree covers its own region
+        auto bound = [&](std::size_t p) { return values.begin() + values.size() * p / partitions; };
+        auto byLatitude = [](const PackedRTree::Entry& a, const PackedRTree::Entry& b) {
+            return a.latitude < b.latitude;
+        };
+        for (std::size_t p = 1; p < partitions; ++p) {
+            std::nth_element(bound(p - 1), bound(p), values.end(), byLatitude);
+        }
+    }
+    return values;
+}
+
+std::vector<DataSet::SpatialSegment> DataSet::packStrips(const std::vector<PackedRTree::Entry>& values,
+                                                          std::size_t partitions) const {
+    auto bound = [&](std::size_t p) { return values.begin() + values.size() * p / partitions; };
+    std::vector<SpatialSegment> strips(partitions);
+    context_->parallelFor(partitions, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t p = first; p < last; ++p) {
+            strips[p].tree = std::make_shared<const PackedRTree>(
+                PackedRTree::pack(std::vector<PackedRTree::Entry>(bound(p), bound(p + 1)), *context_));
+        }
+    });
+    return strips;
+}
+
+void DataSet::installSpatialIndex(std::vector<SpatialSegment> segments, std::size_t strips,
+                                  std::chrono::steady_clock::time_point startTime) {
+    std::unique_lock lock(spatial_mutex_);
+    segments_ = std::move(segments);
+    strips_ = strips;
+    spatialStats_ = statistics();
+    spatialStats_.build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+DataSet::SpatialIndexStats DataSet::statistics() const {
+    SpatialIndexStats stats;
+    stats.partitions = segments_.size();
+    for (const auto& segment : segments_) {
+        stats.values += segment.tree->size() - segment.removed.cardinality();
+        if (segment.tree->empty()) {
+            continue;
+        }
+        const PackedRTree::Shape shape = segment.tree->shape();
+        stats.levels = std::max(stats.levels, shape.levels);
+        stats.internal_nodes += shape.internalNodes;
+        stats.leaves += shape.leaves;
+        stats.min_leaf_values =
+            stats.min_leaf_values ? std::min(stats.min_leaf_values, shape.minLeafEntries) : shape.minLeafEntries;
+        stats.max_leaf_values = std::max(stats.max_leaf_values, shape.maxLeafEntries);
+    }
+    return stats;
+}
+
+template <typename Visit>
+bool DataSet::visitPoints(const PackedRTree::Bounds& box, Visit&& visit) const {
+    for (const auto& segment : segments_) {
+        const RowBitmap& removed = segment.removed;
+        const bool complete = segment.tree->query(box, [&](const PackedRTree::Entry& entry) {
+            return removed.contains(entry.row) || visit(entry);
+        });
+        if (!complete) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DataSet::indexDates(RowId firstRow) {
+    const auto& timestamps = store_->timestamps();
+    std::vector<DateIndex::Entry> added;
+    added.reserve(timestamps.size() - firstRow);
+    for (std::size_t row = firstRow; row < timestamps.size(); ++row) {
+        added.emplace_back(timestamps[row], static_cast<RowId>(row));
+    }
+    dates_.insert(std::move(added), *context_);
+}
+
+const RowBitmap* DataSet::findPostings(
+    const CodeIndex& index, StringDomain domain, const std::string& value
+) const {
+    // Resolve the string to its code once; unknown strings cannot match
+    auto code = store_->pool()->find(domain, value);
+    if (code == StringPool::kNotFound || code >= index.size() || index[code].empty()) {
+        return nullptr;
+    }
+    return &index[code];
+}
+
+DataSet::RecordPtr DataSet::makeRecordPtr(RowId row) const {
+    // The view and a reference to the store share one allocation
+    struct PinnedView {
+        PinnedView(std::shared_ptr<const ColumnStore> owner, RowId row)
+            : store(std::move(owner)), view(*store, row) {}
+        std::shared_ptr<const ColumnStore> store;
+        RecordView view;
+    };
+    auto pinned = std::make_shared<PinnedView>(store_, row);
+    return RecordPtr(pinned, &pinned->view);
+}
+
+RowSet DataSet::borrowRows(std::vector<RowSpan> spans) const {
+    return RowSet(store_, weak_from_this().lock(), std::move(spans));
+}
+
+RowSet DataSet::borrowRows(const std::vector<const RowBitmap*>& bitmaps) const {
+    return RowSet(store_, weak_from_this().lock(), bitmaps);
+}
+
+RowSet DataSet::ownRows(std::vector<RowId> rows) const {
+    return RowSet(store_, std::move(rows));
+}
+
+RowSet DataSet::rowsInCountRange(const CountIndex& index, int minCount, int maxCount) const {
+    if (minCount > maxCount) {
+        return RowSet(store_);
+    }
+    // One bitmap per distinct count, in ascending count order
+    std::vector<const RowBitmap*> bitmaps;
+    auto last = index.upper_bound(maxCount);
+    for (auto it = index.lower_bound(minCount); it != last; ++it) {
+        bitmaps.push_back(&it->second);
+    }
+    return borrowRows(bitmaps);
+}
+
+DataSet::Records DataSet::toRecords(const RowSet& rows) const {
+    NYCOLLISION_TIME_SCOPE(MaterializeRecords);
+    NYCOLLISION_COUNT(MaterializedRecords, rows.size());
+    Records result(rows.size());
+    std::size_t offset = 0;
+    rows.forEachBlock([&](const RowId* block, std::size_t count) {
+        // Small blocks are filled inline; a parallel region costs more than they do
+        constexpr std::size_t kRowsPerTask = 1 << 12;
+        RecordPtr* out = result.data() + offset;
+        context_->parallelFor(count, kRowsPerTask, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                out[i] = makeRecordPtr(block[i]);
+            }
+        });
+        offset += count;
+        return true;
+    });
+    return result;
+}
+
+CasualtyAggregate DataSet::aggregate(const RowSet& rows) const {
+    NYCOLLISION_TIME_SCOPE(QueryAggregate);
+    constexpr std::size_t kRowsPerTask = 1 << 12;
+    CasualtyAggregate result;
+    rows.forEachBlock([&](const RowId* block, std::size_t count) {
+        const bool consecutive =
+            std::adjacent_find(block, block + count, [](RowId a, RowId b) { return b != a + 1; }) ==
+            block + count;
+        const std::size_t tasks = (count + kRowsPerTask - 1) / kRowsPerTask;
+        std::vector<CasualtyAggregate> partial(tasks);
+        context_->parallelFor(tasks, 1, [&](std::size_t firstTask, std::size_t lastTask) {
+            for (std::size_t t = firstTask; t < lastTask; ++t) {
+                const std::size_t first = t * kRowsPerTask;
+                const std::size_t n = std::min(kRowsPerTask, count - first);
+                if (consecutive) {
+                    partial[t].addRange(*store_, block[first], static_cast<RowId>(block[first] + n));
+                } else {
+                    partial[t].addRows(*store_, block + first, n);
+                }
+            }
+        });
+        for (const auto& part : partial) {
+            result += part;
+        }
+        return true;
+    });
+    return result;
+}
+
+RowSet DataSet::rowsByGeoBounds(float minLat, float maxLat, float minLon, float maxLon) const {
+    NYCOLLISION_TIME_SCOPE(QueryGeoBounds);
+    return rowsByGeoBoundsRTree(minLat, maxLat, minLon, maxLon);
+}
+
+RowSet DataSet::rowsByGeoBoundsBruteForce(
     float minLat, float maxLat,
     float minLon, float maxLon
 ) const {
-    std::vector<std::shared_ptr<Record>> result;
+    std::vector<RowId> result;
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
     
-    for (const auto& record : records_) {
-        auto loc = record->getLocation();
-        if (loc.latitude >= minLat && loc.latitude <= maxLat &&
-            loc.longitude >= minLon && loc.longitude <= maxLon) {
-            result.push_back(record);
+    for (std::size_t row = 0; row < lats.size(); ++row) {
+        if (lats[row] >= minLat && lats[row] <= maxLat &&
+            lons[row] >= minLon && lons[row] <= maxLon) {
+            result.push_back(static_cast<RowId>(row));
         }
     }
     
-    return convertToInterfaceRecords(result);
+    return ownRows(std::move(result));
 }
 
-DataSet::Records DataSet::queryByGeoBoundsRTree(
+RowSet DataSet::rowsByGeoBoundsRTree(
     float minLat, float maxLat,
     float minLon, float maxLon
 ) const {
-    std::vector<std::shared_ptr<Record>> result;
+    std::vector<RowId> result;
     
     // Create bounding box for query
-    Point min_point(minLat, minLon);
-    Point max_point(maxLat, maxLon);
-    Box query_box(min_point, max_point);
+    const PackedRTree::Bounds query_box{minLat, minLon, maxLat, maxLon};
     
-    // Query R-tree with thread safety
+    // Query every tree with thread safety
     {
         std::shared_lock lock(spatial_mutex_);
-        
-        // Perform spatial query
-        std::vector<Value> found_values;
-        rtree_.query(bgi::intersects(query_box), std::back_inserter(found_values));
-        
-        // Extract records from query results
-        result.reserve(found_values.size());
-        for (const auto& value : found_values) {
-            result.push_back(value.second);
-        }
+        visitPoints(query_box, [&result](const PackedRTree::Entry& entry) {
+            result.push_back(entry.row);
+            return true;
+        });
     }
     
-    return convertToInterfaceRecords(result);
+    return ownRows(std::move(result));
+}
+
+std::size_t DataSet::visitByGeoBounds(
+    float minLat, float maxLat,
+    float minLon, float maxLon,
+    const RecordVisitor& visitor, ScanOptions options
+) const {
+    const PackedRTree::Bounds query_box{minLat, minLon, maxLat, maxLon};
+    std::size_t skip = options.offset;
+    std::size_t visited = 0;
+
+    std::shared_lock lock(spatial_mutex_);
+    visitPoints(query_box, [&](const PackedRTree::Entry& entry) {
+        if (skip > 0) {
+            --skip;
+            return true;
+        }
+        if (visited == options.limit) {
+            return false;
+        }
+        ++visited;
+        return visitor(RecordView(*store_, entry.row));
+    });
+    return visited;
+}
+
+namespace {
+
+// Nearest first, equal distances in row order; keeps at most limit
+void sortByDistance(std::vector<DataSet::Neighbor>& neighbors,
+                    std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+    auto nearer = [](const DataSet::Neighbor& a, const DataSet::Neighbor& b) {
+        return a.meters < b.meters || (a.meters == b.meters && a.row < b.row);
+    };
+    if (limit < neighbors.size()) {
+        std::partial_sort(neighbors.begin(), neighbors.begin() + limit, neighbors.end(), nearer);
+        neighbors.resize(limit);
+    } else {
+        std::sort(neighbors.begin(), neighbors.end(), nearer);
+    }
+}
+
+std::vector<RowId> rowsOf(const std::vector<DataSet::Neighbor>& neighbors) {
+    std::vector<RowId> rows;
+    rows.reserve(neighbors.size());
+    for (const auto& neighbor : neighbors) {
+        rows.push_back(neighbor.row);
+    }
+    return rows;
+}
+
+} // namespace
+
+void DataSet::collectWithin(float latitude, float longitude, double meters, std::vector<Neighbor>& out) const {
+    // Padded so rounding the box to float cannot cut off a stored point;
+    // collisions lie far from the antimeridian, so longitudes do not wrap
+    constexpr double kPadDegrees = 1e-5;
+    const DegreeExtent extent = degreeExtent(latitude, meters);
+    const double lonDegrees = extent.lonDegrees >= 180.0 ? 360.0 : extent.lonDegrees + kPadDegrees;
+    const PackedRTree::Bounds box{static_cast<float>(latitude - extent.latDegrees - kPadDegrees),
+                                  static_cast<float>(longitude - lonDegrees),
+                                  static_cast<float>(latitude + extent.latDegrees + kPadDegrees),
+                                  static_cast<float>(longitude + lonDegrees)};
+
+    visitPoints(box, [&](const PackedRTree::Entry& entry) {
+        const double distance = distanceMeters(latitude, longitude, entry.latitude, entry.longitude);
+        if (distance <= meters) {
+            out.push_back({entry.row, distance});
+        }
+        return true;
+    });
+}
+
+std::vector<DataSet::Neighbor> DataSet::neighbors(float latitude, float longitude, std::size_t k) const {
+    NYCOLLISION_TIME_SCOPE(QueryNearest);
+    std::vector<Neighbor> result;
+    if (k == 0) {
+        return result;
+    }
+
+    std::shared_lock lock(spatial_mutex_);
+    // k candidates lie within the k-th smallest candidate distance, so the
+    // true k nearest do too
+    std::vector<double> bounds;
+    for (const auto& segment : segments_) {
+        const RowBitmap& removed = segment.removed;
+        auto live = [&removed](const PackedRTree::Entry& entry) { return !removed.contains(entry.row); };
+        for (const auto& entry : segment.tree->nearest(latitude, longitude, k, live)) {
+            bounds.push_back(distanceMeters(latitude, longitude, entry.latitude, entry.longitude));
+        }
+    }
+    if (bounds.empty()) {
+        return result;
+    }
+    const auto kth = bounds.begin() + (std::min(k, bounds.size()) - 1);
+    std::nth_element(bounds.begin(), kth, bounds.end());
+
+    collectWithin(latitude, longitude, *kth, result);
+    sortByDistance(result, k);
+    return result;
+}
+
+std::vector<DataSet::Neighbor> DataSet::neighborsWithin(float latitude, float longitude, double meters) const {
+    NYCOLLISION_TIME_SCOPE(QueryRadius);
+    std::vector<Neighbor> result;
+    if (!(meters >= 0.0)) {
+        return result;
+    }
+    {
+        std::shared_lock lock(spatial_mutex_);
+        collectWithin(latitude, longitude, meters, result);
+    }
+    sortByDistance(result);
+    return result;
+}
+
+std::vector<DataSet::Neighbor> DataSet::neighborsBruteForce(float latitude, float longitude, std::size_t k) const {
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    std::vector<Neighbor> result;
+    result.reserve(lats.size());
+    for (std::size_t row = 0; row < lats.size(); ++row) {
+        result.push_back({static_cast<RowId>(row), distanceMeters(latitude, longitude, lats[row], lons[row])});
+    }
+    sortByDistance(result, k);
+    return result;
+}
+
+std::vector<DataSet::Neighbor> DataSet::neighborsWithinBruteForce(
+    float latitude, float longitude, double meters
+) const {
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    std::vector<Neighbor> result;
+    for (std::size_t row = 0; row < lats.size(); ++row) {
+        const double distance = distanceMeters(latitude, longitude, lats[row], lons[row]);
+        if (distance <= meters) {
+            result.push_back({static_cast<RowId>(row), distance});
+        }
+    }
+    sortByDistance(result);
+    return result;
+}
+
+RowSet DataSet::rowsNearest(float latitude, float longitude, std::size_t k) const {
+    return ownRows(rowsOf(neighbors(latitude, longitude, k)));
+}
+
+RowSet DataSet::rowsByRadius(float latitude, float longitude, double meters) const {
+    return ownRows(rowsOf(neighborsWithin(latitude, longitude, meters)));
 }
 
 DataSet::QueryStats DataSet::benchmarkQuery(
@@ -91,7 +953,7 @@ DataSet::QueryStats DataSet::benchmarkQuery(
     // Benchmark brute force method
     {
         auto start = std::chrono::high_resolution_clock::now();
-        auto results = queryByGeoBoundsBruteForce(minLat, maxLat, minLon, maxLon);
+        auto results = rowsByGeoBoundsBruteForce(minLat, maxLat, minLon, maxLon);
         auto end = std::chrono::high_resolution_clock::now();
         
         std::chrono::duration<double> elapsed = end - start;
@@ -102,7 +964,7 @@ DataSet::QueryStats DataSet::benchmarkQuery(
     // Benchmark R-tree method
     {
         auto start = std::chrono::high_resolution_clock::now();
-        auto results = queryByGeoBoundsRTree(minLat, maxLat, minLon, maxLon);
+        auto results = rowsByGeoBoundsRTree(minLat, maxLat, minLon, maxLon);
         auto end = std::chrono::high_resolution_clock::now();
         
         std::chrono::duration<double> elapsed = end - start;
@@ -119,102 +981,725 @@ DataSet::QueryStats DataSet::benchmarkQuery(
     return stats;
 }
 
-DataSet::Records DataSet::queryByBorough(const std::string& borough) const {
-    auto it = boroughIndex_.find(borough);
-    return it != boroughIndex_.end() ? convertToInterfaceRecords(it->second) : Records{};
+RowSet DataSet::rowsByBorough(const std::string& borough) const {
+    NYCOLLISION_TIME_SCOPE(QueryBorough);
+    const auto* rows = findPostings(boroughIndex_, StringDomain::Borough, borough);
+    return rows ? borrowRows({rows}) : RowSet(store_);
 }
 
-DataSet::Records DataSet::queryByZipCode(const std::string& zipCode) const {
-    auto it = zipIndex_.find(zipCode);
-    return it != zipIndex_.end() ? convertToInterfaceRecords(it->second) : Records{};
+RowSet DataSet::rowsByZipCode(const std::string& zipCode) const {
+    NYCOLLISION_TIME_SCOPE(QueryZipCode);
+    const auto* rows = findPostings(zipIndex_, StringDomain::ZipCode, zipCode);
+    return rows ? borrowRows({rows}) : RowSet(store_);
 }
 
-DataSet::Records DataSet::queryByDateRange(const Date& start, const Date& end) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = dateIndex_.lower_bound(start);
-    auto endIt = dateIndex_.upper_bound(end);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+RowSet DataSet::rowsByDateRange(Timestamp start, Timestamp end) const {
+    NYCOLLISION_TIME_SCOPE(QueryDateRange);
+    if (start > end) {
+        return RowSet(store_);
     }
-    return convertToInterfaceRecords(result);
+    // Matching rows are one contiguous slice of the date order, a span per block
+    return borrowRows(dates_.range(start, end));
 }
 
-DataSet::Records DataSet::queryByVehicleType(const std::string& vehicleType) const {
-    auto it = vehicleTypeIndex_.find(vehicleType);
-    return it != vehicleTypeIndex_.end() ? convertToInterfaceRecords(it->second) : Records{};
+RowSet DataSet::rowsByVehicleType(const std::string& vehicleType) const {
+    NYCOLLISION_TIME_SCOPE(QueryVehicleType);
+    const auto* rows = findPostings(vehicleTypeIndex_, StringDomain::VehicleType, vehicleType);
+    return rows ? borrowRows({rows}) : RowSet(store_);
 }
 
-DataSet::Records DataSet::queryByInjuryRange(int minInjuries, int maxInjuries) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = injuryIndex_.lower_bound(minInjuries);
-    auto endIt = injuryIndex_.upper_bound(maxInjuries);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+RowSet DataSet::rowsByInjuryRange(int minInjuries, int maxInjuries) const {
+    NYCOLLISION_TIME_SCOPE(QueryInjuryRange);
+    return rowsInCountRange(injuryIndex_, minInjuries, maxInjuries);
+}
+
+RowSet DataSet::rowsByFatalityRange(int minFatalities, int maxFatalities) const {
+    NYCOLLISION_TIME_SCOPE(QueryFatalityRange);
+    return rowsInCountRange(fatalityIndex_, minFatalities, maxFatalities);
+}
+
+DataSet::RecordPtr DataSet::queryByUniqueKey(int key) const {
+    NYCOLLISION_TIME_SCOPE(QueryUniqueKey);
+    RowId row;
+    return keyIndex_.find(key, row) ? makeRecordPtr(row) : nullptr;
+}
+
+RowSet DataSet::rowsByRegion(const std::string& layer, const std::string& region) const {
+    NYCOLLISION_TIME_SCOPE(QueryRegion);
+    const RegionIndex& index = regionIndex(layer);
+    const auto id = index.layer->find(region);
+    if (id >= index.postings.size() || index.postings[id].empty()) {
+        return RowSet(store_);
     }
-    return convertToInterfaceRecords(result);
+    return borrowRows({&index.postings[id]});
 }
 
-DataSet::Records DataSet::queryByFatalityRange(int minFatalities, int maxFatalities) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = fatalityIndex_.lower_bound(minFatalities);
-    auto endIt = fatalityIndex_.upper_bound(maxFatalities);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+RowSet DataSet::rowsInArea(RegionLayer::MultiPolygon area) const {
+    NYCOLLISION_TIME_SCOPE(QueryPolygon);
+    std::vector<RowId> result;
+    if (area.empty()) {
+        return ownRows(std::move(result));
     }
-    return convertToInterfaceRecords(result);
+    bg::correct(area);
+
+    // Padded so rounding the bounds to float cannot cut off a stored point
+    constexpr double kPadDegrees = 1e-5;
+    const auto bounds = bg::return_envelope<RegionLayer::Box>(area);
+    const PackedRTree::Bounds box{static_cast<float>(bounds.min_corner().y() - kPadDegrees),
+                                  static_cast<float>(bounds.min_corner().x() - kPadDegrees),
+                                  static_cast<float>(bounds.max_corner().y() + kPadDegrees),
+                                  static_cast<float>(bounds.max_corner().x() + kPadDegrees)};
+    {
+        std::shared_lock lock(spatial_mutex_);
+        visitPoints(box, [&](const PackedRTree::Entry& entry) {
+            if (bg::covered_by(RegionLayer::Point(entry.longitude, entry.latitude), area)) {
+                result.push_back(entry.row);
+            }
+            return true;
+        });
+    }
+    std::sort(result.begin(), result.end());
+    return ownRows(std::move(result));
 }
 
-DataSet::RecordPtr DataSet::queryByUniqueKey(int key) const {
-    auto it = keyIndex_.find(key);
-    return it != keyIndex_.end() ? std::static_pointer_cast<const IRecord>(it->second) : nullptr;
+std::vector<HeatmapCell> DataSet::heatmap(float minLat, float maxLat, float minLon, float maxLon, double cellMeters,
+                                          const Query& filter) const {
+    if (!(cellMeters > 0.0)) {
+        throw std::runtime_error("Heatmap cell size must be positive");
+    }
+    NYCOLLISION_TIME_SCOPE(QueryHeatmap);
+    std::vector<HeatmapCell> result;
+    if (!(minLat <= maxLat && minLon <= maxLon)) {
+        return result;
+    }
+    Query scoped = filter;
+    const RowSet rows = rowsMatching(scoped.inArea(minLat, maxLat, minLon, maxLon));
+
+    const double cellLat = cellMeters / (kEarthRadiusMeters * kRadiansPerDegree);
+    const double cosLat = std::cos((static_cast<double>(minLat) + maxLat) / 2 * kRadiansPerDegree);
+    const double cellLon = cellLat / std::max(cosLat, 1e-9);
+    const auto columns = static_cast<std::uint32_t>(
+        std::clamp(std::ceil((static_cast<double>(maxLon) - minLon) / cellLon), 1.0, 4294967295.0));
+    const auto lines = static_cast<std::uint32_t>(
+        std::clamp(std::ceil((static_cast<double>(maxLat) - minLat) / cellLat), 1.0, 4294967295.0));
+
+    // Cell x in the high 32 bits, y in the low
+    using Cells = std::unordered_map<std::uint64_t, CasualtyTotals>;
+    const auto& lats = store_->latitudes();
+    const auto& lons = store_->longitudes();
+    auto cellOf = [&](RowId row) {
+        const auto x = static_cast<std::uint32_t>(
+            std::min<double>(std::floor((static_cast<double>(lons[row]) - minLon) / cellLon), columns - 1));
+        const auto y = static_cast<std::uint32_t>(
+            std::min<double>(std::floor((static_cast<double>(lats[row]) - minLat) / cellLat), lines - 1));
+        return std::uint64_t{x} << 32 | y;
+    };
+
+    constexpr std::size_t kRowsPerTask = 1 << 12;
+    Cells cells;
+    rows.forEachBlock([&](const RowId* block, std::size_t count) {
+        const std::size_t tasks = (count + kRowsPerTask - 1) / kRowsPerTask;
+        std::vector<Cells> partial(tasks);
+        context_->parallelFor(tasks, 1, [&](std::size_t firstTask, std::size_t lastTask) {
+            for (std::size_t t = firstTask; t < lastTask; ++t) {
+                const std::size_t last = std::min(count, (t + 1) * kRowsPerTask);
+                for (std::size_t i = t * kRowsPerTask; i < last; ++i) {
+                    partial[t][cellOf(block[i])].add(*store_, block[i]);
+                }
+            }
+        });
+        for (const auto& part : partial) {
+            for (const auto& [key, totals] : part) {
+                cells[key] += totals;
+            }
+        }
+        return true;
+    });
+
+    result.reserve(cells.size());
+    for (const auto& [key, totals] : cells) {
+        HeatmapCell cell;
+        cell.x = static_cast<std::uint32_t>(key >> 32);
+        cell.y = static_cast<std::uint32_t>(key);
+        cell.minLat = minLat + cell.y * cellLat;
+        cell.maxLat = std::min<double>(maxLat, cell.minLat + cellLat);
+        cell.minLon = minLon + cell.x * cellLon;
+        cell.maxLon = std::min<double>(maxLon, cell.minLon + cellLon);
+        cell.totals = totals;
+        result.push_back(cell);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const HeatmapCell& a, const HeatmapCell& b) { return std::tie(a.y, a.x) < std::tie(b.y, b.x); });
+    return result;
 }
 
-DataSet::Records DataSet::queryByPedestrianFatalities(int minFatalities, int maxFatalities) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = pedestrianFatalityIndex_.lower_bound(minFatalities);
-    auto endIt = pedestrianFatalityIndex_.upper_bound(maxFatalities);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+std::vector<HeatmapCell> DataSet::heatmapTiles(float minLat, float maxLat, float minLon, float maxLon,
+                                               int level) const {
+    NYCOLLISION_TIME_SCOPE(QueryHeatmap);
+    return tiles_.cells(minLat, maxLat, minLon, maxLon, level);
+}
+
+SpatialClustering DataSet::clusters(double epsMeters, std::size_t minPoints, const Query& filter) const {
+    NYCOLLISION_TIME_SCOPE(QueryClusters);
+    return SpatialClustering::dbscan(*store_, rowsMatching(filter).toVector(), epsMeters, minPoints, *context_);
+}
+
+RowSet DataSet::rowsByPedestrianFatalities(int minFatalities, int maxFatalities) const {
+    NYCOLLISION_TIME_SCOPE(QueryPedestrianFatalities);
+    return rowsInCountRange(pedestrianFatalityIndex_, minFatalities, maxFatalities);
+}
+
+RowSet DataSet::rowsByCyclistFatalities(int minFatalities, int maxFatalities) const {
+    NYCOLLISION_TIME_SCOPE(QueryCyclistFatalities);
+    return rowsInCountRange(cyclistFatalityIndex_, minFatalities, maxFatalities);
+}
+
+RowSet DataSet::rowsByMotoristFatalities(int minFatalities, int maxFatalities) const {
+    NYCOLLISION_TIME_SCOPE(QueryMotoristFatalities);
+    return rowsInCountRange(motoristFatalityIndex_, minFatalities, maxFatalities);
+}
+
+std::size_t DataSet::estimateRows(const Query::Predicate& predicate) const {
+    using Field = Query::Field;
+    switch (predicate.field) {
+    case Field::GeoBounds: {
+        // Assume points are spread evenly over the bounds of each tree
+        const PackedRTree::Bounds query_box{predicate.minLat, predicate.minLon, predicate.maxLat, predicate.maxLon};
+        auto area = [](const PackedRTree::Bounds& box) {
+            return (static_cast<double>(box.maxLat) - box.minLat) * (static_cast<double>(box.maxLon) - box.minLon);
+        };
+        double estimate = 0.0;
+        bool touches = false;
+        std::shared_lock lock(spatial_mutex_);
+        for (const auto& segment : segments_) {
+            const PackedRTree& tree = *segment.tree;
+            const PackedRTree::Bounds bounds = tree.bounds();
+            const PackedRTree::Bounds overlap{std::max(bounds.minLat, query_box.minLat),
+                                              std::max(bounds.minLon, query_box.minLon),
+                                              std::min(bounds.maxLat, query_box.maxLat),
+                                              std::min(bounds.maxLon, query_box.maxLon)};
+            if (tree.empty() || !(overlap.minLat <= overlap.maxLat && overlap.minLon <= overlap.maxLon)) {
+                continue;
+            }
+            touches = true;
+            const double live = static_cast<double>(tree.size() - segment.removed.cardinality());
+            estimate += area(bounds) > 0.0 ? live * area(overlap) / area(bounds) : live;
+        }
+        // A box overlapping the bounds only along an edge can still hit points,
+        // so only a disjoint box is estimated as empty
+        return std::max<std::size_t>(static_cast<std::size_t>(estimate), touches ? 1 : 0);
+    }
+    default:
+        // Exact: posting cardinalities and the date order give the count directly
+        return rowsFor(predicate).size();
     }
-    return convertToInterfaceRecords(result);
 }
 
-DataSet::Records DataSet::queryByCyclistFatalities(int minFatalities, int maxFatalities) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = cyclistFatalityIndex_.lower_bound(minFatalities);
-    auto endIt = cyclistFatalityIndex_.upper_bound(maxFatalities);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+bool DataSet::hasBitmapIndex(Query::Field field) {
+    return field != Query::Field::GeoBounds && field != Query::Field::DateRange;
+}
+
+RowSet DataSet::rowsFor(const Query::Predicate& predicate) const {
+    // Range bounds outside int clamp to the int range; the indexes hold no such keys
+    auto count = [](std::int64_t value) {
+        return static_cast<int>(std::clamp<std::int64_t>(value, std::numeric_limits<int>::min(),
+                                                         std::numeric_limits<int>::max()));
+    };
+    auto timestamp = [](std::int64_t value) {
+        return static_cast<Timestamp>(std::clamp<std::int64_t>(value, std::numeric_limits<Timestamp>::min(),
+                                                               std::numeric_limits<Timestamp>::max()));
+    };
+    const auto& p = predicate;
+    switch (p.field) {
+    case Query::Field::GeoBounds: return rowsByGeoBounds(p.minLat, p.maxLat, p.minLon, p.maxLon);
+    case Query::Field::Borough: return rowsByBorough(p.value);
+    case Query::Field::ZipCode: return rowsByZipCode(p.value);
+    case Query::Field::DateRange: return rowsByDateRange(timestamp(p.min), timestamp(p.max));
+    case Query::Field::VehicleType: return rowsByVehicleType(p.value);
+    case Query::Field::Injuries: return rowsByInjuryRange(count(p.min), count(p.max));
+    case Query::Field::Fatalities: return rowsByFatalityRange(count(p.min), count(p.max));
+    case Query::Field::PedestrianFatalities: return rowsByPedestrianFatalities(count(p.min), count(p.max));
+    case Query::Field::CyclistFatalities: return rowsByCyclistFatalities(count(p.min), count(p.max));
+    case Query::Field::MotoristFatalities: return rowsByMotoristFatalities(count(p.min), count(p.max));
+    case Query::Field::Region: return rowsByRegion(p.layer, p.value);
     }
-    return convertToInterfaceRecords(result);
+    return RowSet(store_);
 }
 
-DataSet::Records DataSet::queryByMotoristFatalities(int minFatalities, int maxFatalities) const {
-    std::vector<std::shared_ptr<Record>> result;
-    auto startIt = motoristFatalityIndex_.lower_bound(minFatalities);
-    auto endIt = motoristFatalityIndex_.upper_bound(maxFatalities);
-    
-    for (auto it = startIt; it != endIt; ++it) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+std::function<bool(RowId)> DataSet::matcherFor(const Query::Predicate& predicate) const {
+    const ColumnStore& store = *store_;
+    const std::int64_t min = predicate.min;
+    const std::int64_t max = predicate.max;
+    auto sumOf = [&store, min, max](std::initializer_list<CasualtyField> fields) {
+        std::vector<const ColumnStore::Column<ColumnStore::Count>*> columns;
+        for (CasualtyField field : fields) {
+            columns.push_back(&store.casualties(field));
+        }
+        return [columns, min, max](RowId row) {
+            std::int64_t total = 0;
+            for (const auto* column : columns) {
+                total += (*column)[row];
+            }
+            return total >= min && total <= max;
+        };
+    };
+    auto code = [&store](StringDomain domain, const std::string& value) { return store.pool()->find(domain, value); };
+
+    switch (predicate.field) {
+    case Query::Field::GeoBounds: {
+        const auto& lats = store.latitudes();
+        const auto& lons = store.longitudes();
+        const auto& p = predicate;
+        return [&lats, &lons, minLat = p.minLat, maxLat = p.maxLat, minLon = p.minLon, maxLon = p.maxLon](RowId row) {
+            return lats[row] >= minLat && lats[row] <= maxLat && lons[row] >= minLon && lons[row] <= maxLon;
+        };
+    }
+    case Query::Field::Borough:
+        return [&store, wanted = code(StringDomain::Borough, predicate.value)](RowId row) {
+            return store.boroughCode(row) == wanted;
+        };
+    case Query::Field::ZipCode:
+        return [&store, wanted = code(StringDomain::ZipCode, predicate.value)](RowId row) {
+            return store.zipCodeCode(row) == wanted;
+        };
+    case Query::Field::DateRange: {
+        const auto& timestamps = store.timestamps();
+        return [&timestamps, min, max](RowId row) { return timestamps[row] >= min && timestamps[row] <= max; };
     }
-    return convertToInterfaceRecords(result);
+    case Query::Field::VehicleType:
+        return [&store, wanted = code(StringDomain::VehicleType, predicate.value)](RowId row) {
+            const auto* types = store.vehicleTypeCodes(row);
+            return std::find(types, types + ColumnStore::kVehicleSlots, wanted) != types + ColumnStore::kVehicleSlots;
+        };
+    case Query::Field::Injuries:
+        return sumOf({CasualtyField::PersonsInjured, CasualtyField::PedestriansInjured,
+                      CasualtyField::CyclistsInjured, CasualtyField::MotoristsInjured});
+    case Query::Field::Fatalities:
+        return sumOf({CasualtyField::PersonsKilled, CasualtyField::PedestriansKilled,
+                      CasualtyField::CyclistsKilled, CasualtyField::MotoristsKilled});
+    case Query::Field::PedestrianFatalities: return sumOf({CasualtyField::PedestriansKilled});
+    case Query::Field::CyclistFatalities: return sumOf({CasualtyField::CyclistsKilled});
+    case Query::Field::MotoristFatalities: return sumOf({CasualtyField::MotoristsKilled});
+    case Query::Field::Region: {
+        const RegionIndex& index = regionIndex(predicate.layer);
+        return [&regions = index.regions, wanted = index.layer->find(predicate.value)](RowId row) {
+            return wanted != RegionLayer::kNoRegion && regions[row] == wanted;
+        };
+    }
+    }
+    return [](RowId) { return false; };
 }
 
+QueryPlan DataSet::plan(const Query& query) const {
+    QueryPlan plan;
+    const auto& predicates = query.predicates();
+    const std::size_t rows = size();
+    if (predicates.empty()) {
+        plan.estimated_rows = rows;
+        return plan;
+    }
 
+    for (std::size_t i = 0; i < predicates.size(); ++i) {
+        plan.steps.push_back({i, QueryPlan::Access::Filter, estimateRows(predicates[i])});
+    }
+    std::stable_sort(plan.steps.begin(), plan.steps.end(), [](const auto& a, const auto& b) {
+        return a.estimated_rows < b.estimated_rows;
+    });
 
+    // The most selective predicate drives; an exact zero ends the query
+    auto& driver = plan.steps.front();
+    if (driver.estimated_rows == 0) {
+        driver.access = QueryPlan::Access::Empty;
+        plan.steps.resize(1);
+        return plan;
+    }
+    driver.access = QueryPlan::Access::Index;
 
+    // With a bitmap driver, other bitmap-indexed predicates of comparable
+    // size are ANDed before any row is decoded; the rest are filtered
+    const bool bitmapDriver = hasBitmapIndex(predicates[driver.predicate].field);
+    double candidates = static_cast<double>(driver.estimated_rows);
+    for (std::size_t i = 1; i < plan.steps.size(); ++i) {
+        auto& step = plan.steps[i];
+        bool merge = bitmapDriver && hasBitmapIndex(predicates[step.predicate].field) &&
+                     step.estimated_rows <= kIntersectRatio * std::max(candidates, 1.0);
+        step.access = merge ? QueryPlan::Access::Intersect : QueryPlan::Access::Filter;
+        candidates *= rows > 0 ? static_cast<double>(step.estimated_rows) / rows : 0.0;
+    }
+    std::stable_partition(plan.steps.begin() + 1, plan.steps.end(), [](const auto& step) {
+        return step.access == QueryPlan::Access::Intersect;
+    });
+    plan.estimated_rows = static_cast<std::size_t>(candidates + 0.5);
+    return plan;
+}
 
+RowSet DataSet::rowsMatching(const Query& query) const {
+    NYCOLLISION_TIME_SCOPE(QueryMultiPredicate);
+    const QueryPlan plan = this->plan(query);
+    const auto& predicates = query.predicates();
+    if (plan.steps.empty()) {
+        std::vector<RowId> all(size());
+        std::iota(all.begin(), all.end(), RowId{0});
+        return ownRows(std::move(all));
+    }
 
+    const auto& driver = predicates[plan.steps.front().predicate];
+    if (plan.steps.front().access == QueryPlan::Access::Empty) {
+        return RowSet(store_);
+    }
 
+    std::vector<RowId> rows;
+    std::size_t next = 1;
+    if (hasBitmapIndex(driver.field)) {
+        RowSet driverSet = rowsFor(driver);
+        RowBitmap scratch;
+        const RowBitmap& driverRows = driverSet.asBitmap(scratch);
+        if (plan.steps.size() == 1) {
+            // A single posting bitmap is returned as borrowed
+            return &driverRows == &scratch ? RowSet(store_, std::move(scratch)) : driverSet;
+        }
+        RowBitmap candidates = &driverRows == &scratch ? std::move(scratch) : driverRows;
+        for (; next < plan.steps.size() && plan.steps[next].access == QueryPlan::Access::Intersect; ++next) {
+            RowSet other = rowsFor(predicates[plan.steps[next].predicate]);
+            candidates &= other.asBitmap(scratch);
+        }
+        if (next == plan.steps.size()) {
+            return RowSet(store_, std::move(candidates));
+        }
+        rows = candidates.toVector();
+    } else {
+        rows = rowsFor(driver).toVector();
+        std::sort(rows.begin(), rows.end());
+    }
 
+    for (; next < plan.steps.size() && !rows.empty(); ++next) {
+        // Test candidates in parallel, then compact in row order
+        auto matches = matcherFor(predicates[plan.steps[next].predicate]);
+        std::vector<std::uint8_t> keep(rows.size());
+        constexpr std::size_t kRowsPerTask = 1 << 14;
+        context_->parallelFor(rows.size(), kRowsPerTask, [&](std::size_t first, std::size_t last) {
+            for (std::size_t j = first; j < last; ++j) {
+                keep[j] = matches(rows[j]);
+            }
+        });
+        std::size_t kept = 0;
+        for (std::size_t j = 0; j < rows.size(); ++j) {
+            if (keep[j]) {
+                rows[kept++] = rows[j];
+            }
+        }
+        rows.resize(kept);
+    }
+    return ownRows(std::move(rows));
+}
 
+std::size_t DataSet::indexMemoryUsage() const {
+    std::size_t bytes = dates_.memoryUsage();
+    for (const CodeIndex* index : {&boroughIndex_, &zipIndex_, &vehicleTypeIndex_}) {
+        for (const auto& bitmap : *index) {
+            bytes += sizeof(RowBitmap) + bitmap.memoryUsage();
+        }
+    }
+    for (const CountIndex* index : {&injuryIndex_, &fatalityIndex_, &pedestrianFatalityIndex_,
+                                    &cyclistFatalityIndex_, &motoristFatalityIndex_}) {
+        for (const auto& entry : *index) {
+            bytes += sizeof(entry) + entry.second.memoryUsage();
+        }
+    }
+    for (const auto& index : regionIndexes_) {
+        bytes += index.regions.memoryUsage();
+        for (const auto& bitmap : index.postings) {
+            bytes += sizeof(RowBitmap) + bitmap.memoryUsage();
+        }
+    }
+    return bytes;
+}
+
+namespace {
+
+void saveCodeIndex(const std::vector<RowBitmap>& index, SnapshotBuffer& out) {
+    out.put<std::uint64_t>(index.size());
+    for (const auto& bitmap : index) {
+        bitmap.save(out);
+    }
+}
+
+void loadCodeIndex(std::vector<RowBitmap>& index, SnapshotCursor in) {
+    index.resize(in.get<std::uint64_t>());
+    for (auto& bitmap : index) {
+        bitmap = RowBitmap::load(in);
+    }
+}
 
+void saveCountIndex(const std::map<int, RowBitmap>& index, SnapshotBuffer& out) {
+    out.put<std::uint64_t>(index.size());
+    for (const auto& [count, bitmap] : index) {
+        out.put(count);
+        bitmap.save(out);
+    }
+}
 
+void loadCountIndex(std::map<int, RowBitmap>& index, SnapshotCursor in) {
+    const auto size = in.get<std::uint64_t>();
+    for (std::uint64_t i = 0; i < size; ++i) {
+        const int count = in.get<int>();
+        index.emplace_hint(index.end(), count, RowBitmap::load(in));
+    }
+}
 
+void savePool(const StringPool& pool, SnapshotBuffer& out) {
+    for (std::size_t d = 0; d < kStringDomainCount; ++d) {
+        const StringDictionary& dictionary = pool.dictionary(static_cast<StringDomain>(d));
+        const std::size_t size = dictionary.size();
+        out.put<std::uint64_t>(size);
+        for (std::size_t code = 1; code < size; ++code) {
+            out.putString(dictionary.decode(static_cast<StringPool::Code>(code)));
+        }
+    }
+}
+
+// Encode the snapshot's strings under their saved codes. The pool is left
+// untouched unless every domain agrees with it: codes the pool already holds
+// must decode to the same strings, and the rest must be new to it.
+void loadPool(StringPool& pool, SnapshotCursor in) {
+    std::array<std::vector<std::string_view>, kStringDomainCount> strings;
+    for (std::size_t d = 0; d < kStringDomainCount; ++d) {
+        const auto domain = static_cast<StringDomain>(d);
+        const auto size = in.get<std::uint64_t>();
+        const StringDictionary& dictionary = pool.dictionary(domain);
+        std::unordered_set<std::string_view> added;
+        auto& values = strings[d];
+        values.reserve(size > 0 ? size - 1 : 0);
+        for (std::uint64_t code = 1; code < size; ++code) {
+            values.push_back(in.getString());
+        }
+        for (std::uint64_t code = 1; code < size; ++code) {
+            const std::string_view value = values[code - 1];
+            const bool matches = code < dictionary.size()
+                                     ? dictionary.decode(static_cast<StringPool::Code>(code)) == value
+                                     : dictionary.find(value) == StringPool::kNotFound && added.insert(value).second;
+            if (!matches) {
+                throw std::runtime_error("Snapshot strings do not match the dataset's string pool");
+            }
+        }
+    }
+    for (std::size_t d = 0; d < kStringDomainCount; ++d) {
+        for (std::string_view value : strings[d]) {
+            pool.encode(static_cast<StringDomain>(d), value);
+        }
+    }
+}
+
+// Fingerprint of a layer's region names and polygons, so a snapshot's region
+// columns are only reused for the layer they were computed from
+std::uint32_t layerChecksum(const RegionLayer& layer) {
+    std::uint32_t crc = 0;
+    for (RegionLayer::RegionId id = 0; id < layer.size(); ++id) {
+        const std::string& name = layer.regionName(id);
+        crc = crc32(name.c_str(), name.size() + 1, crc);
+        bg::for_each_point(layer.area(id), [&crc](const RegionLayer::Point& point) {
+            const double coordinates[2] = {point.x(), point.y()};
+            crc = crc32(coordinates, sizeof(coordinates), crc);
+        });
+    }
+    return crc;
+}
+
+} // namespace
+
+void DataSet::saveSnapshot(const std::string& filename, SnapshotSource source) const {
+    NYCOLLISION_TIME_SCOPE(SnapshotSave);
+    SnapshotWriter out(filename, source);
+
+    SnapshotBuffer& meta = out.section("meta");
+    meta.put<std::uint64_t>(store_->size());
+    meta.put(parseStats_);
+    meta.put<std::uint64_t>(spatialPartitions_);
+
+    savePool(*store_->pool(), out.section("pool"));
+    store_->save(out);
+
+    keyIndex_.save(out.section("idx.keys"));
+    dates_.save(out.section("idx.dates"));
+    saveCodeIndex(boroughIndex_, out.section("idx.boroughs"));
+    saveCodeIndex(zipIndex_, out.section("idx.zip_codes"));
+    saveCodeIndex(vehicleTypeIndex_, out.section("idx.vehicle_types"));
+    saveCountIndex(injuryIndex_, out.section("idx.injuries"));
+    saveCountIndex(fatalityIndex_, out.section("idx.fatalities"));
+    saveCountIndex(pedestrianFatalityIndex_, out.section("idx.ped_fatalities"));
+    saveCountIndex(cyclistFatalityIndex_, out.section("idx.cyc_fatalities"));
+    saveCountIndex(motoristFatalityIndex_, out.section("idx.mot_fatalities"));
+    rollup_.save(out.section("rollup"));
+    tiles_.save(out.section("tiles"));
+
+    {
+        // The packed trees as they are, strips first, each with the rows masked out of it
+        std::shared_lock lock(spatial_mutex_);
+        SnapshotBuffer& spatial = out.section("spatial");
+        spatial.put<std::uint64_t>(strips_);
+        spatial.put<std::uint64_t>(segments_.size());
+        for (const auto& segment : segments_) {
+            segment.tree->save(spatial);
+            segment.removed.save(spatial);
+        }
+    }
+
+    SnapshotBuffer& regions = out.section("regions");
+    regions.put<std::uint64_t>(regionIndexes_.size());
+    for (const auto& index : regionIndexes_) {
+        regions.putString(index.layer->name());
+        regions.put(layerChecksum(*index.layer));
+        index.regions.save(regions);
+        saveCodeIndex(index.postings, regions);
+    }
+
+    out.commit();
+}
+
+void DataSet::loadSnapshot(const std::string& filename) {
+    if (size() != 0) {
+        throw std::runtime_error("Snapshots can only be loaded into an empty dataset");
+    }
+    NYCOLLISION_TIME_SCOPE(SnapshotLoad);
+    SnapshotReader in(filename);
+    const ExecutionContext& context = *context_;
+
+    try {
+        SnapshotCursor meta = in.section("meta");
+        const auto rows = meta.get<std::uint64_t>();
+        parseStats_ = meta.get<ParseStats>();
+        spatialPartitions_ = static_cast<size_t>(meta.get<std::uint64_t>());
+
+        // Stored region layers by name, matched to the added layers once every section is in
+        std::unordered_map<std::string, RegionIndex> storedRegions;
+        std::unordered_map<std::string, std::uint32_t> storedChecksums;
+
+        context.parallelInvoke({
+            [&] { loadPool(*store_->pool(), in.section("pool")); },
+            [&] { store_->load(in, context); },
+            [&] {
+                SnapshotCursor keys = in.section("idx.keys");
+                keyIndex_.load(keys);
+            },
+            [&] {
+                SnapshotCursor dates = in.section("idx.dates");
+                dates_.load(dates);
+            },
+            [&] { loadCodeIndex(boroughIndex_, in.section("idx.boroughs")); },
+            [&] { loadCodeIndex(zipIndex_, in.section("idx.zip_codes")); },
+            [&] { loadCodeIndex(vehicleTypeIndex_, in.section("idx.vehicle_types")); },
+            [&] { loadCountIndex(injuryIndex_, in.section("idx.injuries")); },
+            [&] { loadCountIndex(fatalityIndex_, in.section("idx.fatalities")); },
+            [&] { loadCountIndex(pedestrianFatalityIndex_, in.section("idx.ped_fatalities")); },
+            [&] { loadCountIndex(cyclistFatalityIndex_, in.section("idx.cyc_fatalities")); },
+            [&] { loadCountIndex(motoristFatalityIndex_, in.section("idx.mot_fatalities")); },
+            [&] {
+                SnapshotCursor cube = in.section("rollup");
+                rollup_.load(cube);
+            },
+            [&] {
+                SnapshotCursor tiles = in.section("tiles");
+                tiles_.load(tiles);
+            },
+            [&] {
+                auto startTime = std::chrono::steady_clock::now();
+                SnapshotCursor spatial = in.section("spatial");
+                const auto strips = spatial.get<std::uint64_t>();
+                const auto count = spatial.get<std::uint64_t>();
+                if (strips > count) {
+                    throw std::runtime_error("Snapshot spatial index is inconsistent");
+                }
+                std::vector<SpatialSegment> segments(count);
+                for (auto& segment : segments) {
+                    segment.tree = std::make_shared<const PackedRTree>(PackedRTree::load(spatial));
+                    segment.removed = RowBitmap::load(spatial);
+                }
+                installSpatialIndex(std::move(segments), strips, startTime);
+            },
+            [&] {
+                SnapshotCursor regions = in.section("regions");
+                const auto count = regions.get<std::uint64_t>();
+                for (std::uint64_t i = 0; i < count; ++i) {
+                    const std::string name(regions.getString());
+                    storedChecksums[name] = regions.get<std::uint32_t>();
+                    RegionIndex& stored = storedRegions[name];
+                    stored.regions.load(regions);
+                    stored.postings.resize(regions.get<std::uint64_t>());
+                    for (auto& bitmap : stored.postings) {
+                        bitmap = RowBitmap::load(regions);
+                    }
+                }
+            },
+        });
+        if (store_->size() != rows || dates_.size() != rows || spatialStats_.values != rows) {
+            throw std::runtime_error("Snapshot sections disagree on the number of rows: " + filename);
+        }
+        for (auto& index : regionIndexes_) {
+            auto stored = storedRegions.find(index.layer->name());
+            if (stored == storedRegions.end() || storedChecksums[stored->first] != layerChecksum(*index.layer)) {
+                indexRegionLayer(index);
+                continue;
+            }
+            if (stored->second.regions.size() != rows) {
+                throw std::runtime_error("Snapshot sections disagree on the number of rows: " + filename);
+            }
+            index.regions = std::move(stored->second.regions);
+            index.postings = std::move(stored->second.postings);
+        }
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
+void DataSet::clear() {
+    store_ = std::make_shared<ColumnStore>(store_->pool());
+    parseStats_ = ParseStats{};
+    {
+        std::unique_lock lock(spatial_mutex_);
+        segments_.clear();
+        strips_ = 0;
+        spatialStats_ = SpatialIndexStats{};
+    }
+    keyIndex_.clear();
+    dates_.clear();
+    for (CodeIndex* index : {&boroughIndex_, &zipIndex_, &vehicleTypeIndex_}) {
+        index->clear();
+    }
+    for (CountIndex* index : {&injuryIndex_, &fatalityIndex_, &pedestrianFatalityIndex_,
+                              &cyclistFatalityIndex_, &motoristFatalityIndex_}) {
+        index->clear();
+    }
+    rollup_ = RollupCube(store_->pool());
+    tiles_ = HeatmapTiles();
+    for (auto& index : regionIndexes_) {
+        index.regions.clear();
+        index.postings.clear();
+    }
+}
+
+std::string DataSet::explain(const Query& query) const {
+    const QueryPlan plan = this->plan(query);
+    std::ostringstream out;
+    out << "Query plan (estimated " << plan.estimated_rows << " rows):\n";
+    if (plan.steps.empty()) {
+        out << "  1. scan       all rows (" << size() << ")\n";
+        return out.str();
+    }
+    for (std::size_t i = 0; i < plan.steps.size(); ++i) {
+        const auto& step = plan.steps[i];
+        const char* access = "filter";
+        switch (step.access) {
+        case QueryPlan::Access::Index: access = "index"; break;
+        case QueryPlan::Access::Intersect: access = "intersect"; break;
+        case QueryPlan::Access::Filter: access = "filter"; break;
+        case QueryPlan::Access::Empty: access = "empty"; break;
+        }
+        out << "  " << (i + 1) << ". " << std::setw(10) << std::left << access << " "
+            << Query::describe(query.predicates()[step.predicate])
+            << " (~" << step.estimated_rows << " rows)\n";
+    }
+    return out.str();
+}
 
 } // namespace nycollision
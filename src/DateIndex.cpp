@@ -0,0 +1,164 @@
+#include "../include/nycollision/data/DateIndex.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace nycollision {
+
+void DateIndex::appendBlocks(const std::vector<Entry>& entries, std::vector<BlockPtr>& out) {
+    // Even pieces of at most 2 * kBlockEntries, at least kBlockEntries when there are several
+    const std::size_t count = entries.size() <= 2 * kBlockEntries ? 1 : entries.size() / kBlockEntries;
+    for (std::size_t p = 0; p < count; ++p) {
+        const std::size_t first = entries.size() * p / count;
+        const std::size_t last = entries.size() * (p + 1) / count;
+        auto block = std::make_shared<Block>();
+        block->keys.reserve(last - first);
+        block->rows.reserve(last - first);
+        for (std::size_t i = first; i < last; ++i) {
+            block->keys.push_back(entries[i].first);
+            block->rows.push_back(entries[i].second);
+        }
+        out.push_back(std::move(block));
+    }
+}
+
+void DateIndex::insert(std::vector<Entry> added, const ExecutionContext& context) {
+    if (added.empty()) {
+        return;
+    }
+    // Sort row partitions concurrently, then merge neighbours pairwise
+    constexpr std::size_t kMinPartitionEntries = std::size_t{1} << 16;
+    const std::size_t partitions = std::clamp<std::size_t>(added.size() / kMinPartitionEntries, 1, context.threads());
+    auto cut = [&](std::size_t p) { return added.begin() + added.size() * std::min(p, partitions) / partitions; };
+    context.parallelFor(partitions, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t p = first; p < last; ++p) {
+            std::sort(cut(p), cut(p + 1));
+        }
+    });
+    for (std::size_t width = 1; width < partitions; width *= 2) {
+        const std::size_t pairs = (partitions + 2 * width - 1) / (2 * width);
+        context.parallelFor(pairs, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t pair = first; pair < last; ++pair) {
+                std::size_t p = pair * 2 * width;
+                std::inplace_merge(cut(p), cut(p + width), cut(p + 2 * width));
+            }
+        });
+    }
+
+    // Each block takes the entries below the next block's first; untouched blocks stay shared
+    std::vector<BlockPtr> blocks;
+    blocks.reserve(blocks_.size() + added.size() / kBlockEntries + 1);
+    auto next = added.begin();
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+        const Block& block = *blocks_[b];
+        auto last = b + 1 < blocks_.size() ? std::lower_bound(next, added.end(), blocks_[b + 1]->front())
+                                           : added.end();
+        if (last == next) {
+            blocks.push_back(blocks_[b]);
+            continue;
+        }
+        std::vector<Entry> merged;
+        merged.reserve(block.keys.size() + (last - next));
+        for (std::size_t i = 0; i < block.keys.size(); ++i) {
+            for (; next != last && *next < block.entry(i); ++next) {
+                merged.push_back(*next);
+            }
+            merged.push_back(block.entry(i));
+        }
+        merged.insert(merged.end(), next, last);
+        next = last;
+        appendBlocks(merged, blocks);
+    }
+    if (blocks_.empty()) {
+        appendBlocks(added, blocks);
+    }
+    blocks_ = std::move(blocks);
+    size_ += added.size();
+}
+
+void DateIndex::remove(std::vector<Entry> removed) {
+    std::sort(removed.begin(), removed.end());
+    auto next = removed.begin();
+    for (std::size_t b = 0; b < blocks_.size() && next != removed.end(); ++b) {
+        const Block& block = *blocks_[b];
+        next = std::lower_bound(next, removed.end(), block.front());
+        auto last = std::upper_bound(next, removed.end(), block.back());
+        if (next == last) {
+            continue;
+        }
+        auto copy = std::make_shared<Block>();
+        copy->keys.reserve(block.keys.size());
+        copy->rows.reserve(block.rows.size());
+        for (std::size_t i = 0; i < block.keys.size(); ++i) {
+            if (!std::binary_search(next, last, block.entry(i))) {
+                copy->keys.push_back(block.keys[i]);
+                copy->rows.push_back(block.rows[i]);
+            }
+        }
+        size_ -= block.keys.size() - copy->keys.size();
+        blocks_[b] = std::move(copy);
+        next = last;
+    }
+    blocks_.erase(std::remove_if(blocks_.begin(), blocks_.end(),
+                                 [](const BlockPtr& block) { return block->keys.empty(); }),
+                  blocks_.end());
+}
+
+std::vector<RowSpan> DateIndex::range(Timestamp start, Timestamp end) const {
+    std::vector<RowSpan> spans;
+    // First block whose last timestamp reaches start
+    auto block = std::partition_point(blocks_.begin(), blocks_.end(),
+                                      [start](const BlockPtr& b) { return b->keys.back() < start; });
+    for (; block != blocks_.end() && (*block)->keys.front() <= end; ++block) {
+        const auto& keys = (*block)->keys;
+        auto first = std::lower_bound(keys.begin(), keys.end(), start);
+        auto last = std::upper_bound(first, keys.end(), end);
+        if (first != last) {
+            spans.push_back(RowSpan{(*block)->rows.data() + (first - keys.begin()),
+                                    static_cast<std::size_t>(last - first)});
+        }
+    }
+    return spans;
+}
+
+std::size_t DateIndex::memoryUsage() const {
+    std::size_t bytes = blocks_.capacity() * sizeof(BlockPtr);
+    for (const auto& block : blocks_) {
+        bytes += sizeof(Block) + block->keys.capacity() * sizeof(Timestamp) + block->rows.capacity() * sizeof(RowId);
+    }
+    return bytes;
+}
+
+void DateIndex::save(SnapshotBuffer& out) const {
+    out.put<std::uint64_t>(size_);
+    for (const auto& block : blocks_) {
+        out.putValues(block->keys.data(), block->keys.size());
+    }
+    out.put<std::uint64_t>(size_);
+    for (const auto& block : blocks_) {
+        out.putValues(block->rows.data(), block->rows.size());
+    }
+}
+
+void DateIndex::load(SnapshotCursor& in) {
+    const std::string_view keys = in.getArray<Timestamp>();
+    const std::string_view rows = in.getArray<RowId>();
+    const std::size_t count = keys.size() / sizeof(Timestamp);
+    if (rows.size() / sizeof(RowId) != count) {
+        throw std::runtime_error("Snapshot date index is inconsistent");
+    }
+    clear();
+    for (std::size_t first = 0; first < count; first += kBlockEntries) {
+        const std::size_t size = std::min(kBlockEntries, count - first);
+        auto block = std::make_shared<Block>();
+        block->keys.resize(size);
+        block->rows.resize(size);
+        std::memcpy(block->keys.data(), keys.data() + first * sizeof(Timestamp), size * sizeof(Timestamp));
+        std::memcpy(block->rows.data(), rows.data() + first * sizeof(RowId), size * sizeof(RowId));
+        blocks_.push_back(std::move(block));
+    }
+    size_ = count;
+}
+
+} // namespace nycollision
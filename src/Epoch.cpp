@@ -0,0 +1,39 @@
+#include "../include/nycollision/util/Epoch.h"
+#include <functional>
+#include <thread>
+
+namespace nycollision {
+
+EpochDomain::Guard EpochDomain::enter() const {
+    // Threads start probing at different slots so uncontended readers own theirs
+    static thread_local const std::size_t home = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    for (std::size_t probe = home;; ++probe) {
+        auto& slot = slots_[probe % kSlots].epoch;
+        std::uint64_t expected = 0;
+        if (slot.load(std::memory_order_relaxed) == 0 &&
+            slot.compare_exchange_strong(expected, epoch_.load(std::memory_order_seq_cst),
+                                         std::memory_order_seq_cst)) {
+            return Guard(&slot);
+        }
+        if ((probe - home + 1) % kSlots == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void EpochDomain::synchronize() {
+    // Guards entered from here on read the new epoch and observe everything
+    // unlinked before this call, so only older ones are waited for
+    const std::uint64_t target = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    for (auto& slot : slots_) {
+        for (;;) {
+            const std::uint64_t entered = slot.epoch.load(std::memory_order_seq_cst);
+            if (entered == 0 || entered >= target) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace nycollision
@@ -0,0 +1,178 @@
+#include "../include/nycollision/util/ExecutionContext.h"
+#include "../include/nycollision/util/ThreadAffinity.h"
+#include "../include/nycollision/util/WorkStealingPool.h"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <omp.h>
+
+namespace nycollision {
+
+namespace {
+
+// Keeps the first exception thrown by any of several concurrent calls
+class FirstError {
+public:
+    template <typename Func>
+    void capture(Func&& func) {
+        try {
+            func();
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+
+    void rethrow() const {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::exception_ptr error_;
+};
+
+std::size_t resolveThreads(const ExecutionContext::Options& options) {
+    if (options.threads > 0) {
+        return options.threads;
+    }
+    if (!options.cpuAffinity.empty()) {
+        return options.cpuAffinity.size();
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Pin an OpenMP worker of the current team to its CPU of the list, as the
+// work-stealing pool pins its workers. The calling thread (number 0) keeps
+// its own affinity. The runtime keeps its workers between regions, so a
+// worker is pinned again only when it is handed a different CPU.
+void pinTeamWorker(const std::vector<int>& cpus) {
+    const int thread = omp_get_thread_num();
+    if (cpus.empty() || thread == 0) {
+        return;
+    }
+    thread_local int pinned = -1;
+    const int cpu = cpus[static_cast<std::size_t>(thread - 1) % cpus.size()];
+    if (cpu != pinned && pinCurrentThread(cpu)) {
+        pinned = cpu;
+    }
+}
+
+} // namespace
+
+ExecutionContext::ExecutionContext() : ExecutionContext(Options{}) {}
+
+ExecutionContext::ExecutionContext(Options options)
+    : threads_(resolveThreads(options)),
+      cpuAffinity_(std::move(options.cpuAffinity)),
+      backend_(options.backend) {
+    if (backend_ == Backend::WorkStealing && threads_ > 1) {
+        pool_ = std::make_unique<WorkStealingPool>(threads_ - 1, cpuAffinity_);
+    }
+}
+
+ExecutionContext::~ExecutionContext() = default;
+
+const std::shared_ptr<ExecutionContext>& ExecutionContext::defaultContext() {
+    static const auto context = std::make_shared<ExecutionContext>();
+    return context;
+}
+
+void ExecutionContext::parallelFor(std::size_t count, std::size_t grain,
+                                   const std::function<void(std::size_t, std::size_t)>& body) const {
+    grain = std::max<std::size_t>(grain, 1);
+    const std::size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 0) {
+        return;
+    }
+    if (chunks == 1 || threads_ == 1) {
+        body(0, count);
+        return;
+    }
+
+    auto chunk = [&](std::size_t c) { body(c * grain, std::min(count, (c + 1) * grain)); };
+    FirstError error;
+
+    if (pool_) {
+        WorkStealingPool::TaskGroup group;
+        for (std::size_t c = 0; c < chunks; ++c) {
+            pool_->submit(group, [&chunk, c] { chunk(c); });
+        }
+        pool_->wait(group);
+        return;
+    }
+
+    if (omp_in_parallel()) {
+        // Nested inside one of our regions: feed the existing team
+        #pragma omp taskloop grainsize(1) shared(chunk, error)
+        for (std::size_t c = 0; c < chunks; ++c) {
+            error.capture([&] { chunk(c); });
+        }
+    } else {
+        const int team = static_cast<int>(std::min(threads_, chunks));
+        #pragma omp parallel num_threads(team)
+        {
+            pinTeamWorker(cpuAffinity_);
+            #pragma omp for schedule(dynamic, 1)
+            for (std::size_t c = 0; c < chunks; ++c) {
+                error.capture([&] { chunk(c); });
+            }
+        }
+    }
+    error.rethrow();
+}
+
+void ExecutionContext::parallelInvoke(std::initializer_list<std::function<void()>> tasks) const {
+    invoke(tasks.begin(), tasks.end());
+}
+
+void ExecutionContext::parallelInvoke(const std::vector<std::function<void()>>& tasks) const {
+    invoke(tasks.data(), tasks.data() + tasks.size());
+}
+
+void ExecutionContext::invoke(const std::function<void()>* first, const std::function<void()>* last) const {
+    FirstError error;
+    if (last - first <= 1 || threads_ == 1) {
+        for (const auto* task = first; task != last; ++task) {
+            error.capture(*task);
+        }
+        error.rethrow();
+        return;
+    }
+
+    if (pool_) {
+        WorkStealingPool::TaskGroup group;
+        for (const auto* task = first; task != last; ++task) {
+            pool_->submit(group, [task] { (*task)(); });
+        }
+        pool_->wait(group);
+        return;
+    }
+
+    if (omp_in_parallel()) {
+        for (const auto* task = first; task != last; ++task) {
+            #pragma omp task shared(error) firstprivate(task)
+            error.capture(*task);
+        }
+        #pragma omp taskwait
+    } else {
+        // A full team, so parallelFor calls inside the tasks have threads to use
+        #pragma omp parallel num_threads(static_cast<int>(threads_))
+        {
+            pinTeamWorker(cpuAffinity_);
+            #pragma omp single
+            for (const auto* task = first; task != last; ++task) {
+                #pragma omp task shared(error) firstprivate(task)
+                error.capture(*task);
+            }
+        }
+    }
+    error.rethrow();
+}
+
+} // namespace nycollision
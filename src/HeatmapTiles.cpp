@@ -0,0 +1,281 @@
+#include "../include/nycollision/data/HeatmapTiles.h"
+#include "../include/nycollision/core/GeoDistance.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace nycollision {
+
+namespace {
+
+// Tile of a coordinate along one axis; out-of-range and NaN coordinates go to the edge tiles
+std::uint32_t tileOf(double degrees, double origin, double span, int level) {
+    const double tiles = std::ldexp(1.0, level);
+    const double position = (degrees - origin) / span * tiles;
+    if (!(position >= 0.0)) {
+        return 0;
+    }
+    return static_cast<std::uint32_t>(std::min(position, tiles - 1.0));
+}
+
+double tileEdge(std::uint32_t tile, double origin, double span, int level) {
+    return origin + span * std::ldexp(static_cast<double>(tile), -level);
+}
+
+bool isZero(const CasualtyTotals& totals) {
+    return totals.collisions == 0 &&
+           std::all_of(totals.casualties.begin(), totals.casualties.end(), [](std::uint64_t v) { return v == 0; });
+}
+
+} // namespace
+
+HeatmapTiles::Key HeatmapTiles::finestKeyOf(float latitude, float longitude) {
+    const Key x = tileOf(longitude, -180.0, 360.0, kMaxLevel);
+    const Key y = tileOf(latitude, -90.0, 180.0, kMaxLevel);
+    return x << 32 | y;
+}
+
+void HeatmapTiles::addRows(const ColumnStore& store, RowId first, RowId last, Cells& cells) {
+    const auto& lats = store.latitudes();
+    const auto& lons = store.longitudes();
+    for (RowId row = first; row < last; ++row) {
+        cells[finestKeyOf(lats[row], lons[row])].add(store, row);
+    }
+}
+
+void HeatmapTiles::add(const ColumnStore& store, RowId first, RowId last, const ExecutionContext& context) {
+    constexpr std::size_t kMinPartitionRows = std::size_t{1} << 16;
+    const std::size_t rows = last - first;
+    const std::size_t partitions = std::clamp<std::size_t>(rows / kMinPartitionRows, 1, context.threads());
+
+    std::vector<Cells> cells(partitions);
+    context.parallelFor(partitions, 1, [&](std::size_t firstPart, std::size_t lastPart) {
+        for (std::size_t p = firstPart; p < lastPart; ++p) {
+            addRows(store, static_cast<RowId>(first + rows * p / partitions),
+                    static_cast<RowId>(first + rows * (p + 1) / partitions), cells[p]);
+        }
+    });
+
+    for (std::size_t p = 1; p < partitions; ++p) {
+        for (const auto& [key, totals] : cells[p]) {
+            cells[0][key] += totals;
+        }
+    }
+    apply(std::move(cells[0]), false);
+}
+
+void HeatmapTiles::add(const ColumnStore& store, const std::vector<RowId>& rows) {
+    Cells changes;
+    for (RowId row : rows) {
+        addRows(store, row, row + 1, changes);
+    }
+    apply(std::move(changes), false);
+}
+
+void HeatmapTiles::remove(const ColumnStore& store, const std::vector<RowId>& rows) {
+    Cells changes;
+    for (RowId row : rows) {
+        addRows(store, row, row + 1, changes);
+    }
+    apply(std::move(changes), true);
+}
+
+CasualtyTotals HeatmapTiles::Level::find(Key key) const {
+    CasualtyTotals totals;
+    auto it = base->find(key);
+    if (it != base->end()) {
+        totals = it->second;
+    }
+    auto change = changes.find(key);
+    if (change != changes.end()) {
+        totals += change->second;
+    }
+    return totals;
+}
+
+template <typename Func>
+void HeatmapTiles::Level::forEach(Func&& func) const {
+    for (const auto& [key, totals] : *base) {
+        auto change = changes.find(key);
+        if (change == changes.end()) {
+            func(key, totals);
+            continue;
+        }
+        CasualtyTotals sum = totals;
+        sum += change->second;
+        if (sum.collisions != 0) {
+            func(key, sum);
+        }
+    }
+    for (const auto& [key, totals] : changes) {
+        if (totals.collisions != 0 && base->count(key) == 0) {
+            func(key, totals);
+        }
+    }
+}
+
+std::size_t HeatmapTiles::Level::size() const {
+    std::size_t count = base->size();
+    for (const auto& [key, totals] : changes) {
+        auto it = base->find(key);
+        if (it == base->end()) {
+            count += totals.collisions != 0;
+        } else if (it->second.collisions + totals.collisions == 0) {
+            --count;
+        }
+    }
+    return count;
+}
+
+void HeatmapTiles::Level::fold() {
+    auto merged = std::make_shared<Cells>(*base);
+    for (const auto& [key, totals] : changes) {
+        auto it = merged->emplace(key, CasualtyTotals{}).first;
+        it->second += totals;
+        if (it->second.collisions == 0) {
+            merged->erase(it);
+        }
+    }
+    base = std::move(merged);
+    changes.clear();
+}
+
+void HeatmapTiles::apply(Cells changes, bool subtract) {
+    for (int level = kMaxLevel;; --level) {
+        Level& tiles = levels_[level - kMinLevel];
+        for (const auto& [key, totals] : changes) {
+            auto it = tiles.changes.emplace(key, CasualtyTotals{}).first;
+            if (subtract) {
+                it->second -= totals;
+            } else {
+                it->second += totals;
+            }
+            if (isZero(it->second)) {
+                tiles.changes.erase(it);
+            }
+        }
+        if (tiles.changes.size() * kFoldRatio > tiles.base->size()) {
+            tiles.fold();
+        }
+        if (level == kMinLevel) {
+            return;
+        }
+
+        // Each tile's parent halves both coordinates
+        Cells parents;
+        for (const auto& [key, totals] : changes) {
+            parents[(key >> 33) << 32 | (key & 0xFFFFFFFFu) >> 1] += totals;
+        }
+        changes = std::move(parents);
+    }
+}
+
+std::vector<HeatmapCell> HeatmapTiles::cells(double minLat, double maxLat, double minLon, double maxLon,
+                                             int level) const {
+    std::vector<HeatmapCell> result;
+    if (!(minLat <= maxLat && minLon <= maxLon)) {
+        return result;
+    }
+    level = std::clamp(level, kMinLevel, kMaxLevel);
+    const Level& tiles = levels_[level - kMinLevel];
+    const std::uint32_t x0 = tileOf(minLon, -180.0, 360.0, level);
+    const std::uint32_t x1 = tileOf(maxLon, -180.0, 360.0, level);
+    const std::uint32_t y0 = tileOf(minLat, -90.0, 180.0, level);
+    const std::uint32_t y1 = tileOf(maxLat, -90.0, 180.0, level);
+
+    auto emit = [&](Key key, const CasualtyTotals& totals) {
+        HeatmapCell cell;
+        cell.x = static_cast<std::uint32_t>(key >> 32);
+        cell.y = static_cast<std::uint32_t>(key);
+        cell.minLat = tileEdge(cell.y, -90.0, 180.0, level);
+        cell.maxLat = tileEdge(cell.y + 1, -90.0, 180.0, level);
+        cell.minLon = tileEdge(cell.x, -180.0, 360.0, level);
+        cell.maxLon = tileEdge(cell.x + 1, -180.0, 360.0, level);
+        cell.totals = totals;
+        result.push_back(cell);
+    };
+
+    const double span = (static_cast<double>(x1 - x0) + 1) * (static_cast<double>(y1 - y0) + 1);
+    if (span <= static_cast<double>(tiles.base->size() + tiles.changes.size())) {
+        for (std::uint32_t y = y0; y <= y1; ++y) {
+            for (std::uint32_t x = x0; x <= x1; ++x) {
+                const Key key = Key{x} << 32 | y;
+                const CasualtyTotals totals = tiles.find(key);
+                if (totals.collisions != 0) {
+                    emit(key, totals);
+                }
+            }
+        }
+        return result;
+    }
+
+    tiles.forEach([&](Key key, const CasualtyTotals& totals) {
+        const auto x = static_cast<std::uint32_t>(key >> 32);
+        const auto y = static_cast<std::uint32_t>(key);
+        if (x >= x0 && x <= x1 && y >= y0 && y <= y1) {
+            emit(key, totals);
+        }
+    });
+    std::sort(result.begin(), result.end(),
+              [](const HeatmapCell& a, const HeatmapCell& b) { return std::tie(a.y, a.x) < std::tie(b.y, b.x); });
+    return result;
+}
+
+int HeatmapTiles::levelFor(double cellMeters) {
+    const double worldMeters = 180.0 * kRadiansPerDegree * kEarthRadiusMeters;
+    if (!(cellMeters > 0.0)) {
+        return kMaxLevel;
+    }
+    const int level = static_cast<int>(std::floor(std::log2(worldMeters / cellMeters)));
+    return std::clamp(level, kMinLevel, kMaxLevel);
+}
+
+std::size_t HeatmapTiles::cellCount() const {
+    std::size_t count = 0;
+    for (const auto& tiles : levels_) {
+        count += tiles.size();
+    }
+    return count;
+}
+
+namespace {
+
+template <typename Cells>
+void saveCells(const Cells& cells, SnapshotBuffer& out) {
+    out.put<std::uint64_t>(cells.size());
+    for (const auto& [key, totals] : cells) {
+        out.put(key);
+        out.put(totals);
+    }
+}
+
+template <typename Cells>
+void loadCells(Cells& cells, SnapshotCursor& in) {
+    const auto count = in.get<std::uint64_t>();
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const auto key = in.get<typename Cells::key_type>();
+        cells[key] = in.get<CasualtyTotals>();
+    }
+}
+
+} // namespace
+
+void HeatmapTiles::save(SnapshotBuffer& out) const {
+    for (const auto& tiles : levels_) {
+        saveCells(*tiles.base, out);
+        saveCells(tiles.changes, out);
+    }
+}
+
+void HeatmapTiles::load(SnapshotCursor& in) {
+    for (auto& tiles : levels_) {
+        auto base = std::make_shared<Cells>();
+        loadCells(*base, in);
+        tiles.base = std::move(base);
+        tiles.changes.clear();
+        loadCells(tiles.changes, in);
+    }
+}
+
+} // namespace nycollision
@@ -0,0 +1,90 @@
+#include "../include/nycollision/data/KeyIndex.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+
+namespace nycollision {
+
+namespace {
+
+bool byKey(const KeyIndex::Entry& a, const KeyIndex::Entry& b) { return a.key < b.key; }
+
+} // namespace
+
+KeyIndex::Run KeyIndex::merge(const Run& older, const Run& newer) {
+    Run merged;
+    merged.reserve(older.size() + newer.size());
+    auto a = older.begin();
+    auto b = newer.begin();
+    while (a != older.end() && b != newer.end()) {
+        if (a->key < b->key) {
+            merged.push_back(*a++);
+        } else {
+            a += a->key == b->key;
+            merged.push_back(*b++);
+        }
+    }
+    merged.insert(merged.end(), a, older.end());
+    merged.insert(merged.end(), b, newer.end());
+    return merged;
+}
+
+void KeyIndex::insert(std::vector<Entry> entries) {
+    if (entries.empty()) {
+        return;
+    }
+    // Keep the last entry of each key
+    std::stable_sort(entries.begin(), entries.end(), byKey);
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (i + 1 < entries.size() && entries[i + 1].key == entries[i].key) {
+            continue;
+        }
+        entries[kept++] = entries[i];
+    }
+    entries.resize(kept);
+
+    auto run = std::make_shared<const Run>(std::move(entries));
+    while (!runs_.empty() && runs_.back()->size() <= 2 * run->size()) {
+        run = std::make_shared<const Run>(merge(*runs_.back(), *run));
+        runs_.pop_back();
+    }
+    runs_.push_back(std::move(run));
+}
+
+bool KeyIndex::find(int key, RowId& row) const {
+    for (auto run = runs_.rbegin(); run != runs_.rend(); ++run) {
+        auto it = std::lower_bound((*run)->begin(), (*run)->end(), Entry{key, 0}, byKey);
+        if (it != (*run)->end() && it->key == key) {
+            row = it->row;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KeyIndex::save(SnapshotBuffer& out) const {
+    out.put<std::uint64_t>(runs_.size());
+    for (const auto& run : runs_) {
+        out.putVector(*run);
+    }
+}
+
+void KeyIndex::load(SnapshotCursor& in) {
+    runs_.clear();
+    const auto runs = in.get<std::uint64_t>();
+    for (std::uint64_t r = 0; r < runs; ++r) {
+        Run run;
+        in.getVector(run);
+        runs_.push_back(std::make_shared<const Run>(std::move(run)));
+    }
+}
+
+std::size_t KeyIndex::memoryUsage() const {
+    std::size_t bytes = runs_.capacity() * sizeof(runs_[0]);
+    for (const auto& run : runs_) {
+        bytes += sizeof(Run) + run->capacity() * sizeof(Entry);
+    }
+    return bytes;
+}
+
+} // namespace nycollision
@@ -0,0 +1,37 @@
+#include "../include/nycollision/data/LiveDataSet.h"
+
+namespace nycollision {
+
+LiveDataSet::LiveDataSet(std::shared_ptr<StringPool> pool, std::shared_ptr<const ExecutionContext> context,
+                         std::shared_ptr<const ExecutionContext> ingestContext)
+    : context_(context),
+      ingestContext_(ingestContext ? std::move(ingestContext) : context),
+      versions_(std::make_shared<const DataSet>(std::move(pool), std::move(context))) {}
+
+void LiveDataSet::update(const std::function<void(DataSet&)>& build) {
+    std::lock_guard lock(update_mutex_);
+    // Only updates replace the version, so it cannot change while this one forks it
+    std::shared_ptr<DataSet> next = versions_.acquire()->fork(ingestContext_);
+    build(*next);
+    if (ingestContext_ != context_) {
+        // Readers run on the query threads; the fork shares everything with next
+        next = next->fork(context_);
+    }
+    versions_.publish(std::move(next));
+}
+
+void LiveDataSet::loadFromFile(const std::string& filename, const IParser& parser) {
+    update([&](DataSet& next) { next.loadFromFile(filename, parser); });
+}
+
+DataSet::AppendStats LiveDataSet::appendFromFile(const std::string& filename, const IParser& parser) {
+    DataSet::AppendStats stats;
+    update([&](DataSet& next) { stats = next.appendFromFile(filename, parser); });
+    return stats;
+}
+
+void LiveDataSet::loadSnapshot(const std::string& filename) {
+    update([&](DataSet& next) { next.loadSnapshot(filename); });
+}
+
+} // namespace nycollision
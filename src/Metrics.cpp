@@ -0,0 +1,311 @@
+#include "../include/nycollision/util/Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace nycollision {
+
+namespace {
+
+// Written only by the owning thread, so updates are plain loads and stores;
+// the atomics let snapshot() read them from other threads
+struct AtomicHistogram {
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::kBuckets> buckets{};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> max{0};
+};
+
+struct alignas(64) Shard {
+    std::array<AtomicHistogram, Metrics::kOperations> latencies;
+    std::array<std::atomic<std::uint64_t>, Metrics::kCounters> counters{};
+};
+
+void bump(std::atomic<std::uint64_t>& value, std::uint64_t by) {
+    value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+// Shards outlive their threads: an exiting thread returns its shard, counts
+// included, for the next new thread to continue
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard*> free;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry;  // Never destroyed; threads may exit after static destruction
+    return *instance;
+}
+
+class ShardLease {
+public:
+    ShardLease() {
+        Registry& r = registry();
+        std::lock_guard lock(r.mutex);
+        if (r.free.empty()) {
+            r.shards.push_back(std::make_unique<Shard>());
+            shard_ = r.shards.back().get();
+        } else {
+            shard_ = r.free.back();
+            r.free.pop_back();
+        }
+    }
+    ~ShardLease() {
+        Registry& r = registry();
+        std::lock_guard lock(r.mutex);
+        r.free.push_back(shard_);
+    }
+
+    Shard& shard() { return *shard_; }
+
+private:
+    Shard* shard_;
+};
+
+Shard& localShard() {
+    thread_local ShardLease lease;
+    return lease.shard();
+}
+
+const char* const kOperationNames[Metrics::kOperations] = {
+    "query_geo_bounds",
+    "query_nearest",
+    "query_radius",
+    "query_region",
+    "query_polygon",
+    "query_heatmap",
+    "query_clusters",
+    "query_borough",
+    "query_zip_code",
+    "query_date_range",
+    "query_vehicle_type",
+    "query_injury_range",
+    "query_fatality_range",
+    "query_pedestrian_fatalities",
+    "query_cyclist_fatalities",
+    "query_motorist_fatalities",
+    "query_unique_key",
+    "query_multi_predicate",
+    "query_aggregate",
+    "materialize_records",
+    "ingest_read",
+    "ingest_split",
+    "ingest_tokenize",
+    "ingest_parse",
+    "ingest_store",
+    "ingest_index",
+    "ingest_spatial_index",
+    "ingest_regions",
+    "ingest_upsert",
+    "snapshot_save",
+    "snapshot_load",
+};
+
+const char* const kCounterNames[Metrics::kCounters] = {
+    "ingest_bytes",
+    "ingest_records",
+    "ingest_rejected",
+    "materialized_records",
+};
+
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+} // namespace
+
+std::size_t LatencyHistogram::bucketOf(std::uint64_t nanoseconds) {
+    if (nanoseconds < kSubBuckets) {
+        return static_cast<std::size_t>(nanoseconds);
+    }
+    const unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(nanoseconds));
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    const std::size_t sub = (nanoseconds >> (exponent - kSubBucketBits)) - kSubBuckets;
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::upperBound(std::size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const unsigned shift = static_cast<unsigned>(bucket / kSubBuckets) - 1;
+    const std::uint64_t lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+    return lower + (std::uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds, std::uint64_t count) {
+    buckets_[bucketOf(nanoseconds)] += count;
+    count_ += count;
+    sum_ += nanoseconds * count;
+    max_ = std::max(max_, nanoseconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t LatencyHistogram::percentile(double quantile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<std::uint64_t>(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count_ - 1));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i];
+        if (seen > rank) {
+            return std::min(upperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+void Metrics::record(Operation operation, std::uint64_t nanoseconds) {
+    AtomicHistogram& histogram = localShard().latencies[static_cast<std::size_t>(operation)];
+    bump(histogram.buckets[LatencyHistogram::bucketOf(nanoseconds)], 1);
+    bump(histogram.sum, nanoseconds);
+    if (nanoseconds > histogram.max.load(std::memory_order_relaxed)) {
+        histogram.max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::add(Counter counter, std::uint64_t value) {
+    bump(localShard().counters[static_cast<std::size_t>(counter)], value);
+}
+
+MetricsSnapshot Metrics::snapshot() {
+    std::vector<LatencyHistogram> latencies(kOperations);
+    std::array<std::uint64_t, kCounters> counters{};
+    {
+        Registry& r = registry();
+        std::lock_guard lock(r.mutex);
+        for (const auto& shard : r.shards) {
+            for (std::size_t op = 0; op < kOperations; ++op) {
+                const AtomicHistogram& source = shard->latencies[op];
+                LatencyHistogram histogram;
+                for (std::size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+                    const auto count = source.buckets[b].load(std::memory_order_relaxed);
+                    histogram.buckets_[b] = count;
+                    histogram.count_ += count;
+                }
+                histogram.sum_ = source.sum.load(std::memory_order_relaxed);
+                histogram.max_ = source.max.load(std::memory_order_relaxed);
+                latencies[op].merge(histogram);
+            }
+            for (std::size_t c = 0; c < kCounters; ++c) {
+                counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    MetricsSnapshot snapshot;
+    for (std::size_t op = 0; op < kOperations; ++op) {
+        if (latencies[op].count() > 0) {
+            snapshot.latencies.push_back({kOperationNames[op], latencies[op]});
+        }
+    }
+    for (std::size_t c = 0; c < kCounters; ++c) {
+        snapshot.counters.push_back({kCounterNames[c], counters[c]});
+    }
+    return snapshot;
+}
+
+void Metrics::reset() {
+    Registry& r = registry();
+    std::lock_guard lock(r.mutex);
+    for (const auto& shard : r.shards) {
+        for (auto& histogram : shard->latencies) {
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : shard->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Metrics::enabled() {
+#ifdef NYCOLLISION_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* Metrics::name(Operation operation) { return kOperationNames[static_cast<std::size_t>(operation)]; }
+
+const char* Metrics::name(Counter counter) { return kCounterNames[static_cast<std::size_t>(counter)]; }
+
+std::string MetricsSnapshot::toPrometheus() const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "# HELP nycollision_operation_seconds Latency of queries and ingest stages\n"
+        << "# TYPE nycollision_operation_seconds summary\n";
+    for (const auto& latency : latencies) {
+        const std::string label = "operation=\"" + latency.operation + "\"";
+        for (double quantile : kQuantiles) {
+            out << "nycollision_operation_seconds{" << label << ",quantile=\"" << quantile << "\"} "
+                << latency.histogram.percentile(quantile) * 1e-9 << "\n";
+        }
+        out << "nycollision_operation_seconds_sum{" << label << "} " << latency.histogram.sum() * 1e-9 << "\n"
+            << "nycollision_operation_seconds_count{" << label << "} " << latency.histogram.count() << "\n";
+    }
+    for (const auto& count : counters) {
+        out << "# TYPE nycollision_" << count.counter << "_total counter\n"
+            << "nycollision_" << count.counter << "_total " << count.value << "\n";
+    }
+    return out.str();
+}
+
+std::string MetricsSnapshot::toJson() const {
+    std::ostringstream out;
+    out << "{\n  \"operations\": {";
+    for (std::size_t i = 0; i < latencies.size(); ++i) {
+        const LatencyHistogram& h = latencies[i].histogram;
+        out << (i ? ",\n" : "\n") << "    \"" << latencies[i].operation << "\": {\"count\": " << h.count()
+            << ", \"sum_ns\": " << h.sum() << ", \"mean_ns\": " << static_cast<std::uint64_t>(h.mean())
+            << ", \"max_ns\": " << h.max() << ", \"p50_ns\": " << h.percentile(0.5)
+            << ", \"p90_ns\": " << h.percentile(0.9) << ", \"p99_ns\": " << h.percentile(0.99)
+            << ", \"p999_ns\": " << h.percentile(0.999) << "}";
+    }
+    out << (latencies.empty() ? "" : "\n  ") << "},\n  \"counters\": {";
+    for (std::size_t i = 0; i < counters.size(); ++i) {
+        out << (i ? ", " : "") << "\"" << counters[i].counter << "\": " << counters[i].value;
+    }
+    out << "}\n}\n";
+    return out.str();
+}
+
+void MetricsSnapshot::write(const std::string& filename) const {
+    const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out << (json ? toJson() : toPrometheus());
+        out.flush();
+        if (!out) {
+            out.close();
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Failed to write metrics: " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to replace metrics file: " + filename);
+    }
+}
+
+} // namespace nycollision
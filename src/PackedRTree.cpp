@@ -0,0 +1,123 @@
+#include "../include/nycollision/data/PackedRTree.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace nycollision {
+
+namespace {
+
+// Sort key of a coordinate; NaN sorts last so the order stays strict
+float sortKey(float degrees) { return std::isnan(degrees) ? std::numeric_limits<float>::infinity() : degrees; }
+
+} // namespace
+
+PackedRTree PackedRTree::pack(std::vector<Entry> entries, const ExecutionContext& context) {
+    PackedRTree tree;
+    tree.entries_ = std::move(entries);
+    auto& points = tree.entries_;
+    if (points.empty()) {
+        return tree;
+    }
+
+    // Slices of whole leaves, about as many slices as leaves per slice
+    const std::size_t leaves = (points.size() + kNodeCapacity - 1) / kNodeCapacity;
+    const auto slices = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(leaves))));
+    const std::size_t sliceSize = (leaves + slices - 1) / slices * kNodeCapacity;
+    std::sort(points.begin(), points.end(), [](const Entry& a, const Entry& b) {
+        const float x = sortKey(a.latitude), y = sortKey(b.latitude);
+        return x < y || (x == y && a.row < b.row);
+    });
+    const std::size_t sliceCount = (points.size() + sliceSize - 1) / sliceSize;
+    context.parallelFor(sliceCount, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t s = first; s < last; ++s) {
+            auto begin = points.begin() + s * sliceSize;
+            auto end = points.begin() + std::min(points.size(), (s + 1) * sliceSize);
+            std::sort(begin, end, [](const Entry& a, const Entry& b) {
+                const float x = sortKey(a.longitude), y = sortKey(b.longitude);
+                return x < y || (x == y && a.row < b.row);
+            });
+        }
+    });
+
+    // Leaf boxes, then each level's boxes from the one below until a single root
+    tree.levelStarts_.push_back(0);
+    tree.nodes_.resize(leaves);
+    context.parallelFor(leaves, 1 << 12, [&](std::size_t first, std::size_t last) {
+        for (std::size_t leaf = first; leaf < last; ++leaf) {
+            Bounds box;
+            const std::size_t end = std::min(points.size(), (leaf + 1) * kNodeCapacity);
+            for (std::size_t i = leaf * kNodeCapacity; i < end; ++i) {
+                box.expand({points[i].latitude, points[i].longitude, points[i].latitude, points[i].longitude});
+            }
+            tree.nodes_[leaf] = box;
+        }
+    });
+    tree.levelStarts_.push_back(leaves);
+    for (std::size_t below = leaves; below > 1;) {
+        const std::size_t start = tree.levelStarts_[tree.levelStarts_.size() - 2];
+        const std::size_t nodes = (below + kNodeCapacity - 1) / kNodeCapacity;
+        for (std::size_t node = 0; node < nodes; ++node) {
+            Bounds box;
+            const std::size_t end = std::min(below, (node + 1) * kNodeCapacity);
+            for (std::size_t i = node * kNodeCapacity; i < end; ++i) {
+                box.expand(tree.nodes_[start + i]);
+            }
+            tree.nodes_.push_back(box);
+        }
+        tree.levelStarts_.push_back(tree.nodes_.size());
+        below = nodes;
+    }
+    return tree;
+}
+
+PackedRTree::Shape PackedRTree::shape() const {
+    Shape shape;
+    if (entries_.empty()) {
+        return shape;
+    }
+    shape.levels = levelStarts_.size() - 1;
+    shape.leaves = levelSize(0);
+    shape.internalNodes = nodes_.size() - shape.leaves;
+    shape.minLeafEntries = entries_.size() - (shape.leaves - 1) * kNodeCapacity;
+    shape.maxLeafEntries = std::min(entries_.size(), kNodeCapacity);
+    return shape;
+}
+
+bool PackedRTree::contains(const Entry& entry) const {
+    const Bounds point{entry.latitude, entry.longitude, entry.latitude, entry.longitude};
+    return !query(point, [&entry](const Entry& found) { return found.row != entry.row; });
+}
+
+void PackedRTree::save(SnapshotBuffer& out) const {
+    out.putVector(entries_);
+    out.putVector(nodes_);
+    std::vector<std::uint64_t> levelStarts(levelStarts_.begin(), levelStarts_.end());
+    out.putVector(levelStarts);
+}
+
+PackedRTree PackedRTree::load(SnapshotCursor& in) {
+    PackedRTree tree;
+    in.getVector(tree.entries_);
+    in.getVector(tree.nodes_);
+    std::vector<std::uint64_t> levelStarts;
+    in.getVector(levelStarts);
+    tree.levelStarts_.assign(levelStarts.begin(), levelStarts.end());
+
+    // Every level must group the one below by kNodeCapacity, up to a single root
+    bool valid = tree.entries_.empty() ? tree.nodes_.empty() && tree.levelStarts_.empty()
+                                       : tree.levelStarts_.size() >= 2 && tree.levelStarts_[0] == 0 &&
+                                             tree.levelStarts_.back() == tree.nodes_.size();
+    std::size_t below = tree.entries_.size();
+    for (std::size_t level = 0; valid && level + 1 < tree.levelStarts_.size(); ++level) {
+        valid = tree.levelStarts_[level] <= tree.levelStarts_[level + 1] &&
+                tree.levelSize(level) == (below + kNodeCapacity - 1) / kNodeCapacity;
+        below = tree.levelSize(level);
+    }
+    if (!valid || (!tree.entries_.empty() && below != 1)) {
+        throw std::runtime_error("Snapshot R-tree is inconsistent: " + in.name());
+    }
+    return tree;
+}
+
+} // namespace nycollision
@@ -0,0 +1,184 @@
+#include "../include/nycollision/data/RegionLayer.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+namespace nycollision {
+
+namespace bg = boost::geometry;
+namespace bgi = boost::geometry::index;
+namespace pt = boost::property_tree;
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(),
+                      [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+}
+
+// GeoJSON positions are [longitude, latitude, ...]; arrays are children with empty keys
+RegionLayer::Polygon polygonOf(const pt::ptree& rings) {
+    RegionLayer::Polygon polygon;
+    bool outer = true;
+    for (const auto& ring : rings) {
+        auto& points = outer ? polygon.outer() : polygon.inners().emplace_back();
+        outer = false;
+        for (const auto& position : ring.second) {
+            auto coordinate = position.second.begin();
+            if (position.second.size() < 2) {
+                throw std::runtime_error("GeoJSON position needs a longitude and a latitude");
+            }
+            const double longitude = coordinate->second.get_value<double>();
+            const double latitude = (++coordinate)->second.get_value<double>();
+            points.emplace_back(longitude, latitude);
+        }
+    }
+    return polygon;
+}
+
+} // namespace
+
+std::shared_ptr<RegionLayer> RegionLayer::load(const std::string& name, const std::string& filename,
+                                               const std::string& nameProperty) {
+    if (endsWith(filename, ".geojson") || endsWith(filename, ".json")) {
+        return fromGeoJson(name, filename, nameProperty);
+    }
+    return fromWkt(name, filename);
+}
+
+std::shared_ptr<RegionLayer> RegionLayer::fromGeoJson(const std::string& name, const std::string& filename,
+                                                      const std::string& nameProperty) {
+    pt::ptree root;
+    try {
+        pt::read_json(filename, root);
+    } catch (const pt::json_parser_error& e) {
+        throw std::runtime_error("Failed to read GeoJSON: " + std::string(e.what()));
+    }
+    auto features = root.get_child_optional("features");
+    if (root.get<std::string>("type", "") != "FeatureCollection" || !features) {
+        throw std::runtime_error("Not a GeoJSON FeatureCollection: " + filename);
+    }
+
+    auto layer = std::make_shared<RegionLayer>(name);
+    for (const auto& entry : *features) {
+        const pt::ptree& feature = entry.second;
+        const std::string type = feature.get<std::string>("geometry.type", "");
+        auto coordinates = feature.get_child_optional("geometry.coordinates");
+        if ((type != "Polygon" && type != "MultiPolygon") || !coordinates) {
+            continue;
+        }
+
+        // Looked up by key, so property names may contain dots
+        static const pt::ptree kNoProperties;
+        const pt::ptree& properties = feature.get_child("properties", kNoProperties);
+        auto property = properties.find(nameProperty);
+        if (property == properties.not_found()) {
+            throw std::runtime_error("GeoJSON feature without property \"" + nameProperty + "\": " + filename);
+        }
+
+        MultiPolygon area;
+        if (type == "Polygon") {
+            area.push_back(polygonOf(*coordinates));
+        } else {
+            for (const auto& polygon : *coordinates) {
+                area.push_back(polygonOf(polygon.second));
+            }
+        }
+        layer->add(property->second.data(), std::move(area));
+    }
+    return layer;
+}
+
+std::shared_ptr<RegionLayer> RegionLayer::fromWkt(const std::string& name, const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    auto layer = std::make_shared<RegionLayer>(name);
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); ++number) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const auto tab = line.find('\t');
+        if (tab == std::string::npos) {
+            throw std::runtime_error(filename + ":" + std::to_string(number) + ": expected <name><TAB><WKT>");
+        }
+        try {
+            layer->addWkt(line.substr(0, tab), line.substr(tab + 1));
+        } catch (const std::exception& e) {
+            throw std::runtime_error(filename + ":" + std::to_string(number) + ": " + e.what());
+        }
+    }
+    return layer;
+}
+
+RegionLayer::RegionId RegionLayer::add(const std::string& region, MultiPolygon area) {
+    bg::correct(area);
+    auto [it, added] = ids_.emplace(region, static_cast<RegionId>(regions_.size()));
+    const RegionId id = it->second;
+    if (added) {
+        regions_.push_back({region, {}});
+    }
+    for (auto& polygon : area) {
+        boxes_.insert(Entry(bg::return_envelope<Box>(polygon), id));
+        regions_[id].area.push_back(std::move(polygon));
+    }
+    return id;
+}
+
+RegionLayer::RegionId RegionLayer::addWkt(const std::string& region, const std::string& wkt) {
+    std::size_t start = 0;
+    while (start < wkt.size() && std::isspace(static_cast<unsigned char>(wkt[start]))) {
+        ++start;
+    }
+    auto startsWith = [&](const char* keyword) {
+        for (std::size_t i = 0; keyword[i]; ++i) {
+            if (start + i >= wkt.size() || std::toupper(static_cast<unsigned char>(wkt[start + i])) != keyword[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    MultiPolygon area;
+    try {
+        if (startsWith("MULTIPOLYGON")) {
+            bg::read_wkt(wkt, area);
+        } else if (startsWith("POLYGON")) {
+            Polygon polygon;
+            bg::read_wkt(wkt, polygon);
+            area.push_back(std::move(polygon));
+        } else {
+            throw std::runtime_error("expected POLYGON or MULTIPOLYGON");
+        }
+    } catch (const bg::read_wkt_exception& e) {
+        throw std::runtime_error(std::string("Invalid WKT: ") + e.what());
+    }
+    return add(region, std::move(area));
+}
+
+RegionLayer::RegionId RegionLayer::find(const std::string& region) const {
+    auto it = ids_.find(region);
+    return it != ids_.end() ? it->second : kNoRegion;
+}
+
+RegionLayer::RegionId RegionLayer::regionOf(float latitude, float longitude) const {
+    const Point point(longitude, latitude);
+    RegionId best = kNoRegion;
+    for (auto it = boxes_.qbegin(bgi::intersects(point)); it != boxes_.qend(); ++it) {
+        if (it->second < best && bg::covered_by(point, regions_[it->second].area)) {
+            best = it->second;
+        }
+    }
+    return best;
+}
+
+} // namespace nycollision
@@ -0,0 +1,230 @@
+#include "../include/nycollision/data/RollupCube.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+#include <tuple>
+
+namespace nycollision {
+
+namespace {
+
+std::vector<StringPool::Code> codesOf(const StringPool& pool, StringDomain domain,
+                                      const std::vector<std::string>& values) {
+    std::vector<StringPool::Code> codes;
+    for (const auto& value : values) {
+        auto code = pool.find(domain, value);
+        if (code != StringPool::kNotFound) {
+            codes.push_back(code);
+        }
+    }
+    return codes;
+}
+
+bool inRange(int value, int first, int last) { return value >= first && value <= last; }
+
+bool listed(const std::vector<StringPool::Code>& codes, StringPool::Code code) {
+    return std::find(codes.begin(), codes.end(), code) != codes.end();
+}
+
+} // namespace
+
+int RollupCube::monthOf(Timestamp timestamp) {
+    return timestamp == kInvalidTimestamp ? kUnknown : monthOf(CalendarDate::fromTimestamp(timestamp));
+}
+
+template <typename Apply>
+void RollupCube::forEachCell(const ColumnStore& store, RowId row, Apply&& apply) {
+    const Timestamp timestamp = store.timestamp(row);
+    Key key;
+    key.borough = store.boroughCode(row);
+    key.month = monthOf(timestamp);
+    if (timestamp != kInvalidTimestamp) {
+        int minute = timestamp % kMinutesPerDay;
+        key.hour = (minute < 0 ? minute + kMinutesPerDay : minute) / 60;
+    }
+
+    CasualtyTotals totals;
+    totals.collisions = 1;
+    for (std::size_t i = 0; i < kCasualtyFieldCount; ++i) {
+        totals.casualties[i] = store.casualty(static_cast<CasualtyField>(i), row);
+    }
+    apply(false, key, totals);
+
+    // Once per distinct vehicle type; slots are filled from the front
+    const Code* types = store.vehicleTypeCodes(row);
+    if (types[0] == StringPool::kEmpty) {
+        apply(true, key, totals);
+        return;
+    }
+    for (std::size_t i = 0; i < ColumnStore::kVehicleSlots && types[i] != StringPool::kEmpty; ++i) {
+        if (std::find(types, types + i, types[i]) == types + i) {
+            key.vehicleType = types[i];
+            apply(true, key, totals);
+        }
+    }
+}
+
+RollupCube::Shard& RollupCube::shardFor(int month) {
+    auto& shard = shards_[month];
+    if (!shard) {
+        shard = std::make_shared<Shard>();
+    } else if (shard.use_count() > 1) {
+        shard = std::make_shared<Shard>(*shard);
+    }
+    return *shard;
+}
+
+std::size_t RollupCube::cellCount() const {
+    std::size_t count = 0;
+    for (const auto& [month, shard] : shards_) {
+        count += shard->cells.size() + shard->vehicleCells.size();
+    }
+    return count;
+}
+
+void RollupCube::addRows(const ColumnStore& store, RowId first, RowId last, Cells& cells, Cells& vehicleCells) {
+    for (RowId row = first; row < last; ++row) {
+        forEachCell(store, row, [&](bool byVehicle, const Key& key, const CasualtyTotals& totals) {
+            (byVehicle ? vehicleCells : cells)[key] += totals;
+        });
+    }
+}
+
+void RollupCube::add(const ColumnStore& store, RowId first, RowId last, const ExecutionContext& context) {
+    constexpr std::size_t kMinPartitionRows = std::size_t{1} << 16;
+    const std::size_t rows = last - first;
+    const std::size_t partitions = std::clamp<std::size_t>(rows / kMinPartitionRows, 1, context.threads());
+
+    std::vector<Cells> cells(partitions);
+    std::vector<Cells> vehicleCells(partitions);
+    context.parallelFor(partitions, 1, [&](std::size_t firstPart, std::size_t lastPart) {
+        for (std::size_t p = firstPart; p < lastPart; ++p) {
+            addRows(store, static_cast<RowId>(first + rows * p / partitions),
+                    static_cast<RowId>(first + rows * (p + 1) / partitions), cells[p], vehicleCells[p]);
+        }
+    });
+
+    for (std::size_t p = 0; p < partitions; ++p) {
+        for (const auto& [key, totals] : cells[p]) {
+            addCell(false, key, totals);
+        }
+        for (const auto& [key, totals] : vehicleCells[p]) {
+            addCell(true, key, totals);
+        }
+    }
+}
+
+void RollupCube::add(const ColumnStore& store, const std::vector<RowId>& rows) {
+    for (RowId row : rows) {
+        forEachCell(store, row, [this](bool byVehicle, const Key& key, const CasualtyTotals& totals) {
+            addCell(byVehicle, key, totals);
+        });
+    }
+}
+
+void RollupCube::remove(const ColumnStore& store, const std::vector<RowId>& rows) {
+    for (RowId row : rows) {
+        forEachCell(store, row, [this](bool byVehicle, const Key& key, const CasualtyTotals& totals) {
+            if (shards_.count(key.month) == 0) {
+                return;
+            }
+            Shard& shard = shardFor(key.month);
+            Cells& cells = byVehicle ? shard.vehicleCells : shard.cells;
+            auto it = cells.find(key);
+            if (it == cells.end()) {
+                return;
+            }
+            it->second -= totals;
+            if (it->second.collisions == 0) {
+                cells.erase(it);
+            }
+            if (shard.cells.empty() && shard.vehicleCells.empty()) {
+                shards_.erase(key.month);
+            }
+        });
+    }
+}
+
+CasualtyTotals RollupCube::total(const CubeSlice& slice) const {
+    auto groups = groupBy(0, slice);
+    return groups.empty() ? CasualtyTotals{} : groups.front().totals;
+}
+
+std::vector<RollupCube::Group> RollupCube::groupBy(unsigned dimensions, const CubeSlice& slice) const {
+    const auto boroughs = codesOf(*pool_, StringDomain::Borough, slice.boroughs);
+    const auto vehicleTypes = codesOf(*pool_, StringDomain::VehicleType, slice.vehicleTypes);
+    const bool byVehicle = (dimensions & VehicleType) || !slice.vehicleTypes.empty();
+
+    // Names missing from the pool have no code, so a list of only those matches nothing
+    Cells grouped;
+    for (const auto& [month, shard] : shards_) {
+        if (!inRange(month, slice.firstMonth, slice.lastMonth)) {
+            continue;
+        }
+        for (const auto& [key, totals] : byVehicle ? shard->vehicleCells : shard->cells) {
+            if ((!slice.boroughs.empty() && !listed(boroughs, key.borough)) ||
+                (!slice.vehicleTypes.empty() && !listed(vehicleTypes, key.vehicleType)) ||
+                !inRange(key.hour, slice.firstHour, slice.lastHour)) {
+                continue;
+            }
+            Key group;
+            group.borough = (dimensions & Borough) ? key.borough : 0;
+            group.month = (dimensions & Month) ? key.month : kUnknown;
+            group.hour = (dimensions & Hour) ? key.hour : kUnknown;
+            group.vehicleType = (dimensions & VehicleType) ? key.vehicleType : 0;
+            grouped[group] += totals;
+        }
+    }
+
+    std::vector<Group> result;
+    result.reserve(grouped.size());
+    for (const auto& [key, totals] : grouped) {
+        Group group;
+        if (dimensions & Borough) group.borough = pool_->decode(StringDomain::Borough, key.borough);
+        if (dimensions & VehicleType) group.vehicleType = pool_->decode(StringDomain::VehicleType, key.vehicleType);
+        group.month = key.month;
+        group.hour = key.hour;
+        group.totals = totals;
+        result.push_back(std::move(group));
+    }
+    std::sort(result.begin(), result.end(), [](const Group& a, const Group& b) {
+        return std::tie(a.borough, a.month, a.hour, a.vehicleType) <
+               std::tie(b.borough, b.month, b.hour, b.vehicleType);
+    });
+    return result;
+}
+
+void RollupCube::saveCells(bool byVehicle, SnapshotBuffer& out) const {
+    std::uint64_t count = 0;
+    for (const auto& [month, shard] : shards_) {
+        count += (byVehicle ? shard->vehicleCells : shard->cells).size();
+    }
+    out.put(count);
+    for (const auto& [month, shard] : shards_) {
+        for (const auto& [key, totals] : byVehicle ? shard->vehicleCells : shard->cells) {
+            out.put(key);
+            out.put(totals);
+        }
+    }
+}
+
+void RollupCube::loadCells(bool byVehicle, SnapshotCursor& in) {
+    const auto count = in.get<std::uint64_t>();
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const Key key = in.get<Key>();
+        Shard& shard = shardFor(key.month);
+        (byVehicle ? shard.vehicleCells : shard.cells)[key] = in.get<CasualtyTotals>();
+    }
+}
+
+void RollupCube::save(SnapshotBuffer& out) const {
+    saveCells(false, out);
+    saveCells(true, out);
+}
+
+void RollupCube::load(SnapshotCursor& in) {
+    shards_.clear();
+    loadCells(false, in);
+    loadCells(true, in);
+}
+
+} // namespace nycollision
@@ -0,0 +1,436 @@
+#include "../include/nycollision/data/RowBitmap.h"
+#include "../include/nycollision/util/Snapshot.h"
+#include <algorithm>
+#include <iterator>
+
+namespace nycollision {
+
+namespace {
+
+std::uint16_t keyOf(RowId row) { return static_cast<std::uint16_t>(row >> 16); }
+std::uint16_t lowOf(RowId row) { return static_cast<std::uint16_t>(row & 0xFFFF); }
+
+std::size_t popcount(const std::vector<std::uint64_t>& words) {
+    std::size_t count = 0;
+    for (std::uint64_t word : words) {
+        count += static_cast<std::size_t>(__builtin_popcountll(word));
+    }
+    return count;
+}
+
+bool testBit(const std::vector<std::uint64_t>& words, std::uint16_t low) {
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+} // namespace
+
+RowBitmap::const_iterator::const_iterator(const RowBitmap* bitmap, std::size_t container)
+    : bitmap_(bitmap), container_(container) {
+    settle();
+}
+
+void RowBitmap::const_iterator::advance() {
+    // Bitmap containers already dropped the current bit from word_
+    if (bitmap_->containers_[container_]->bits.empty()) {
+        ++position_;
+    }
+    settle();
+}
+
+void RowBitmap::const_iterator::settle() {
+    const auto& containers = bitmap_->containers_;
+    while (container_ < containers.size()) {
+        const auto& container = *containers[container_];
+        const RowId base = static_cast<RowId>(container.key) << 16;
+        if (container.bits.empty()) {
+            if (position_ < container.array.size()) {
+                row_ = base | container.array[position_];
+                return;
+            }
+        } else {
+            // position_ is the next word to load
+            while (word_ == 0 && position_ < kWords) {
+                word_ = container.bits[position_++];
+            }
+            if (word_ != 0) {
+                row_ = base | static_cast<RowId>((position_ - 1) * 64 + __builtin_ctzll(word_));
+                word_ &= word_ - 1;
+                return;
+            }
+        }
+        ++container_;
+        position_ = 0;
+        word_ = 0;
+    }
+}
+
+RowBitmap RowBitmap::fromSorted(const RowId* rows, std::size_t count) {
+    RowBitmap bitmap;
+    for (std::size_t i = 0; i < count; ++i) {
+        bitmap.add(rows[i]);
+    }
+    bitmap.shrinkToFit();
+    return bitmap;
+}
+
+RowBitmap::Container& RowBitmap::own(ContainerPtr& container) {
+    if (container.use_count() > 1) {
+        container = std::make_shared<Container>(*container);
+    }
+    return *container;
+}
+
+RowBitmap::Container& RowBitmap::containerFor(std::uint16_t key) {
+    if (containers_.empty() || containers_.back()->key < key) {
+        containers_.push_back(std::make_shared<Container>(Container{key, 0, {}, {}}));
+        return *containers_.back();
+    }
+    if (containers_.back()->key == key) {
+        return own(containers_.back());
+    }
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const ContainerPtr& c, std::uint16_t k) { return c->key < k; });
+    if (it == containers_.end() || (*it)->key != key) {
+        it = containers_.insert(it, std::make_shared<Container>(Container{key, 0, {}, {}}));
+    }
+    return own(*it);
+}
+
+const RowBitmap::Container* RowBitmap::findContainer(std::uint16_t key) const {
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const ContainerPtr& c, std::uint16_t k) { return c->key < k; });
+    return it != containers_.end() && (*it)->key == key ? it->get() : nullptr;
+}
+
+void RowBitmap::add(RowId row) {
+    Container& container = containerFor(keyOf(row));
+    const std::uint16_t low = lowOf(row);
+
+    if (!container.bits.empty()) {
+        std::uint64_t& word = container.bits[low >> 6];
+        const std::uint64_t mask = std::uint64_t{1} << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            ++container.cardinality;
+            ++cardinality_;
+        }
+        return;
+    }
+
+    auto& array = container.array;
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    } else {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (*it == low) {
+            return;
+        }
+        array.insert(it, low);
+    }
+    ++container.cardinality;
+    ++cardinality_;
+    if (array.size() > kArrayLimit) {
+        toBitmap(container);
+    }
+}
+
+void RowBitmap::remove(RowId row) {
+    const std::uint16_t key = keyOf(row);
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const ContainerPtr& c, std::uint16_t k) { return c->key < k; });
+    if (it == containers_.end() || (*it)->key != key) {
+        return;
+    }
+    const std::uint16_t low = lowOf(row);
+    const Container& current = **it;
+    const bool present = current.bits.empty()
+                             ? std::binary_search(current.array.begin(), current.array.end(), low)
+                             : testBit(current.bits, low);
+    if (!present) {
+        return;
+    }
+    Container& container = own(*it);
+
+    if (!container.bits.empty()) {
+        container.bits[low >> 6] &= ~(std::uint64_t{1} << (low & 63));
+        if (--container.cardinality <= kArrayLimit) {
+            toArray(container);
+        }
+    } else {
+        container.array.erase(std::lower_bound(container.array.begin(), container.array.end(), low));
+        --container.cardinality;
+    }
+    --cardinality_;
+    if (container.cardinality == 0) {
+        containers_.erase(it);
+    }
+}
+
+bool RowBitmap::contains(RowId row) const {
+    const Container* container = findContainer(keyOf(row));
+    if (!container) {
+        return false;
+    }
+    const std::uint16_t low = lowOf(row);
+    if (!container->bits.empty()) {
+        return testBit(container->bits, low);
+    }
+    return std::binary_search(container->array.begin(), container->array.end(), low);
+}
+
+void RowBitmap::toBitmap(Container& container) {
+    container.bits.assign(kWords, 0);
+    for (std::uint16_t low : container.array) {
+        container.bits[low >> 6] |= std::uint64_t{1} << (low & 63);
+    }
+    container.array.clear();
+    container.array.shrink_to_fit();
+}
+
+void RowBitmap::toArray(Container& container) {
+    container.array.clear();
+    container.array.reserve(container.cardinality);
+    for (std::size_t w = 0; w < kWords; ++w) {
+        for (std::uint64_t word = container.bits[w]; word != 0; word &= word - 1) {
+            container.array.push_back(static_cast<std::uint16_t>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    container.bits.clear();
+    container.bits.shrink_to_fit();
+}
+
+void RowBitmap::intersect(Container& into, const Container& other) {
+    if (!into.bits.empty() && !other.bits.empty()) {
+        for (std::size_t w = 0; w < kWords; ++w) {
+            into.bits[w] &= other.bits[w];
+        }
+        into.cardinality = static_cast<std::uint32_t>(popcount(into.bits));
+        if (into.cardinality <= kArrayLimit) {
+            toArray(into);
+        }
+        return;
+    }
+
+    std::vector<std::uint16_t> result;
+    if (into.bits.empty() && other.bits.empty()) {
+        result.reserve(std::min(into.array.size(), other.array.size()));
+        std::set_intersection(into.array.begin(), into.array.end(), other.array.begin(), other.array.end(),
+                              std::back_inserter(result));
+    } else {
+        // One side is an array: keep its offsets that the bitmap side has
+        const auto& array = into.bits.empty() ? into.array : other.array;
+        const auto& bits = into.bits.empty() ? other.bits : into.bits;
+        result.reserve(array.size());
+        for (std::uint16_t low : array) {
+            if (testBit(bits, low)) {
+                result.push_back(low);
+            }
+        }
+        into.bits.clear();
+        into.bits.shrink_to_fit();
+    }
+    into.array = std::move(result);
+    into.cardinality = static_cast<std::uint32_t>(into.array.size());
+}
+
+void RowBitmap::unite(Container& into, const Container& other) {
+    if (into.bits.empty() && other.bits.empty() &&
+        into.array.size() + other.array.size() <= kArrayLimit) {
+        std::vector<std::uint16_t> result;
+        result.reserve(into.array.size() + other.array.size());
+        std::set_union(into.array.begin(), into.array.end(), other.array.begin(), other.array.end(),
+                       std::back_inserter(result));
+        into.array = std::move(result);
+        into.cardinality = static_cast<std::uint32_t>(into.array.size());
+        return;
+    }
+
+    if (into.bits.empty()) {
+        toBitmap(into);
+    }
+    if (other.bits.empty()) {
+        for (std::uint16_t low : other.array) {
+            into.bits[low >> 6] |= std::uint64_t{1} << (low & 63);
+        }
+    } else {
+        for (std::size_t w = 0; w < kWords; ++w) {
+            into.bits[w] |= other.bits[w];
+        }
+    }
+    into.cardinality = static_cast<std::uint32_t>(popcount(into.bits));
+    if (into.cardinality <= kArrayLimit) {
+        toArray(into);
+    }
+}
+
+RowBitmap& RowBitmap::operator&=(const RowBitmap& other) {
+    std::vector<ContainerPtr> result;
+    auto a = containers_.begin();
+    auto b = other.containers_.begin();
+    cardinality_ = 0;
+    while (a != containers_.end() && b != other.containers_.end()) {
+        if ((*a)->key < (*b)->key) {
+            ++a;
+        } else if ((*b)->key < (*a)->key) {
+            ++b;
+        } else {
+            if (*a != *b) {
+                intersect(own(*a), **b);
+            }
+            if ((*a)->cardinality != 0) {
+                cardinality_ += (*a)->cardinality;
+                result.push_back(std::move(*a));
+            }
+            ++a;
+            ++b;
+        }
+    }
+    containers_ = std::move(result);
+    return *this;
+}
+
+RowBitmap& RowBitmap::operator|=(const RowBitmap& other) {
+    if (other.empty()) {
+        return *this;
+    }
+    // Appending a bitmap whose rows all come later, as partitioned builds do
+    if (!containers_.empty() && containers_.back()->key < other.containers_.front()->key) {
+        containers_.insert(containers_.end(), other.containers_.begin(), other.containers_.end());
+        cardinality_ += other.cardinality_;
+        return *this;
+    }
+
+    std::vector<ContainerPtr> result;
+    result.reserve(containers_.size() + other.containers_.size());
+    auto a = containers_.begin();
+    auto b = other.containers_.begin();
+    while (a != containers_.end() || b != other.containers_.end()) {
+        if (b == other.containers_.end() || (a != containers_.end() && (*a)->key < (*b)->key)) {
+            result.push_back(std::move(*a++));
+        } else if (a == containers_.end() || (*b)->key < (*a)->key) {
+            result.push_back(*b++);
+        } else {
+            if (*a != *b) {
+                unite(own(*a), **b);
+            }
+            result.push_back(std::move(*a));
+            ++a;
+            ++b;
+        }
+    }
+    containers_ = std::move(result);
+    cardinality_ = 0;
+    for (const auto& container : containers_) {
+        cardinality_ += container->cardinality;
+    }
+    return *this;
+}
+
+bool RowBitmap::operator==(const RowBitmap& other) const {
+    if (cardinality_ != other.cardinality_ || containers_.size() != other.containers_.size()) {
+        return false;
+    }
+    // Both sides convert at the same cardinality, so equal sets have equal layouts
+    for (std::size_t i = 0; i < containers_.size(); ++i) {
+        if (containers_[i] == other.containers_[i]) {
+            continue;
+        }
+        const auto& a = *containers_[i];
+        const auto& b = *other.containers_[i];
+        if (a.key != b.key || a.cardinality != b.cardinality || a.array != b.array || a.bits != b.bits) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t RowBitmap::decodeContainer(std::size_t index, RowId* out) const {
+    const Container& container = *containers_[index];
+    const RowId base = static_cast<RowId>(container.key) << 16;
+    std::size_t count = 0;
+    if (container.bits.empty()) {
+        for (std::uint16_t low : container.array) {
+            out[count++] = base | low;
+        }
+        return count;
+    }
+    for (std::size_t w = 0; w < kWords; ++w) {
+        for (std::uint64_t word = container.bits[w]; word != 0; word &= word - 1) {
+            out[count++] = base | static_cast<RowId>(w * 64 + __builtin_ctzll(word));
+        }
+    }
+    return count;
+}
+
+std::vector<RowId> RowBitmap::toVector() const {
+    std::vector<RowId> rows(cardinality_);
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < containers_.size(); ++i) {
+        offset += decodeContainer(i, rows.data() + offset);
+    }
+    return rows;
+}
+
+std::size_t RowBitmap::memoryUsage() const {
+    std::size_t bytes = containers_.capacity() * sizeof(ContainerPtr);
+    for (const auto& container : containers_) {
+        bytes += sizeof(Container);
+        bytes += container->array.capacity() * sizeof(std::uint16_t);
+        bytes += container->bits.capacity() * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
+
+void RowBitmap::shrinkToFit() {
+    containers_.shrink_to_fit();
+    for (auto& container : containers_) {
+        if (container->array.capacity() != container->array.size()) {
+            own(container).array.shrink_to_fit();
+        }
+    }
+}
+
+void RowBitmap::save(SnapshotBuffer& out) const {
+    out.put<std::uint64_t>(containers_.size());
+    for (const auto& shared : containers_) {
+        const Container& container = *shared;
+        out.put(container.key);
+        out.put(container.cardinality);
+        out.put<std::uint8_t>(container.bits.empty() ? 0 : 1);
+        if (container.bits.empty()) {
+            out.putVector(container.array);
+        } else {
+            out.putVector(container.bits);
+        }
+    }
+}
+
+RowBitmap RowBitmap::load(SnapshotCursor& in) {
+    RowBitmap bitmap;
+    const auto count = in.get<std::uint64_t>();
+    if (count > kContainerRows) {
+        throw std::runtime_error("Invalid bitmap in snapshot section: " + in.name());
+    }
+    bitmap.containers_.resize(count);
+    for (auto& shared : bitmap.containers_) {
+        shared = std::make_shared<Container>();
+        Container& container = *shared;
+        container.key = in.get<std::uint16_t>();
+        container.cardinality = in.get<std::uint32_t>();
+        bool valid;
+        if (in.get<std::uint8_t>() != 0) {
+            in.getVector(container.bits);
+            valid = container.bits.size() == kWords && popcount(container.bits) == container.cardinality;
+        } else {
+            in.getVector(container.array);
+            valid = container.array.size() == container.cardinality;
+        }
+        if (!valid) {
+            throw std::runtime_error("Invalid bitmap in snapshot section: " + in.name());
+        }
+        bitmap.cardinality_ += container.cardinality;
+    }
+    return bitmap;
+}
+
+} // namespace nycollision
@@ -0,0 +1,317 @@
+#include "../include/nycollision/util/Snapshot.h"
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nycollision {
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'Y', 'C', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr std::size_t kAlignment = 64;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint32_t sectionCount;
+    std::uint32_t tableCrc;  // Over the section table
+    std::uint64_t tableOffset;
+};
+
+struct SectionEntry {
+    char name[SnapshotWriter::kMaxNameLength + 1];
+    std::uint32_t crc;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader> && std::is_trivially_copyable_v<SectionEntry>);
+
+// Slicing-by-8 tables for the reflected polynomial 0xEDB88320
+using CrcTables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+const CrcTables& crcTables() {
+    static const CrcTables tables = [] {
+        CrcTables t{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            }
+            t[0][i] = crc;
+        }
+        for (std::size_t slice = 1; slice < t.size(); ++slice) {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                t[slice][i] = (t[slice - 1][i] >> 8) ^ t[0][t[slice - 1][i] & 0xFF];
+            }
+        }
+        return t;
+    }();
+    return tables;
+}
+
+std::uint64_t alignUp(std::uint64_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+
+std::string directoryOf(const std::string& filename) {
+    const std::size_t slash = filename.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : filename.substr(0, slash);
+}
+
+// Makes a rename within the directory durable
+void syncDirectory(const std::string& directory) {
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open directory: " + directory);
+    }
+    const int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync directory: " + directory);
+    }
+}
+
+FileHeader readHeader(const MappedFile& file, const std::string& filename) {
+    FileHeader header;
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error("Not a snapshot file: " + filename);
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a snapshot file: " + filename);
+    }
+    if (header.byteOrder != kByteOrderMark) {
+        throw std::runtime_error("Snapshot written with another byte order: " + filename);
+    }
+    if (header.version != SnapshotReader::kFormatVersion) {
+        throw std::runtime_error("Unsupported snapshot format version " + std::to_string(header.version) +
+                                 ": " + filename);
+    }
+    return header;
+}
+
+} // namespace
+
+std::uint32_t crc32(const void* data, std::size_t size, std::uint32_t crc) {
+    const auto& t = crcTables();
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, bytes += 8) {
+        std::uint32_t lo;
+        std::uint32_t hi;
+        std::memcpy(&lo, bytes, 4);
+        std::memcpy(&hi, bytes + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; --size, ++bytes) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes) & 0xFF];
+    }
+    return ~crc;
+}
+
+SnapshotSource SnapshotSource::of(const std::string& filename) {
+    struct stat st {};
+    if (::stat(filename.c_str(), &st) != 0) {
+        throw std::runtime_error("Failed to stat file: " + filename);
+    }
+    SnapshotSource source;
+    source.size = static_cast<std::uint64_t>(st.st_size);
+    source.modified_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return source;
+}
+
+void SnapshotBuffer::spill(const void* data, std::size_t size) {
+    if (finished_) {
+        throw std::logic_error("Snapshot section already finished: " + name_);
+    }
+    flush();
+    if (size < kStagingBytes) {
+        pending_.append(static_cast<const char*>(data), size);
+    } else {
+        crc_ = crc32(data, size, crc_);
+        writer_->writeBytes(data, size);
+    }
+    size_ += size;
+}
+
+void SnapshotBuffer::flush() {
+    crc_ = crc32(pending_.data(), pending_.size(), crc_);
+    writer_->writeBytes(pending_.data(), pending_.size());
+    pending_.clear();
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& filename, SnapshotSource source)
+    : filename_(filename), temporary_(filename + ".XXXXXX"), source_(source) {
+    fd_ = ::mkstemp(temporary_.data());
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to create snapshot: " + temporary_);
+    }
+    // The header is written by commit(), once the table's position is known
+    offset_ = sizeof(FileHeader);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        ::unlink(temporary_.c_str());
+    }
+}
+
+SnapshotBuffer& SnapshotWriter::section(const std::string& name) {
+    if (name.empty() || name.size() > kMaxNameLength) {
+        throw std::invalid_argument("Invalid snapshot section name: " + name);
+    }
+    for (const auto& section : sections_) {
+        if (section->name_ == name) {
+            throw std::invalid_argument("Duplicate snapshot section: " + name);
+        }
+    }
+    if (fd_ < 0) {
+        throw std::logic_error("Snapshot already committed: " + filename_);
+    }
+    finishSection();
+    pad();
+    sections_.push_back(std::unique_ptr<SnapshotBuffer>(new SnapshotBuffer(*this, name, offset_)));
+    return *sections_.back();
+}
+
+void SnapshotWriter::commit() {
+    if (fd_ < 0) {
+        throw std::logic_error("Snapshot already committed: " + filename_);
+    }
+    finishSection();
+
+    std::vector<SectionEntry> table(sections_.size());
+    for (std::size_t i = 0; i < sections_.size(); ++i) {
+        const SnapshotBuffer& section = *sections_[i];
+        SectionEntry& entry = table[i];
+        std::memset(&entry, 0, sizeof(entry));
+        section.name_.copy(entry.name, kMaxNameLength);
+        entry.crc = section.crc_;
+        entry.offset = section.offset_;
+        entry.size = section.size_;
+    }
+    pad();
+    const std::uint64_t tableOffset = offset_;
+    writeBytes(table.data(), table.size() * sizeof(SectionEntry));
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = SnapshotReader::kFormatVersion;
+    header.byteOrder = kByteOrderMark;
+    header.sourceSize = source_.size;
+    header.sourceModified = source_.modified_ns;
+    header.sectionCount = static_cast<std::uint32_t>(table.size());
+    header.tableCrc = crc32(table.data(), table.size() * sizeof(SectionEntry));
+    header.tableOffset = tableOffset;
+    writeAt(0, &header, sizeof(header));
+
+    if (::fsync(fd_) != 0) {
+        throw std::runtime_error("Failed to sync snapshot: " + temporary_);
+    }
+    const int fd = std::exchange(fd_, -1);
+    if (::close(fd) != 0 || std::rename(temporary_.c_str(), filename_.c_str()) != 0) {
+        ::unlink(temporary_.c_str());
+        throw std::runtime_error("Failed to replace snapshot: " + filename_);
+    }
+    syncDirectory(directoryOf(filename_));
+}
+
+void SnapshotWriter::writeAt(std::uint64_t offset, const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd_, bytes, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to write snapshot: " + temporary_);
+        }
+        bytes += written;
+        offset += static_cast<std::uint64_t>(written);
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+void SnapshotWriter::writeBytes(const void* data, std::size_t size) {
+    writeAt(offset_, data, size);
+    offset_ += size;
+}
+
+void SnapshotWriter::pad() {
+    static const char padding[kAlignment] = {};
+    writeBytes(padding, alignUp(offset_) - offset_);
+}
+
+void SnapshotWriter::finishSection() {
+    if (sections_.empty() || sections_.back()->finished_) {
+        return;
+    }
+    SnapshotBuffer& section = *sections_.back();
+    section.flush();
+    std::string().swap(section.pending_);
+    section.finished_ = true;
+}
+
+SnapshotReader::SnapshotReader(const std::string& filename) : file_(filename) {
+    const FileHeader header = readHeader(file_, filename);
+    source_.size = header.sourceSize;
+    source_.modified_ns = header.sourceModified;
+
+    const std::size_t tableBytes = std::size_t{header.sectionCount} * sizeof(SectionEntry);
+    if (header.tableOffset > file_.size() || tableBytes > file_.size() - header.tableOffset) {
+        throw std::runtime_error("Snapshot section table truncated: " + filename);
+    }
+    std::vector<SectionEntry> table(header.sectionCount);
+    std::memcpy(table.data(), file_.data() + header.tableOffset, tableBytes);
+    if (crc32(table.data(), tableBytes) != header.tableCrc) {
+        throw std::runtime_error("Snapshot section table is corrupt: " + filename);
+    }
+
+    for (const auto& entry : table) {
+        if (entry.offset > file_.size() || entry.size > file_.size() - entry.offset) {
+            throw std::runtime_error("Snapshot section out of bounds: " + filename);
+        }
+        std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        sections_[name] = {std::string_view(file_.data() + entry.offset, entry.size), entry.crc};
+    }
+}
+
+SnapshotCursor SnapshotReader::section(const std::string& name) const {
+    auto it = sections_.find(name);
+    if (it == sections_.end()) {
+        throw std::runtime_error("Snapshot section missing: " + name);
+    }
+    const auto& [bytes, crc] = it->second;
+    if (crc32(bytes.data(), bytes.size()) != crc) {
+        throw std::runtime_error("Snapshot section is corrupt: " + name);
+    }
+    return SnapshotCursor(bytes, name);
+}
+
+bool SnapshotReader::isFresh(const std::string& snapshot, const std::string& source) {
+    try {
+        MappedFile file(snapshot);
+        const FileHeader header = readHeader(file, snapshot);
+        return SnapshotSource{header.sourceSize, header.sourceModified} == SnapshotSource::of(source);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+} // namespace nycollision
@@ -0,0 +1,375 @@
+#include "../include/nycollision/data/SpatialClustering.h"
+#include "../include/nycollision/core/GeoDistance.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace nycollision {
+
+namespace {
+
+struct UnitVector {
+    double x, y, z;
+};
+
+UnitVector unitVectorOf(float latitude, float longitude) {
+    const double lat = latitude * kRadiansPerDegree;
+    const double lon = longitude * kRadiansPerDegree;
+    return {std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat)};
+}
+
+double squaredChord(const UnitVector& a, const UnitVector& b) {
+    const double dx = a.x - b.x;
+    const double dy = a.y - b.y;
+    const double dz = a.z - b.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Squared chord of a great-circle distance; half a circumference or more reaches every point
+double squaredChordOf(double meters) {
+    const double chord = 2 * std::sin(std::min(meters / kEarthRadiusMeters, 3.14159265358979323846) / 2);
+    return chord * chord;
+}
+
+// Union-find safe for concurrent unite() calls. Each root is linked under a
+// smaller one, so a set's root ends up as its smallest member.
+class DisjointSets {
+public:
+    explicit DisjointSets(std::size_t size) : parents_(size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            parents_[i].store(static_cast<std::uint32_t>(i), std::memory_order_relaxed);
+        }
+    }
+
+    std::uint32_t find(std::uint32_t x) {
+        for (;;) {
+            std::uint32_t parent = parents_[x].load(std::memory_order_acquire);
+            if (parent == x) {
+                return x;
+            }
+            // Path halving: skip to the grandparent, which is also an ancestor
+            const std::uint32_t grandparent = parents_[parent].load(std::memory_order_acquire);
+            if (grandparent != parent) {
+                parents_[x].compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+            }
+            x = grandparent;
+        }
+    }
+
+    void unite(std::uint32_t a, std::uint32_t b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) {
+                return;
+            }
+            if (a < b) {
+                std::swap(a, b);
+            }
+            // Fails when another thread linked a first; retry from the new roots
+            std::uint32_t expected = a;
+            if (parents_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<std::atomic<std::uint32_t>> parents_;
+};
+
+} // namespace
+
+void SpatialClustering::checkParameters(double epsMeters, std::size_t minPoints) {
+    if (!(epsMeters > 0.0)) {
+        throw std::runtime_error("DBSCAN eps must be positive");
+    }
+    if (minPoints == 0) {
+        throw std::runtime_error("DBSCAN minPoints must be at least 1");
+    }
+}
+
+std::vector<RowId> SpatialClustering::locatedRows(const ColumnStore& store, const std::vector<RowId>& rows) {
+    const auto& lats = store.latitudes();
+    const auto& lons = store.longitudes();
+    std::vector<RowId> located;
+    located.reserve(rows.size());
+    for (RowId row : rows) {
+        const bool unset = lats[row] == 0.0f && lons[row] == 0.0f;
+        if (!unset && std::isfinite(lats[row]) && std::isfinite(lons[row])) {
+            located.push_back(row);
+        }
+    }
+    return located;
+}
+
+SpatialClustering SpatialClustering::dbscan(const ColumnStore& store, const std::vector<RowId>& rows,
+                                            double epsMeters, std::size_t minPoints,
+                                            const ExecutionContext& context) {
+    checkParameters(epsMeters, minPoints);
+    SpatialClustering result;
+    result.rows_ = locatedRows(store, rows);
+    const std::size_t points = result.rows_.size();
+    if (points == 0) {
+        return result;
+    }
+    const auto& lats = store.latitudes();
+    const auto& lons = store.longitudes();
+
+    // Cells are eps tall, and eps wide at the point farthest from the equator,
+    // where a degree of longitude is shortest; widened when needed so cell
+    // numbers fit in 32 bits
+    float minLat = lats[result.rows_[0]], maxLat = minLat;
+    float minLon = lons[result.rows_[0]], maxLon = minLon;
+    for (RowId row : result.rows_) {
+        minLat = std::min(minLat, lats[row]);
+        maxLat = std::max(maxLat, lats[row]);
+        minLon = std::min(minLon, lons[row]);
+        maxLon = std::max(maxLon, lons[row]);
+    }
+    constexpr double kSlack = 1.0 + 1e-9;
+    constexpr double kMaxCells = 2147483648.0;
+    const double polewardLat = std::max(std::abs(minLat), std::abs(maxLat));
+    const DegreeExtent extent = degreeExtent(polewardLat, epsMeters);
+    const double cellLat = std::max(extent.latDegrees * kSlack, (static_cast<double>(maxLat) - minLat) / kMaxCells);
+    const double cellLon = std::max(extent.lonDegrees * kSlack, (static_cast<double>(maxLon) - minLon) / kMaxCells);
+
+    // Points sorted by cell, x in the high 32 bits of the key and y in the low
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> keyed(points);
+    context.parallelFor(points, 1 << 12, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            const RowId row = result.rows_[i];
+            const auto x = static_cast<std::uint64_t>((static_cast<double>(lons[row]) - minLon) / cellLon);
+            const auto y = static_cast<std::uint64_t>((static_cast<double>(lats[row]) - minLat) / cellLat);
+            keyed[i] = {x << 32 | y, static_cast<std::uint32_t>(i)};
+        }
+    });
+    std::sort(keyed.begin(), keyed.end());
+
+    struct Cell {
+        std::uint64_t key;
+        std::uint32_t begin, end;  // Positions in sorted order
+    };
+    std::vector<Cell> cells;
+    std::unordered_map<std::uint64_t, std::uint32_t> cellIndex;
+    std::vector<UnitVector> vectors(points);
+    std::vector<std::uint32_t> pointAt(points);  // Index into rows_ of each sorted position
+    for (std::uint32_t p = 0; p < points; ++p) {
+        if (cells.empty() || cells.back().key != keyed[p].first) {
+            cellIndex.emplace(keyed[p].first, static_cast<std::uint32_t>(cells.size()));
+            cells.push_back({keyed[p].first, p, p});
+        }
+        ++cells.back().end;
+        pointAt[p] = keyed[p].second;
+        const RowId row = result.rows_[keyed[p].second];
+        vectors[p] = unitVectorOf(lats[row], lons[row]);
+    }
+    keyed = {};
+
+    // The cell itself and its existing neighbours
+    auto neighbourCells = [&](const Cell& cell, std::uint32_t (&out)[9]) {
+        const std::int64_t x = static_cast<std::int64_t>(cell.key >> 32);
+        const std::int64_t y = static_cast<std::int64_t>(cell.key & 0xFFFFFFFFu);
+        std::size_t count = 0;
+        for (std::int64_t nx = x - 1; nx <= x + 1; ++nx) {
+            for (std::int64_t ny = y - 1; ny <= y + 1; ++ny) {
+                if (nx < 0 || ny < 0) {
+                    continue;
+                }
+                auto it = cellIndex.find(static_cast<std::uint64_t>(nx) << 32 | static_cast<std::uint64_t>(ny));
+                if (it != cellIndex.end()) {
+                    out[count++] = it->second;
+                }
+            }
+        }
+        return count;
+    };
+
+    const double limit = squaredChordOf(epsMeters);
+    constexpr std::size_t kCellsPerTask = 64;
+
+    // Core points, counting neighbours until minPoints
+    std::vector<char> core(points, 0);
+    context.parallelFor(cells.size(), kCellsPerTask, [&](std::size_t firstCell, std::size_t lastCell) {
+        std::uint32_t around[9];
+        for (std::size_t c = firstCell; c < lastCell; ++c) {
+            const std::size_t neighbours = neighbourCells(cells[c], around);
+            for (std::uint32_t p = cells[c].begin; p < cells[c].end; ++p) {
+                std::size_t within = 0;
+                for (std::size_t n = 0; n < neighbours && within < minPoints; ++n) {
+                    const Cell& other = cells[around[n]];
+                    for (std::uint32_t q = other.begin; q < other.end && within < minPoints; ++q) {
+                        within += squaredChord(vectors[p], vectors[q]) <= limit;
+                    }
+                }
+                core[p] = within >= minPoints;
+            }
+        }
+    });
+
+    // Link core points within eps; each pair is seen from its later position
+    DisjointSets sets(points);
+    context.parallelFor(cells.size(), kCellsPerTask, [&](std::size_t firstCell, std::size_t lastCell) {
+        std::uint32_t around[9];
+        for (std::size_t c = firstCell; c < lastCell; ++c) {
+            const std::size_t neighbours = neighbourCells(cells[c], around);
+            for (std::uint32_t p = cells[c].begin; p < cells[c].end; ++p) {
+                if (!core[p]) {
+                    continue;
+                }
+                for (std::size_t n = 0; n < neighbours; ++n) {
+                    const Cell& other = cells[around[n]];
+                    for (std::uint32_t q = other.begin; q < std::min(other.end, p); ++q) {
+                        if (core[q] && squaredChord(vectors[p], vectors[q]) <= limit &&
+                            sets.find(p) != sets.find(q)) {
+                            sets.unite(p, q);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Border points join the set of their nearest core point; ties go to the earlier row
+    std::vector<std::uint32_t> roots(points, kNoise);
+    std::vector<char> corePoint(points, 0);
+    context.parallelFor(cells.size(), kCellsPerTask, [&](std::size_t firstCell, std::size_t lastCell) {
+        std::uint32_t around[9];
+        for (std::size_t c = firstCell; c < lastCell; ++c) {
+            const std::size_t neighbours = neighbourCells(cells[c], around);
+            for (std::uint32_t p = cells[c].begin; p < cells[c].end; ++p) {
+                corePoint[pointAt[p]] = core[p];
+                if (core[p]) {
+                    roots[pointAt[p]] = sets.find(p);
+                    continue;
+                }
+                double best = limit;
+                std::uint32_t nearest = kNoise;
+                for (std::size_t n = 0; n < neighbours; ++n) {
+                    const Cell& other = cells[around[n]];
+                    for (std::uint32_t q = other.begin; q < other.end; ++q) {
+                        if (!core[q]) {
+                            continue;
+                        }
+                        const double chord = squaredChord(vectors[p], vectors[q]);
+                        if (chord < best || (chord == best && (nearest == kNoise || pointAt[q] < pointAt[nearest]))) {
+                            best = chord;
+                            nearest = q;
+                        }
+                    }
+                }
+                if (nearest != kNoise) {
+                    roots[pointAt[p]] = sets.find(nearest);
+                }
+            }
+        }
+    });
+
+    result.label(store, roots, corePoint);
+    return result;
+}
+
+SpatialClustering SpatialClustering::dbscanBruteForce(const ColumnStore& store, const std::vector<RowId>& rows,
+                                                      double epsMeters, std::size_t minPoints) {
+    checkParameters(epsMeters, minPoints);
+    SpatialClustering result;
+    result.rows_ = locatedRows(store, rows);
+    const std::size_t points = result.rows_.size();
+    const auto& lats = store.latitudes();
+    const auto& lons = store.longitudes();
+    auto meters = [&](std::size_t i, std::size_t j) {
+        return distanceMeters(lats[result.rows_[i]], lons[result.rows_[i]], lats[result.rows_[j]],
+                              lons[result.rows_[j]]);
+    };
+
+    std::vector<char> core(points, 0);
+    for (std::size_t i = 0; i < points; ++i) {
+        std::size_t within = 0;
+        for (std::size_t j = 0; j < points; ++j) {
+            within += meters(i, j) <= epsMeters;
+        }
+        core[i] = within >= minPoints;
+    }
+
+    DisjointSets sets(points);
+    for (std::size_t i = 0; i < points; ++i) {
+        for (std::size_t j = 0; j < i; ++j) {
+            if (core[i] && core[j] && meters(i, j) <= epsMeters) {
+                sets.unite(static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j));
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> roots(points, kNoise);
+    for (std::size_t i = 0; i < points; ++i) {
+        if (core[i]) {
+            roots[i] = sets.find(static_cast<std::uint32_t>(i));
+            continue;
+        }
+        double best = epsMeters;
+        std::size_t nearest = points;
+        for (std::size_t j = 0; j < points; ++j) {
+            const double distance = meters(i, j);
+            if (core[j] && (distance < best || (distance == best && nearest == points))) {
+                best = distance;
+                nearest = j;
+            }
+        }
+        if (nearest != points) {
+            roots[i] = sets.find(static_cast<std::uint32_t>(nearest));
+        }
+    }
+
+    result.label(store, roots, core);
+    return result;
+}
+
+void SpatialClustering::label(const ColumnStore& store, const std::vector<std::uint32_t>& roots,
+                              const std::vector<char>& core) {
+    const auto& lats = store.latitudes();
+    const auto& lons = store.longitudes();
+    labels_.assign(rows_.size(), kNoise);
+    std::vector<ClusterId> idOfRoot(rows_.size(), kNoise);
+    for (std::size_t i = 0; i < rows_.size(); ++i) {
+        if (roots[i] == kNoise) {
+            ++noise_;
+            continue;
+        }
+        ClusterId& id = idOfRoot[roots[i]];
+        const RowId row = rows_[i];
+        if (id == kNoise) {
+            id = static_cast<ClusterId>(clusters_.size());
+            Cluster& cluster = clusters_.emplace_back();
+            cluster.minLat = cluster.maxLat = lats[row];
+            cluster.minLon = cluster.maxLon = lons[row];
+        }
+        labels_[i] = id;
+        Cluster& cluster = clusters_[id];
+        cluster.totals.add(store, row);
+        cluster.corePoints += core[i] != 0;
+        cluster.latitude += lats[row];
+        cluster.longitude += lons[row];
+        cluster.minLat = std::min(cluster.minLat, lats[row]);
+        cluster.maxLat = std::max(cluster.maxLat, lats[row]);
+        cluster.minLon = std::min(cluster.minLon, lons[row]);
+        cluster.maxLon = std::max(cluster.maxLon, lons[row]);
+    }
+    for (Cluster& cluster : clusters_) {
+        cluster.latitude /= static_cast<double>(cluster.totals.collisions);
+        cluster.longitude /= static_cast<double>(cluster.totals.collisions);
+    }
+}
+
+std::vector<RowId> SpatialClustering::rowsOf(ClusterId cluster) const {
+    std::vector<RowId> result;
+    for (std::size_t i = 0; i < rows_.size(); ++i) {
+        if (labels_[i] == cluster) {
+            result.push_back(rows_[i]);
+        }
+    }
+    return result;
+}
+
+} // namespace nycollision
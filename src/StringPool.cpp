@@ -0,0 +1,49 @@
+#include "../include/nycollision/core/StringPool.h"
+#include <atomic>
+
+namespace nycollision {
+
+namespace {
+std::atomic<std::uint64_t> nextPoolId{1};
+}
+
+StringPool::StringPool() : id_(nextPoolId.fetch_add(1, std::memory_order_relaxed)) {}
+
+const std::shared_ptr<StringPool>& StringPool::global() {
+    static const std::shared_ptr<StringPool> pool = std::make_shared<StringPool>();
+    return pool;
+}
+
+std::size_t StringPool::memoryUsage() const {
+    std::size_t bytes = 0;
+    for (const auto& dictionary : dictionaries_) {
+        bytes += dictionary.memoryUsage();
+    }
+    return bytes;
+}
+
+StringPool::Code StringPool::LocalCache::encode(StringPool& pool, StringDomain domain, std::string_view value) {
+    if (value.empty()) {
+        return kEmpty;
+    }
+    if (poolId_ != pool.id()) {
+        for (auto& codes : codes_) codes.clear();
+        poolId_ = pool.id();
+    }
+
+    auto& codes = codes_[static_cast<std::size_t>(domain)];
+    auto it = codes.find(value);
+    if (it != codes.end()) {
+        return it->second;
+    }
+
+    if (codes.size() >= kMaxEntries) {
+        codes.clear();
+    }
+    Code code = pool.encode(domain, value);
+    // Key on the pool's copy so the memo never refers to parser buffers
+    codes.emplace(std::string_view(pool.decode(domain, code)), code);
+    return code;
+}
+
+} // namespace nycollision
@@ -0,0 +1,30 @@
+#include "../include/nycollision/util/ThreadAffinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace nycollision {
+
+#ifdef __linux__
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+#else
+
+bool pinCurrentThread(int) {
+    return false;
+}
+
+#endif
+
+} // namespace nycollision
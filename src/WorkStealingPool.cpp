@@ -0,0 +1,169 @@
+#include "../include/nycollision/util/WorkStealingPool.h"
+#include "../include/nycollision/util/ThreadAffinity.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace nycollision {
+
+namespace {
+
+// Pool and queue index of the current thread, if it is a worker
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local std::size_t currentQueue = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(std::size_t workers, std::vector<int> cpuAffinity) {
+    queues_.reserve(workers + 1);
+    for (std::size_t i = 0; i <= workers; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        int cpu = cpuAffinity.empty() ? -1 : cpuAffinity[i % cpuAffinity.size()];
+        threads_.emplace_back([this, i, cpu] {
+            if (cpu >= 0) {
+                pinCurrentThread(cpu);
+            }
+            workerLoop(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock(wakeMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(TaskGroup& group, std::function<void()> task) {
+    // Workers push to their own deque; everyone else uses the injection queue
+    std::size_t target = currentPool == this ? currentQueue : queues_.size() - 1;
+    group.pending_.fetch_add(1, std::memory_order_relaxed);
+    group.queued_.fetch_add(1);
+    {
+        std::lock_guard lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(Task{std::move(task), &group});
+    }
+    queued_.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard lock(wakeMutex_);
+    }
+    wake_.notify_one();
+
+    // A task of the group may be adding to it while the caller of wait() sleeps
+    if (group.waiting_.load()) {
+        std::lock_guard lock(group.mutex_);
+        group.changed_.notify_all();
+    }
+}
+
+void WorkStealingPool::wait(TaskGroup& group) {
+    std::size_t self = currentPool == this ? currentQueue : queues_.size() - 1;
+    Task task;
+    while (group.pending_.load(std::memory_order_acquire) != 0) {
+        if (tryTake(self, task, &group)) {
+            execute(task);
+            continue;
+        }
+        // The rest of the group runs on other threads: sleep until it
+        // finishes or queues more tasks
+        std::unique_lock lock(group.mutex_);
+        group.waiting_.store(true);
+        group.changed_.wait(lock, [&group] {
+            return group.pending_.load(std::memory_order_acquire) == 0 || group.queued_.load() != 0;
+        });
+        group.waiting_.store(false);
+    }
+
+    // Tasks finish under the group's lock, so taking it lets the last one
+    // leave before the caller destroys the group
+    std::exception_ptr error;
+    {
+        std::lock_guard lock(group.mutex_);
+        error = std::exchange(group.error_, nullptr);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::workerLoop(std::size_t index) {
+    currentPool = this;
+    currentQueue = index;
+    Task task;
+    while (true) {
+        if (tryTake(index, task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock lock(wakeMutex_);
+        wake_.wait(lock, [this] {
+            return stop_ || queued_.load(std::memory_order_acquire) != 0;
+        });
+        if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::tryTake(std::size_t self, Task& task, const TaskGroup* group) {
+    if ((group ? group->queued_.load() : queued_.load(std::memory_order_acquire)) == 0) {
+        return false;
+    }
+    auto wanted = [group](const Task& queued) { return !group || queued.group == group; };
+
+    // Own newest task first, then the oldest task of every other queue
+    const std::size_t count = queues_.size();
+    for (std::size_t step = 0; step < count; ++step) {
+        auto& queue = *queues_[(self + step) % count];
+        std::lock_guard lock(queue.mutex);
+        auto& tasks = queue.tasks;
+        auto it = tasks.end();
+        if (step == 0) {
+            auto newest = std::find_if(tasks.rbegin(), tasks.rend(), wanted);
+            if (newest != tasks.rend()) {
+                it = std::prev(newest.base());
+            }
+        } else {
+            it = std::find_if(tasks.begin(), tasks.end(), wanted);
+        }
+        if (it == tasks.end()) {
+            continue;
+        }
+        task = std::move(*it);
+        tasks.erase(it);
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        task.group->queued_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::execute(Task& task) {
+    TaskGroup& group = *task.group;
+    std::exception_ptr error;
+    try {
+        task.run();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    task.run = nullptr;
+
+    // The group may be destroyed as soon as pending_ reaches 0 and its lock is free
+    std::lock_guard lock(group.mutex_);
+    if (error && !group.error_) {
+        group.error_ = error;
+    }
+    if (group.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        group.changed_.notify_all();
+    }
+}
+
+} // namespace nycollision
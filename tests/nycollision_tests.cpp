@@ -0,0 +1,862 @@
+// Self-checking tests run by CTest: every CSV scanner kernel against a
+// byte-at-a-time reference, chunked parsing against a single chunk, the
+// compressed row bitmap against std::set, streamed snapshot sections and a
+// snapshot round-trip of a dataset holding upserted rows, the
+// upsert path of DataSet::appendFromFile() against a full load of the same
+// records, multi-predicate and distance queries against a scan of every row,
+// grid DBSCAN against the pairwise baseline, and LiveDataSet readers running while versions are published.
+//
+// Usage: nycollision_tests
+// Prints one line per failed check and exits non-zero if any failed.
+
+#include "../bench/SyntheticCollisions.h"
+#include <nycollision/data/DataSet.h>
+#include <nycollision/data/LiveDataSet.h>
+#include <nycollision/data/RowBitmap.h>
+#include <nycollision/data/SpatialClustering.h>
+#include <nycollision/parser/CSVParser.h>
+#include <nycollision/parser/CSVScanner.h>
+#include <nycollision/util/Snapshot.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace nycollision;
+
+namespace {
+
+// Atomic so that checks may run on reader threads
+std::atomic<int> failures{0};
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            ++failures;                                                               \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        }                                                                             \
+    } while (0)
+
+// ---------------------------------------------------------------------------
+// CSV scanning
+// ---------------------------------------------------------------------------
+
+// Byte-at-a-time references for the scanner kernels
+std::size_t referenceRecordEnd(std::string_view data, char quote, bool inQuotes) {
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        if (data[i] == quote) {
+            inQuotes = !inQuotes;
+        } else if (data[i] == '\n' && !inQuotes) {
+            return i + 1;
+        }
+    }
+    return data.size();
+}
+
+bool referenceDelimiters(std::string_view line, char delimiter, char quote, std::vector<std::uint32_t>& positions) {
+    positions.clear();
+    bool inQuotes = false;
+    bool quoted = false;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        if (line[i] == quote) {
+            inQuotes = !inQuotes;
+            quoted = true;
+        } else if (line[i] == delimiter && !inQuotes) {
+            positions.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+    return quoted;
+}
+
+// Random text dense in structural characters, spanning several 64-byte blocks
+std::string randomCSVText(std::mt19937& rng, char delimiter, char quote) {
+    const std::string alphabet = std::string("ab1 ") + delimiter + delimiter + quote + quote + "\n\r";
+    std::uniform_int_distribution<std::size_t> length(0, 300);
+    std::uniform_int_distribution<std::size_t> pick(0, alphabet.size() - 1);
+    std::string text(length(rng), ' ');
+    for (char& c : text) {
+        c = alphabet[pick(rng)];
+    }
+    return text;
+}
+
+void testScannerKernels() {
+    std::vector<CSVScanner::Kernel> kernels;
+    for (auto kernel : {CSVScanner::Kernel::Scalar, CSVScanner::Kernel::SSE42, CSVScanner::Kernel::AVX2}) {
+        if (CSVScanner::isSupported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    CHECK(!kernels.empty() && kernels.front() == CSVScanner::Kernel::Scalar);
+
+    std::mt19937 rng(3);
+    for (auto [delimiter, quote] : {std::pair{',', '"'}, std::pair{';', '\''}}) {
+        std::vector<CSVScanner> scanners;
+        for (auto kernel : kernels) {
+            scanners.emplace_back(delimiter, quote, kernel);
+        }
+        std::vector<std::uint32_t> expected, found;
+        for (int i = 0; i < 3000; ++i) {
+            // Scan from an unaligned offset of a heap buffer, so blocks straddle the text's own
+            const std::string text = randomCSVText(rng, delimiter, quote);
+            const std::size_t offset = text.empty() ? 0 : rng() % std::min<std::size_t>(text.size(), 70);
+            const std::string_view data = std::string_view(text).substr(offset);
+            const bool inQuotes = i % 2 != 0;
+            const bool quoted = referenceDelimiters(data, delimiter, quote, expected);
+            for (const auto& scanner : scanners) {
+                CHECK(scanner.findRecordEnd(data, inQuotes) == referenceRecordEnd(data, quote, inQuotes));
+                CHECK(scanner.findDelimiters(data, found) == quoted && found == expected);
+                CHECK(scanner.countQuotes(data) == static_cast<std::size_t>(std::count(data.begin(), data.end(), quote)));
+            }
+        }
+    }
+}
+
+// Collision ids of the records in a buffer, parsed record by record as the loader does
+std::vector<int> parsedKeys(const CSVParser& parser, std::string_view chunk) {
+    std::vector<int> result;
+    while (!chunk.empty()) {
+        std::string_view text = chunk.substr(0, parser.recordLength(chunk));
+        chunk.remove_prefix(text.size());
+        if (!text.empty() && text.back() == '\n') {
+            text.remove_suffix(1);
+        }
+        if (auto record = parser.parseRecord(text)) {
+            result.push_back(record->getUniqueKey());
+        }
+    }
+    return result;
+}
+
+void testChunkedParse() {
+    // Quoted streets hold delimiters and escaped quotes; every seventh one also a newline
+    bench::SyntheticCollisions generator(5);
+    std::string data;
+    for (int id = 1; id <= 30000; ++id) {
+        std::string row = generator.row(id);
+        const std::size_t street = row.find("FLATBUSH AVENUE,");
+        if (street != std::string::npos && id % 7 == 0) {
+            row[street + 8] = '\n';
+        }
+        data += row + "\n";
+    }
+
+    CSVParser parser;
+    const std::vector<int> whole = parsedKeys(parser, data);
+    CHECK(whole.size() == 30000);
+    ExecutionContext::Options options;
+    options.threads = 3;
+    const ExecutionContext context(options);
+    for (std::size_t chunkCount : {1, 2, 3, 7, 16, 64}) {
+        const auto chunks = parser.splitChunks(data, chunkCount, context);
+        CHECK(chunks.size() <= chunkCount && (chunkCount == 1 || chunks.size() > 1));
+
+        // Chunks tile the buffer in order and each starts a record
+        std::vector<int> keys;
+        const char* next = data.data();
+        for (std::string_view chunk : chunks) {
+            CHECK(chunk.data() == next);
+            CHECK(chunk.data() == data.data() || chunk.data()[-1] == '\n');
+            next = chunk.data() + chunk.size();
+            const std::vector<int> chunkKeys = parsedKeys(parser, chunk);
+            keys.insert(keys.end(), chunkKeys.begin(), chunkKeys.end());
+        }
+        CHECK(next == data.data() + data.size());
+        CHECK(keys == whole);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// RowBitmap
+// ---------------------------------------------------------------------------
+
+std::vector<RowId> sorted(const std::set<RowId>& rows) { return std::vector<RowId>(rows.begin(), rows.end()); }
+
+bool matches(const RowBitmap& bitmap, const std::set<RowId>& expected) {
+    if (bitmap.cardinality() != expected.size() || bitmap.toVector() != sorted(expected)) {
+        return false;
+    }
+    std::vector<RowId> iterated(bitmap.begin(), bitmap.end());
+    return iterated == bitmap.toVector();
+}
+
+// Random rows over a few containers: a sparse one, one near the array limit and a dense one
+std::set<RowId> randomRows(std::mt19937& rng, std::size_t nearLimit) {
+    std::set<RowId> rows;
+    std::uniform_int_distribution<RowId> low(0, RowBitmap::kContainerRows - 1);
+    for (int i = 0; i < 100; ++i) {
+        rows.insert(low(rng));
+    }
+    while (rows.size() < 100 + nearLimit) {
+        rows.insert((RowId{1} << 16) | low(rng));
+    }
+    for (int i = 0; i < 20000; ++i) {
+        rows.insert((RowId{3} << 16) | low(rng));
+    }
+    return rows;
+}
+
+void testBitmapAddRemove() {
+    RowBitmap bitmap;
+    std::set<RowId> expected;
+    const RowId base = RowId{5} << 16;
+
+    // Fill one container up to the array limit, then one row past it
+    for (RowId i = 0; i < RowBitmap::kArrayLimit; ++i) {
+        bitmap.add(base + 2 * i);
+        expected.insert(base + 2 * i);
+    }
+    CHECK(matches(bitmap, expected));
+    bitmap.add(base + 1);
+    expected.insert(base + 1);
+    CHECK(matches(bitmap, expected));
+    CHECK(bitmap.containerCount() == 1 && bitmap.containerCardinality(0) == RowBitmap::kArrayLimit + 1);
+
+    // Back across the boundary, then down to nothing
+    bitmap.remove(base + 1);
+    expected.erase(base + 1);
+    CHECK(matches(bitmap, expected));
+    bitmap.remove(base + 3);  // Not stored
+    CHECK(matches(bitmap, expected));
+    for (RowId row : sorted(expected)) {
+        CHECK(bitmap.contains(row));
+        bitmap.remove(row);
+    }
+    CHECK(bitmap.empty() && bitmap.containerCount() == 0);
+
+    // Random adds and removes across the boundary, out of order
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<RowId> offset(0, 2 * RowBitmap::kArrayLimit);
+    expected.clear();
+    for (int i = 0; i < 40000; ++i) {
+        const RowId row = base + offset(rng);
+        if (i % 3 == 2) {
+            bitmap.remove(row);
+            expected.erase(row);
+        } else {
+            bitmap.add(row);
+            expected.insert(row);
+        }
+        if (i % 1000 == 0) {
+            CHECK(matches(bitmap, expected));
+        }
+    }
+    CHECK(matches(bitmap, expected));
+    CHECK(RowBitmap::fromSorted(bitmap.toVector().data(), bitmap.cardinality()) == bitmap);
+}
+
+void testBitmapSetOperations() {
+    std::mt19937 rng(11);
+    for (std::size_t nearLimit : {RowBitmap::kArrayLimit - 50, RowBitmap::kArrayLimit, RowBitmap::kArrayLimit + 50}) {
+        const std::set<RowId> a = randomRows(rng, nearLimit);
+        const std::set<RowId> b = randomRows(rng, RowBitmap::kArrayLimit);
+        const std::vector<RowId> aRows = sorted(a);
+        const std::vector<RowId> bRows = sorted(b);
+        const RowBitmap aBitmap = RowBitmap::fromSorted(aRows.data(), aRows.size());
+        const RowBitmap bBitmap = RowBitmap::fromSorted(bRows.data(), bRows.size());
+        CHECK(matches(aBitmap, a));
+        CHECK(matches(bBitmap, b));
+
+        std::set<RowId> both;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::inserter(both, both.end()));
+        std::set<RowId> either;
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::inserter(either, either.end()));
+        CHECK(matches(aBitmap & bBitmap, both));
+        CHECK(matches(bBitmap & aBitmap, both));
+        CHECK(matches(aBitmap | bBitmap, either));
+        CHECK(matches(bBitmap | aBitmap, either));
+        CHECK(matches(aBitmap & RowBitmap(), {}));
+        CHECK(matches(aBitmap | RowBitmap(), a));
+    }
+}
+
+void testBitmapCopiesAreIndependent() {
+    std::mt19937 rng(13);
+    const std::set<RowId> rows = randomRows(rng, RowBitmap::kArrayLimit);
+    const std::vector<RowId> sortedRows = sorted(rows);
+    RowBitmap original = RowBitmap::fromSorted(sortedRows.data(), sortedRows.size());
+
+    RowBitmap copy = original;
+    std::set<RowId> copyRows = rows;
+    for (RowId row : {RowId{7}, (RowId{1} << 16) | 9, (RowId{3} << 16) | 11, RowId{9} << 16}) {
+        copy.add(row);
+        copyRows.insert(row);
+    }
+    copy.remove(sortedRows.front());
+    copyRows.erase(sortedRows.front());
+    CHECK(matches(copy, copyRows));
+    CHECK(matches(original, rows));
+
+    // Writes through the original leave the copy alone as well
+    original &= RowBitmap::fromSorted(sortedRows.data(), 100);
+    CHECK(matches(original, std::set<RowId>(sortedRows.begin(), sortedRows.begin() + 100)));
+    CHECK(matches(copy, copyRows));
+}
+
+// ---------------------------------------------------------------------------
+// Clustering
+// ---------------------------------------------------------------------------
+
+void testDbscanMatchesPairwise() {
+    // Dense hotspots a few hundred meters apart over sparse noise, and some rows without coordinates
+    auto pool = std::make_shared<StringPool>();
+    ColumnStore store(pool);
+    std::mt19937 rng(71);
+    std::normal_distribution<float> spread(0.0f, 0.0004f);
+    std::uniform_real_distribution<float> latitude(40.70f, 40.76f), longitude(-74.00f, -73.92f);
+    for (int i = 0; i < 1600; ++i) {
+        Record record(pool);
+        record.setUniqueKey(i);
+        if (i % 50 == 0) {
+            record.setLocation({0.0f, 0.0f});
+        } else if (i % 3 == 0) {
+            record.setLocation({latitude(rng), longitude(rng)});
+        } else {
+            const int hotspot = i % 7;
+            record.setLocation({40.72f + 0.004f * hotspot + spread(rng), -73.96f + 0.003f * (hotspot % 3) + spread(rng)});
+        }
+        store.append(record);
+    }
+    std::vector<RowId> all(store.size()), odd;
+    std::iota(all.begin(), all.end(), RowId{0});
+    std::copy_if(all.begin(), all.end(), std::back_inserter(odd), [](RowId row) { return row % 2 != 0; });
+
+    std::vector<std::unique_ptr<ExecutionContext>> contexts;
+    for (std::size_t threads : {1, 3}) {
+        for (auto backend : {ExecutionContext::Backend::OpenMP, ExecutionContext::Backend::WorkStealing}) {
+            ExecutionContext::Options options;
+            options.threads = threads;
+            options.backend = backend;
+            contexts.push_back(std::make_unique<ExecutionContext>(options));
+        }
+    }
+
+    std::size_t clustered = 0;
+    for (const auto* rows : {&all, &odd}) {
+        for (auto [eps, minPoints] : {std::pair{30.0, std::size_t{4}}, std::pair{60.0, std::size_t{12}}}) {
+            const auto pairwise = SpatialClustering::dbscanBruteForce(store, *rows, eps, minPoints);
+            clustered += pairwise.clusters().size();
+            for (const auto& context : contexts) {
+                const auto grid = SpatialClustering::dbscan(store, *rows, eps, minPoints, *context);
+                CHECK(grid.rows() == pairwise.rows());
+                CHECK(grid.labels() == pairwise.labels());
+                CHECK(grid.noise() == pairwise.noise());
+                CHECK(grid.clusters().size() == pairwise.clusters().size());
+                for (std::size_t c = 0; c < std::min(grid.clusters().size(), pairwise.clusters().size()); ++c) {
+                    CHECK(grid.clusters()[c].corePoints == pairwise.clusters()[c].corePoints);
+                    CHECK(grid.clusters()[c].totals.collisions == pairwise.clusters()[c].totals.collisions);
+                }
+            }
+        }
+    }
+    CHECK(clustered >= 4);
+}
+
+// ---------------------------------------------------------------------------
+// Datasets
+// ---------------------------------------------------------------------------
+
+class TempFile {
+public:
+    explicit TempFile(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() / ("nycollision_tests_" + name)).string()) {}
+    ~TempFile() { std::filesystem::remove(path_); }
+
+    void write(const std::string& text) const {
+        std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+        out << text;
+        if (!out) {
+            throw std::runtime_error("Failed to write " + path_);
+        }
+    }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+std::vector<int> keys(const DataSet& dataset, const RowSet& rows) {
+    std::vector<int> result;
+    for (RowId row : rows.toVector()) {
+        result.push_back(dataset.columns().uniqueKey(row));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Both datasets hold the same records, whatever their rows
+void checkSameRecords(const DataSet& a, const DataSet& b) {
+    CHECK(a.size() == b.size());
+    const Timestamp first = std::numeric_limits<Timestamp>::min();
+    const Timestamp last = std::numeric_limits<Timestamp>::max();
+    CHECK(keys(a, a.rowsByDateRange(first, last)) == keys(b, b.rowsByDateRange(first, last)));
+    CHECK(keys(a, a.rowsByGeoBounds(40.6f, 40.7f, -74.0f, -73.9f)) ==
+          keys(b, b.rowsByGeoBounds(40.6f, 40.7f, -74.0f, -73.9f)));
+    CHECK(keys(a, a.rowsNearest(40.7f, -73.95f, 25)) == keys(b, b.rowsNearest(40.7f, -73.95f, 25)));
+    for (const char* borough : {"BROOKLYN", "QUEENS", "STATEN ISLAND"}) {
+        CHECK(keys(a, a.rowsByBorough(borough)) == keys(b, b.rowsByBorough(borough)));
+    }
+    CHECK(keys(a, a.rowsByVehicleType("TAXI")) == keys(b, b.rowsByVehicleType("TAXI")));
+    CHECK(keys(a, a.rowsByInjuryRange(2, 5)) == keys(b, b.rowsByInjuryRange(2, 5)));
+    CHECK(a.rollup().total().injuries() == b.rollup().total().injuries());
+    for (RowId row = 0; row < a.size(); row += 17) {
+        const int key = a.columns().uniqueKey(row);
+        auto record = b.queryByUniqueKey(key);
+        CHECK(record && record->getTimestamp() == a.columns().timestamp(row));
+    }
+}
+
+void testUpsert() {
+    constexpr int kBaseRows = 5000;
+    constexpr int kNewRows = 300;
+    bench::SyntheticCollisions original(21);
+    bench::SyntheticCollisions revised(22);
+
+    // Every tenth record is revised, the last one twice, and new ids follow the base
+    std::string base = bench::SyntheticCollisions::header() + "\n";
+    std::string delta = base;
+    std::string final = base;
+    for (int id = 1; id <= kBaseRows; ++id) {
+        const std::string row = original.row(id);
+        base += row + "\n";
+        if (id % 10 == 0) {
+            const std::string revision = revised.row(id);
+            delta += revision + "\n";
+            final += revision + "\n";
+        } else {
+            final += row + "\n";
+        }
+    }
+    delta.insert(bench::SyntheticCollisions::header().size() + 1, revised.row(kBaseRows) + "\n");
+    for (int id = kBaseRows + 1; id <= kBaseRows + kNewRows; ++id) {
+        const std::string row = revised.row(id);
+        delta += row + "\n";
+        final += row + "\n";
+    }
+
+    // Records without a usable collision id: blank and malformed
+    const std::string keyless = revised.row(999999);
+    for (const char* id : {",,", ",12x,"}) {
+        std::string row = keyless;
+        row.replace(row.find(",999999,"), 8, id);
+        delta += row + "\n";
+    }
+
+    TempFile baseFile("upsert_base.csv"), deltaFile("upsert_delta.csv"), finalFile("upsert_final.csv");
+    baseFile.write(base);
+    deltaFile.write(delta);
+    finalFile.write(final);
+
+    CSVParser parser;
+    DataSet upserted(parser.stringPool());
+    upserted.loadFromFile(baseFile.path(), parser);
+    const DataSet::AppendStats stats = upserted.appendFromFile(deltaFile.path(), parser);
+    CHECK(stats.inserted == kNewRows);
+    CHECK(stats.updated == kBaseRows / 10);
+    CHECK(stats.superseded == 1);
+    CHECK(stats.rejected == 2);
+    CHECK(upserted.size() == kBaseRows + kNewRows);
+
+    DataSet loaded(parser.stringPool());
+    loaded.loadFromFile(finalFile.path(), parser);
+    checkSameRecords(upserted, loaded);
+}
+
+// Whether a record satisfies a predicate, read from the record rather than the indexes
+bool referenceMatch(const IRecord& record, const Query::Predicate& p, const RegionLayer& layer) {
+    const auto in = [&p](std::int64_t value) { return value >= p.min && value <= p.max; };
+    const CasualtyStats& casualties = record.getCasualtyStats();
+    const GeoCoordinate location = record.getLocation();
+    switch (p.field) {
+    case Query::Field::GeoBounds:
+        return location.latitude >= p.minLat && location.latitude <= p.maxLat && location.longitude >= p.minLon &&
+               location.longitude <= p.maxLon;
+    case Query::Field::Borough: return record.getBorough() == p.value;
+    case Query::Field::ZipCode: return record.getZipCode() == p.value;
+    case Query::Field::DateRange: return in(record.getTimestamp());
+    case Query::Field::VehicleType: {
+        const auto& types = record.getVehicleInfo().vehicle_types;
+        return std::find(types.begin(), types.end(), p.value) != types.end();
+    }
+    case Query::Field::Injuries: return in(casualties.getTotalInjuries());
+    case Query::Field::Fatalities: return in(casualties.getTotalFatalities());
+    case Query::Field::PedestrianFatalities: return in(casualties.pedestrians_killed);
+    case Query::Field::CyclistFatalities: return in(casualties.cyclists_killed);
+    case Query::Field::MotoristFatalities: return in(casualties.motorists_killed);
+    case Query::Field::Region:
+        return layer.find(p.value) != RegionLayer::kNoRegion &&
+               layer.regionOf(location.latitude, location.longitude) == layer.find(p.value);
+    }
+    return false;
+}
+
+void testQueryMatchesScan() {
+    TempFile file("query.csv");
+    bench::SyntheticCollisions generator(51);
+    file.write(generator.document(20000));
+
+    auto zones = std::make_shared<RegionLayer>("zone");
+    zones->addWkt("north", "POLYGON((-74.3 40.75, -73.6 40.75, -73.6 41.0, -74.3 41.0, -74.3 40.75))");
+    zones->addWkt("west", "POLYGON((-74.3 40.4, -74.05 40.4, -74.05 40.75, -74.3 40.75, -74.3 40.4))");
+
+    CSVParser parser;
+    DataSet dataset(parser.stringPool());
+    dataset.addRegionLayer(zones);
+    dataset.loadFromFile(file.path(), parser);
+    // A ZIP code in use and its borough
+    const StringPool& pool = *dataset.columns().pool();
+    RowId sample = 0;
+    while (pool.decode(StringDomain::ZipCode, dataset.columns().zipCodeCode(sample)).empty()) {
+        ++sample;
+    }
+    const std::string zip = pool.decode(StringDomain::ZipCode, dataset.columns().zipCodeCode(sample));
+    const std::string zipBorough = pool.decode(StringDomain::Borough, dataset.columns().boroughCode(sample));
+    const Timestamp start = CalendarDate{2016, 1, 1}.startOfDay();
+    const Timestamp end = CalendarDate{2016, 6, 30}.endOfDay();
+
+    using Access = QueryPlan::Access;
+    struct Case {
+        Query query;
+        Access shape;  // Access some step of the plan must use
+    };
+    const std::vector<Case> cases = {
+        // Bitmap drivers, with comparable bitmaps ANDed
+        {Query().borough("BROOKLYN").vehicleType("TAXI"), Access::Intersect},
+        {Query().vehicleType("Bike").region("zone", "north").injuries(1, 3), Access::Intersect},
+        {Query().zipCode(zip), Access::Index},
+        // Predicates without bitmaps, or with much larger ones, checked against the columns
+        {Query().zipCode(zip).borough(zipBorough), Access::Filter},
+        {Query().borough("QUEENS").inArea(40.6f, 40.8f, -74.0f, -73.8f), Access::Filter},
+        {Query().region("zone", "west").dateRange(start, end).fatalities(0, 0), Access::Filter},
+        {Query().pedestrianFatalities(1, 1).cyclistFatalities(0, 0).motoristFatalities(0, 1), Access::Filter},
+        {Query().fatalities(1, 10).borough("BRONX"), Access::Filter},
+        // A predicate matching nothing ends the plan
+        {Query().borough("QUEENS").zipCode("99999"), Access::Empty},
+        {Query().injuries(1, 3).region("zone", "nowhere"), Access::Empty},
+        {Query().borough("MANHATTAN").vehicleType("No Such Vehicle"), Access::Empty},
+    };
+    std::vector<Query> queries;
+    for (const Case& c : cases) {
+        const QueryPlan plan = dataset.plan(c.query);
+        CHECK(std::any_of(plan.steps.begin(), plan.steps.end(),
+                          [&c](const QueryPlan::Step& step) { return step.access == c.shape; }));
+        queries.push_back(c.query);
+    }
+
+    // Drivers without a bitmap, alone and followed by filters
+    for (const Query& query : {Query().dateRange(start, end), Query().inArea(40.7f, 40.72f, -73.95f, -73.9f),
+                               Query().inArea(40.7f, 40.75f, -73.95f, -73.85f).vehicleType("Sedan").injuries(2, 10)}) {
+        const QueryPlan plan = dataset.plan(query);
+        const Query::Field driver = query.predicates()[plan.steps.front().predicate].field;
+        CHECK(plan.steps.front().access == Access::Index &&
+              (driver == Query::Field::DateRange || driver == Query::Field::GeoBounds));
+        CHECK(std::all_of(plan.steps.begin() + 1, plan.steps.end(),
+                          [](const QueryPlan::Step& step) { return step.access == Access::Filter; }));
+        queries.push_back(query);
+    }
+    queries.push_back(Query());
+
+    for (const Query& query : queries) {
+        std::vector<int> expected;
+        for (RowId row = 0; row < dataset.size(); ++row) {
+            const RecordView record(dataset.columns(), row);
+            const auto& predicates = query.predicates();
+            if (std::all_of(predicates.begin(), predicates.end(),
+                            [&](const Query::Predicate& p) { return referenceMatch(record, p, *zones); })) {
+                expected.push_back(record.getUniqueKey());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        CHECK(keys(dataset, dataset.rowsMatching(query)) == expected);
+    }
+}
+
+bool sameNeighbors(const std::vector<DataSet::Neighbor>& a, const std::vector<DataSet::Neighbor>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](const auto& x, const auto& y) { return x.row == y.row && x.meters == y.meters; });
+}
+
+void testNeighborsMatchScan() {
+    // Enough points for two latitude strips, then a delta below the repack threshold
+    constexpr int kBaseRows = 2 * static_cast<int>(DataSet::kMinPartitionValues) + 4000;
+    constexpr int kRevised = 3000;
+    constexpr int kNewRows = 1500;
+    TempFile baseFile("neighbors_base.csv"), deltaFile("neighbors_delta.csv");
+    bench::SyntheticCollisions original(61);
+    bench::SyntheticCollisions revised(62);
+    baseFile.write(original.document(kBaseRows));
+    deltaFile.write(revised.document(kRevised + kNewRows, kBaseRows - kRevised + 1));
+
+    CSVParser parser;
+    DataSet dataset(parser.stringPool());
+    dataset.setSpatialPartitions(2);
+    dataset.loadFromFile(baseFile.path(), parser);
+    CHECK(dataset.spatialIndexStats().partitions == 2);
+
+    // Probe around stored points and around the old places of revised ones,
+    // which the strips still hold but must mask out
+    std::mt19937 rng(63);
+    std::uniform_real_distribution<float> jitter(-0.002f, 0.002f);
+    std::vector<GeoCoordinate> probes;
+    auto probeNear = [&](RowId row) {
+        const GeoCoordinate location = dataset.columns().location(row);
+        probes.push_back(location);
+        probes.push_back({location.latitude + jitter(rng), location.longitude + jitter(rng)});
+    };
+    for (RowId row : {RowId{17}, RowId{90001}}) {
+        probeNear(row);
+    }
+    for (RowId row = kBaseRows - kRevised; row < kBaseRows; row += 1000) {
+        probeNear(row);
+    }
+
+    const DataSet::AppendStats stats = dataset.appendFromFile(deltaFile.path(), parser);
+    CHECK(stats.updated == kRevised && stats.inserted == kNewRows);
+    CHECK(dataset.spatialIndexStats().partitions > 2);  // Strips plus delta trees
+
+    // Each scan is checked against two indexed queries: a shorter nearest
+    // list is a prefix, and a zero radius keeps only exact hits
+    for (const auto [latitude, longitude] : probes) {
+        const auto nearest = dataset.neighborsBruteForce(latitude, longitude, 50);
+        CHECK(sameNeighbors(dataset.neighbors(latitude, longitude, 50), nearest));
+        CHECK(sameNeighbors(dataset.neighbors(latitude, longitude, 1), {nearest.front()}));
+
+        const auto within = dataset.neighborsWithinBruteForce(latitude, longitude, 400.0);
+        CHECK(!within.empty() && sameNeighbors(dataset.neighborsWithin(latitude, longitude, 400.0), within));
+        std::vector<DataSet::Neighbor> hits;
+        std::copy_if(within.begin(), within.end(), std::back_inserter(hits),
+                     [](const DataSet::Neighbor& neighbor) { return neighbor.meters == 0.0; });
+        CHECK(sameNeighbors(dataset.neighborsWithin(latitude, longitude, 0.0), hits));
+    }
+}
+
+// Whether a temporary file of a SnapshotWriter for the snapshot is left behind
+bool hasTemporaries(const std::string& snapshot) {
+    const std::filesystem::path path(snapshot);
+    const std::string prefix = path.filename().string() + ".";
+    for (const auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
+        if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sections larger than the writer's staging buffer, written in pieces and in
+// one go, read back whole; abandoned writers remove their temporary file
+void testSnapshotWriter() {
+    TempFile snapshot("sections.bin");
+    std::vector<std::uint64_t> large(400000);
+    std::iota(large.begin(), large.end(), std::uint64_t{7});
+    {
+        SnapshotWriter out(snapshot.path(), SnapshotSource{12, 34});
+        SnapshotBuffer& first = out.section("first");
+        first.put<std::uint32_t>(5);
+        first.putVector(large);
+        SnapshotBuffer& pieces = out.section("pieces");
+        pieces.put<std::uint64_t>(large.size());
+        for (std::size_t i = 0; i < large.size(); i += 1000) {
+            pieces.putValues(large.data() + i, 1000);
+        }
+        pieces.putString("end");
+        out.section("empty");
+
+        bool threw = false;
+        try {
+            first.put<std::uint32_t>(6);
+        } catch (const std::logic_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        out.commit();
+    }
+    CHECK(!hasTemporaries(snapshot.path()));
+
+    SnapshotReader in(snapshot.path());
+    CHECK(in.source() == (SnapshotSource{12, 34}));
+    SnapshotCursor first = in.section("first");
+    CHECK(first.get<std::uint32_t>() == 5);
+    std::vector<std::uint64_t> values;
+    first.getVector(values);
+    CHECK(values == large && first.atEnd());
+    SnapshotCursor pieces = in.section("pieces");
+    pieces.getVector(values);
+    CHECK(values == large && pieces.getString() == "end" && pieces.atEnd());
+    CHECK(in.section("empty").atEnd());
+
+    {
+        SnapshotWriter abandoned(snapshot.path());
+        abandoned.section("first").putVector(large);
+        CHECK(hasTemporaries(snapshot.path()));
+    }
+    CHECK(!hasTemporaries(snapshot.path()));
+    CHECK(SnapshotReader(snapshot.path()).hasSection("pieces"));
+}
+
+void testSnapshotRoundTrip() {
+    TempFile baseFile("snapshot_base.csv"), deltaFile("snapshot_delta.csv"), snapshot("snapshot.bin");
+    bench::SyntheticCollisions generator(31);
+    baseFile.write(generator.document(20000));
+    // Revisions of stored ids and new ones, so the spatial index holds delta trees and masked rows
+    deltaFile.write(generator.document(400, 19801));
+
+    CSVParser parser;
+    DataSet saved(parser.stringPool());
+    saved.setSpatialPartitions(4);
+    saved.loadFromFile(baseFile.path(), parser);
+    saved.appendFromFile(deltaFile.path(), parser);
+    saved.saveSnapshot(snapshot.path());
+
+    DataSet loaded(std::make_shared<StringPool>());
+    loaded.loadSnapshot(snapshot.path());
+    checkSameRecords(saved, loaded);
+    CHECK(saved.columns().uniqueKey(123) == loaded.columns().uniqueKey(123));
+    CHECK(saved.spatialIndexStats().partitions == loaded.spatialIndexStats().partitions);
+    CHECK(saved.spatialIndexStats().values == loaded.spatialIndexStats().values);
+    CHECK(saved.tiles().cellCount() == loaded.tiles().cellCount());
+    CHECK(saved.parseStats().records == loaded.parseStats().records);
+
+    // Loading needs an empty dataset, and a failed load leaves the dataset empty
+    bool threw = false;
+    try {
+        loaded.loadSnapshot(snapshot.path());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw && loaded.size() == saved.size());
+
+    auto conflicting = std::make_shared<StringPool>();
+    conflicting->encode(StringDomain::Borough, "NOT A BOROUGH");
+    DataSet other(conflicting);
+    threw = false;
+    try {
+        other.loadSnapshot(snapshot.path());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw && other.size() == 0);
+}
+
+// Readers must see every published version whole: its size, its key map and
+// its date order agree, whatever the publisher is doing meanwhile
+void testLiveReadsDuringPublish() {
+    constexpr int kBaseRows = 4000;
+    constexpr int kDeltaRows = 200;
+    constexpr int kPublishes = 12;
+    constexpr int kReaders = 3;
+    bench::SyntheticCollisions original(41);
+    bench::SyntheticCollisions revised(42);
+
+    // Each delta revises the first rows and appends the next kDeltaRows ids
+    TempFile baseFile("live_base.csv");
+    baseFile.write(original.document(kBaseRows));
+    std::vector<TempFile> deltas;
+    deltas.reserve(kPublishes);
+    for (int i = 0; i < kPublishes; ++i) {
+        deltas.emplace_back("live_delta" + std::to_string(i) + ".csv");
+        std::string text = revised.document(50);
+        for (int id = kBaseRows + i * kDeltaRows + 1; id <= kBaseRows + (i + 1) * kDeltaRows; ++id) {
+            text += revised.row(id) + "\n";
+        }
+        deltas.back().write(text);
+    }
+
+    CSVParser parser;
+    LiveDataSet live(parser.stringPool());
+    live.loadFromFile(baseFile.path(), parser);
+    const std::shared_ptr<const DataSet> pinned = live.current();
+
+    const Timestamp first = std::numeric_limits<Timestamp>::min();
+    const Timestamp last = std::numeric_limits<Timestamp>::max();
+    std::atomic<bool> publishing{true};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; ++r) {
+        readers.emplace_back([&] {
+            std::size_t previous = 0;
+            std::size_t reads = 0;
+            while (publishing.load() || reads == 0) {
+                const std::size_t size = live.read([&](const DataSet& dataset) {
+                    // Ids run 1..size in every version
+                    const std::size_t rows = dataset.size();
+                    const int highest = static_cast<int>(rows);
+                    CHECK(rows >= kBaseRows && (rows - kBaseRows) % kDeltaRows == 0);
+                    CHECK(dataset.queryByUniqueKey(highest) != nullptr);
+                    CHECK(dataset.queryByUniqueKey(highest + 1) == nullptr);
+                    CHECK(dataset.rowsByDateRange(first, last).size() == rows);
+                    return rows;
+                });
+                CHECK(size >= previous);
+                previous = size;
+                ++reads;
+            }
+        });
+    }
+
+    // Publish through both update() and the loading shortcuts
+    for (int i = 0; i < kPublishes; ++i) {
+        if (i % 2 == 0) {
+            live.appendFromFile(deltas[i].path(), parser);
+        } else {
+            live.update([&](DataSet& next) { next.appendFromFile(deltas[i].path(), parser); });
+        }
+    }
+    publishing = false;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    CHECK(live.version() == 2 + kPublishes);
+    CHECK(live.current()->size() == kBaseRows + kPublishes * kDeltaRows);
+
+    // The version pinned before the publishes is unchanged and still usable
+    CHECK(pinned->size() == kBaseRows);
+    CHECK(pinned->queryByUniqueKey(kBaseRows) != nullptr);
+    CHECK(pinned->queryByUniqueKey(kBaseRows + 1) == nullptr);
+    CHECK(pinned->rowsByDateRange(first, last).size() == kBaseRows);
+    DataSet reloaded(parser.stringPool());
+    reloaded.loadFromFile(baseFile.path(), parser);
+    checkSameRecords(*pinned, reloaded);
+}
+
+} // namespace
+
+int main() {
+    try {
+        testScannerKernels();
+        testChunkedParse();
+        testBitmapAddRemove();
+        testBitmapSetOperations();
+        testBitmapCopiesAreIndependent();
+        testUpsert();
+        testQueryMatchesScan();
+        testNeighborsMatchScan();
+        testSnapshotWriter();
+        testSnapshotRoundTrip();
+        testLiveReadsDuringPublish();
+        testDbscanMatchesPairwise();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Unexpected exception: %s\n", e.what());
+        return 1;
+    }
+    if (failures != 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures.load());
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}